@@ -0,0 +1,80 @@
+//
+//
+//  Description:
+//      Implementation of the cluster backend interface.  A backend answers for one
+//      scheduler (cluster type, head node and script directory) and takes whole
+//      batches of jobs per call, for status queries, submission and killing.
+//      Backends are shared by every session of the server process.
+//
+//  Author:
+//      Dan Ginsburg
+//
+//  Children's Hospital Boston
+//  GPL v2
+//
+#include "ClusterBackend.h"
+#include "ScriptClusterBackend.h"
+#include "LocalClusterBackend.h"
+
+///
+//  Namespaces
+//
+using namespace std;
+
+///
+//  Static data
+//
+const char *ClusterBackend::LOCAL_CLUSTER_TYPE = "local";
+std::map<std::string, boost::shared_ptr<ClusterBackend> > ClusterBackend::mBackends;
+boost::mutex ClusterBackend::mBackendsMutex;
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Constructor/Destructor
+//
+//
+
+///
+//  Constructor
+//
+ClusterBackend::ClusterBackend()
+{
+}
+
+///
+//  Destructor
+//
+ClusterBackend::~ClusterBackend()
+{
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Public Members
+//
+//
+
+///
+//  Get the process-wide backend of a cluster, created on first use
+//
+boost::shared_ptr<ClusterBackend> ClusterBackend::getBackend(const std::string& clusterType,
+                                                             const std::string& clusterHeadNode,
+                                                             const std::string& scriptDir)
+{
+    boost::mutex::scoped_lock lock(mBackendsMutex);
+
+    boost::shared_ptr<ClusterBackend>& backend = mBackends[clusterType + ":" + clusterHeadNode + ":" + scriptDir];
+    if (backend == NULL)
+    {
+        if (clusterType == LOCAL_CLUSTER_TYPE)
+        {
+            backend.reset(new LocalClusterBackend(scriptDir));
+        }
+        else
+        {
+            backend.reset(new ScriptClusterBackend(clusterType, clusterHeadNode, scriptDir));
+        }
+    }
+
+    return backend;
+}
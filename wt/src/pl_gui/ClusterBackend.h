@@ -0,0 +1,106 @@
+//
+//
+//  Description:
+//      Definition of the cluster backend interface.  A backend answers for one
+//      scheduler (cluster type, head node and script directory) and takes whole
+//      batches of jobs per call, for status queries, submission and killing.
+//      Backends are shared by every session of the server process.
+//
+//  Author:
+//      Dan Ginsburg
+//
+//  Children's Hospital Boston
+//  GPL v2
+//
+#ifndef CLUSTERBACKEND_H
+#define CLUSTERBACKEND_H
+
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <map>
+#include <string>
+#include <vector>
+
+///
+/// \class ClusterBackend
+/// \brief Interface to a cluster scheduler that takes batches of jobs
+///
+class ClusterBackend
+{
+public:
+
+    /// State of a job in the scheduler
+    typedef enum
+    {
+        JOB_NOT_FOUND,      // The scheduler does not know the job (not queued yet, or finished)
+        JOB_QUEUED,         // Waiting for a node
+        JOB_RUNNING         // Running
+    } JobStateEnum;
+
+    /// Job known to the scheduler
+    typedef struct
+    {
+        /// Job ID, with the prefix of the cluster
+        std::string mJobId;
+
+        /// Cluster sh file of the job
+        std::string mClusterShFile;
+
+    } JobRef;
+
+    /// Cluster type of the local fake scheduler, used by pl_cluster_bench
+    static const char *LOCAL_CLUSTER_TYPE;
+
+    ///
+    /// Destructor
+    ///
+    virtual ~ClusterBackend();
+
+    ///
+    /// Get the state of jobs in the scheduler
+    /// \param jobs Jobs to query
+    /// \param states Filled with the state of each job
+    /// \return false if the scheduler could not be asked, states are then not known
+    ///
+    virtual bool queryStatus(const std::vector<JobRef>& jobs, std::vector<JobStateEnum>& states) = 0;
+
+    ///
+    /// Submit jobs to the scheduler
+    /// \param commands Shell command of each job
+    /// \param jobIds Filled with the ID of each job
+    /// \return false if the backend cannot submit single jobs
+    ///
+    virtual bool submit(const std::vector<std::string>& commands, std::vector<std::string>& jobIds) = 0;
+
+    ///
+    /// Kill jobs
+    ///
+    virtual void kill(const std::vector<JobRef>& jobs) = 0;
+
+    ///
+    /// Get the process-wide backend of a cluster, created on first use
+    /// \param clusterType Cluster type (mosix, pbs, ... or LOCAL_CLUSTER_TYPE)
+    /// \param clusterHeadNode Cluster head node, empty for the local host
+    /// \param scriptDir Directory holding the cluster scripts
+    ///
+    static boost::shared_ptr<ClusterBackend> getBackend(const std::string& clusterType,
+                                                        const std::string& clusterHeadNode,
+                                                        const std::string& scriptDir);
+
+protected:
+
+    ///
+    /// Constructor
+    ///
+    ClusterBackend();
+
+private:
+
+    /// Backends by cluster
+    static std::map<std::string, boost::shared_ptr<ClusterBackend> > mBackends;
+
+    /// Mutex protecting the backends
+    static boost::mutex mBackendsMutex;
+};
+
+#endif // CLUSTERBACKEND_H
@@ -0,0 +1,200 @@
+//
+//
+//  Description:
+//      Benchmark of a cluster backend, pl_cluster_bench.  Submits a number of jobs
+//      in batches and then polls their status the way JobStatusPoller does, once
+//      per interval for all of them in one batch, until the scheduler has finished
+//      them all.  The time taken by submission and by each status query is
+//      reported.
+//
+//      With the default cluster type of "local" the jobs run as processes on this
+//      box (LocalClusterBackend), so no cluster is needed.  The script clusters
+//      cannot submit single jobs and are not benchmarked here.
+//
+//  Author:
+//      Dan Ginsburg
+//
+//  Children's Hospital Boston
+//  GPL v2
+//
+#include "ClusterBackend.h"
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/thread/thread.hpp>
+#include <iostream>
+#include <sstream>
+#include <stdlib.h>
+#include <unistd.h>
+
+///
+//  Namespaces
+//
+using namespace std;
+using namespace boost::posix_time;
+
+///
+//  Interval between status queries, the same as JobStatusPoller::POLL_INTERVAL_MS
+//
+static const int POLL_INTERVAL_MS = 1000;
+
+///
+//  Print usage
+//
+static void usage(const char *program)
+{
+    cerr << "Usage: " << program << " [-n numJobs] [-t jobSeconds] [-b batchSize]" << endl
+         << "       [-C clusterType] [-r clusterHeadNode] [-s scriptDir]" << endl
+         << endl
+         << "  -n  Number of jobs to submit (default 100)" << endl
+         << "  -t  Seconds each job sleeps (default 1)" << endl
+         << "  -b  Number of jobs per submit call (default 100)" << endl
+         << "  -C  Cluster type (default " << ClusterBackend::LOCAL_CLUSTER_TYPE << ")" << endl
+         << "  -r  Cluster head node (default the local host)" << endl
+         << "  -s  Directory the jobs run from (default the current directory)" << endl;
+}
+
+///
+//  Main entrypoint
+//
+int main(int argc, char **argv)
+{
+    int numJobs = 100;
+    int jobSeconds = 1;
+    int batchSize = 100;
+    std::string clusterType = ClusterBackend::LOCAL_CLUSTER_TYPE;
+    std::string clusterHeadNode;
+    std::string scriptDir;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "n:t:b:C:r:s:h")) != -1)
+    {
+        switch (opt)
+        {
+        case 'n':
+            numJobs = atoi(optarg);
+            break;
+        case 't':
+            jobSeconds = atoi(optarg);
+            break;
+        case 'b':
+            batchSize = atoi(optarg);
+            break;
+        case 'C':
+            clusterType = optarg;
+            break;
+        case 'r':
+            clusterHeadNode = optarg;
+            break;
+        case 's':
+            scriptDir = optarg;
+            break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (numJobs < 1 || jobSeconds < 0 || batchSize < 1)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    boost::shared_ptr<ClusterBackend> backend = ClusterBackend::getBackend(clusterType, clusterHeadNode, scriptDir);
+
+    // Submit the jobs in batches
+    std::ostringstream command;
+    command << "sleep " << jobSeconds;
+
+    std::vector<ClusterBackend::JobRef> jobs;
+    ptime submitStart = microsec_clock::universal_time();
+
+    for (int first = 0; first < numJobs; first += batchSize)
+    {
+        int count = (numJobs - first < batchSize) ? numJobs - first : batchSize;
+        std::vector<std::string> commands(count, command.str());
+        std::vector<std::string> jobIds;
+
+        if (!backend->submit(commands, jobIds))
+        {
+            cerr << "Cluster type " << clusterType << " cannot submit jobs" << endl;
+            return 1;
+        }
+
+        for (size_t i = 0; i < jobIds.size(); i++)
+        {
+            ClusterBackend::JobRef job;
+            job.mJobId = jobIds[i];
+            jobs.push_back(job);
+        }
+    }
+
+    time_duration submitTime = microsec_clock::universal_time() - submitStart;
+
+    // Poll all of the jobs in one batch per interval until none is left
+    int numQueries = 0;
+    int numFailedQueries = 0;
+    time_duration queryTime = seconds(0);
+    time_duration maxQueryTime = seconds(0);
+    ptime pollStart = microsec_clock::universal_time();
+
+    while (true)
+    {
+        std::vector<ClusterBackend::JobStateEnum> states;
+        ptime queryStart = microsec_clock::universal_time();
+        bool answered = backend->queryStatus(jobs, states);
+        time_duration elapsed = microsec_clock::universal_time() - queryStart;
+
+        numQueries++;
+        queryTime += elapsed;
+        if (elapsed > maxQueryTime)
+        {
+            maxQueryTime = elapsed;
+        }
+
+        int numQueued = 0;
+        int numRunning = 0;
+        if (answered)
+        {
+            for (size_t i = 0; i < states.size(); i++)
+            {
+                if (states[i] == ClusterBackend::JOB_QUEUED)
+                {
+                    numQueued++;
+                }
+                else if (states[i] == ClusterBackend::JOB_RUNNING)
+                {
+                    numRunning++;
+                }
+            }
+
+            cout << "Query " << numQueries << ": " << numQueued << " queued, " << numRunning << " running ("
+                 << elapsed.total_microseconds() << " us)" << endl;
+
+            if (numQueued == 0 && numRunning == 0)
+            {
+                break;
+            }
+        }
+        else
+        {
+            numFailedQueries++;
+            cout << "Query " << numQueries << ": failed" << endl;
+        }
+
+        boost::this_thread::sleep(milliseconds((long)POLL_INTERVAL_MS));
+    }
+
+    time_duration pollTime = microsec_clock::universal_time() - pollStart;
+
+    cout << endl
+         << "Jobs:                 " << numJobs << endl
+         << "Submit time:          " << submitTime.total_milliseconds() << " ms ("
+         << ((double)submitTime.total_microseconds() / numJobs) << " us per job)" << endl
+         << "Time until finished:  " << pollTime.total_milliseconds() << " ms" << endl
+         << "Status queries:       " << numQueries << " (" << numFailedQueries << " failed)" << endl
+         << "Mean query time:      " << (queryTime.total_microseconds() / numQueries) << " us ("
+         << ((double)queryTime.total_microseconds() / numQueries / numJobs) << " us per job)" << endl
+         << "Longest query time:   " << maxQueryTime.total_microseconds() << " us" << endl;
+
+    return (numFailedQueries == 0) ? 0 : 1;
+}
@@ -0,0 +1,584 @@
+//
+//
+//  Description:
+//      Implementation of the cluster job catalog.  The catalog is an immutable
+//      snapshot of the <ClusterJob> records in schedule.log.xml, shared between all
+//      of the sessions in the server process (see ClusterJobCatalogCache).
+//
+//      The schedule log only ever grows, so a newer snapshot is built from the
+//      previous one plus the records appended to the file since.  Jobs are stored
+//      in fixed size blocks of rows.  Every full block is shared by all of the
+//      snapshots that contain it, so extending a snapshot only copies the last,
+//      partly filled block and parses the new records.
+//
+//      The sort orders are extended the same way: the new jobs are sorted on their
+//      own and merged into the order of the previous snapshot.  Likewise only the
+//      posting lists of the users and projects with new jobs are copied.
+//
+//  Author:
+//      Dan Ginsburg
+//
+//  Children's Hospital Boston
+//  GPL v2
+//
+#include "ClusterJobCatalog.h"
+#include "RowBitmap.h"
+#include "TextMatcher.h"
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <algorithm>
+#include <limits>
+#include <stdio.h>
+#include <string.h>
+
+///
+//  Namespaces
+//
+using namespace std;
+
+///
+//  Static data
+//
+const boost::int64_t ClusterJobCatalog::INVALID_TIME = std::numeric_limits<boost::int64_t>::min();
+
+const char* ClusterJobCatalog::mFieldTagNames[ClusterJobCatalog::NUM_FIELDS] =
+{
+    "Date",                 // DATE
+    "Command",              // COMMAND
+    "MetaScript",           // META_SCRIPT
+    "Arguments",            // ARGUMENTS
+    "JobId",                // JOB_ID
+    "Project",              // PROJECT
+    "User",                 // USER
+    "PatientID",            // PATIENT_ID
+    "PatientName",          // PATIENT_NAME
+    "ScanName",             // SCAN_NAME
+    "PatientBirthday",      // PATIENT_BIRTHDAY
+    "ImageScanDate",        // IMAGE_SCAN_DATE
+    "ScannerManufacturer",  // SCANNER_MANUFACTURER
+    "ScannerModel",         // SCANNER_MODEL
+    "SoftwareVer",          // SOFTWARE_VER
+};
+
+const int ClusterJobCatalog::mSortKeyFields[ClusterJobCatalog::NUM_SORT_KEYS] =
+{
+    ClusterJobCatalog::DATE,            // SORT_DATE
+    ClusterJobCatalog::USER,            // SORT_USER
+    ClusterJobCatalog::PATIENT_ID,      // SORT_MRID
+    ClusterJobCatalog::META_SCRIPT,     // SORT_PIPELINE
+};
+
+const int ClusterJobCatalog::mSearchFields[] =
+{
+    ClusterJobCatalog::DATE,
+    ClusterJobCatalog::PATIENT_ID,
+    ClusterJobCatalog::PATIENT_NAME,
+    ClusterJobCatalog::SCAN_NAME,
+    ClusterJobCatalog::PATIENT_BIRTHDAY,
+    ClusterJobCatalog::IMAGE_SCAN_DATE,
+    ClusterJobCatalog::SCANNER_MANUFACTURER,
+    ClusterJobCatalog::SCANNER_MODEL,
+    ClusterJobCatalog::SOFTWARE_VER,
+    ClusterJobCatalog::META_SCRIPT,
+};
+
+const int ClusterJobCatalog::NUM_SEARCH_FIELDS = sizeof(ClusterJobCatalog::mSearchFields) / sizeof(int);
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Constructor/Destructor
+//
+//
+
+///
+//  Constructor
+//
+ClusterJobCatalog::ClusterJobCatalog() :
+    mNumJobs(0)
+{
+    mLastRecord.mOffset = 0;
+    mLastRecord.mLength = 0;
+    mLastRecord.mHash = 0;
+
+    for (int key = 0; key < NUM_SORT_KEYS; key++)
+    {
+        mSortOrders[key].reset(new std::vector<int>());
+    }
+}
+
+///
+//  Destructor
+//
+ClusterJobCatalog::~ClusterJobCatalog()
+{
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Public Members
+//
+//
+
+///
+//  Build a catalog of the jobs of a previous catalog followed by new records
+//
+boost::shared_ptr<ClusterJobCatalog> ClusterJobCatalog::extend(const ClusterJobCatalog *previous,
+                                                               XMLRecordParser& parser,
+                                                               const std::vector<XMLRecordParser::Record>& records,
+                                                               size_t first)
+{
+    boost::shared_ptr<ClusterJobCatalog> catalog(new ClusterJobCatalog());
+    boost::shared_ptr<Block> tail;
+
+    if (previous != NULL)
+    {
+        catalog->mBlocks = previous->mBlocks;
+        catalog->mNumJobs = previous->mNumJobs;
+        catalog->mLastRecord = previous->mLastRecord;
+
+        // The partly filled block is still part of the previous catalog, so new
+        // jobs go into a copy of it
+        int tailRows = catalog->mNumJobs % ROWS_PER_BLOCK;
+        if (tailRows > 0 && first < records.size())
+        {
+            const Block& last = *catalog->mBlocks.back();
+
+            tail.reset(new Block());
+            for (int i = 0; i < tailRows; i++)
+            {
+                copyJob(*tail, last, i);
+            }
+            catalog->mBlocks.pop_back();
+        }
+    }
+
+    for (size_t record = first; record < records.size(); record++)
+    {
+        // Parse a pass of jobs at a time on all cores, then add them in order
+        if ((record - first) % XMLRecordParser::RECORDS_PER_PASS == 0)
+        {
+            parser.parseRecords(records, record,
+                                std::min(XMLRecordParser::RECORDS_PER_PASS, records.size() - record));
+        }
+
+        if (tail == NULL)
+        {
+            tail.reset(new Block());
+        }
+
+        parseJob(*tail, parser, record);
+        catalog->mNumJobs++;
+
+        if ((int)tail->mTimes.size() == ROWS_PER_BLOCK)
+        {
+            catalog->mBlocks.push_back(tail);
+            tail.reset();
+        }
+    }
+
+    if (tail != NULL)
+    {
+        catalog->mBlocks.push_back(tail);
+    }
+
+    if (first < records.size())
+    {
+        catalog->mLastRecord = records.back();
+    }
+
+    for (int key = 0; key < NUM_SORT_KEYS; key++)
+    {
+        catalog->buildSortOrder(key, previous);
+    }
+    catalog->buildPostings(USER, previous);
+    catalog->buildPostings(PROJECT, previous);
+
+    return catalog;
+}
+
+///
+//  Get whether a job comes before another by a field, ties broken by row
+//
+bool ClusterJobCatalog::lessThan(int field, int row1, int row2) const
+{
+    int result;
+
+    if (field == DATE)
+    {
+        boost::int64_t time1 = getTime(row1);
+        boost::int64_t time2 = getTime(row2);
+
+        result = (time1 < time2) ? -1 : (time1 > time2 ? 1 : 0);
+    }
+    else
+    {
+        result = strcmp(getField(row1, field), getField(row2, field));
+    }
+
+    return result != 0 ? result < 0 : row1 < row2;
+}
+
+///
+//  Find the jobs whose user or project matches a filter
+//
+void ClusterJobCatalog::findRows(int field, const std::string& filter, std::vector<int>& rows) const
+{
+    const PostingMap& postings = getPostings(field);
+    TextMatcher matcher(filter);
+
+    rows.clear();
+
+    // A plain name is a single lookup
+    if (!matcher.hasRegExp())
+    {
+        PostingMap::const_iterator iter = postings.find(filter);
+        if (iter != postings.end())
+        {
+            rows = *iter->second;
+        }
+        return;
+    }
+
+    // A regular expression is matched against each distinct name
+    int numMatched = 0;
+    for (PostingMap::const_iterator iter = postings.begin(); iter != postings.end(); iter++)
+    {
+        if (matcher.regExpMatch(iter->first.c_str()))
+        {
+            rows.insert(rows.end(), iter->second->begin(), iter->second->end());
+            numMatched++;
+        }
+    }
+
+    if (numMatched > 1)
+    {
+        std::sort(rows.begin(), rows.end());
+    }
+}
+
+///
+//  Find the jobs where any of the searchable fields matches a search term
+//
+void ClusterJobCatalog::search(const TextMatcher& matcher, RowBitmap& rows) const
+{
+    for (size_t blockIndex = 0; blockIndex < mBlocks.size(); blockIndex++)
+    {
+        const Block& block = *mBlocks[blockIndex];
+        int firstRow = (int)blockIndex * ROWS_PER_BLOCK;
+        int numRows = (int)block.mTimes.size();
+
+        // One scan over the text of the whole block.  After a match the scan
+        // resumes at the next job, since the job already matched.
+        if (!block.mSearchText.empty())
+        {
+            const char *text = &block.mSearchText[0];
+            const char *textEnd = text + block.mSearchText.size();
+            const char *pos = text;
+            int index = 0;
+
+            while (index < numRows && (pos = matcher.find(pos, textEnd)) != NULL)
+            {
+                index = (int)(std::upper_bound(block.mSearchOffsets.begin() + index, block.mSearchOffsets.end(),
+                                               (int)(pos - text)) - block.mSearchOffsets.begin()) - 1;
+                rows.set(firstRow + index);
+
+                index++;
+                if (index < numRows)
+                {
+                    pos = text + block.mSearchOffsets[index];
+                }
+            }
+        }
+
+        if (matcher.hasRegExp())
+        {
+            for (int index = 0; index < numRows; index++)
+            {
+                if (!rows.test(firstRow + index) && regExpMatches(matcher, firstRow + index))
+                {
+                    rows.set(firstRow + index);
+                }
+            }
+        }
+    }
+}
+
+///
+//  Get whether any of the searchable fields of a job matches a search term
+//
+bool ClusterJobCatalog::searchMatches(const TextMatcher& matcher, int row) const
+{
+    const Block& block = getBlock(row);
+    int index = row % ROWS_PER_BLOCK;
+    int begin = block.mSearchOffsets[index];
+    int end = (index + 1 < (int)block.mSearchOffsets.size()) ? block.mSearchOffsets[index + 1] :
+                                                                (int)block.mSearchText.size();
+
+    if (begin < end && matcher.find(&block.mSearchText[begin], &block.mSearchText[0] + end) != NULL)
+    {
+        return true;
+    }
+
+    return matcher.hasRegExp() && regExpMatches(matcher, row);
+}
+
+///
+//  Parse a schedule log date (MM/dd/yy HH:mm:ss ddd)
+//
+boost::int64_t ClusterJobCatalog::parseTime(const std::string& dateStr)
+{
+    int month, day, year, hour, minute, second;
+
+    if (sscanf(dateStr.c_str(), "%d/%d/%d %d:%d:%d", &month, &day, &year, &hour, &minute, &second) != 6 ||
+        hour < 0 || hour > 23 || minute < 0 || minute > 59 || second < 0 || second > 59)
+    {
+        return INVALID_TIME;
+    }
+
+    // Two digit years
+    if (year < 70)
+    {
+        year += 2000;
+    }
+    else if (year < 100)
+    {
+        year += 1900;
+    }
+
+    try
+    {
+        boost::posix_time::ptime time(boost::gregorian::date(year, month, day),
+                                      boost::posix_time::time_duration(hour, minute, second));
+        boost::posix_time::ptime epoch(boost::gregorian::date(1970, 1, 1));
+
+        return (time - epoch).total_seconds();
+    }
+    catch (...)
+    {
+        // Day or month out of range
+        return INVALID_TIME;
+    }
+}
+
+///
+//  Format a timestamp the way the results table shows it
+//
+std::string ClusterJobCatalog::formatTime(boost::int64_t time)
+{
+    boost::posix_time::ptime dateTime = boost::posix_time::ptime(boost::gregorian::date(1970, 1, 1)) +
+                                        boost::posix_time::seconds((long)time);
+    boost::gregorian::date date = dateTime.date();
+    boost::posix_time::time_duration timeOfDay = dateTime.time_of_day();
+
+    char buf[64];
+    snprintf(buf, sizeof(buf), "%s %s %d %02d:%02d:%02d %04d",
+             date.day_of_week().as_short_string(), date.month().as_short_string(), (int)date.day(),
+             (int)timeOfDay.hours(), (int)timeOfDay.minutes(), (int)timeOfDay.seconds(), (int)date.year());
+
+    return buf;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Private Members
+//
+//
+
+///
+//  Get whether a search term matches any of the searchable fields of a job as a
+//  whole-string regular expression
+//
+bool ClusterJobCatalog::regExpMatches(const TextMatcher& matcher, int row) const
+{
+    for (int i = 0; i < NUM_SEARCH_FIELDS; i++)
+    {
+        if (hasField(row, mSearchFields[i]) &&
+            matcher.regExpMatch(getSearchValue(getBlock(row), row % ROWS_PER_BLOCK, mSearchFields[i]).c_str()))
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+///
+//  Build the posting lists of a field from those of a previous catalog and the
+//  jobs added since
+//
+void ClusterJobCatalog::buildPostings(int field, const ClusterJobCatalog *previous)
+{
+    PostingMap& postings = getPostings(field);
+    int firstNew = 0;
+
+    if (previous != NULL)
+    {
+        postings = previous->getPostings(field);
+        firstNew = previous->mNumJobs;
+    }
+
+    std::map< std::string, std::vector<int> > newRows;
+    for (int row = firstNew; row < mNumJobs; row++)
+    {
+        if (hasField(row, field))
+        {
+            newRows[getField(row, field)].push_back(row);
+        }
+    }
+
+    // The lists of the previous catalog are shared, so a list with new rows is a copy
+    for (std::map< std::string, std::vector<int> >::const_iterator iter = newRows.begin();
+         iter != newRows.end(); iter++)
+    {
+        boost::shared_ptr< std::vector<int> > rows(new std::vector<int>());
+
+        PostingMap::const_iterator existing = postings.find(iter->first);
+        if (existing != postings.end())
+        {
+            rows->reserve(existing->second->size() + iter->second.size());
+            rows->insert(rows->end(), existing->second->begin(), existing->second->end());
+        }
+        rows->insert(rows->end(), iter->second.begin(), iter->second.end());
+
+        postings[iter->first] = rows;
+    }
+}
+
+///
+//  Build the sort order of a key from the order of a previous catalog and the
+//  jobs added since
+//
+void ClusterJobCatalog::buildSortOrder(int key, const ClusterJobCatalog *previous)
+{
+    int firstNew = 0;
+    if (previous != NULL)
+    {
+        firstNew = previous->mNumJobs;
+
+        if (firstNew == mNumJobs)
+        {
+            mSortOrders[key] = previous->mSortOrders[key];
+            return;
+        }
+    }
+
+    FieldLess less(*this, mSortKeyFields[key]);
+
+    std::vector<int> newRows;
+    newRows.reserve(mNumJobs - firstNew);
+    for (int row = firstNew; row < mNumJobs; row++)
+    {
+        newRows.push_back(row);
+    }
+    std::sort(newRows.begin(), newRows.end(), less);
+
+    boost::shared_ptr< std::vector<int> > sortOrder(new std::vector<int>(mNumJobs));
+    if (previous != NULL)
+    {
+        const std::vector<int>& previousOrder = *previous->mSortOrders[key];
+
+        std::merge(previousOrder.begin(), previousOrder.end(),
+                   newRows.begin(), newRows.end(),
+                   sortOrder->begin(), less);
+    }
+    else
+    {
+        sortOrder->swap(newRows);
+    }
+
+    mSortOrders[key] = sortOrder;
+}
+
+///
+//  Append a copy of a job of another block
+//
+void ClusterJobCatalog::copyJob(Block& block, const Block& other, int index)
+{
+    for (int field = 0; field < NUM_FIELDS; field++)
+    {
+        int offset = other.mFieldOffsets[field][index];
+
+        addField(block, field, offset >= 0 ? &other.mStringData[offset] : "", offset >= 0);
+    }
+
+    block.mTimes.push_back(other.mTimes[index]);
+    addSearchText(block);
+}
+
+///
+//  Append a parsed <ClusterJob> record
+//
+void ClusterJobCatalog::parseJob(Block& block, const XMLRecordParser& parser, size_t record)
+{
+    for (int field = 0; field < NUM_FIELDS; field++)
+    {
+        const XMLRecordParser::Element *element = parser.findElement(record, mFieldTagNames[field]);
+        std::string value;
+
+        if (element != NULL)
+        {
+            value = XMLRecordParser::getText(*element);
+        }
+
+        // Like the results table always did, an invalid date is kept as such
+        addField(block, field, value, element != NULL && (field == DATE || value != "ERROR:"));
+    }
+
+    int dateOffset = block.mFieldOffsets[DATE].back();
+    block.mTimes.push_back(dateOffset >= 0 ? parseTime(&block.mStringData[dateOffset]) : INVALID_TIME);
+    addSearchText(block);
+}
+
+///
+//  Append the lowercase searchable fields of the last job added to a block
+//
+void ClusterJobCatalog::addSearchText(Block& block)
+{
+    int index = (int)block.mTimes.size() - 1;
+
+    block.mSearchOffsets.push_back((int)block.mSearchText.size());
+
+    // Fields are NUL separated so that a match never spans two of them
+    for (int i = 0; i < NUM_SEARCH_FIELDS; i++)
+    {
+        if (block.mFieldOffsets[mSearchFields[i]][index] < 0)
+        {
+            continue;
+        }
+
+        std::string value = getSearchValue(block, index, mSearchFields[i]);
+        size_t start = block.mSearchText.size();
+
+        block.mSearchText.insert(block.mSearchText.end(), value.c_str(), value.c_str() + value.size() + 1);
+        TextMatcher::toLower(&block.mSearchText[start], &block.mSearchText[start] + value.size());
+    }
+}
+
+///
+//  Get the text of a searchable field of a job as the results table shows it
+//
+std::string ClusterJobCatalog::getSearchValue(const Block& block, int index, int field)
+{
+    // The date is shown as a WDateTime, so "2012" or "Mar" find it
+    if (field == DATE && block.mTimes[index] != INVALID_TIME)
+    {
+        return formatTime(block.mTimes[index]);
+    }
+
+    return &block.mStringData[block.mFieldOffsets[field][index]];
+}
+
+///
+//  Append a field value to a block
+//
+void ClusterJobCatalog::addField(Block& block, int field, const std::string& value, bool isSet)
+{
+    if (!isSet)
+    {
+        block.mFieldOffsets[field].push_back(-1);
+        return;
+    }
+
+    block.mFieldOffsets[field].push_back((int)block.mStringData.size());
+    block.mStringData.insert(block.mStringData.end(), value.begin(), value.end());
+    block.mStringData.push_back('\0');
+}
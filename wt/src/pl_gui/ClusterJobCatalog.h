@@ -0,0 +1,340 @@
+//
+//
+//  Description:
+//      Definition of the cluster job catalog.  The catalog is an immutable snapshot
+//      of the <ClusterJob> records in schedule.log.xml, shared between all of the
+//      sessions in the server process (see ClusterJobCatalogCache).
+//
+//      The schedule log only ever grows, so a newer snapshot is built from the
+//      previous one plus the records appended to the file since.  Jobs are stored
+//      in fixed size blocks of rows.  Every full block is shared by all of the
+//      snapshots that contain it, so extending a snapshot only copies the last,
+//      partly filled block and parses the new records.
+//
+//      The job date is parsed once into a timestamp when the record is read.  The
+//      catalog also keeps the order of the jobs by date, user, MRID and pipeline,
+//      so that the results table can show them sorted without sorting per session.
+//
+//      For filtering, the catalog keeps the rows of each user and each project
+//      (posting lists), and a lowercase copy of the searchable fields of every job
+//      in one buffer per block, which a free-text search scans in a single pass.
+//
+//  Author:
+//      Dan Ginsburg
+//
+//  Children's Hospital Boston
+//  GPL v2
+//
+#ifndef CLUSTERJOBCATALOG_H
+#define CLUSTERJOBCATALOG_H
+
+#include "XMLRecordParser.h"
+#include <boost/shared_ptr.hpp>
+#include <boost/cstdint.hpp>
+#include <map>
+#include <string>
+#include <vector>
+
+class RowBitmap;
+class TextMatcher;
+
+///
+/// \class ClusterJobCatalog
+/// \brief Immutable, append-only snapshot of the jobs in schedule.log.xml
+///
+class ClusterJobCatalog
+{
+public:
+
+    /// Fields stored per job, in the order of the elements of <ClusterJob>
+    typedef enum
+    {
+        DATE = 0,
+        COMMAND,
+        META_SCRIPT,
+        ARGUMENTS,
+        JOB_ID,
+        PROJECT,
+        USER,
+        PATIENT_ID,
+        PATIENT_NAME,
+        SCAN_NAME,
+        PATIENT_BIRTHDAY,
+        IMAGE_SCAN_DATE,
+        SCANNER_MANUFACTURER,
+        SCANNER_MODEL,
+        SOFTWARE_VER,
+
+        NUM_FIELDS
+    } FieldEnum;
+
+    /// Keys the jobs are kept sorted by
+    typedef enum
+    {
+        SORT_DATE = 0,
+        SORT_USER,
+        SORT_MRID,
+        SORT_PIPELINE,
+
+        NUM_SORT_KEYS
+    } SortKeyEnum;
+
+    /// Number of jobs per block
+    static const int ROWS_PER_BLOCK = 4096;
+
+    /// Timestamp of a job without a date or whose date could not be parsed
+    static const boost::int64_t INVALID_TIME;
+
+    ///
+    /// Constructor, creates an empty catalog
+    ///
+    ClusterJobCatalog();
+
+    ///
+    /// Destructor
+    ///
+    virtual ~ClusterJobCatalog();
+
+    ///
+    /// Build a catalog of the jobs of a previous catalog followed by the records of
+    /// a mapped schedule log
+    /// \param previous Catalog to extend, NULL to start from an empty catalog
+    /// \param parser Parser with the schedule log mapped
+    /// \param records Records to add, found by the parser
+    /// \param first Index of the first record to add
+    /// \return New catalog
+    ///
+    static boost::shared_ptr<ClusterJobCatalog> extend(const ClusterJobCatalog *previous,
+                                                       XMLRecordParser& parser,
+                                                       const std::vector<XMLRecordParser::Record>& records,
+                                                       size_t first);
+
+    ///
+    /// Get the number of jobs
+    ///
+    int getNumJobs() const                          {   return mNumJobs;    }
+
+    ///
+    /// Get whether a job has a field.  Fields that were missing, or other than the
+    /// date set to "ERROR:", in the log are not set.
+    ///
+    bool hasField(int row, int field) const
+    {
+        return getBlock(row).mFieldOffsets[field][row % ROWS_PER_BLOCK] >= 0;
+    }
+
+    ///
+    /// Get the value of a field of a job, empty if it is not set
+    ///
+    const char* getField(int row, int field) const
+    {
+        const Block& block = getBlock(row);
+        int offset = block.mFieldOffsets[field][row % ROWS_PER_BLOCK];
+
+        return offset >= 0 ? &block.mStringData[offset] : "";
+    }
+
+    ///
+    /// Get the date of a job as seconds since 1970-01-01 00:00:00, in the time zone
+    /// of the log
+    /// \return Timestamp, or INVALID_TIME if the job has no valid date
+    ///
+    boost::int64_t getTime(int row) const          {   return getBlock(row).mTimes[row % ROWS_PER_BLOCK];  }
+
+    ///
+    /// Get the jobs in ascending order of a sort key, jobs with the same key in
+    /// the order they were scheduled.  Jobs without a value sort first.
+    /// \param key SortKeyEnum to get the order of
+    /// \return Rows of the jobs, in order
+    ///
+    const std::vector<int>& getSortOrder(int key) const     {   return *mSortOrders[key];   }
+
+    ///
+    /// Get the field a sort key orders the jobs by
+    ///
+    static int getSortKeyField(int key)             {   return mSortKeyFields[key];     }
+
+    ///
+    /// Get whether a job comes before another by a field, ties broken by row
+    ///
+    bool lessThan(int field, int row1, int row2) const;
+
+    ///
+    /// Find the jobs whose user or project matches a filter.  The filter is matched
+    /// against the whole name, as a regular expression if it contains regular
+    /// expression syntax.
+    /// \param field USER or PROJECT
+    /// \param filter Filter to match
+    /// \param rows Filled with the rows of the matching jobs, in ascending order
+    ///
+    void findRows(int field, const std::string& filter, std::vector<int>& rows) const;
+
+    ///
+    /// Find the jobs where any of the searchable fields matches a search term
+    /// \param matcher Compiled search term
+    /// \param rows Matching rows are set in this bitmap, of getNumJobs() rows
+    ///
+    void search(const TextMatcher& matcher, RowBitmap& rows) const;
+
+    ///
+    /// Get whether any of the searchable fields of a job matches a search term
+    ///
+    bool searchMatches(const TextMatcher& matcher, int row) const;
+
+    ///
+    /// \class FieldLess
+    /// \brief Orders the rows of a catalog by a field, for std::sort and std::merge
+    ///
+    class FieldLess
+    {
+    public:
+        FieldLess(const ClusterJobCatalog& catalog, int field) :
+            mCatalog(&catalog),
+            mField(field)
+        {
+        }
+
+        bool operator()(int row1, int row2) const
+        {
+            return mCatalog->lessThan(mField, row1, row2);
+        }
+
+    private:
+        const ClusterJobCatalog *mCatalog;
+        int mField;
+    };
+
+    ///
+    /// Get the name of the XML element of a field
+    ///
+    static const char* getFieldTagName(int field)   {   return mFieldTagNames[field];   }
+
+    ///
+    /// Parse a schedule log date (MM/dd/yy HH:mm:ss ddd)
+    /// \return Timestamp, or INVALID_TIME if the date could not be parsed
+    ///
+    static boost::int64_t parseTime(const std::string& dateStr);
+
+    ///
+    /// Format a timestamp the way the results table shows it, in the default format
+    /// of WDateTime (ddd MMM d HH:mm:ss yyyy)
+    ///
+    static std::string formatTime(boost::int64_t time);
+
+    ///
+    /// Get the last record in the file the catalog was read from, used to check
+    /// that the file was only appended to.  Its length is 0 if the catalog is empty.
+    ///
+    const XMLRecordParser::Record& getLastRecord() const  {   return mLastRecord;     }
+
+private:
+
+    /// Fixed size block of jobs
+    typedef struct
+    {
+        /// NUL terminated field values
+        std::vector<char> mStringData;
+
+        /// Offset of each field value in mStringData, -1 if the field is not set
+        std::vector<int> mFieldOffsets[NUM_FIELDS];
+
+        /// Timestamp of each job
+        std::vector<boost::int64_t> mTimes;
+
+        /// Lowercase, NUL separated searchable fields of each job
+        std::vector<char> mSearchText;
+
+        /// Offset of the searchable fields of each job in mSearchText
+        std::vector<int> mSearchOffsets;
+
+    } Block;
+
+    /// Rows of the jobs of each user or project, in ascending order
+    typedef std::map< std::string, boost::shared_ptr< const std::vector<int> > > PostingMap;
+
+    ///
+    /// Get the block that holds a row
+    ///
+    const Block& getBlock(int row) const            {   return *mBlocks[row / ROWS_PER_BLOCK];  }
+
+    ///
+    /// Append a copy of a job of another block
+    ///
+    static void copyJob(Block& block, const Block& other, int index);
+
+    ///
+    /// Append a parsed <ClusterJob> record
+    ///
+    static void parseJob(Block& block, const XMLRecordParser& parser, size_t record);
+
+    ///
+    /// Append a field value to a block
+    ///
+    static void addField(Block& block, int field, const std::string& value, bool isSet);
+
+    ///
+    /// Append the lowercase searchable fields of the last job added to a block
+    ///
+    static void addSearchText(Block& block);
+
+    ///
+    /// Get the text of a searchable field of a job as the results table shows it
+    ///
+    static std::string getSearchValue(const Block& block, int index, int field);
+
+    ///
+    /// Get whether a search term matches any of the searchable fields of a job as a
+    /// whole-string regular expression
+    ///
+    bool regExpMatches(const TextMatcher& matcher, int row) const;
+
+    ///
+    /// Get the posting lists of a field
+    ///
+    PostingMap& getPostings(int field)              {   return field == USER ? mUserRows : mProjectRows;    }
+    const PostingMap& getPostings(int field) const  {   return field == USER ? mUserRows : mProjectRows;    }
+
+    ///
+    /// Build the posting lists of a field from those of a previous catalog and the
+    /// jobs added since
+    ///
+    void buildPostings(int field, const ClusterJobCatalog *previous);
+
+    ///
+    /// Build the sort order of a key from the order of a previous catalog and
+    /// the jobs added since
+    ///
+    void buildSortOrder(int key, const ClusterJobCatalog *previous);
+
+    /// Blocks of jobs, all but the last are full
+    std::vector< boost::shared_ptr<const Block> > mBlocks;
+
+    /// Number of jobs
+    int mNumJobs;
+
+    /// Rows of the jobs in order of each sort key
+    boost::shared_ptr< const std::vector<int> > mSortOrders[NUM_SORT_KEYS];
+
+    /// Rows of the jobs of each user
+    PostingMap mUserRows;
+
+    /// Rows of the jobs of each project
+    PostingMap mProjectRows;
+
+    /// Last record of the file
+    XMLRecordParser::Record mLastRecord;
+
+    /// Element name of each field
+    static const char* mFieldTagNames[NUM_FIELDS];
+
+    /// Field of each sort key
+    static const int mSortKeyFields[NUM_SORT_KEYS];
+
+    /// Fields searched by free text, every column of the results table but the user
+    static const int mSearchFields[];
+
+    /// Number of entries in mSearchFields
+    static const int NUM_SEARCH_FIELDS;
+};
+
+#endif // CLUSTERJOBCATALOG_H
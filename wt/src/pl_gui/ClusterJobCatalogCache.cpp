@@ -0,0 +1,178 @@
+//
+//
+//  Description:
+//      Implementation of the process-wide cluster job catalog cache.  Every session
+//      shares the same immutable ClusterJobCatalog snapshot of schedule.log.xml
+//      through a reference-counted pointer.
+//
+//      The schedule log is appended to by each submission, so when it grows the
+//      cache tails it: only the records after the last one it has seen are found
+//      and parsed, and the new snapshot shares everything else with the previous
+//      one.  If the file was replaced or rewritten instead, it is read from the
+//      start.
+//
+//  Author:
+//      Dan Ginsburg
+//
+//  Children's Hospital Boston
+//  GPL v2
+//
+#include "ClusterJobCatalogCache.h"
+#include "ClusterJobCatalog.h"
+#include "XMLRecordParser.h"
+#include <Wt/WApplication>
+#include <Wt/WLogger>
+#include <sys/stat.h>
+#include <vector>
+
+///
+//  Namespaces
+//
+using namespace Wt;
+using namespace std;
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Constructor/Destructor
+//
+//
+
+///
+//  Constructor
+//
+ClusterJobCatalogCache::ClusterJobCatalogCache()
+{
+}
+
+///
+//  Destructor
+//
+ClusterJobCatalogCache::~ClusterJobCatalogCache()
+{
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Public Members
+//
+//
+
+///
+//  Get the process-wide cache instance
+//
+ClusterJobCatalogCache& ClusterJobCatalogCache::instance()
+{
+    static ClusterJobCatalogCache cache;
+    return cache;
+}
+
+///
+//  Get the current catalog for a schedule log
+//
+boost::shared_ptr<const ClusterJobCatalog> ClusterJobCatalogCache::getCatalog(const std::string& scheduleLogFile)
+{
+    struct stat fileStat;
+    CacheEntry entry;
+    entry.mInode = 0;
+    entry.mModTime = 0;
+    entry.mFileSize = 0;
+
+    if (stat(scheduleLogFile.c_str(), &fileStat) == 0)
+    {
+        entry.mInode = fileStat.st_ino;
+        entry.mModTime = fileStat.st_mtime;
+        entry.mFileSize = fileStat.st_size;
+    }
+
+    // Fast path: the cached snapshot is still current
+    {
+        boost::mutex::scoped_lock lock(mEntriesMutex);
+        std::map<std::string, CacheEntry>::const_iterator iter = mEntries.find(scheduleLogFile);
+        if (iter != mEntries.end() &&
+            iter->second.mInode == entry.mInode &&
+            iter->second.mModTime == entry.mModTime &&
+            iter->second.mFileSize == entry.mFileSize)
+        {
+            return iter->second.mCatalog;
+        }
+    }
+
+    // Only one session loads at a time.  Anyone who was waiting on the load
+    // picks up the snapshot that was just built rather than reading again.
+    boost::mutex::scoped_lock loadLock(mLoadMutex);
+    boost::shared_ptr<const ClusterJobCatalog> previous;
+    {
+        boost::mutex::scoped_lock lock(mEntriesMutex);
+        std::map<std::string, CacheEntry>::const_iterator iter = mEntries.find(scheduleLogFile);
+        if (iter != mEntries.end())
+        {
+            if (iter->second.mInode == entry.mInode &&
+                iter->second.mModTime == entry.mModTime &&
+                iter->second.mFileSize == entry.mFileSize)
+            {
+                return iter->second.mCatalog;
+            }
+
+            // A file that shrank or was replaced is read from the start
+            if (iter->second.mInode == entry.mInode &&
+                iter->second.mFileSize <= entry.mFileSize)
+            {
+                previous = iter->second.mCatalog;
+            }
+        }
+    }
+
+    XMLRecordParser parser("ClusterJob");
+    if (!parser.mapFile(scheduleLogFile))
+    {
+        WApplication::instance()->log("error") << "Failed opening schedule XML log file for reading: " << scheduleLogFile;
+        return boost::shared_ptr<const ClusterJobCatalog>(new ClusterJobCatalog());
+    }
+
+    // A job being appended by the scheduler is picked up on the next refresh
+    std::vector<XMLRecordParser::Record> records;
+    size_t first = 0;
+
+    if (previous != NULL && previous->getLastRecord().mLength > 0)
+    {
+        // Resume from the last record seen.  If it is still there unchanged, the
+        // file was only appended to and the records after it are new.
+        const XMLRecordParser::Record& last = previous->getLastRecord();
+        parser.findRecords(records, last.mOffset);
+
+        if (!records.empty() &&
+            records[0].mOffset == last.mOffset &&
+            records[0].mLength == last.mLength &&
+            records[0].mHash == last.mHash)
+        {
+            first = 1;
+        }
+        else
+        {
+            previous.reset();
+        }
+    }
+    else
+    {
+        previous.reset();
+    }
+
+    if (previous == NULL)
+    {
+        parser.findRecords(records);
+        first = 0;
+    }
+
+    entry.mCatalog = ClusterJobCatalog::extend(previous.get(), parser, records, first);
+
+    WApplication::instance()->log("info") << "Loaded cluster job catalog " << scheduleLogFile << " ("
+                                          << entry.mCatalog->getNumJobs() << " jobs, "
+                                          << records.size() - first << " parsed)";
+
+    // Swap in the new snapshot.  Sessions holding the previous snapshot keep
+    // their reference until they refresh.
+    boost::mutex::scoped_lock lock(mEntriesMutex);
+    mEntries[scheduleLogFile] = entry;
+
+    return entry.mCatalog;
+}
@@ -0,0 +1,93 @@
+//
+//
+//  Description:
+//      Definition of the process-wide cluster job catalog cache.  Every session
+//      shares the same immutable ClusterJobCatalog snapshot of schedule.log.xml
+//      through a reference-counted pointer.
+//
+//      The schedule log is appended to by each submission, so when it grows the
+//      cache tails it: only the records after the last one it has seen are found
+//      and parsed, and the new snapshot shares everything else with the previous
+//      one.  If the file was replaced or rewritten instead, it is read from the
+//      start.
+//
+//  Author:
+//      Dan Ginsburg
+//
+//  Children's Hospital Boston
+//  GPL v2
+//
+#ifndef CLUSTERJOBCATALOGCACHE_H
+#define CLUSTERJOBCATALOGCACHE_H
+
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/cstdint.hpp>
+#include <sys/types.h>
+#include <ctime>
+#include <map>
+#include <string>
+
+class ClusterJobCatalog;
+
+///
+/// \class ClusterJobCatalogCache
+/// \brief Singleton that holds the shared ClusterJobCatalog snapshot for each schedule log
+///
+class ClusterJobCatalogCache
+{
+public:
+
+    ///
+    /// Get the process-wide cache instance
+    ///
+    static ClusterJobCatalogCache& instance();
+
+    ///
+    /// Get the current catalog for a schedule log.  The file is read on first use
+    /// and the records appended to it are added whenever it changes.
+    /// \param scheduleLogFile Full path to schedule.log.xml
+    /// \return Shared catalog snapshot (never NULL, empty if the file could not be read)
+    ///
+    boost::shared_ptr<const ClusterJobCatalog> getCatalog(const std::string& scheduleLogFile);
+
+private:
+
+    ///
+    /// Constructor
+    ///
+    ClusterJobCatalogCache();
+
+    ///
+    /// Destructor
+    ///
+    virtual ~ClusterJobCatalogCache();
+
+    /// Cached catalog for a single file
+    typedef struct
+    {
+        /// Current snapshot
+        boost::shared_ptr<const ClusterJobCatalog> mCatalog;
+
+        /// Inode of the file the snapshot was read from
+        ino_t mInode;
+
+        /// Modification time of the file the snapshot was read from
+        std::time_t mModTime;
+
+        /// Size of the file the snapshot was read from
+        boost::uintmax_t mFileSize;
+
+    } CacheEntry;
+
+    /// Cached catalogs, keyed by file path
+    std::map<std::string, CacheEntry> mEntries;
+
+    /// Mutex protecting mEntries
+    boost::mutex mEntriesMutex;
+
+    /// Mutex serializing loads, so that only one session reads a changed file
+    boost::mutex mLoadMutex;
+};
+
+#endif // CLUSTERJOBCATALOGCACHE_H
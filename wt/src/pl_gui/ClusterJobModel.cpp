@@ -0,0 +1,654 @@
+//
+//
+//  Description:
+//      Implementation of the cluster job model.  This is a per-session item model
+//      over the shared ClusterJobCatalog snapshot, with the columns of the results
+//      table.  Every data() request is answered directly from the catalog, so a
+//      session keeps no copy of the jobs and only the rows the view shows are
+//      ever read.
+//
+//      The model sorts and filters the jobs itself.  It keeps only the list of
+//      catalog rows that pass the filters, in the order of the sort column.  For
+//      the columns the catalog keeps a sort order of, that list is a walk over the
+//      precomputed order, so changing a filter never sorts.  The direction of the
+//      sort is applied when mapping rows, so reversing it costs nothing.
+//
+//      The user and project filters are answered from the posting lists of the
+//      catalog, and the search term is compiled once into a TextMatcher.  Only the
+//      jobs that pass the user and project filters are searched, and the full
+//      catalog is searched in one scan of its lowercase text.
+//
+//      The status column is fed by the job status poller.  The view only asks for
+//      the data of the rows it renders, so the rows asked the status of are the
+//      window around what is shown.  Their jobs are watched in one subscription,
+//      updated after each batch of requests, and the poller posts the states of
+//      all of them that changed in a poll at once.  Jobs are dropped from the
+//      subscription once they finish, their final state is kept.
+//
+//  Author:
+//      Dan Ginsburg
+//
+//  Children's Hospital Boston
+//  GPL v2
+//
+#include "ClusterJobModel.h"
+#include "ClusterJobCatalog.h"
+#include "RowBitmap.h"
+#include "TextMatcher.h"
+#include "MetaLogParser.h"
+#include "PipelineApp.h"
+#include "ConfigOptions.h"
+#include <Wt/WString>
+#include <Wt/WDateTime>
+#include <Wt/WDate>
+#include <Wt/WTime>
+#include <boost/bind.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <algorithm>
+#include <iterator>
+#include <sstream>
+#include <math.h>
+
+///
+//  Namespaces
+//
+using namespace Wt;
+using namespace std;
+
+///
+//  Static data
+//
+const ClusterJobModel::ColumnInfo ClusterJobModel::mColumnInfo[ClusterJobModel::NUM_COLUMNS] =
+{
+    { ClusterJobCatalog::DATE,                  ClusterJobCatalog::SORT_DATE,       "Date"          },  // DATE_COLUMN
+    { ClusterJobCatalog::USER,                  ClusterJobCatalog::SORT_USER,       "User"          },  // USER_COLUMN
+    { ClusterJobCatalog::PATIENT_ID,            ClusterJobCatalog::SORT_MRID,       "MRID"          },  // MRID_COLUMN
+    { ClusterJobCatalog::PATIENT_NAME,          -1,                                 "Name"          },  // NAME_COLUMN
+    { ClusterJobCatalog::SCAN_NAME,             -1,                                 "Scan Name"     },  // SCAN_NAME_COLUMN
+    { ClusterJobCatalog::PATIENT_BIRTHDAY,      -1,                                 "Birthday"      },  // BIRTHDAY_COLUMN
+    { ClusterJobCatalog::IMAGE_SCAN_DATE,       -1,                                 "Scan Date"     },  // SCAN_DATE_COLUMN
+    { ClusterJobCatalog::SCANNER_MANUFACTURER,  -1,                                 "Manufacturer"  },  // MANUFACTURER_COLUMN
+    { ClusterJobCatalog::SCANNER_MODEL,         -1,                                 "Model"         },  // MODEL_COLUMN
+    { ClusterJobCatalog::SOFTWARE_VER,          -1,                                 "Software Ver"  },  // SOFTWARE_VER_COLUMN
+    { ClusterJobCatalog::META_SCRIPT,           ClusterJobCatalog::SORT_PIPELINE,   "Pipeline"      },  // PIPELINE_COLUMN
+    { -1,                                       -1,                                 "Status"        },  // STATUS_COLUMN
+};
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Constructor/Destructor
+//
+//
+
+///
+//  Constructor
+//
+ClusterJobModel::ClusterJobModel(WObject *parent) :
+    WAbstractTableModel(parent),
+    mCatalog(new ClusterJobCatalog()),
+    mSubscriptionId(-1),
+    mNumStatusRequests(0),
+    mWatchUpdatePending(false)
+{
+    mClusterJob.mJobIDPrefix = getConfigOptionsPtr()->GetJobIDPrefix();
+    mClusterJob.mClusterType = getConfigOptionsPtr()->GetClusterType();
+    mClusterJob.mClusterHeadNode = getConfigOptionsPtr()->GetClusterHeadNode();
+    mClusterJob.mScriptDir = getConfigOptionsPtr()->GetScriptDir();
+    mClusterJob.mClusterDir = getConfigOptionsPtr()->GetClusterDir();
+    mKeyPrefix = JobStatusPoller::getKey(mClusterJob);
+
+    resetAll();
+}
+
+///
+//  Destructor
+//
+ClusterJobModel::~ClusterJobModel()
+{
+    if (mSubscriptionId != -1)
+    {
+        JobStatusPoller::instance().unsubscribe(mSubscriptionId);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Public Members
+//
+//
+
+///
+//  Clear the filters and sort by date, newest first
+//
+void ClusterJobModel::resetAll()
+{
+    mUserFilter = false;
+    mSearchTerm = false;
+    mProjectFilter = false;
+    mUserFilterStr = "";
+    mSearchMatcher.reset();
+    mProjectFilterStr = "";
+    mSortColumn = DATE_COLUMN;
+    mSortOrder = DescendingOrder;
+
+    updateRows();
+    reset();
+}
+
+///
+//  Set the catalog that backs the model, resetting the model
+//
+void ClusterJobModel::setCatalog(boost::shared_ptr<const ClusterJobCatalog> catalog)
+{
+    mCatalog = catalog;
+
+    updateRows();
+    reset();
+}
+
+///
+// Set user filter
+//
+void ClusterJobModel::setUserFilter(bool filter, std::string userFilter)
+{
+    mUserFilter = filter;
+    mUserFilterStr = userFilter;
+
+    updateRows();
+    reset();
+}
+
+///
+// Set search term
+//
+void ClusterJobModel::setSearchTerm(bool search, std::string searchTerm)
+{
+    mSearchTerm = search;
+    mSearchMatcher.reset(new TextMatcher(searchTerm));
+
+    updateRows();
+    reset();
+}
+
+///
+//  Set project filter
+//
+void ClusterJobModel::setProjectFilter(bool filter, std::string projectFilter)
+{
+    mProjectFilter = filter;
+    mProjectFilterStr = projectFilter;
+
+    updateRows();
+    reset();
+}
+
+///
+//  Return the number of columns
+//
+int ClusterJobModel::columnCount(const WModelIndex& parent) const
+{
+    return parent.isValid() ? 0 : NUM_COLUMNS;
+}
+
+///
+//  Return the number of rows
+//
+int ClusterJobModel::rowCount(const WModelIndex& parent) const
+{
+    return parent.isValid() ? 0 : (int)mRows.size();
+}
+
+///
+//  Return the data for an index in the given role
+//
+boost::any ClusterJobModel::data(const WModelIndex& index, int role) const
+{
+    if (!index.isValid() || index.row() >= (int)mRows.size())
+    {
+        return boost::any();
+    }
+
+    int row = getCatalogRow(index.row());
+
+    if (role == DisplayRole)
+    {
+        if (index.column() == DATE_COLUMN)
+        {
+            return dateData(row);
+        }
+
+        if (index.column() == STATUS_COLUMN)
+        {
+            return statusData(index.row(), row);
+        }
+
+        return fieldData(row, mColumnInfo[index.column()].mField);
+    }
+
+    if (index.column() != DATE_COLUMN)
+    {
+        return boost::any();
+    }
+
+    switch (role)
+    {
+    case COMMAND_ROLE:
+        return fieldData(row, ClusterJobCatalog::COMMAND);
+    case META_SCRIPT_ROLE:
+        return fieldData(row, ClusterJobCatalog::META_SCRIPT);
+    case ARGUMENTS_ROLE:
+        return fieldData(row, ClusterJobCatalog::ARGUMENTS);
+    case JOB_ID_ROLE:
+        return fieldData(row, ClusterJobCatalog::JOB_ID);
+    case PROJECT_ROLE:
+        return fieldData(row, ClusterJobCatalog::PROJECT);
+    default:
+        return boost::any();
+    }
+}
+
+///
+//  Return the header data for a column
+//
+boost::any ClusterJobModel::headerData(int section, Orientation orientation, int role) const
+{
+    if (orientation != Horizontal || role != DisplayRole || section < 0 || section >= NUM_COLUMNS)
+    {
+        return boost::any();
+    }
+
+    return boost::any(WString::fromUTF8(mColumnInfo[section].mHeader));
+}
+
+///
+//  Sort the model by a column
+//
+void ClusterJobModel::sort(int column, SortOrder order)
+{
+    // The status is not a field of the catalog
+    if (column < 0 || column >= NUM_COLUMNS || mColumnInfo[column].mField < 0)
+    {
+        return;
+    }
+
+    layoutAboutToBeChanged().emit();
+
+    // The view asks the status of the rows it shows again
+    mStatusRows.clear();
+
+    // Reversing the direction only changes how rows are mapped
+    bool columnChanged = (column != mSortColumn);
+    mSortColumn = column;
+    mSortOrder = order;
+
+    if (columnChanged)
+    {
+        updateRows();
+    }
+
+    layoutChanged().emit();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Private Members
+//
+//
+
+///
+//  Rebuild the list of rows that pass the filters, in order of the sort column
+//
+void ClusterJobModel::updateRows()
+{
+    const ClusterJobCatalog& catalog = *mCatalog;
+    int numJobs = catalog.getNumJobs();
+    int sortKey = mColumnInfo[mSortColumn].mSortKey;
+
+    mRows.clear();
+    mStatusRows.clear();
+
+    if (!mUserFilter && !mSearchTerm && !mProjectFilter)
+    {
+        if (sortKey >= 0)
+        {
+            mRows = catalog.getSortOrder(sortKey);
+            return;
+        }
+
+        mRows.reserve(numJobs);
+        for (int row = 0; row < numJobs; row++)
+        {
+            mRows.push_back(row);
+        }
+    }
+    else
+    {
+        // Rows that pass the filters, in ascending order
+        findRows(mRows);
+
+        // A large result is ordered by walking the precomputed order, a small one
+        // by sorting it
+        if (sortKey >= 0 && (double)mRows.size() * log((double)mRows.size() + 1.0) > (double)numJobs)
+        {
+            RowBitmap accepted(numJobs);
+            for (size_t i = 0; i < mRows.size(); i++)
+            {
+                accepted.set(mRows[i]);
+            }
+
+            const std::vector<int>& sortOrder = catalog.getSortOrder(sortKey);
+            size_t numRows = 0;
+            for (size_t i = 0; i < sortOrder.size(); i++)
+            {
+                if (accepted.test(sortOrder[i]))
+                {
+                    mRows[numRows++] = sortOrder[i];
+                }
+            }
+            return;
+        }
+    }
+
+    std::sort(mRows.begin(), mRows.end(),
+              ClusterJobCatalog::FieldLess(catalog, mColumnInfo[mSortColumn].mField));
+}
+
+///
+//  Find the rows that pass the filters
+//
+void ClusterJobModel::findRows(std::vector<int>& rows) const
+{
+    const ClusterJobCatalog& catalog = *mCatalog;
+    bool haveRows = false;
+
+    if (mProjectFilter)
+    {
+        catalog.findRows(ClusterJobCatalog::PROJECT, mProjectFilterStr, rows);
+        haveRows = true;
+    }
+
+    if (mUserFilter)
+    {
+        std::vector<int> userRows;
+        catalog.findRows(ClusterJobCatalog::USER, mUserFilterStr, userRows);
+
+        if (haveRows)
+        {
+            std::vector<int> intersection;
+            std::set_intersection(rows.begin(), rows.end(), userRows.begin(), userRows.end(),
+                                  std::back_inserter(intersection));
+            rows.swap(intersection);
+        }
+        else
+        {
+            rows.swap(userRows);
+        }
+        haveRows = true;
+    }
+
+    if (mSearchTerm)
+    {
+        if (haveRows)
+        {
+            size_t numRows = 0;
+            for (size_t i = 0; i < rows.size(); i++)
+            {
+                if (catalog.searchMatches(*mSearchMatcher, rows[i]))
+                {
+                    rows[numRows++] = rows[i];
+                }
+            }
+            rows.resize(numRows);
+        }
+        else
+        {
+            RowBitmap matches(catalog.getNumJobs());
+            catalog.search(*mSearchMatcher, matches);
+
+            for (int row = matches.findNext(0); row >= 0; row = matches.findNext(row + 1))
+            {
+                rows.push_back(row);
+            }
+        }
+    }
+}
+
+///
+//  Get the catalog row of a model row
+//
+int ClusterJobModel::getCatalogRow(int row) const
+{
+    return mSortOrder == AscendingOrder ? mRows[row] : mRows[mRows.size() - 1 - row];
+}
+
+///
+//  Return a field of a job as model data, empty if the field is not set
+//
+boost::any ClusterJobModel::fieldData(int row, int field) const
+{
+    if (!mCatalog->hasField(row, field))
+    {
+        return boost::any();
+    }
+
+    return boost::any(WString::fromUTF8(mCatalog->getField(row, field)));
+}
+
+///
+//  Return the date of a job as model data
+//
+boost::any ClusterJobModel::dateData(int row) const
+{
+    if (!mCatalog->hasField(row, ClusterJobCatalog::DATE))
+    {
+        return boost::any();
+    }
+
+    boost::int64_t time = mCatalog->getTime(row);
+    if (time == ClusterJobCatalog::INVALID_TIME)
+    {
+        return boost::any(WDateTime());
+    }
+
+    boost::posix_time::ptime dateTime = boost::posix_time::ptime(boost::gregorian::date(1970, 1, 1)) +
+                                        boost::posix_time::seconds((long)time);
+    boost::gregorian::date date = dateTime.date();
+    boost::posix_time::time_duration timeOfDay = dateTime.time_of_day();
+
+    return boost::any(WDateTime(WDate(date.year(), date.month(), date.day()),
+                                WTime(timeOfDay.hours(), timeOfDay.minutes(), timeOfDay.seconds())));
+}
+
+///
+//  Return the status of a job as model data, and watch the job while its row is shown
+//
+boost::any ClusterJobModel::statusData(int row, int catalogRow) const
+{
+    if (!mCatalog->hasField(catalogRow, ClusterJobCatalog::JOB_ID))
+    {
+        return boost::any();
+    }
+
+    // The requests of a render are collected and the watched jobs updated once,
+    // after the view is done
+    mStatusRows[row] = mNumStatusRequests++;
+    if (!mWatchUpdatePending)
+    {
+        mWatchUpdatePending = true;
+        IOExecutor::instance().post(mIOClient.getApp(), mIOClient.getClientId(),
+                                    boost::bind(&ClusterJobModel::updateWatchedJobs,
+                                                const_cast<ClusterJobModel*>(this), _1));
+    }
+
+    JobStatusPoller::JobStateMap::const_iterator iter =
+        mJobStates.find(mKeyPrefix + mCatalog->getField(catalogRow, ClusterJobCatalog::JOB_ID));
+    if (iter == mJobStates.end())
+    {
+        return boost::any();
+    }
+
+    const JobStatusPoller::JobState& state = iter->second;
+    std::ostringstream text;
+
+    switch (state.mStatus)
+    {
+    case JobStatusPoller::STATUS_WAITING:
+        text << "Waiting";
+        break;
+    case JobStatusPoller::STATUS_QUEUED:
+        text << "Queued";
+        break;
+    case JobStatusPoller::STATUS_RUNNING:
+        text << "Running";
+        if (state.mPercentComplete >= 0)
+        {
+            text << " (" << state.mPercentComplete << "%)";
+        }
+        break;
+    case JobStatusPoller::STATUS_COMPLETED_SUCCESS:
+        text << "Success";
+        break;
+    case JobStatusPoller::STATUS_COMPLETED_FAILURE:
+        text << "Failure";
+        break;
+    case JobStatusPoller::STATUS_UNKNOWN:
+        text << "Unknown";
+        break;
+    default:
+        return boost::any();
+    }
+
+    return boost::any(WString::fromUTF8(text.str()));
+}
+
+///
+//  Get the status poller job of a catalog row
+//
+JobStatusPoller::Job ClusterJobModel::getJob(int catalogRow) const
+{
+    JobStatusPoller::Job job = mClusterJob;
+    job.mJobId = mCatalog->getField(catalogRow, ClusterJobCatalog::JOB_ID);
+    job.mClusterShFile = mCatalog->getField(catalogRow, ClusterJobCatalog::COMMAND);
+    job.mMetaScript = mCatalog->getField(catalogRow, ClusterJobCatalog::META_SCRIPT);
+    job.mStages = MetaLogParser::getStages(mCatalog->getField(catalogRow, ClusterJobCatalog::ARGUMENTS));
+
+    return job;
+}
+
+///
+//  Watch the jobs of the rows the view asked the status of [IOExecutor callback]
+//
+void ClusterJobModel::updateWatchedJobs(IOExecutor::StatusEnum status)
+{
+    mWatchUpdatePending = false;
+
+    // Keep the rows asked for most recently, the view renders around what is shown
+    if ((int)mStatusRows.size() > MAX_WATCHED_JOBS)
+    {
+        std::vector<int> requests;
+        for (std::map<int, int>::const_iterator iter = mStatusRows.begin(); iter != mStatusRows.end(); ++iter)
+        {
+            requests.push_back(iter->second);
+        }
+        std::nth_element(requests.begin(), requests.end() - MAX_WATCHED_JOBS, requests.end());
+        int firstKept = *(requests.end() - MAX_WATCHED_JOBS);
+
+        std::map<int, int>::iterator iter = mStatusRows.begin();
+        while (iter != mStatusRows.end())
+        {
+            if (iter->second < firstKept)
+            {
+                mStatusRows.erase(iter++);
+            }
+            else
+            {
+                ++iter;
+            }
+        }
+    }
+
+    std::vector<JobStatusPoller::Job> jobs;
+    for (std::map<int, int>::const_iterator iter = mStatusRows.begin(); iter != mStatusRows.end(); ++iter)
+    {
+        if (iter->first >= (int)mRows.size())
+        {
+            continue;
+        }
+
+        JobStatusPoller::Job job = getJob(getCatalogRow(iter->first));
+
+        // Finished jobs are not polled again
+        JobStatusPoller::JobStateMap::const_iterator stateIter = mJobStates.find(JobStatusPoller::getKey(job));
+        if (stateIter == mJobStates.end() || !isTerminal(stateIter->second))
+        {
+            jobs.push_back(job);
+        }
+    }
+
+    if (mSubscriptionId == -1)
+    {
+        mSubscriptionId = JobStatusPoller::instance().subscribeJobs(mIOClient.getApp(), mIOClient.getClientId(), jobs,
+                                                                    boost::bind(&ClusterJobModel::jobStatesChanged, this, _1));
+    }
+    else
+    {
+        JobStatusPoller::instance().setJobs(mSubscriptionId, jobs);
+    }
+}
+
+///
+//  Job states changed [JobStatusPoller callback]
+//
+void ClusterJobModel::jobStatesChanged(const JobStatusPoller::JobStateMap& states)
+{
+    bool haveTerminal = false;
+    for (JobStatusPoller::JobStateMap::const_iterator iter = states.begin(); iter != states.end(); ++iter)
+    {
+        mJobStates[iter->first] = iter->second;
+        haveTerminal = haveTerminal || isTerminal(iter->second);
+    }
+
+    // Only the rows the view asked for can show a status
+    int firstRow = -1;
+    int lastRow = -1;
+    for (std::map<int, int>::const_iterator iter = mStatusRows.begin(); iter != mStatusRows.end(); ++iter)
+    {
+        if (iter->first >= (int)mRows.size())
+        {
+            continue;
+        }
+
+        int catalogRow = getCatalogRow(iter->first);
+        if (states.find(mKeyPrefix + mCatalog->getField(catalogRow, ClusterJobCatalog::JOB_ID)) != states.end())
+        {
+            if (firstRow == -1)
+            {
+                firstRow = iter->first;
+            }
+            lastRow = iter->first;
+        }
+    }
+
+    if (firstRow != -1)
+    {
+        dataChanged().emit(index(firstRow, STATUS_COLUMN), index(lastRow, STATUS_COLUMN));
+    }
+
+    // Stop watching the jobs that finished
+    if (haveTerminal && !mWatchUpdatePending)
+    {
+        mWatchUpdatePending = true;
+        IOExecutor::instance().post(mIOClient.getApp(), mIOClient.getClientId(),
+                                    boost::bind(&ClusterJobModel::updateWatchedJobs, this, _1));
+    }
+}
+
+///
+//  Get whether a job state is final
+//
+bool ClusterJobModel::isTerminal(const JobStatusPoller::JobState& state)
+{
+    // The poller reports a failure for a while before it is sure of it, the job
+    // stays watched until then
+    return state.mFinal;
+}
@@ -0,0 +1,275 @@
+//
+//
+//  Description:
+//      Definition of the cluster job model.  This is a per-session item model over
+//      the shared ClusterJobCatalog snapshot, with the columns of the results table.
+//      Every data() request is answered directly from the catalog, so a session
+//      keeps no copy of the jobs and only the rows the view shows are ever read.
+//
+//      The model sorts and filters the jobs itself.  It keeps only the list of
+//      catalog rows that pass the filters, in the order of the sort column.  For
+//      the columns the catalog keeps a sort order of, that list is a walk over the
+//      precomputed order, and the direction of the sort is applied when mapping rows.
+//      The filters are answered from the posting lists and search text of the catalog.
+//
+//      The status column is fed by the job status poller.  Only the jobs of the
+//      rows the view asked the status of, a window around what is shown, are
+//      watched, and jobs are no longer watched once they finish.
+//
+//  Author:
+//      Dan Ginsburg
+//
+//  Children's Hospital Boston
+//  GPL v2
+//
+#ifndef CLUSTERJOBMODEL_H
+#define CLUSTERJOBMODEL_H
+
+#include "IOClient.h"
+#include "JobStatusPoller.h"
+#include <Wt/WAbstractTableModel>
+#include <boost/shared_ptr.hpp>
+#include <map>
+#include <string>
+#include <vector>
+
+class ClusterJobCatalog;
+class TextMatcher;
+
+using namespace Wt;
+
+///
+/// \class ClusterJobModel
+/// \brief Sorted and filtered item model of the results table over a shared ClusterJobCatalog
+///
+class ClusterJobModel : public WAbstractTableModel
+{
+public:
+
+    /// Columns of the model
+    typedef enum
+    {
+        DATE_COLUMN = 0,
+        USER_COLUMN,
+        MRID_COLUMN,
+        NAME_COLUMN,
+        SCAN_NAME_COLUMN,
+        BIRTHDAY_COLUMN,
+        SCAN_DATE_COLUMN,
+        MANUFACTURER_COLUMN,
+        MODEL_COLUMN,
+        SOFTWARE_VER_COLUMN,
+        PIPELINE_COLUMN,
+        STATUS_COLUMN,
+
+        NUM_COLUMNS
+    } ColumnEnum;
+
+    /// Extended (not for display) data of the date column
+    typedef enum
+    {
+        COMMAND_ROLE = Wt::UserRole,
+        META_SCRIPT_ROLE,
+        ARGUMENTS_ROLE,
+        JOB_ID_ROLE,
+        PROJECT_ROLE
+    } UserRoleEnum;
+
+    /// Maximum number of jobs whose status is watched, the most recently shown
+    static const int MAX_WATCHED_JOBS = 200;
+
+    ///
+    /// Constructor
+    ///
+    ClusterJobModel(WObject *parent = 0);
+
+    ///
+    /// Destructor
+    ///
+    virtual ~ClusterJobModel();
+
+    ///
+    /// Clear the filters and sort by date, newest first
+    ///
+    void resetAll();
+
+    ///
+    /// Set the catalog that backs the model, resetting the model
+    ///
+    void setCatalog(boost::shared_ptr<const ClusterJobCatalog> catalog);
+
+    ///
+    /// Get the catalog that backs the model
+    ///
+    const boost::shared_ptr<const ClusterJobCatalog>& getCatalog() const    {   return mCatalog;    }
+
+    ///
+    /// Set user filter
+    ///
+    void setUserFilter(bool filter, std::string userFilter = "");
+
+    ///
+    /// Set search term
+    ///
+    void setSearchTerm(bool search, std::string searchTerm = "");
+
+    ///
+    /// Set project filter
+    ///
+    void setProjectFilter(bool filter, std::string projectFilter = "");
+
+    ///
+    /// Return the number of columns
+    ///
+    virtual int columnCount(const WModelIndex& parent = WModelIndex()) const;
+
+    ///
+    /// Return the number of rows
+    ///
+    virtual int rowCount(const WModelIndex& parent = WModelIndex()) const;
+
+    ///
+    /// Return the data for an index in the given role
+    ///
+    virtual boost::any data(const WModelIndex& index, int role = DisplayRole) const;
+    using WAbstractTableModel::data;
+
+    ///
+    /// Return the header data for a column
+    ///
+    virtual boost::any headerData(int section, Orientation orientation = Horizontal,
+                                  int role = DisplayRole) const;
+
+    ///
+    /// Sort the model by a column
+    ///
+    virtual void sort(int column, SortOrder order = AscendingOrder);
+
+private:
+
+    ///
+    /// Rebuild the list of rows that pass the filters, in order of the sort column
+    ///
+    void updateRows();
+
+    ///
+    /// Find the rows that pass the filters
+    /// \param rows Filled with the catalog rows, in ascending order
+    ///
+    void findRows(std::vector<int>& rows) const;
+
+    ///
+    /// Get the catalog row of a model row
+    ///
+    int getCatalogRow(int row) const;
+
+    ///
+    /// Return a field of a job as model data, empty if the field is not set
+    ///
+    boost::any fieldData(int catalogRow, int field) const;
+
+    ///
+    /// Return the date of a job as model data
+    ///
+    boost::any dateData(int catalogRow) const;
+
+    ///
+    /// Return the status of a job as model data, and watch the job while its row is shown
+    ///
+    boost::any statusData(int row, int catalogRow) const;
+
+    ///
+    /// Get the status poller job of a catalog row
+    ///
+    JobStatusPoller::Job getJob(int catalogRow) const;
+
+    ///
+    /// Watch the jobs of the rows the view asked the status of [IOExecutor callback]
+    ///
+    void updateWatchedJobs(IOExecutor::StatusEnum status);
+
+    ///
+    /// Job states changed [JobStatusPoller callback]
+    ///
+    void jobStatesChanged(const JobStatusPoller::JobStateMap& states);
+
+    ///
+    /// Get whether a job state is final
+    ///
+    static bool isTerminal(const JobStatusPoller::JobState& state);
+
+    /// Column information
+    typedef struct
+    {
+        /// ClusterJobCatalog::FieldEnum shown in the column
+        int mField;
+
+        /// ClusterJobCatalog::SortKeyEnum of the column, -1 if the catalog has no order for it
+        int mSortKey;
+
+        /// Header text
+        const char *mHeader;
+
+    } ColumnInfo;
+
+    /// Static column info table
+    static const ColumnInfo mColumnInfo[NUM_COLUMNS];
+
+    /// Shared catalog snapshot
+    boost::shared_ptr<const ClusterJobCatalog> mCatalog;
+
+    /// Catalog rows that pass the filters, in ascending order of the sort column
+    std::vector<int> mRows;
+
+    /// Column sorted by
+    int mSortColumn;
+
+    /// Sort direction
+    SortOrder mSortOrder;
+
+    /// User filter on
+    bool mUserFilter;
+
+    /// Search term on
+    bool mSearchTerm;
+
+    /// Project filter on
+    bool mProjectFilter;
+
+    /// User filter
+    std::string mUserFilterStr;
+
+    /// Compiled search term
+    boost::shared_ptr<TextMatcher> mSearchMatcher;
+
+    /// Project filter
+    std::string mProjectFilterStr;
+
+    /// I/O client, status changes are posted for it
+    IOClient mIOClient;
+
+    /// Subscription to the job status poller, -1 if none
+    int mSubscriptionId;
+
+    /// Cluster settings every job is watched with
+    JobStatusPoller::Job mClusterJob;
+
+    /// Key of a job without its ID
+    std::string mKeyPrefix;
+
+    /// Last known state of jobs by key.  Final states are kept for good, those
+    /// jobs are never watched again.
+    JobStatusPoller::JobStateMap mJobStates;
+
+    /// Rows the view asked the status of since the rows last changed, with the
+    /// order they were asked in
+    mutable std::map<int, int> mStatusRows;
+
+    /// Number of status requests
+    mutable int mNumStatusRequests;
+
+    /// An update of the watched jobs is posted
+    mutable bool mWatchUpdatePending;
+};
+
+#endif // CLUSTERJOBMODEL_H
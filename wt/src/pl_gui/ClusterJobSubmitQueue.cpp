@@ -0,0 +1,385 @@
+//
+//
+//  Description:
+//      Implementation of the cluster job submission queue.  Sessions enqueue their
+//      submissions instead of running pl_batch_web.bash in the event handler.  A
+//      bounded pool of worker threads runs them, taking users in turn so that one
+//      user's large batch does not hold back everyone else.  Queued submissions
+//      with the same pipeline type and options are coalesced into a single batch
+//      file and pl_batch_web.bash run.  Progress and completion are reported to
+//      the submitting session by server push, through the IOExecutor.
+//
+//  Author:
+//      Dan Ginsburg
+//
+//  Children's Hospital Boston
+//  GPL v2
+//
+#include "ClusterJobSubmitQueue.h"
+#include <boost/bind.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/filesystem.hpp>
+#include <algorithm>
+#include <sstream>
+#include <fstream>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+///
+//  Namespaces
+//
+using namespace std;
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Constructor/Destructor
+//
+//
+
+///
+//  Constructor
+//
+ClusterJobSubmitQueue::ClusterJobSubmitQueue() :
+    mNextSequence(0)
+{
+    for (int i = 0; i < NUM_THREADS; i++)
+    {
+        boost::thread(boost::bind(&ClusterJobSubmitQueue::runWorker, this));
+    }
+}
+
+///
+//  Destructor
+//
+ClusterJobSubmitQueue::~ClusterJobSubmitQueue()
+{
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Public Members
+//
+//
+
+///
+//  Get the process-wide queue instance
+//
+ClusterJobSubmitQueue& ClusterJobSubmitQueue::instance()
+{
+    // Never destroyed, its threads run for the life of the process
+    static ClusterJobSubmitQueue *queue = new ClusterJobSubmitQueue();
+    return *queue;
+}
+
+///
+//  Enqueue a submission
+//
+void ClusterJobSubmitQueue::enqueue(WApplication *app, int clientId, const Submission& submission,
+                                    const ProgressCallback& progress)
+{
+    EntryPtr entry(new Entry());
+    entry->mSubmission = submission;
+    entry->mApp = app;
+    entry->mClientId = clientId;
+    entry->mProgress = progress;
+
+    boost::mutex::scoped_lock lock(mMutex);
+    entry->mSequence = mNextSequence++;
+
+    std::deque<EntryPtr>& userQueue = mUserQueues[submission.mUser];
+    if (userQueue.empty())
+    {
+        mUserOrder.push_back(submission.mUser);
+    }
+    userQueue.push_back(entry);
+
+    reportQueued();
+    mQueueCondition.notify_one();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Private Members
+//
+//
+
+///
+//  Run batches (worker thread)
+//
+void ClusterJobSubmitQueue::runWorker()
+{
+    while (true)
+    {
+        std::vector<EntryPtr> batch;
+
+        {
+            boost::mutex::scoped_lock lock(mMutex);
+            while (mUserOrder.empty())
+            {
+                mQueueCondition.wait(lock);
+            }
+
+            takeBatch(batch);
+            reportQueued();
+        }
+
+        runBatch(batch);
+    }
+}
+
+///
+//  Take the next batch
+//
+void ClusterJobSubmitQueue::takeBatch(std::vector<EntryPtr>& batch)
+{
+    // The oldest submission of the user whose turn it is
+    std::string user = mUserOrder.front();
+    mUserOrder.pop_front();
+
+    std::deque<EntryPtr>& userQueue = mUserQueues[user];
+    batch.push_back(userQueue.front());
+    userQueue.pop_front();
+
+    if (userQueue.empty())
+    {
+        mUserQueues.erase(user);
+    }
+    else
+    {
+        mUserOrder.push_back(user);
+    }
+
+    // Coalesce every queued submission that can go in the same batch file
+    const Submission& first = batch[0]->mSubmission;
+    int numRuns = (int)first.mRuns.size();
+
+    std::map<std::string, std::deque<EntryPtr> >::iterator iter = mUserQueues.begin();
+    while (iter != mUserQueues.end())
+    {
+        std::deque<EntryPtr>& queue = iter->second;
+        std::deque<EntryPtr> remaining;
+
+        for (size_t i = 0; i < queue.size(); i++)
+        {
+            int entryRuns = (int)queue[i]->mSubmission.mRuns.size();
+
+            if (numRuns + entryRuns <= MAX_RUNS_PER_BATCH && canCoalesce(first, queue[i]->mSubmission))
+            {
+                batch.push_back(queue[i]);
+                numRuns += entryRuns;
+            }
+            else
+            {
+                remaining.push_back(queue[i]);
+            }
+        }
+
+        queue.swap(remaining);
+
+        if (queue.empty())
+        {
+            mUserOrder.erase(std::find(mUserOrder.begin(), mUserOrder.end(), iter->first));
+            mUserQueues.erase(iter++);
+        }
+        else
+        {
+            ++iter;
+        }
+    }
+}
+
+///
+//  Report the position of every queued submission
+//
+void ClusterJobSubmitQueue::reportQueued()
+{
+    std::vector<EntryPtr> queued;
+    for (std::map<std::string, std::deque<EntryPtr> >::const_iterator iter = mUserQueues.begin();
+         iter != mUserQueues.end(); ++iter)
+    {
+        queued.insert(queued.end(), iter->second.begin(), iter->second.end());
+    }
+
+    for (size_t i = 0; i < queued.size(); i++)
+    {
+        Progress progress;
+        progress.mState = SUBMIT_QUEUED;
+        progress.mNumAhead = 0;
+
+        for (size_t j = 0; j < queued.size(); j++)
+        {
+            if (queued[j]->mSequence < queued[i]->mSequence)
+            {
+                progress.mNumAhead++;
+            }
+        }
+
+        reportProgress(queued[i], progress);
+    }
+}
+
+///
+//  Run a batch of submissions as one pl_batch_web.bash run
+//
+void ClusterJobSubmitQueue::runBatch(const std::vector<EntryPtr>& batch)
+{
+    const Submission& first = batch[0]->mSubmission;
+    Progress progress;
+    progress.mNumAhead = 0;
+    progress.mResult.mExitStatus = -1;
+
+    std::string batchFile = writeBatchFile(batch);
+    if (batchFile.empty())
+    {
+        progress.mState = SUBMIT_FAILED;
+        progress.mError = "Error creating file on server: /tmp/pl_gui_tmp";
+        for (size_t i = 0; i < batch.size(); i++)
+        {
+            reportProgress(batch[i], progress);
+        }
+        return;
+    }
+
+    // Create the following command line args for running pl_batch
+    //  -v 10 -t <tmpfile> -T <pipelineType>
+    std::string commandArgs;
+    commandArgs = "\"-v 10 -t " + boost::filesystem::path(batchFile).leaf().string() + " -T ";
+    commandArgs += first.mPipelineType;
+    commandArgs += "\"";
+
+    progress.mCommand = first.mScriptDir + "/pl_batch_web.bash " + first.mPackageDir + " " + first.mScriptDir + " ";
+    progress.mCommand += commandArgs + " /tmp " + batchFile;
+
+    progress.mState = SUBMIT_RUNNING;
+    for (size_t i = 0; i < batch.size(); i++)
+    {
+        reportProgress(batch[i], progress);
+    }
+
+    ClusterJobSubmitter submitter(first.mClusterDir);
+    ClusterJobSubmitter::SubmitResult result;
+    submitter.submit(progress.mCommand, result);
+
+    size_t numRuns = 0;
+    for (size_t i = 0; i < batch.size(); i++)
+    {
+        numRuns += batch[i]->mSubmission.mRuns.size();
+    }
+
+    if (result.mLogEntries.size() != numRuns)
+    {
+        std::ostringstream error;
+        error << "New lines: " << result.mLogEntries.size() << " Scans to process: " << numRuns;
+
+        progress.mState = SUBMIT_FAILED;
+        progress.mError = error.str();
+        progress.mResult = result;
+        for (size_t i = 0; i < batch.size(); i++)
+        {
+            reportProgress(batch[i], progress);
+        }
+        return;
+    }
+
+    // The schedule entries are in the order of the batch file, so each
+    // submission gets its own run of them
+    bool haveJobs = (result.mJobs.size() == numRuns);
+    size_t firstRun = 0;
+
+    for (size_t i = 0; i < batch.size(); i++)
+    {
+        size_t entryRuns = batch[i]->mSubmission.mRuns.size();
+
+        progress.mState = SUBMIT_SUCCEEDED;
+        progress.mResult.mExitStatus = result.mExitStatus;
+        progress.mResult.mLogEntries.assign(result.mLogEntries.begin() + firstRun,
+                                            result.mLogEntries.begin() + firstRun + entryRuns);
+        progress.mResult.mJobs.clear();
+        if (haveJobs)
+        {
+            progress.mResult.mJobs.assign(result.mJobs.begin() + firstRun,
+                                          result.mJobs.begin() + firstRun + entryRuns);
+        }
+
+        reportProgress(batch[i], progress);
+        firstRun += entryRuns;
+    }
+}
+
+///
+//  Write the batch file of a batch
+//
+std::string ClusterJobSubmitQueue::writeBatchFile(const std::vector<EntryPtr>& batch)
+{
+    char *tmpName = strdup("/tmp/pl_gui_tmpXXXXXX");
+
+    int fd = mkstemp(tmpName);
+    if (fd == -1)
+    {
+        free(tmpName);
+        return "";
+    }
+    close(fd);
+
+    std::string batchFile = tmpName;
+    free(tmpName);
+
+    // Open temporary file for writing
+    ofstream tmpFile(batchFile.c_str(), ios::out);
+    if (!tmpFile.is_open())
+    {
+        return "";
+    }
+
+    // plBatch_create outputs command line options and then a list
+    // of files to process
+    tmpFile << "DEFAULTCOM = " << batch[0]->mSubmission.mCommandLine << endl;
+    tmpFile << "DEFAULTDIR = " << batch[0]->mSubmission.mDicomDir << endl;
+
+    for (size_t i = 0; i < batch.size(); i++)
+    {
+        const std::vector<std::string>& runs = batch[i]->mSubmission.mRuns;
+        for (size_t run = 0; run < runs.size(); run++)
+        {
+            tmpFile << runs[run] << endl;
+        }
+    }
+
+    tmpFile.close();
+
+    return batchFile;
+}
+
+///
+//  Get whether two submissions can be run as one batch
+//
+bool ClusterJobSubmitQueue::canCoalesce(const Submission& submission1, const Submission& submission2)
+{
+    // The batch file has a single set of options for every run
+    return submission1.mPipelineType == submission2.mPipelineType &&
+           submission1.mCommandLine == submission2.mCommandLine &&
+           submission1.mDicomDir == submission2.mDicomDir &&
+           submission1.mPackageDir == submission2.mPackageDir &&
+           submission1.mScriptDir == submission2.mScriptDir &&
+           submission1.mClusterDir == submission2.mClusterDir;
+}
+
+///
+//  Post progress to the session of a submission
+//
+void ClusterJobSubmitQueue::reportProgress(const EntryPtr& entry, const Progress& progress)
+{
+    IOExecutor::instance().post(entry->mApp, entry->mClientId,
+                                boost::bind(&ClusterJobSubmitQueue::deliverProgress,
+                                            entry->mProgress, progress, _1));
+}
+
+///
+//  Call a progress callback
+//
+void ClusterJobSubmitQueue::deliverProgress(ProgressCallback callback, Progress progress,
+                                            IOExecutor::StatusEnum status)
+{
+    callback(progress);
+}
@@ -0,0 +1,217 @@
+//
+//
+//  Description:
+//      Definition of the cluster job submission queue.  Sessions enqueue their
+//      submissions instead of running pl_batch_web.bash in the event handler.  A
+//      bounded pool of worker threads runs them, taking users in turn so that one
+//      user's large batch does not hold back everyone else.  Queued submissions
+//      with the same pipeline type and options are coalesced into a single batch
+//      file and pl_batch_web.bash run.  Progress and completion are reported to
+//      the submitting session by server push, through the IOExecutor.
+//
+//  Author:
+//      Dan Ginsburg
+//
+//  Children's Hospital Boston
+//  GPL v2
+//
+#ifndef CLUSTERJOBSUBMITQUEUE_H
+#define CLUSTERJOBSUBMITQUEUE_H
+
+#include "ClusterJobSubmitter.h"
+#include "IOExecutor.h"
+#include <boost/function.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition.hpp>
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+
+///
+/// \class ClusterJobSubmitQueue
+/// \brief Singleton queue that runs job submissions off the sessions' threads
+///
+class ClusterJobSubmitQueue
+{
+public:
+
+    /// State of a submission
+    typedef enum
+    {
+        SUBMIT_QUEUED,      // Waiting for a worker
+        SUBMIT_RUNNING,     // pl_batch_web.bash is running
+        SUBMIT_SUCCEEDED,   // Every job was added to the schedule
+        SUBMIT_FAILED       // The batch could not be run or not every job was added
+    } StateEnum;
+
+    /// Submission of a batch of runs
+    typedef struct
+    {
+        /// User submitting
+        std::string mUser;
+
+        /// Pipeline type (pl_batch -T)
+        std::string mPipelineType;
+
+        /// Pipeline command line options (DEFAULTCOM)
+        std::string mCommandLine;
+
+        /// DICOM directory (DEFAULTDIR)
+        std::string mDicomDir;
+
+        /// Run specifications, one line of the batch file each
+        std::vector<std::string> mRuns;
+
+        /// Package directory
+        std::string mPackageDir;
+
+        /// Script directory
+        std::string mScriptDir;
+
+        /// Cluster directory
+        std::string mClusterDir;
+
+    } Submission;
+
+    /// Progress of a submission
+    typedef struct
+    {
+        /// Current state
+        StateEnum mState;
+
+        /// Number of submissions queued ahead of this one, when queued
+        int mNumAhead;
+
+        /// Command that was run, once running
+        std::string mCommand;
+
+        /// Exit status, lines and jobs of this submission, once done
+        ClusterJobSubmitter::SubmitResult mResult;
+
+        /// Error message, if failed
+        std::string mError;
+
+    } Progress;
+
+    /// Progress callback, runs with the session's update lock held
+    typedef boost::function<void (const Progress&)> ProgressCallback;
+
+    /// Number of worker threads.  The schedule is appended to by one submission at
+    /// a time, so further workers would only wait on each other instead of
+    /// coalescing what is queued.
+    static const int NUM_THREADS = 1;
+
+    /// Maximum number of runs coalesced into one batch
+    static const int MAX_RUNS_PER_BATCH = 256;
+
+    ///
+    /// Get the process-wide queue instance
+    ///
+    static ClusterJobSubmitQueue& instance();
+
+    ///
+    /// Enqueue a submission
+    /// \param app Application whose session progress is reported to
+    /// \param clientId IOExecutor client id the progress callbacks are posted for,
+    ///                 cancelling the client drops them (the submission still runs)
+    /// \param submission Submission to run
+    /// \param progress Progress callback
+    ///
+    void enqueue(WApplication *app, int clientId, const Submission& submission,
+                 const ProgressCallback& progress);
+
+private:
+
+    ///
+    /// Constructor
+    ///
+    ClusterJobSubmitQueue();
+
+    ///
+    /// Destructor
+    ///
+    virtual ~ClusterJobSubmitQueue();
+
+    /// Queued submission
+    typedef struct
+    {
+        /// Order of submission
+        int mSequence;
+
+        /// Submission
+        Submission mSubmission;
+
+        /// Application progress is reported to
+        WApplication *mApp;
+
+        /// IOExecutor client id progress is posted for
+        int mClientId;
+
+        /// Progress callback
+        ProgressCallback mProgress;
+
+    } Entry;
+
+    typedef boost::shared_ptr<Entry> EntryPtr;
+
+    ///
+    /// Run batches (worker thread)
+    ///
+    void runWorker();
+
+    ///
+    /// Take the next batch: the oldest submission of the next user in turn, and
+    /// every queued submission it can be coalesced with.  Call with mMutex held.
+    ///
+    void takeBatch(std::vector<EntryPtr>& batch);
+
+    ///
+    /// Report the position of every queued submission.  Call with mMutex held.
+    ///
+    void reportQueued();
+
+    ///
+    /// Run a batch of submissions as one pl_batch_web.bash run
+    ///
+    static void runBatch(const std::vector<EntryPtr>& batch);
+
+    ///
+    /// Write the batch file of a batch
+    /// \return Path of the file, empty on failure
+    ///
+    static std::string writeBatchFile(const std::vector<EntryPtr>& batch);
+
+    ///
+    /// Get whether two submissions can be run as one batch
+    ///
+    static bool canCoalesce(const Submission& submission1, const Submission& submission2);
+
+    ///
+    /// Post progress to the session of a submission
+    ///
+    static void reportProgress(const EntryPtr& entry, const Progress& progress);
+
+    ///
+    /// Call a progress callback (IOExecutor completion callback)
+    ///
+    static void deliverProgress(ProgressCallback callback, Progress progress, IOExecutor::StatusEnum status);
+
+    /// Queued submissions of each user, oldest first
+    std::map<std::string, std::deque<EntryPtr> > mUserQueues;
+
+    /// Users with queued submissions, in the order they are served
+    std::deque<std::string> mUserOrder;
+
+    /// Sequence number of the next submission
+    int mNextSequence;
+
+    /// Mutex protecting all of the above
+    boost::mutex mMutex;
+
+    /// Signalled when a submission is queued
+    boost::condition mQueueCondition;
+};
+
+#endif // CLUSTERJOBSUBMITQUEUE_H
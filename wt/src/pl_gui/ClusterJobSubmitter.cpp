@@ -0,0 +1,187 @@
+//
+//
+//  Description:
+//      Implementation of the cluster job submitter.  Runs pl_batch_web.bash to add jobs
+//      to the cluster schedule and reports the jobs it added.  The end offsets of
+//      schedule.log and schedule.log.xml are recorded before the script runs, so
+//      only the entries appended by the submission are read afterwards, however
+//      large the schedule history is.
+//
+//      The submitter does not touch the Wt session, so it can run on any thread.
+//      Submissions are run one at a time, so that the region appended to the
+//      schedule while a script runs belongs to that script alone.
+//
+//  Author:
+//      Dan Ginsburg
+//
+//  Children's Hospital Boston
+//  GPL v2
+//
+#include "ClusterJobSubmitter.h"
+#include "XMLRecordParser.h"
+#include <boost/process/process.hpp>
+#include <boost/process/child.hpp>
+#include <boost/process/launch_shell.hpp>
+#include <sys/stat.h>
+#include <algorithm>
+#include <fstream>
+
+///
+//  Namespaces
+//
+using namespace std;
+using namespace boost::processes;
+
+///
+//  Static data
+//
+boost::mutex ClusterJobSubmitter::mSubmitMutex;
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Constructor/Destructor
+//
+//
+
+///
+//  Constructor
+//
+ClusterJobSubmitter::ClusterJobSubmitter(const std::string& clusterDir) :
+    mScheduleLogFile(clusterDir + "/schedule.log"),
+    mScheduleXMLFile(clusterDir + "/schedule.log.xml")
+{
+}
+
+///
+//  Destructor
+//
+ClusterJobSubmitter::~ClusterJobSubmitter()
+{
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Public Members
+//
+//
+
+///
+//  Run a submission command and read back the jobs it added to the schedule
+//
+void ClusterJobSubmitter::submit(const std::string& command, SubmitResult& result) const
+{
+    boost::mutex::scoped_lock lock(mSubmitMutex);
+
+    boost::uint64_t logOffset = getFileSize(mScheduleLogFile);
+    boost::uint64_t xmlOffset = getFileSize(mScheduleXMLFile);
+
+    context ctx;
+    child c = launch_shell(command.c_str(), ctx);
+    boost::processes::status s = c.wait();
+    result.mExitStatus = s.exit_status();
+
+    // A schedule that was rotated while the script ran is read from the start
+    if (getFileSize(mScheduleLogFile) < logOffset)
+    {
+        logOffset = 0;
+    }
+    if (getFileSize(mScheduleXMLFile) < xmlOffset)
+    {
+        xmlOffset = 0;
+    }
+
+    result.mLogEntries.clear();
+    readLogEntries(mScheduleLogFile, logOffset, result.mLogEntries);
+
+    result.mJobs.clear();
+    readJobs(mScheduleXMLFile, xmlOffset, result.mJobs);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Private Members
+//
+//
+
+///
+//  Get the size of a file
+//
+boost::uint64_t ClusterJobSubmitter::getFileSize(const std::string& fileName)
+{
+    struct stat fileStat;
+
+    if (stat(fileName.c_str(), &fileStat) != 0)
+    {
+        return 0;
+    }
+
+    return (boost::uint64_t)fileStat.st_size;
+}
+
+///
+//  Read the lines appended to schedule.log after an offset
+//
+void ClusterJobSubmitter::readLogEntries(const std::string& fileName, boost::uint64_t offset,
+                                         std::vector<std::string>& logEntries)
+{
+    ifstream ifs(fileName.c_str(), ios::in);
+
+    if (!ifs.is_open())
+    {
+        return;
+    }
+
+    ifs.seekg((streamoff)offset, ios::beg);
+
+    std::string line;
+    while (getline(ifs, line))
+    {
+        if (line.size() > 2)
+        {
+            logEntries.push_back(line);
+        }
+    }
+}
+
+///
+//  Read the <ClusterJob> records appended to schedule.log.xml after an offset
+//
+void ClusterJobSubmitter::readJobs(const std::string& fileName, boost::uint64_t offset,
+                                   std::vector<JobRecord>& jobs)
+{
+    XMLRecordParser parser("ClusterJob");
+    if (!parser.mapFile(fileName))
+    {
+        return;
+    }
+
+    std::vector<XMLRecordParser::Record> records;
+    parser.findRecords(records, offset);
+
+    for (size_t record = 0; record < records.size(); record++)
+    {
+        if (record % XMLRecordParser::RECORDS_PER_PASS == 0)
+        {
+            parser.parseRecords(records, record,
+                                std::min(XMLRecordParser::RECORDS_PER_PASS, records.size() - record));
+        }
+
+        JobRecord job;
+        const XMLRecordParser::Element *element;
+
+        if ((element = parser.findElement(record, "JobId")) != NULL)
+        {
+            job.mJobId = XMLRecordParser::getText(*element);
+        }
+        if ((element = parser.findElement(record, "PatientID")) != NULL)
+        {
+            job.mMRID = XMLRecordParser::getText(*element);
+        }
+        if ((element = parser.findElement(record, "MetaScript")) != NULL)
+        {
+            job.mPipeline = XMLRecordParser::getText(*element);
+        }
+
+        jobs.push_back(job);
+    }
+}
@@ -0,0 +1,113 @@
+//
+//
+//  Description:
+//      Definition of the cluster job submitter.  Runs pl_batch_web.bash to add jobs
+//      to the cluster schedule and reports the jobs it added.  The end offsets of
+//      schedule.log and schedule.log.xml are recorded before the script runs, so
+//      only the entries appended by the submission are read afterwards, however
+//      large the schedule history is.
+//
+//      The submitter does not touch the Wt session, so it can run on any thread.
+//      Submissions are run one at a time, so that the region appended to the
+//      schedule while a script runs belongs to that script alone.
+//
+//  Author:
+//      Dan Ginsburg
+//
+//  Children's Hospital Boston
+//  GPL v2
+//
+#ifndef CLUSTERJOBSUBMITTER_H
+#define CLUSTERJOBSUBMITTER_H
+
+#include <boost/cstdint.hpp>
+#include <boost/thread/mutex.hpp>
+#include <string>
+#include <vector>
+
+///
+/// \class ClusterJobSubmitter
+/// \brief Submits jobs to the cluster schedule and returns the jobs added
+///
+class ClusterJobSubmitter
+{
+public:
+
+    /// Job added to the schedule
+    typedef struct
+    {
+        /// Cluster job ID
+        std::string mJobId;
+
+        /// MRID (Patient ID) of the scan processed
+        std::string mMRID;
+
+        /// Pipeline meta script
+        std::string mPipeline;
+
+    } JobRecord;
+
+    /// Result of a submission
+    typedef struct
+    {
+        /// Exit status of pl_batch_web.bash
+        int mExitStatus;
+
+        /// Lines appended to schedule.log
+        std::vector<std::string> mLogEntries;
+
+        /// Jobs appended to schedule.log.xml
+        std::vector<JobRecord> mJobs;
+
+    } SubmitResult;
+
+    ///
+    /// Constructor
+    /// \param clusterDir Directory that holds the cluster schedule logs
+    ///
+    ClusterJobSubmitter(const std::string& clusterDir);
+
+    ///
+    /// Destructor
+    ///
+    virtual ~ClusterJobSubmitter();
+
+    ///
+    /// Run a submission command and read back the jobs it added to the schedule
+    /// \param command Shell command that runs pl_batch_web.bash
+    /// \param result Filled with the exit status and the entries added
+    ///
+    void submit(const std::string& command, SubmitResult& result) const;
+
+private:
+
+    ///
+    /// Get the size of a file
+    /// \return Size in bytes, 0 if the file does not exist
+    ///
+    static boost::uint64_t getFileSize(const std::string& fileName);
+
+    ///
+    /// Read the lines appended to schedule.log after an offset.  Like the line
+    /// count submissions were always checked with, blank lines are skipped.
+    ///
+    static void readLogEntries(const std::string& fileName, boost::uint64_t offset,
+                               std::vector<std::string>& logEntries);
+
+    ///
+    /// Read the <ClusterJob> records appended to schedule.log.xml after an offset
+    ///
+    static void readJobs(const std::string& fileName, boost::uint64_t offset,
+                         std::vector<JobRecord>& jobs);
+
+    /// Serializes submissions, they all append to the same schedule
+    static boost::mutex mSubmitMutex;
+
+    /// Full path to schedule.log
+    std::string mScheduleLogFile;
+
+    /// Full path to schedule.log.xml
+    std::string mScheduleXMLFile;
+};
+
+#endif // CLUSTERJOBSUBMITTER_H
@@ -39,6 +39,7 @@
 #include <string>
 #include <boost/filesystem.hpp>
 #include <boost/regex.hpp>
+#include <boost/bind.hpp>
 
 ///
 //  Namespaces
@@ -143,6 +144,8 @@ FilePreviewBox::~FilePreviewBox()
 //
 void FilePreviewBox::resetAll()
 {
+    mIOClient.cancel();
+
     mFileName->setText("");
     mFileDir->setText("");
     mFileSize->setText("");
@@ -154,137 +157,84 @@ void FilePreviewBox::resetAll()
 //
 void FilePreviewBox::setFilePath(std::string filePathStr)
 {
-    try
-    {
-        path filePath = path(filePathStr);
-        path fileDir = filePath.branch_path();
+    // A preview still loading for the previous file is no longer wanted
+    mIOClient.cancel();
 
-        mFileName->setText(filePath.leaf().string());
-        mFileDir->setText(fileDir.string());
-        mDownloadFileResource->setFileName(filePathStr);
-        mDownloadFileResource->suggestFileName(filePath.leaf().string());
+    path filePath = path(filePathStr);
+    path fileDir = filePath.branch_path();
 
-        mFileSize->setText(WString("{1} Bytes").arg((int)file_size(filePath)));
+    mFileName->setText(filePath.leaf().string());
+    mFileDir->setText(fileDir.string());
+    mDownloadFileResource->setFileName(filePathStr);
+    mDownloadFileResource->suggestFileName(filePath.leaf().string());
 
-        if (fileMatchesExpression(filePathStr, getConfigXMLPtr()->getImageFilePattern()))
-        {
-            if (mImageResource == NULL)
-            {
-                mImageResource = new WFileResource("image/" + filePath.extension().string(), filePathStr);
-            }
-            else
-            {
-                mImageResource->setFileName(filePathStr);
-            }
-            mImagePreview->setResource(mImageResource);
-            mImagePreview->setMaximumSize(650, 532);
-            mPreviewStack->setCurrentIndex(0);
-            mPreviewStack->show();
-        }
-        else if(fileMatchesExpression(filePathStr, getConfigXMLPtr()->getTextFilePattern()))
-        {
-            std::ifstream inFile(filePathStr.c_str(), ios::in);
-            if (inFile.is_open())
-            {
-                ostringstream oss;
-                oss << inFile.rdbuf();
+    // Show that the file is loading until it has been read
+    mFileSize->setText("Loading...");
+    mPreviewStack->hide();
 
-                if (oss.str().size() < WApplication::instance()->maximumRequestSize())
-                {
-                    mTextPreview->setText(oss.str().c_str());
-                }
-                else
-                {
-                    mTextPreview->setText("The file is too large to display, please click Download to view it.");
-                }
+    boost::shared_ptr<FilePreviewLoad> load(new FilePreviewLoad());
+    load->mFilePath = filePathStr;
+    load->mPreview = PREVIEW_NONE;
+    load->mMaxTextSize = WApplication::instance()->maximumRequestSize();
+    load->mExists = false;
+    load->mFileSize = 0;
+    load->mTextRead = false;
 
-                mPreviewStack->setCurrentIndex(1);
-                mPreviewStack->show();
-            }
-            else
-            {
-                mPreviewStack->hide();
-            }
-        }
-        else
-        {
-            bool previewFound = false;
-            const std::list<ConfigXML::PreviewPatternNode> &previewPatternList = getConfigXMLPtr()->getPreviewPatterns();
-            std::list<ConfigXML::PreviewPatternNode>::const_iterator iter = previewPatternList.begin();
+    // Decide which preview to show here, where invalid expressions can be logged
+    if (fileMatchesExpression(filePathStr, getConfigXMLPtr()->getImageFilePattern()))
+    {
+        load->mPreview = PREVIEW_IMAGE;
+    }
+    else if(fileMatchesExpression(filePathStr, getConfigXMLPtr()->getTextFilePattern()))
+    {
+        load->mPreview = PREVIEW_TEXT;
+    }
+    else
+    {
+        load->mPreview = PREVIEW_PATTERN;
 
-            while (iter != previewPatternList.end() && !previewFound)
-            {
-                if (fileMatchesExpression(filePathStr, (*iter).mExpression))
-                {
-                    // See if a file matching the preview expression exists
-                    for(directory_iterator dirIter(fileDir); dirIter != directory_iterator(); ++dirIter)
-                    {
-                        const string fileName = dirIter->path().filename().string();
-
-                        // Skip if no match
-                        if( !fileMatchesExpression( fileName, (*iter).mPreviewExpression ) )
-                            continue;
-
-                        if (!is_directory(dirIter->path()))
-                        {
-                            if (mImageResource == NULL)
-                            {
-                                mImageResource = new WFileResource("image/" + dirIter->path().extension().string(), dirIter->path().string());
-                            }
-                            else
-                            {
-                                mImageResource->setFileName(dirIter->path().string());
-                            }
-                            mImagePreview->setResource(mImageResource);
-                            mImagePreview->setMaximumSize(1000, 820);
-                            mPreviewStack->setCurrentIndex(0);
-                            mPreviewStack->show();
-                            previewFound = true;
-                            break;
-                        }
-                    }
-                }
+        const std::list<ConfigXML::PreviewPatternNode> &previewPatternList = getConfigXMLPtr()->getPreviewPatterns();
+        std::list<ConfigXML::PreviewPatternNode>::const_iterator iter = previewPatternList.begin();
 
-                iter++;
-            }
-
-            // No preview available
-            if (!previewFound)
+        while (iter != previewPatternList.end())
+        {
+            regex previewRegEx;
+            if (fileMatchesExpression(filePathStr, (*iter).mExpression) &&
+                compileExpression((*iter).mPreviewExpression, previewRegEx))
             {
-                mPreviewStack->hide();
+                load->mPreviewExpressions.push_back(previewRegEx);
             }
 
-            bool viewerFound = false;
+            iter++;
+        }
 
-            const std::list<ConfigXML::ViewerPatternNode> &viewerPatternList = getConfigXMLPtr()->getViewerPatterns();
-            std::list<ConfigXML::ViewerPatternNode>::const_iterator viewerIter = viewerPatternList.begin();
+        bool viewerFound = false;
 
-            while (viewerIter != viewerPatternList.end() && !viewerFound)
-            {
-                if (fileMatchesExpression(filePathStr, (*viewerIter).mExpression))
-                {
+        const std::list<ConfigXML::ViewerPatternNode> &viewerPatternList = getConfigXMLPtr()->getViewerPatterns();
+        std::list<ConfigXML::ViewerPatternNode>::const_iterator viewerIter = viewerPatternList.begin();
 
-                    mViewerAnchor->setRef((*viewerIter).mViewerURL + filePathStr);
-                    mViewerAnchor->show();
-                    viewerFound = true;
-                    break;
-                }
+        while (viewerIter != viewerPatternList.end() && !viewerFound)
+        {
+            if (fileMatchesExpression(filePathStr, (*viewerIter).mExpression))
+            {
 
-                viewerIter++;
+                mViewerAnchor->setRef((*viewerIter).mViewerURL + filePathStr);
+                mViewerAnchor->show();
+                viewerFound = true;
+                break;
             }
 
-            if (!viewerFound)
-            {
-                mViewerAnchor->hide();
-            }
+            viewerIter++;
+        }
+
+        if (!viewerFound)
+        {
+            mViewerAnchor->hide();
         }
-    }
-    catch (...)
-    {
-        // If any exceptions occur, the file may no longer exist, so reset box
-        resetAll();
     }
 
+    mIOClient.submit(boost::bind(&FilePreviewBox::loadFilePreview, load),
+                     boost::bind(&FilePreviewBox::filePreviewLoaded, this, load, _1));
 }
 
 
@@ -300,6 +250,20 @@ void FilePreviewBox::setFilePath(std::string filePathStr)
 bool FilePreviewBox::fileMatchesExpression(const std::string& filePathStr, const std::string &filePatternExpr) const
 {
     regex regEx;
+    if (!compileExpression(filePatternExpr, regEx))
+    {
+        return false;
+    }
+
+    boost::smatch what;
+    return (boost::regex_match( filePathStr, what, regEx ));
+}
+
+///
+//  Compile a regular expression from the config XML file
+//
+bool FilePreviewBox::compileExpression(const std::string &filePatternExpr, boost::regex& regEx) const
+{
     try
     {
         regEx = regex(filePatternExpr);
@@ -310,9 +274,149 @@ bool FilePreviewBox::fileMatchesExpression(const std::string& filePathStr, const
         return false;
     }
 
-    boost::smatch what;
-    return (boost::regex_match( filePathStr, what, regEx ));
+    return true;
+}
+
+///
+//  Read the file and find its preview (I/O thread)
+//
+void FilePreviewBox::loadFilePreview(boost::shared_ptr<FilePreviewLoad> load)
+{
+    try
+    {
+        path filePath = path(load->mFilePath);
+
+        load->mFileSize = file_size(filePath);
+        load->mExists = true;
+
+        if (load->mPreview == PREVIEW_TEXT)
+        {
+            // Files too large to send are not read at all
+            if (load->mFileSize >= load->mMaxTextSize)
+            {
+                return;
+            }
+
+            std::ifstream inFile(load->mFilePath.c_str(), ios::in);
+            if (inFile.is_open())
+            {
+                ostringstream oss;
+                oss << inFile.rdbuf();
+
+                load->mText = oss.str();
+                load->mTextRead = true;
+            }
+        }
+        else if (load->mPreview == PREVIEW_PATTERN && !load->mPreviewExpressions.empty())
+        {
+            // See if a file matching one of the preview expressions exists, in the
+            // order of the expressions
+            std::vector<path> dirFiles;
+            for(directory_iterator dirIter(filePath.branch_path()); dirIter != directory_iterator(); ++dirIter)
+            {
+                dirFiles.push_back(dirIter->path());
+            }
+
+            for (size_t i = 0; i < load->mPreviewExpressions.size() && load->mPreviewFile.empty(); i++)
+            {
+                for (size_t j = 0; j < dirFiles.size(); j++)
+                {
+                    boost::smatch what;
+                    const string fileName = dirFiles[j].filename().string();
+
+                    // Skip if no match
+                    if (!boost::regex_match(fileName, what, load->mPreviewExpressions[i]))
+                        continue;
+
+                    if (!is_directory(dirFiles[j]))
+                    {
+                        load->mPreviewFile = dirFiles[j].string();
+                        break;
+                    }
+                }
+            }
+        }
+    }
+    catch (...)
+    {
+        // The file may no longer exist
+        load->mExists = false;
+    }
+}
+
+///
+//  File read and its preview found
+//
+void FilePreviewBox::filePreviewLoaded(boost::shared_ptr<FilePreviewLoad> load, IOExecutor::StatusEnum status)
+{
+    if (status == IOExecutor::IO_TIMED_OUT)
+    {
+        WApplication::instance()->log("error") << "Timed out reading file: " << load->mFilePath;
+        mFileSize->setText("Timed out reading file");
+        mPreviewStack->hide();
+        return;
+    }
+
+    // If the file could not be read, it may no longer exist, so reset box
+    if (!load->mExists)
+    {
+        resetAll();
+        return;
+    }
+
+    mFileSize->setText(WString("{1} Bytes").arg((int)load->mFileSize));
+
+    if (load->mPreview == PREVIEW_IMAGE)
+    {
+        setImagePreview(load->mFilePath, 650, 532);
+    }
+    else if (load->mPreview == PREVIEW_TEXT)
+    {
+        if (load->mTextRead)
+        {
+            mTextPreview->setText(load->mText.c_str());
+        }
+        else if (load->mFileSize >= load->mMaxTextSize)
+        {
+            mTextPreview->setText("The file is too large to display, please click Download to view it.");
+        }
+        else
+        {
+            mPreviewStack->hide();
+            return;
+        }
+
+        mPreviewStack->setCurrentIndex(1);
+        mPreviewStack->show();
+    }
+    else if (!load->mPreviewFile.empty())
+    {
+        setImagePreview(load->mPreviewFile, 1000, 820);
+    }
+    else
+    {
+        // No preview available
+        mPreviewStack->hide();
+    }
+}
+
+///
+//  Show an image file in the preview
+//
+void FilePreviewBox::setImagePreview(const std::string& imageFilePathStr, int maxWidth, int maxHeight)
+{
+    if (mImageResource == NULL)
+    {
+        mImageResource = new WFileResource("image/" + path(imageFilePathStr).extension().string(), imageFilePathStr);
+    }
+    else
+    {
+        mImageResource->setFileName(imageFilePathStr);
+    }
+    mImagePreview->setResource(mImageResource);
+    mImagePreview->setMaximumSize(maxWidth, maxHeight);
+    mPreviewStack->setCurrentIndex(0);
+    mPreviewStack->show();
 }
 
 
-;
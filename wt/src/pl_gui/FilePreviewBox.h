@@ -17,6 +17,10 @@
 #include <vector>
 #include <string>
 #include "GlobalEnums.h"
+#include "IOClient.h"
+#include <boost/shared_ptr.hpp>
+#include <boost/regex.hpp>
+#include <boost/cstdint.hpp>
 
 namespace Wt
 {
@@ -66,6 +70,67 @@ private:
     ///
     bool fileMatchesExpression(const std::string& filePathStr, const std::string &filePatternExpr) const;
 
+    ///
+    ///  Compile a regular expression from the config XML file
+    ///
+    bool compileExpression(const std::string &filePatternExpr, boost::regex& regEx) const;
+
+    /// Kind of preview shown for a file
+    typedef enum
+    {
+        PREVIEW_NONE,
+        PREVIEW_IMAGE,      // The file is an image
+        PREVIEW_TEXT,       // The file is text
+        PREVIEW_PATTERN     // An image next to the file, found by the preview patterns
+    } PreviewEnum;
+
+    /// File being read for the preview
+    typedef struct
+    {
+        /// File to preview
+        std::string mFilePath;
+
+        /// Kind of preview
+        PreviewEnum mPreview;
+
+        /// Preview expressions to search the file's directory with (PREVIEW_PATTERN)
+        std::vector<boost::regex> mPreviewExpressions;
+
+        /// Largest text that can be sent to the browser
+        size_t mMaxTextSize;
+
+        /// Whether the file could be read
+        bool mExists;
+
+        /// File size
+        boost::uintmax_t mFileSize;
+
+        /// Whether the text was read (PREVIEW_TEXT)
+        bool mTextRead;
+
+        /// Text of the file (PREVIEW_TEXT)
+        std::string mText;
+
+        /// Image found by the preview expressions (PREVIEW_PATTERN)
+        std::string mPreviewFile;
+
+    } FilePreviewLoad;
+
+    ///
+    /// Read the file and find its preview (I/O thread)
+    ///
+    static void loadFilePreview(boost::shared_ptr<FilePreviewLoad> load);
+
+    ///
+    /// File read and its preview found [I/O callback]
+    ///
+    void filePreviewLoaded(boost::shared_ptr<FilePreviewLoad> load, IOExecutor::StatusEnum status);
+
+    ///
+    /// Show an image file in the preview
+    ///
+    void setImagePreview(const std::string& imageFilePathStr, int maxWidth, int maxHeight);
+
 private:
 
     /// File Name
@@ -103,6 +168,9 @@ private:
 
     /// Stacked widget to hold image/text preview
     WStackedWidget *mPreviewStack;
+
+    /// Reads the file off the session
+    IOClient mIOClient;
 };
 
 #endif // FILEPREVIEWBOX_H
@@ -0,0 +1,75 @@
+//
+//
+//  Description:
+//      Implementation of the I/O client.  A widget holds one of these to send its
+//      filesystem work to the shared IOExecutor.  Destroying the client, or asking
+//      it to cancel, drops the completion callbacks of its outstanding requests, so
+//      a callback never runs for a widget that is gone or for a selection that has
+//      since changed.
+//
+//  Author:
+//      Dan Ginsburg
+//
+//  Children's Hospital Boston
+//  GPL v2
+//
+#include "IOClient.h"
+#include <Wt/WApplication>
+
+///
+//  Namespaces
+//
+using namespace Wt;
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Constructor/Destructor
+//
+//
+
+///
+//  Constructor
+//
+IOClient::IOClient() :
+    mClientId(IOExecutor::instance().newClientId()),
+    mApp(WApplication::instance())
+{
+}
+
+///
+//  Destructor
+//
+IOClient::~IOClient()
+{
+    cancel();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Public Members
+//
+//
+
+///
+//  Submit a request
+//
+void IOClient::submit(const IOExecutor::Work& work, const IOExecutor::Done& done, int timeoutMs)
+{
+    IOExecutor::instance().submit(mApp, mClientId, work, done, timeoutMs);
+}
+
+///
+//  Cancel every outstanding request of this client
+//
+void IOClient::cancel()
+{
+    IOExecutor::instance().cancelClient(mClientId);
+}
+
+///
+//  Get whether any request is still waiting for its completion callback
+//
+bool IOClient::isPending() const
+{
+    return IOExecutor::instance().getNumPending(mClientId) > 0;
+}
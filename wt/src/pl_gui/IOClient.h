@@ -0,0 +1,78 @@
+//
+//
+//  Description:
+//      Definition of the I/O client.  A widget holds one of these to send its
+//      filesystem work to the shared IOExecutor.  Destroying the client, or asking
+//      it to cancel, drops the completion callbacks of its outstanding requests, so
+//      a callback never runs for a widget that is gone or for a selection that has
+//      since changed.
+//
+//  Author:
+//      Dan Ginsburg
+//
+//  Children's Hospital Boston
+//  GPL v2
+//
+#ifndef IOCLIENT_H
+#define IOCLIENT_H
+
+#include "IOExecutor.h"
+
+///
+/// \class IOClient
+/// \brief Handle through which a widget submits and cancels its I/O requests
+///
+class IOClient
+{
+public:
+
+    ///
+    /// Constructor, must be called from the widget's session
+    ///
+    IOClient();
+
+    ///
+    /// Destructor, cancels any outstanding requests
+    ///
+    virtual ~IOClient();
+
+    ///
+    /// Submit a request.  The work runs on an I/O thread and the completion callback
+    /// runs in this client's session.
+    /// \param work Filesystem work
+    /// \param done Completion callback
+    /// \param timeoutMs Time after which done is called with IOExecutor::IO_TIMED_OUT
+    ///
+    void submit(const IOExecutor::Work& work, const IOExecutor::Done& done,
+                int timeoutMs = IOExecutor::DEFAULT_TIMEOUT_MS);
+
+    ///
+    /// Cancel every outstanding request of this client
+    ///
+    void cancel();
+
+    ///
+    /// Get whether any request is still waiting for its completion callback
+    ///
+    bool isPending() const;
+
+    ///
+    /// Get the id of this client in the executor
+    ///
+    int getClientId() const                 {   return mClientId;   }
+
+    ///
+    /// Get the application the client belongs to
+    ///
+    WApplication* getApp() const            {   return mApp;        }
+
+private:
+
+    /// Id of this client in the executor
+    int mClientId;
+
+    /// Application the client belongs to
+    WApplication *mApp;
+};
+
+#endif // IOCLIENT_H
@@ -0,0 +1,470 @@
+//
+//
+//  Description:
+//      Implementation of the process-wide I/O executor.  Event handlers hand their
+//      filesystem work to a shared pool of I/O threads instead of doing it while
+//      holding the session, so that a stalled NFS server never ties up a Wt worker
+//      thread.  When the work finishes, or when its timeout expires first, the
+//      completion callback runs with the session's update lock held and the
+//      browser is updated by server push.
+//
+//      A thread stuck in the filesystem cannot be interrupted.  When its request
+//      times out the thread is given up on and a new one is started in its place,
+//      up to a limit, so that one stalled mount does not starve every session.
+//
+//      Callbacks are run by a small pool of delivery threads, one session at a
+//      time each, so a session busy in a long event handler only holds up its own
+//      callbacks.  Timeouts are expired by a thread of their own.
+//
+//  Author:
+//      Dan Ginsburg
+//
+//  Children's Hospital Boston
+//  GPL v2
+//
+#include "IOExecutor.h"
+#include <Wt/WApplication>
+#include <boost/thread/thread.hpp>
+#include <boost/bind.hpp>
+
+///
+//  Namespaces
+//
+using namespace Wt;
+using namespace std;
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Constructor/Destructor
+//
+//
+
+///
+//  Constructor
+//
+IOExecutor::IOExecutor() :
+    mNextClientId(0),
+    mNumThreads(0),
+    mNumStalled(0)
+{
+    boost::mutex::scoped_lock lock(mMutex);
+
+    for (int i = 0; i < NUM_THREADS; i++)
+    {
+        startWorker();
+    }
+
+    // The threads run detached for the life of the process
+    for (int i = 0; i < NUM_DELIVERY_THREADS; i++)
+    {
+        boost::thread(boost::bind(&IOExecutor::runDelivery, this));
+    }
+    boost::thread(boost::bind(&IOExecutor::runTimeouts, this));
+}
+
+///
+//  Destructor
+//
+IOExecutor::~IOExecutor()
+{
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Public Members
+//
+//
+
+///
+//  Get the process-wide executor instance
+//
+IOExecutor& IOExecutor::instance()
+{
+    // Never destroyed, its threads run for the life of the process
+    static IOExecutor *executor = new IOExecutor();
+    return *executor;
+}
+
+///
+//  Get a new id for a client
+//
+int IOExecutor::newClientId()
+{
+    boost::mutex::scoped_lock lock(mMutex);
+    return mNextClientId++;
+}
+
+///
+//  Submit a request
+//
+void IOExecutor::submit(WApplication *app, int clientId, const Work& work, const Done& done, int timeoutMs)
+{
+    RequestPtr request(new Request());
+    request->mClientId = clientId;
+    request->mApp = app;
+    request->mWork = work;
+    request->mDone = done;
+    request->mDeadline = boost::get_system_time() + boost::posix_time::milliseconds(timeoutMs);
+    request->mState = REQUEST_QUEUED;
+    request->mStatus = IO_COMPLETED;
+    request->mCancelled = false;
+
+    boost::mutex::scoped_lock lock(mMutex);
+    mQueue.push_back(request);
+    mActive.push_back(request);
+
+    mWorkCondition.notify_one();
+    mTimeoutCondition.notify_one();
+}
+
+///
+//  Run a callback in a session, without any work
+//
+void IOExecutor::post(WApplication *app, int clientId, const Done& done)
+{
+    RequestPtr request(new Request());
+    request->mClientId = clientId;
+    request->mApp = app;
+    request->mDone = done;
+    request->mState = REQUEST_DONE;
+    request->mStatus = IO_COMPLETED;
+    request->mCancelled = false;
+
+    boost::mutex::scoped_lock lock(mMutex);
+    mDeliveries.push_back(request);
+
+    mDeliveryCondition.notify_one();
+}
+
+///
+//  Cancel every request of a client
+//
+void IOExecutor::cancelClient(int clientId)
+{
+    boost::mutex::scoped_lock lock(mMutex);
+
+    for (size_t i = 0; i < mActive.size(); i++)
+    {
+        if (mActive[i]->mClientId == clientId)
+        {
+            mActive[i]->mCancelled = true;
+        }
+    }
+
+    for (size_t i = 0; i < mDeliveries.size(); i++)
+    {
+        if (mDeliveries[i]->mClientId == clientId)
+        {
+            mDeliveries[i]->mCancelled = true;
+        }
+    }
+}
+
+///
+//  Get the number of requests of a client whose callbacks have not run yet
+//
+int IOExecutor::getNumPending(int clientId)
+{
+    boost::mutex::scoped_lock lock(mMutex);
+    int numPending = 0;
+
+    for (size_t i = 0; i < mActive.size(); i++)
+    {
+        if (mActive[i]->mClientId == clientId && !mActive[i]->mCancelled &&
+            mActive[i]->mState != REQUEST_DONE)
+        {
+            numPending++;
+        }
+    }
+
+    for (size_t i = 0; i < mDeliveries.size(); i++)
+    {
+        if (mDeliveries[i]->mClientId == clientId && !mDeliveries[i]->mCancelled)
+        {
+            numPending++;
+        }
+    }
+
+    return numPending;
+}
+
+///
+//  Cancel every request of an application and wait for the delivery threads
+//
+void IOExecutor::detachApplication(WApplication *app)
+{
+    boost::mutex::scoped_lock lock(mMutex);
+
+    for (size_t i = 0; i < mActive.size(); i++)
+    {
+        if (mActive[i]->mApp == app)
+        {
+            mActive[i]->mCancelled = true;
+        }
+    }
+
+    for (size_t i = 0; i < mDeliveries.size(); i++)
+    {
+        if (mDeliveries[i]->mApp == app)
+        {
+            mDeliveries[i]->mCancelled = true;
+        }
+    }
+
+    // A delivery thread that took a request for the application still uses it,
+    // even before it has the update lock.  Like the update threads the widgets
+    // join in finalize(), it is waited for; once it has the lock it sees the
+    // request cancelled and lets go without running the callback.
+    while (mDelivering.find(app) != mDelivering.end())
+    {
+        mDeliveredCondition.wait(lock);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Private Members
+//
+//
+
+///
+//  Start an I/O thread
+//
+void IOExecutor::startWorker()
+{
+    mNumThreads++;
+    boost::thread(boost::bind(&IOExecutor::runWorker, this));
+}
+
+///
+//  Run requests (I/O thread)
+//
+void IOExecutor::runWorker()
+{
+    boost::mutex::scoped_lock lock(mMutex);
+
+    while (true)
+    {
+        while (mQueue.empty())
+        {
+            mWorkCondition.wait(lock);
+        }
+
+        RequestPtr request = mQueue.front();
+        mQueue.pop_front();
+
+        // Timed out while queued, or nobody wants the result any more
+        if (request->mState != REQUEST_QUEUED || request->mCancelled)
+        {
+            if (request->mState == REQUEST_QUEUED)
+            {
+                request->mState = REQUEST_DONE;
+            }
+            continue;
+        }
+
+        request->mState = REQUEST_RUNNING;
+        lock.unlock();
+
+        try
+        {
+            request->mWork();
+        }
+        catch (...)
+        {
+            // Work reports its own errors through its results
+        }
+
+        lock.lock();
+
+        if (request->mState == REQUEST_DONE)
+        {
+            // The request timed out while running and this thread was replaced.
+            // Leave the pool if it is back to full strength without us.
+            mNumStalled--;
+            if (mNumThreads - mNumStalled > NUM_THREADS)
+            {
+                mNumThreads--;
+                return;
+            }
+            continue;
+        }
+
+        request->mState = REQUEST_DONE;
+        if (!request->mCancelled)
+        {
+            request->mStatus = IO_COMPLETED;
+            mDeliveries.push_back(request);
+            mDeliveryCondition.notify_one();
+        }
+    }
+}
+
+///
+//  Run completion callbacks (delivery thread)
+//
+void IOExecutor::runDelivery()
+{
+    boost::mutex::scoped_lock lock(mMutex);
+
+    while (true)
+    {
+        RequestPtr request = takeDelivery();
+        if (request == NULL)
+        {
+            mDeliveryCondition.wait(lock);
+            continue;
+        }
+
+        WApplication *app = request->mApp;
+        mDelivering.insert(app);
+
+        deliver(request, lock);
+
+        mDelivering.erase(app);
+        mDeliveredCondition.notify_all();
+
+        // Callbacks of the session may have been left for another thread
+        mDeliveryCondition.notify_all();
+    }
+}
+
+///
+//  Time out requests (timeout thread)
+//
+void IOExecutor::runTimeouts()
+{
+    boost::mutex::scoped_lock lock(mMutex);
+
+    while (true)
+    {
+        boost::system_time nextDeadline;
+        if (expireRequests(nextDeadline))
+        {
+            mTimeoutCondition.timed_wait(lock, nextDeadline);
+        }
+        else
+        {
+            mTimeoutCondition.wait(lock);
+        }
+    }
+}
+
+///
+//  Take the next request whose session no other delivery thread is in
+//
+IOExecutor::RequestPtr IOExecutor::takeDelivery()
+{
+    // Callbacks of a session run in order, one at a time
+    std::deque<RequestPtr>::iterator iter = mDeliveries.begin();
+    while (iter != mDeliveries.end())
+    {
+        if ((*iter)->mCancelled)
+        {
+            iter = mDeliveries.erase(iter);
+        }
+        else if (mDelivering.find((*iter)->mApp) != mDelivering.end())
+        {
+            ++iter;
+        }
+        else
+        {
+            RequestPtr request = *iter;
+            mDeliveries.erase(iter);
+            return request;
+        }
+    }
+
+    return RequestPtr();
+}
+
+///
+//  Time out the requests whose deadline has passed
+//
+bool IOExecutor::expireRequests(boost::system_time& nextDeadline)
+{
+    boost::system_time now = boost::get_system_time();
+    std::deque<RequestPtr> active;
+    bool waiting = false;
+
+    for (size_t i = 0; i < mActive.size(); i++)
+    {
+        RequestPtr request = mActive[i];
+
+        // Finished or dropped by a worker
+        if (request->mState == REQUEST_DONE)
+        {
+            continue;
+        }
+
+        if (request->mDeadline > now)
+        {
+            if (!waiting || request->mDeadline < nextDeadline)
+            {
+                nextDeadline = request->mDeadline;
+            }
+            waiting = true;
+            active.push_back(request);
+            continue;
+        }
+
+        if (request->mState == REQUEST_RUNNING)
+        {
+            // Give up on the thread and replace it, unless too many are stuck
+            mNumStalled++;
+            if (mNumStalled <= MAX_STALLED_THREADS && mNumThreads - mNumStalled < NUM_THREADS)
+            {
+                startWorker();
+            }
+        }
+
+        request->mState = REQUEST_DONE;
+        request->mStatus = IO_TIMED_OUT;
+        if (!request->mCancelled)
+        {
+            mDeliveries.push_back(request);
+            mDeliveryCondition.notify_one();
+        }
+    }
+
+    mActive.swap(active);
+
+    return waiting;
+}
+
+///
+//  Run the completion callback of a request in its session
+//
+void IOExecutor::deliver(RequestPtr request, boost::mutex::scoped_lock& lock)
+{
+    WApplication *app = request->mApp;
+    lock.unlock();
+
+    {
+        // First, take the lock to safely manipulate the UI outside of the
+        // normal event loop, by having exclusive access to the session.
+        WApplication::UpdateLock updateLock = app->getUpdateLock();
+
+        // The client may have cancelled, or the application been detached, while
+        // we waited for the session
+        lock.lock();
+        bool cancelled = request->mCancelled;
+        lock.unlock();
+
+        if (!cancelled)
+        {
+            try
+            {
+                request->mDone(request->mStatus);
+            }
+            catch (...)
+            {
+                // Keep delivering to the other sessions
+            }
+
+            app->triggerUpdate();
+        }
+    }
+
+    lock.lock();
+}
@@ -0,0 +1,257 @@
+//
+//
+//  Description:
+//      Definition of the process-wide I/O executor.  Event handlers hand their
+//      filesystem work to a shared pool of I/O threads instead of doing it while
+//      holding the session, so that a stalled NFS server never ties up a Wt worker
+//      thread.  When the work finishes, or when its timeout expires first, the
+//      completion callback runs with the session's update lock held and the
+//      browser is updated by server push.
+//
+//      A thread stuck in the filesystem cannot be interrupted.  When its request
+//      times out the thread is given up on and a new one is started in its place,
+//      up to a limit, so that one stalled mount does not starve every session.
+//
+//      Callbacks are run by a small pool of delivery threads, one session at a
+//      time each, so a session busy in a long event handler only holds up its own
+//      callbacks.  Timeouts are expired by a thread of their own.
+//
+//  Author:
+//      Dan Ginsburg
+//
+//  Children's Hospital Boston
+//  GPL v2
+//
+#ifndef IOEXECUTOR_H
+#define IOEXECUTOR_H
+
+#include <boost/function.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition.hpp>
+#include <boost/thread/thread_time.hpp>
+#include <deque>
+#include <set>
+
+namespace Wt
+{
+    class WApplication;
+}
+
+using namespace Wt;
+
+///
+/// \class IOExecutor
+/// \brief Singleton pool of threads that run filesystem work for the sessions
+///
+class IOExecutor
+{
+public:
+
+    /// Outcome of a request, passed to its completion callback
+    typedef enum
+    {
+        IO_COMPLETED,   // The work ran to completion
+        IO_TIMED_OUT    // The timeout expired first, the work's results must not be used
+    } StatusEnum;
+
+    /// Filesystem work, runs on an I/O thread.  It must not touch any widget or
+    /// call WApplication::instance(), results are passed back through objects
+    /// bound into both callbacks.
+    typedef boost::function<void ()> Work;
+
+    /// Completion callback, runs with the session's update lock held
+    typedef boost::function<void (StatusEnum)> Done;
+
+    /// Number of I/O threads
+    static const int NUM_THREADS = 8;
+
+    /// Number of threads running completion callbacks
+    static const int NUM_DELIVERY_THREADS = 4;
+
+    /// Maximum number of threads given up on while stuck in the filesystem
+    static const int MAX_STALLED_THREADS = 32;
+
+    /// Default timeout of a request
+    static const int DEFAULT_TIMEOUT_MS = 20000;
+
+    ///
+    /// Get the process-wide executor instance
+    ///
+    static IOExecutor& instance();
+
+    ///
+    /// Get a new id for a client, used to cancel its requests together
+    ///
+    int newClientId();
+
+    ///
+    /// Submit a request
+    /// \param app Application whose session the completion callback runs in
+    /// \param clientId Id of the client submitting the request
+    /// \param work Filesystem work to run on an I/O thread
+    /// \param done Completion callback
+    /// \param timeoutMs Time after which done is called with IO_TIMED_OUT
+    ///
+    void submit(WApplication *app, int clientId, const Work& work, const Done& done, int timeoutMs);
+
+    ///
+    /// Run a callback in a session, without any work.  Used by work running
+    /// elsewhere, such as the job submission queue, to report to a session.  The
+    /// callback is cancelled with the client like any other request.
+    /// \param app Application whose session the callback runs in
+    /// \param clientId Id of the client the callback is for
+    /// \param done Callback, passed IO_COMPLETED
+    ///
+    void post(WApplication *app, int clientId, const Done& done);
+
+    ///
+    /// Cancel every request of a client.  Their completion callbacks are not called,
+    /// including any that are waiting for the update lock.  Must be called from the
+    /// client's session.
+    ///
+    void cancelClient(int clientId);
+
+    ///
+    /// Get the number of requests of a client whose callbacks have not run yet
+    ///
+    int getNumPending(int clientId);
+
+    ///
+    /// Cancel every request of an application and wait for the delivery threads
+    /// to let go of it, including one waiting for its update lock.  Call from
+    /// WApplication::finalize(), the application must not be destroyed before.
+    ///
+    void detachApplication(WApplication *app);
+
+private:
+
+    ///
+    /// Constructor
+    ///
+    IOExecutor();
+
+    ///
+    /// Destructor
+    ///
+    virtual ~IOExecutor();
+
+    /// State of a request
+    typedef enum
+    {
+        REQUEST_QUEUED,     // Waiting for an I/O thread
+        REQUEST_RUNNING,    // Work is running
+        REQUEST_DONE        // Completed or timed out, waiting for its callback
+    } RequestStateEnum;
+
+    /// Submitted request
+    typedef struct
+    {
+        /// Client that submitted the request
+        int mClientId;
+
+        /// Application the callback runs in
+        WApplication *mApp;
+
+        /// Filesystem work
+        Work mWork;
+
+        /// Completion callback
+        Done mDone;
+
+        /// Time at which the request times out
+        boost::system_time mDeadline;
+
+        /// Current state
+        RequestStateEnum mState;
+
+        /// Outcome, once done
+        StatusEnum mStatus;
+
+        /// Whether the request was cancelled
+        bool mCancelled;
+
+    } Request;
+
+    typedef boost::shared_ptr<Request> RequestPtr;
+
+    ///
+    /// Start an I/O thread.  Call with mMutex held.
+    ///
+    void startWorker();
+
+    ///
+    /// Run requests (I/O thread)
+    ///
+    void runWorker();
+
+    ///
+    /// Run completion callbacks (delivery thread)
+    ///
+    void runDelivery();
+
+    ///
+    /// Time out requests (timeout thread)
+    ///
+    void runTimeouts();
+
+    ///
+    /// Take the next request whose session no other delivery thread is in.
+    /// Call with mMutex held.
+    /// \return NULL if there is none
+    ///
+    RequestPtr takeDelivery();
+
+    ///
+    /// Time out the requests whose deadline has passed and get the next deadline.
+    /// Call with mMutex held.
+    /// \return Whether any request is still waiting on a deadline
+    ///
+    bool expireRequests(boost::system_time& nextDeadline);
+
+    ///
+    /// Run the completion callback of a request in its session.  Call with mMutex
+    /// held and the request's application in mDelivering, the mutex is released
+    /// while the callback runs.
+    ///
+    void deliver(RequestPtr request, boost::mutex::scoped_lock& lock);
+
+    /// Requests waiting for an I/O thread, in submission order
+    std::deque<RequestPtr> mQueue;
+
+    /// Requests that are queued or running, checked for timeouts
+    std::deque<RequestPtr> mActive;
+
+    /// Requests waiting for their completion callback
+    std::deque<RequestPtr> mDeliveries;
+
+    /// Applications a delivery thread has taken a request for, from when the
+    /// request is taken until the thread has let go of the session
+    std::set<WApplication*> mDelivering;
+
+    /// Next client id
+    int mNextClientId;
+
+    /// Number of I/O threads, including stalled ones
+    int mNumThreads;
+
+    /// Number of I/O threads stuck in work that timed out
+    int mNumStalled;
+
+    /// Mutex protecting all of the above
+    boost::mutex mMutex;
+
+    /// Signalled when a request is queued
+    boost::condition mWorkCondition;
+
+    /// Signalled when a callback can be delivered
+    boost::condition mDeliveryCondition;
+
+    /// Signalled when a request with a deadline is submitted
+    boost::condition mTimeoutCondition;
+
+    /// Signalled when a delivery thread lets go of a session
+    boost::condition mDeliveredCondition;
+};
+
+#endif // IOEXECUTOR_H
@@ -26,13 +26,8 @@
 #include <Wt/WVBoxLayout>
 #include <Wt/WImage>
 #include <iostream>
-#include <boost/filesystem.hpp>
-#include <boost/process/process.hpp>
-#include <boost/process/child.hpp>
-#include <boost/process/launch_shell.hpp>
-#include <boost/process/iostreams_pipe_end_traits.hpp>
-#include <boost/process/pipe_end.hpp>
-#include <boost/iostreams/stream.hpp>
+#include <sstream>
+#include <boost/bind.hpp>
 
 
 ///
@@ -40,9 +35,6 @@
 //
 using namespace Wt;
 using namespace std;
-using namespace boost::processes;
-using namespace boost::iostreams;
-using namespace boost::filesystem;
 
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -56,9 +48,7 @@ using namespace boost::filesystem;
 //
 JobStatus::JobStatus(WContainerWidget *parent) :
     WContainerWidget(parent),
-    mStopUpdateThread(false),
-    mUpdateStatus(false),
-    mApp(WApplication::instance())
+    mSubscriptionId(-1)
 {
     setStyleClass("tabdiv");
 
@@ -82,8 +72,6 @@ JobStatus::JobStatus(WContainerWidget *parent) :
 
     mKillButton->clicked().connect(SLOT(this, JobStatus::killButtonClicked));
 
-    mThread = new boost::thread(boost::bind(&JobStatus::updateStatus, this));
-
     resetAll();
 
 }
@@ -93,6 +81,7 @@ JobStatus::JobStatus(WContainerWidget *parent) :
 //
 JobStatus::~JobStatus()
 {
+    stopUpdate();
 }
 
 
@@ -108,7 +97,26 @@ JobStatus::~JobStatus()
 //
 void JobStatus::startUpdate()
 {
-    mUpdateStatus = true;
+    if (mSubscriptionId != -1 || mClusterShFile == "" || mJobID == "")
+    {
+        return;
+    }
+
+    JobStatusPoller::Job job;
+    job.mJobId = mJobID;
+    job.mClusterShFile = mClusterShFile;
+    job.mMetaScript = mMetaScript;
+    job.mJobIDPrefix = getConfigOptionsPtr()->GetJobIDPrefix();
+    job.mClusterType = getConfigOptionsPtr()->GetClusterType();
+    job.mClusterHeadNode = getConfigOptionsPtr()->GetClusterHeadNode();
+    job.mScriptDir = getConfigOptionsPtr()->GetScriptDir();
+    job.mStages = mStages;
+    job.mClusterDir = getConfigOptionsPtr()->GetClusterDir();
+
+    // The poller queries the cluster for every watched job at once and
+    // posts back only changes of status
+    mSubscriptionId = JobStatusPoller::instance().subscribe(mIOClient.getApp(), mIOClient.getClientId(), job,
+                                                            boost::bind(&JobStatus::statusChanged, this, _1));
 }
 
 ///
@@ -116,7 +124,14 @@ void JobStatus::startUpdate()
 //
 void JobStatus::stopUpdate()
 {
-    mUpdateStatus = false;
+    if (mSubscriptionId != -1)
+    {
+        JobStatusPoller::instance().unsubscribe(mSubscriptionId);
+        mSubscriptionId = -1;
+    }
+
+    // Drop any status of the previous job still waiting to be delivered
+    mIOClient.cancel();
 }
 
 ///
@@ -124,13 +139,7 @@ void JobStatus::stopUpdate()
 //
 void JobStatus::finalize()
 {
-    if (mThread != NULL)
-    {
-        mStopUpdateThread = true;
-        mThread->join();
-        delete mThread;
-        mThread = NULL;
-    }
+    stopUpdate();
 }
 
 ///
@@ -142,35 +151,33 @@ void JobStatus::resetAll()
     mStatusLabel->setText("");
     mKillButton->disable();
 
-    mCurStatus = STATUS_UNSET;
+    stopUpdate();
 
     mClusterShFile = "";
     mMetaScript = "";
+    mStages = "";
     mJobID = "";
     mJobOwner = "";
-
-    stopUpdate();
 }
 
 ///
 //  Populate table with data
 //
 void JobStatus::setJob(const std::string& clusterShFile, const std::string& metaScriptFile,
-                       const std::string& jobID, const std::string& jobOwner)
+                       const std::string& arguments, const std::string& jobID, const std::string& jobOwner)
 {
-    boost::mutex::scoped_lock lock(mUpdateMutex);
-
     resetAll();
 
     mClusterShFile = clusterShFile;
     mMetaScript = metaScriptFile;
+    mStages = MetaLogParser::getStages(arguments);
     mJobID = jobID;
     mJobOwner = jobOwner;
 
     mStatusImage->setImage(new WImage("icons/ajax-loader-trans.gif"));
     mStatusLabel->setText("Determing status...");
 
-    // Trigger the thread to start updating
+    // Subscribe to the status of the job
     startUpdate();
 }
 
@@ -186,198 +193,96 @@ void JobStatus::setJob(const std::string& clusterShFile, const std::string& meta
 //
 void JobStatus::killButtonClicked()
 {
-    // Run the cluster kill script to kill the job
-    std::string cmdToExecute;
-    cmdToExecute = "cluster_kill.bash -J " + getConfigOptionsPtr()->GetJobIDPrefix() + mJobID;
-    cmdToExecute += " -C "+ getConfigOptionsPtr()->GetClusterType();
-    cmdToExecute += " -c " + mClusterShFile;
-    if (getConfigOptionsPtr()->GetClusterHeadNode() != "")
-    {
-        cmdToExecute += " -r " + getConfigOptionsPtr()->GetClusterHeadNode();
-    }
-
-    context ctx;
-    ctx.add(capture_stream(stdout_fileno));
-    ctx.environment = current_environment();
-    ctx.environment["PATH"] = getConfigOptionsPtr()->GetScriptDir() + ":/bin:/usr/bin:/usr/local/bin:/opt/local/bin:" + ctx.environment["PATH"];
-
-    child c = launch_shell(cmdToExecute, ctx);
-    boost::processes::status s = c.wait();
+    ClusterBackend::JobRef job;
+    job.mJobId = getConfigOptionsPtr()->GetJobIDPrefix() + mJobID;
+    job.mClusterShFile = mClusterShFile;
+
+    // The cluster may be slow to answer, the kill runs on an I/O thread
+    mKillIOClient.submit(boost::bind(&JobStatus::killJob,
+                                     getConfigOptionsPtr()->GetClusterType(),
+                                     getConfigOptionsPtr()->GetClusterHeadNode(),
+                                     getConfigOptionsPtr()->GetScriptDir(),
+                                     job),
+                         boost::bind(&JobStatus::jobKilled, this, job.mJobId, _1));
 
     mKillButton->disable();
 }
 
 
 ///
-//  Update thread for checking for status updates
+//  Job status changed [JobStatusPoller callback]
 //
-void JobStatus::updateStatus()
+void JobStatus::statusChanged(const JobStatusPoller::JobState& state)
 {
-    while (!mStopUpdateThread)
+    switch (state.mStatus)
     {
-        if (mUpdateStatus)
+    case JobStatusPoller::STATUS_UNKNOWN:
+        mStatusLabel->setText("UNKNOWN");
+        mStatusImage->setImage(new WImage("icons/lg-alertY-glass.png"));
+        break;
+    case JobStatusPoller::STATUS_RUNNING:
+    case JobStatusPoller::STATUS_QUEUED:
+        if (state.mStatus == JobStatusPoller::STATUS_RUNNING)
         {
-            // Lock mutex for safety again JobStatus::setJob()
-            bool updateStatus = false;
-            mUpdateMutex.lock();
-
-            if (mClusterShFile != "" && mJobID != "")
+            // The stage is parsed from the meta log as it grows
+            std::ostringstream text;
+            text << "RUNNING";
+            if (state.mStage >= 0)
             {
-                // Cluster script dir
-                std::string metaScriptLog = path(mClusterShFile).branch_path().string() + "/" + mMetaScript + ".std";
-
-                // Run the cluster status script to get the status of the job
-                // Determine the password salt by using ypmatch to get
-                std::string cmdToExecute;
-                cmdToExecute = "cluster_status.bash -J " + getConfigOptionsPtrTS(mApp)->GetJobIDPrefix() + mJobID;
-                cmdToExecute += " -C "+ getConfigOptionsPtrTS(mApp)->GetClusterType();
-                cmdToExecute += " -c "+ mClusterShFile;
-                if (getConfigOptionsPtrTS(mApp)->GetClusterHeadNode() != "")
-                {
-                    cmdToExecute += " -r " + getConfigOptionsPtrTS(mApp)->GetClusterHeadNode();
-                }
-
-                context ctx;
-                ctx.add(capture_stream(stdout_fileno));
-                ctx.environment = current_environment();
-                ctx.environment["PATH"] = getConfigOptionsPtrTS(mApp)->GetScriptDir() + ":/bin:/usr/bin:/usr/local/bin:/opt/local/bin:" + ctx.environment["PATH"];
-
-                child c = launch_shell(cmdToExecute, ctx);
-                boost::processes::status s = c.wait();
-
-                // Get the returned encoded password
-                stream<boost::processes::pipe_end> is(c.get_stdout());
-                std::string process;
-                std::string status;
-
-                StatusEnum curStatus = STATUS_UNSET;
-
-
-                try
+                text << " - STAGE " << state.mStage;
+                if (state.mStageText != "")
                 {
-                    is >> process;
-                    is >> status;
-
-                    if (status != "")
-                    {
-                        if (status == "QUEUED")
-                        {
-                            curStatus = STATUS_QUEUED;
-                        }
-                        else
-                        {
-                            curStatus = STATUS_RUNNING;
-                        }
-                    }
-                    else
-                    {
-                        curStatus = STATUS_UNKNOWN;
-                    }
+                    text << " (" << state.mStageText << ")";
                 }
-                catch(...)
-                {
-                    curStatus = STATUS_UNKNOWN;
-                }
-
-                // See if we can figure out what the status of the job is
-                // by looking at the meta log file
-                if (curStatus == STATUS_UNKNOWN)
-                {
-                    if (!exists(metaScriptLog))
-                    {
-                        curStatus = STATUS_WAITING;
-                    }
-                    else
-                    {
-                        // Use the following command to get the result code from the script:
-                        //  tail -2 <filename> | grep code | awk '{print $5}'
-                        // This looks at the "Shutting down with code #..." at the bottom of the script
-                        cmdToExecute = "tail -2 " + metaScriptLog + "| grep code | awk '{print $5}'";
-
-                        child c = launch_shell(cmdToExecute, ctx);
-                        boost::processes::status s = c.wait();
-
-                        // Get the result code
-                        stream<boost::processes::pipe_end> is(c.get_stdout());
-
-                        try
-                        {
-                            std::string returnCode;
-                            is >> returnCode;
-
-                            if (returnCode == "0")
-                            {
-                                curStatus = STATUS_COMPLETED_SUCCESS;
-                            }
-                            else
-                            {
-                                curStatus = STATUS_COMPLETED_FAILURE;
-                            }
-                        }
-                        catch(...)
-                        {
-                            curStatus = STATUS_COMPLETED_FAILURE;
-                        }
-                    }
-                }
-
-                if (curStatus != mCurStatus)
-                {
-                    updateStatus = true;
-                    mCurStatus = curStatus;
-                }
-	        }
-
-            // Unlock mutex before doing mApp->getUpdateLock().  This is crucial because
-            // otherwise a deadlock can occur from setJob() locking this same mutex.
-            mUpdateMutex.unlock();
-            if (updateStatus == true)
+            }
+            if (state.mPercentComplete >= 0)
             {
-                // First, take the lock to safely manipulate the UI outside of the
-                // normal event loop, by having exclusive access to the session.
-                WApplication::UpdateLock lock = mApp->getUpdateLock();
- 
-                switch (mCurStatus)
-                {
-                case STATUS_UNKNOWN:
-                    mStatusLabel->setText("UNKNOWN");
-                    mStatusImage->setImage(new WImage("icons/lg-alertY-glass.png"));
-                    break;
-                case STATUS_RUNNING:
-                case STATUS_QUEUED:
-                    if (mCurStatus == STATUS_RUNNING)
-                        mStatusLabel->setText("RUNNING");
-                    else
-                        mStatusLabel->setText("QUEUED");
-                    mStatusImage->setImage(new WImage("icons/lg-alertO-glass.png"));
-                    if (getCurrentUserName() == mJobOwner)
-                    {
-                        mKillButton->enable();
-                    }
-                    break;
-                case STATUS_WAITING:
-                    mStatusLabel->setText("WAITING TO BE QUEUED");
-                    mStatusImage->setImage(new WImage("icons/lg-alertO-glass.png"));
-                    break;
-                case STATUS_COMPLETED_SUCCESS:
-                    mStatusLabel->setText("COMPLETED (SUCCESS)");
-                    mStatusImage->setImage(new WImage("icons/lg-success-glass.png"));
-                    break;
-                case STATUS_COMPLETED_FAILURE:
-                    mStatusLabel->setText("COMPLETED (FAILURE)");
-                    mStatusImage->setImage(new WImage("icons/lg-failed-glass.png"));
-                    break;
-                default:
-                    // Unset state, don't display anything
-                    break;
-                }
-
-                mApp->triggerUpdate();
+                text << " - " << state.mPercentComplete << "% complete";
             }
+            mStatusLabel->setText(text.str());
         }
-
-        // Sleep for 1 second
-        boost::this_thread::sleep(boost::posix_time::milliseconds(1000));
+        else
+            mStatusLabel->setText("QUEUED");
+        mStatusImage->setImage(new WImage("icons/lg-alertO-glass.png"));
+        if (getCurrentUserName() == mJobOwner)
+        {
+            mKillButton->enable();
+        }
+        break;
+    case JobStatusPoller::STATUS_WAITING:
+        mStatusLabel->setText("WAITING TO BE QUEUED");
+        mStatusImage->setImage(new WImage("icons/lg-alertO-glass.png"));
+        break;
+    case JobStatusPoller::STATUS_COMPLETED_SUCCESS:
+        mStatusLabel->setText("COMPLETED (SUCCESS)");
+        mStatusImage->setImage(new WImage("icons/lg-success-glass.png"));
+        break;
+    case JobStatusPoller::STATUS_COMPLETED_FAILURE:
+        mStatusLabel->setText("COMPLETED (FAILURE)");
+        mStatusImage->setImage(new WImage("icons/lg-failed-glass.png"));
+        break;
+    default:
+        // Unset state, don't display anything
+        break;
     }
 }
 
+///
+//  Kill a job (I/O thread)
+//
+void JobStatus::killJob(const std::string& clusterType, const std::string& clusterHeadNode,
+                        const std::string& scriptDir, const ClusterBackend::JobRef& job)
+{
+    ClusterBackend::getBackend(clusterType, clusterHeadNode, scriptDir)->kill(std::vector<ClusterBackend::JobRef>(1, job));
+}
+
+///
+//  Job killed [IOExecutor callback]
+//
+void JobStatus::jobKilled(const std::string& jobID, IOExecutor::StatusEnum status)
+{
+    if (status == IOExecutor::IO_TIMED_OUT)
+    {
+        WApplication::instance()->log("error") << "Timed out killing job: " << jobID;
+    }
+}
@@ -12,9 +12,9 @@
 #ifndef JOBSTATUS_H
 #define JOBSTATUS_H
 
-#include <boost/thread.hpp>
-#include <boost/thread/condition.hpp>
-
+#include "IOClient.h"
+#include "JobStatusPoller.h"
+#include "ClusterBackend.h"
 #include <Wt/WContainerWidget>
 
 namespace Wt
@@ -70,34 +70,30 @@ public:
     /// Populate with script data
     ///
     void setJob(const std::string& clusterShFile, const std::string& metaScript,
-                const std::string& jobId, const std::string& jobOwner);
+                const std::string& arguments, const std::string& jobId, const std::string& jobOwner);
 
 private:
 
-    // Status enumerant
-    typedef enum
-    {
-        STATUS_UNSET = -1,
-        STATUS_UNKNOWN,
-        STATUS_WAITING,
-        STATUS_QUEUED,
-        STATUS_RUNNING,
-        STATUS_COMPLETED_FAILURE,
-        STATUS_COMPLETED_SUCCESS,
-
-        NUM_STATUS
-
-    } StatusEnum;
-
     ///
     ///  Kill button clicked [slot]
     ///
     void killButtonClicked();
 
     ///
-    ///  Update thread for checking for status updates
+    ///  Job status changed [JobStatusPoller callback]
+    ///
+    void statusChanged(const JobStatusPoller::JobState& state);
+
+    ///
+    ///  Kill a job (I/O thread)
     ///
-    void updateStatus();
+    static void killJob(const std::string& clusterType, const std::string& clusterHeadNode,
+                        const std::string& scriptDir, const ClusterBackend::JobRef& job);
+
+    ///
+    ///  Job killed [IOExecutor callback]
+    ///
+    void jobKilled(const std::string& jobID, IOExecutor::StatusEnum status);
 
 
     /// Cluster sh file
@@ -106,6 +102,9 @@ private:
     /// Cluster sh file
     std::string mMetaScript;
 
+    /// Stages the job runs
+    std::string mStages;
+
     /// Job ID
     std::string mJobID;
 
@@ -121,23 +120,14 @@ private:
     /// Kill button
     WPushButton *mKillButton;
 
-    /// Application instance pointer
-    WApplication *mApp;
-
-    /// Thread for background processing
-    boost::thread  *mThread;
-
-    /// Current status
-    volatile StatusEnum mCurStatus;
-
-    /// Stop updating thread
-    volatile bool mStopUpdateThread;
+    /// I/O client, status changes are posted for it
+    IOClient mIOClient;
 
-    /// Do update
-    volatile bool mUpdateStatus;
+    /// I/O client killing jobs, not cancelled when another job is shown
+    IOClient mKillIOClient;
 
-    /// Mutex
-    boost::mutex mUpdateMutex;
+    /// Subscription to the job status poller, -1 if none
+    int mSubscriptionId;
 };
 
 #endif // JOBSTATUS_H
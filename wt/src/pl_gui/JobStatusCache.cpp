@@ -0,0 +1,281 @@
+//
+//
+//  Description:
+//      Implementation of the process-wide job status cache.  Holds the final state
+//      of every finished job the poller has seen.  A finished job does not change
+//      again, so once its state is cached it is never polled again.  The states are
+//      appended to a cache file in the cluster directory and read back on first
+//      use, so they are kept across server restarts.
+//
+//      Each line of the cache file is one job: key, status, stage, percent complete
+//      and stage text, separated by tabs.  Lines are appended, each in a single
+//      write, so a server killed while writing loses at most its last line.  When
+//      the file is compacted it is written under a temporary name and renamed into
+//      place.  A line another server appends meanwhile may be lost, which again
+//      only costs a poll.
+//
+//  Author:
+//      Dan Ginsburg
+//
+//  Children's Hospital Boston
+//  GPL v2
+//
+#include "JobStatusCache.h"
+#include <fstream>
+#include <sstream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+///
+//  Namespaces
+//
+using namespace std;
+
+///
+//  Static constants
+//
+const size_t JobStatusCache::COMPACT_RATIO;
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Constructor/Destructor
+//
+//
+
+///
+//  Constructor
+//
+JobStatusCache::JobStatusCache()
+{
+}
+
+///
+//  Destructor
+//
+JobStatusCache::~JobStatusCache()
+{
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Public Members
+//
+//
+
+///
+//  Get the process-wide cache instance
+//
+JobStatusCache& JobStatusCache::instance()
+{
+    // Never destroyed, the poller thread uses it for the life of the process
+    static JobStatusCache *cache = new JobStatusCache();
+    return *cache;
+}
+
+///
+//  Get the final state of a job
+//
+bool JobStatusCache::getState(const std::string& clusterDir, const std::string& key,
+                              JobStatusPoller::JobState& state)
+{
+    boost::mutex::scoped_lock lock(mMutex);
+
+    StateMap& states = getStates(clusterDir).mStates;
+    StateMap::const_iterator iter = states.find(key);
+    if (iter == states.end())
+    {
+        return false;
+    }
+
+    state = iter->second;
+    return true;
+}
+
+///
+//  Add the final state of a finished job
+//
+void JobStatusCache::putState(const std::string& clusterDir, const std::string& key,
+                              const JobStatusPoller::JobState& state)
+{
+    boost::mutex::scoped_lock lock(mMutex);
+
+    ClusterStates& clusterStates = getStates(clusterDir);
+    if (!clusterStates.mStates.insert(std::make_pair(key, state)).second || clusterDir == "")
+    {
+        return;
+    }
+
+    // A cluster directory the server cannot write to only keeps the states in memory
+    FILE *fp = fopen(getCacheFile(clusterDir).c_str(), "a");
+    if (fp != NULL)
+    {
+        fputs(formatLine(key, state).c_str(), fp);
+        fclose(fp);
+        clusterStates.mNumLines++;
+    }
+
+    compact(clusterDir, clusterStates);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Private Members
+//
+//
+
+///
+//  Get the states of a cluster directory
+//
+JobStatusCache::ClusterStates& JobStatusCache::getStates(const std::string& clusterDir)
+{
+    std::map<std::string, ClusterStates>::iterator iter = mStates.find(clusterDir);
+    if (iter == mStates.end())
+    {
+        ClusterStates clusterStates;
+        clusterStates.mNumLines = 0;
+
+        iter = mStates.insert(std::make_pair(clusterDir, clusterStates)).first;
+        if (clusterDir != "")
+        {
+            iter->second.mNumLines = readCacheFile(getCacheFile(clusterDir), iter->second.mStates);
+            compact(clusterDir, iter->second);
+        }
+    }
+
+    return iter->second;
+}
+
+///
+//  Rewrite the cache file of a cluster directory with one line per job
+//
+void JobStatusCache::compact(const std::string& clusterDir, ClusterStates& clusterStates)
+{
+    if (clusterStates.mNumLines <= COMPACT_RATIO * clusterStates.mStates.size())
+    {
+        return;
+    }
+
+    // Pick up what other servers appended since the file was read, so that
+    // their jobs are kept
+    std::string cacheFile = getCacheFile(clusterDir);
+    clusterStates.mNumLines = readCacheFile(cacheFile, clusterStates.mStates);
+    if (clusterStates.mNumLines <= COMPACT_RATIO * clusterStates.mStates.size())
+    {
+        return;
+    }
+
+    std::ostringstream tmpFile;
+    tmpFile << cacheFile << ".tmp." << getpid();
+
+    FILE *fp = fopen(tmpFile.str().c_str(), "w");
+    if (fp == NULL)
+    {
+        return;
+    }
+
+    bool success = true;
+    for (StateMap::const_iterator iter = clusterStates.mStates.begin();
+         iter != clusterStates.mStates.end() && success; ++iter)
+    {
+        success = (fputs(formatLine(iter->first, iter->second).c_str(), fp) >= 0);
+    }
+
+    if (fclose(fp) != 0)
+    {
+        success = false;
+    }
+
+    // Replace the file atomically, a reader sees either the old or the new one
+    if (!success || rename(tmpFile.str().c_str(), cacheFile.c_str()) != 0)
+    {
+        remove(tmpFile.str().c_str());
+        return;
+    }
+
+    clusterStates.mNumLines = clusterStates.mStates.size();
+}
+
+///
+//  Read a cache file
+//
+size_t JobStatusCache::readCacheFile(const std::string& cacheFile, StateMap& states)
+{
+    std::ifstream file(cacheFile.c_str(), ios::in);
+    if (!file.is_open())
+    {
+        return 0;
+    }
+
+    size_t numLines = 0;
+    std::string line;
+    while (getline(file, line))
+    {
+        // The last line is incomplete if a server was killed while writing it
+        if (file.eof())
+        {
+            break;
+        }
+        numLines++;
+
+        std::istringstream lineStream(line);
+        std::string key;
+        std::string status;
+        std::string stage;
+        std::string percentComplete;
+        JobStatusPoller::JobState state;
+
+        // A damaged line is skipped, its job is polled again
+        if (!getline(lineStream, key, '\t') ||
+            !getline(lineStream, status, '\t') ||
+            !getline(lineStream, stage, '\t') ||
+            !getline(lineStream, percentComplete, '\t'))
+        {
+            continue;
+        }
+        getline(lineStream, state.mStageText);
+
+        state.mStatus = (JobStatusPoller::StatusEnum)atoi(status.c_str());
+        state.mStage = atoi(stage.c_str());
+        state.mPercentComplete = atoi(percentComplete.c_str());
+        state.mFinal = true;
+
+        if (state.mStatus == JobStatusPoller::STATUS_COMPLETED_SUCCESS ||
+            state.mStatus == JobStatusPoller::STATUS_COMPLETED_FAILURE)
+        {
+            states[key] = state;
+        }
+    }
+
+    return numLines;
+}
+
+///
+//  Format the line of a job in a cache file
+//
+std::string JobStatusCache::formatLine(const std::string& key, const JobStatusPoller::JobState& state)
+{
+    // Tabs and newlines would break the line up
+    std::string stageText = state.mStageText;
+    for (size_t i = 0; i < stageText.size(); i++)
+    {
+        if (stageText[i] == '\t' || stageText[i] == '\n' || stageText[i] == '\r')
+        {
+            stageText[i] = ' ';
+        }
+    }
+
+    std::ostringstream line;
+    line << key << "\t" << (int)state.mStatus << "\t" << state.mStage << "\t"
+         << state.mPercentComplete << "\t" << stageText << "\n";
+
+    return line.str();
+}
+
+///
+//  Get the cache file of a cluster directory
+//
+std::string JobStatusCache::getCacheFile(const std::string& clusterDir)
+{
+    return clusterDir + "/job_status.cache";
+}
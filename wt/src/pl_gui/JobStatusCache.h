@@ -0,0 +1,124 @@
+//
+//
+//  Description:
+//      Definition of the process-wide job status cache.  Holds the final state of
+//      every finished job the poller has seen.  A finished job does not change
+//      again, so once its state is cached it is never polled again.  The states are
+//      appended to a cache file in the cluster directory and read back on first
+//      use, so they are kept across server restarts.
+//
+//      Several servers may share a cluster directory over NFS, where appends are
+//      not atomic.  A line damaged by two servers writing at once is skipped when
+//      the file is read, which only costs polling its job again.  The file is
+//      rewritten without its stale and duplicate lines once it has grown to
+//      several times the number of jobs in it.
+//
+//  Author:
+//      Dan Ginsburg
+//
+//  Children's Hospital Boston
+//  GPL v2
+//
+#ifndef JOBSTATUSCACHE_H
+#define JOBSTATUSCACHE_H
+
+#include "JobStatusPoller.h"
+#include <boost/thread/mutex.hpp>
+#include <map>
+#include <string>
+
+///
+/// \class JobStatusCache
+/// \brief Singleton holding the final states of finished jobs, persisted per cluster directory
+///
+class JobStatusCache
+{
+public:
+
+    ///
+    /// Get the process-wide cache instance
+    ///
+    static JobStatusCache& instance();
+
+    ///
+    /// Get the final state of a job
+    /// \param clusterDir Cluster directory of the job, empty to not persist it
+    /// \param key Key of the job (JobStatusPoller::getKey())
+    /// \param state Filled with the state of the job, if it is cached
+    /// \return false if the job is not known to have finished
+    ///
+    bool getState(const std::string& clusterDir, const std::string& key, JobStatusPoller::JobState& state);
+
+    ///
+    /// Add the final state of a finished job, appended to the cache file
+    /// \param clusterDir Cluster directory of the job, empty to not persist it
+    /// \param key Key of the job (JobStatusPoller::getKey())
+    /// \param state Final state of the job
+    ///
+    void putState(const std::string& clusterDir, const std::string& key, const JobStatusPoller::JobState& state);
+
+private:
+
+    ///
+    /// Constructor
+    ///
+    JobStatusCache();
+
+    ///
+    /// Destructor
+    ///
+    virtual ~JobStatusCache();
+
+    /// Final states by job key
+    typedef std::map<std::string, JobStatusPoller::JobState> StateMap;
+
+    /// States of a cluster directory
+    typedef struct
+    {
+        /// Final states by job key
+        StateMap mStates;
+
+        /// Number of lines in the cache file, as far as this server knows
+        size_t mNumLines;
+
+    } ClusterStates;
+
+    /// The cache file is rewritten once it has this many times more lines than jobs
+    static const size_t COMPACT_RATIO = 2;
+
+    ///
+    /// Get the states of a cluster directory, read from its cache file on first
+    /// use.  Call with mMutex held.
+    ///
+    ClusterStates& getStates(const std::string& clusterDir);
+
+    ///
+    /// Rewrite the cache file of a cluster directory with one line per job, if it
+    /// has grown to COMPACT_RATIO times the number of jobs.  Call with mMutex held.
+    ///
+    static void compact(const std::string& clusterDir, ClusterStates& clusterStates);
+
+    ///
+    /// Read a cache file
+    /// \return Number of complete lines in the file
+    ///
+    static size_t readCacheFile(const std::string& cacheFile, StateMap& states);
+
+    ///
+    /// Format the line of a job in a cache file
+    ///
+    static std::string formatLine(const std::string& key, const JobStatusPoller::JobState& state);
+
+    ///
+    /// Get the cache file of a cluster directory
+    ///
+    static std::string getCacheFile(const std::string& clusterDir);
+
+    /// States by cluster directory
+    std::map<std::string, ClusterStates> mStates;
+
+    /// Mutex protecting the states
+    boost::mutex mMutex;
+};
+
+#endif // JOBSTATUSCACHE_H
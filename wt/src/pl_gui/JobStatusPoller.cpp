@@ -0,0 +1,624 @@
+//
+//
+//  Description:
+//      Implementation of the job status poller.  A single poller per server process
+//      watches every job that any session is showing the status of.  Once per
+//      interval it queries the cluster for all of them in one batched shell run,
+//      instead of each session forking cluster_status.bash for its own job every
+//      second.  Sessions subscribe to a job and are notified, by server push, only
+//      when its status changes.  The meta logs of running and finished jobs are
+//      parsed natively and incrementally for the exit code and current stage.
+//
+//      Finished jobs are kept in the JobStatusCache and never polled again.  The
+//      others are polled less often the longer their state stays the same, queued
+//      jobs less often than running ones.
+//
+//  Author:
+//      Dan Ginsburg
+//
+//  Children's Hospital Boston
+//  GPL v2
+//
+#include "JobStatusPoller.h"
+#include "ClusterBackend.h"
+#include "JobStatusCache.h"
+#include <boost/bind.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/cstdint.hpp>
+#include <algorithm>
+#include <sstream>
+#include <stdlib.h>
+
+///
+//  Namespaces
+//
+using namespace std;
+using namespace boost::filesystem;
+using namespace boost::posix_time;
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Constructor/Destructor
+//
+//
+
+///
+//  Constructor
+//
+JobStatusPoller::JobStatusPoller() :
+    mNextSubscriptionId(0)
+{
+    boost::thread(boost::bind(&JobStatusPoller::runPoller, this));
+}
+
+///
+//  Destructor
+//
+JobStatusPoller::~JobStatusPoller()
+{
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Public Members
+//
+//
+
+///
+//  Get the process-wide poller instance
+//
+JobStatusPoller& JobStatusPoller::instance()
+{
+    // Never destroyed, its thread runs for the life of the process
+    static JobStatusPoller *poller = new JobStatusPoller();
+    return *poller;
+}
+
+///
+//  Subscribe to the status of a job
+//
+int JobStatusPoller::subscribe(WApplication *app, int clientId, const Job& job, const StatusCallback& callback)
+{
+    Subscription subscription;
+    subscription.mApp = app;
+    subscription.mClientId = clientId;
+    subscription.mCallback = callback;
+
+    boost::mutex::scoped_lock lock(mMutex);
+
+    // Another session may already watch the job, so its state may be known now
+    JobStateMap known;
+    watchJobs(subscription, std::vector<Job>(1, job), known);
+    postStates(subscription, known);
+
+    int subscriptionId = mNextSubscriptionId++;
+    mSubscriptions[subscriptionId] = subscription;
+
+    return subscriptionId;
+}
+
+///
+//  Subscribe to the status of a set of jobs
+//
+int JobStatusPoller::subscribeJobs(WApplication *app, int clientId, const std::vector<Job>& jobs,
+                                   const JobStatesCallback& callback)
+{
+    Subscription subscription;
+    subscription.mApp = app;
+    subscription.mClientId = clientId;
+    subscription.mStatesCallback = callback;
+
+    boost::mutex::scoped_lock lock(mMutex);
+
+    JobStateMap known;
+    watchJobs(subscription, jobs, known);
+    postStates(subscription, known);
+
+    int subscriptionId = mNextSubscriptionId++;
+    mSubscriptions[subscriptionId] = subscription;
+
+    return subscriptionId;
+}
+
+///
+//  Replace the jobs of a subscription
+//
+void JobStatusPoller::setJobs(int subscriptionId, const std::vector<Job>& jobs)
+{
+    boost::mutex::scoped_lock lock(mMutex);
+
+    std::map<int, Subscription>::iterator iter = mSubscriptions.find(subscriptionId);
+    if (iter == mSubscriptions.end())
+    {
+        return;
+    }
+
+    // Watch the new jobs before releasing the old ones, so jobs in both keep
+    // their state
+    std::vector<std::string> oldKeys;
+    oldKeys.swap(iter->second.mKeys);
+
+    JobStateMap known;
+    watchJobs(iter->second, jobs, known);
+    releaseJobs(oldKeys);
+
+    // Only the jobs new to the subscription are posted
+    for (size_t i = 0; i < oldKeys.size(); i++)
+    {
+        known.erase(oldKeys[i]);
+    }
+    postStates(iter->second, known);
+}
+
+///
+//  Unsubscribe
+//
+void JobStatusPoller::unsubscribe(int subscriptionId)
+{
+    boost::mutex::scoped_lock lock(mMutex);
+
+    std::map<int, Subscription>::iterator iter = mSubscriptions.find(subscriptionId);
+    if (iter == mSubscriptions.end())
+    {
+        return;
+    }
+
+    releaseJobs(iter->second.mKeys);
+    mSubscriptions.erase(iter);
+}
+
+///
+//  Get the key identifying a job
+//
+std::string JobStatusPoller::getKey(const Job& job)
+{
+    return job.mClusterType + ":" + job.mClusterHeadNode + ":" + job.mJobIDPrefix + job.mJobId;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Private Members
+//
+//
+
+///
+//  Add a subscription to jobs
+//
+void JobStatusPoller::watchJobs(Subscription& subscription, const std::vector<Job>& jobs, JobStateMap& known)
+{
+    for (size_t i = 0; i < jobs.size(); i++)
+    {
+        std::string key = getKey(jobs[i]);
+
+        std::map<std::string, WatchedJob>::iterator iter = mJobs.find(key);
+        if (iter == mJobs.end())
+        {
+            WatchedJob watchedJob;
+            watchedJob.mJob = jobs[i];
+            watchedJob.mState.mStatus = STATUS_UNSET;
+            watchedJob.mState.mStage = -1;
+            watchedJob.mState.mPercentComplete = -1;
+            watchedJob.mState.mFinal = false;
+            watchedJob.mNumSubscriptions = 0;
+
+            iter = mJobs.insert(std::make_pair(key, watchedJob)).first;
+        }
+        else if (std::binary_search(subscription.mKeys.begin(), subscription.mKeys.end(), key))
+        {
+            continue;
+        }
+
+        iter->second.mNumSubscriptions++;
+        subscription.mKeys.insert(std::lower_bound(subscription.mKeys.begin(), subscription.mKeys.end(), key), key);
+
+        if (iter->second.mState.mStatus != STATUS_UNSET)
+        {
+            known[key] = iter->second.mState;
+        }
+    }
+
+    mWatchCondition.notify_one();
+}
+
+///
+//  Remove a subscription from the jobs with keys
+//
+void JobStatusPoller::releaseJobs(const std::vector<std::string>& keys)
+{
+    for (size_t i = 0; i < keys.size(); i++)
+    {
+        std::map<std::string, WatchedJob>::iterator iter = mJobs.find(keys[i]);
+        if (iter != mJobs.end() && --iter->second.mNumSubscriptions == 0)
+        {
+            mJobs.erase(iter);
+        }
+    }
+}
+
+///
+//  Post the states of jobs to a subscription
+//
+void JobStatusPoller::postStates(const Subscription& subscription, const JobStateMap& states)
+{
+    if (states.empty())
+    {
+        return;
+    }
+
+    if (subscription.mStatesCallback)
+    {
+        IOExecutor::instance().post(subscription.mApp, subscription.mClientId,
+                                    boost::bind(&JobStatusPoller::deliverStates,
+                                                subscription.mStatesCallback, states, _1));
+    }
+    else
+    {
+        IOExecutor::instance().post(subscription.mApp, subscription.mClientId,
+                                    boost::bind(&JobStatusPoller::deliverStatus,
+                                                subscription.mCallback, states.begin()->second, _1));
+    }
+}
+
+///
+//  Poll the watched jobs (poller thread)
+//
+void JobStatusPoller::runPoller()
+{
+    while (true)
+    {
+        std::vector<std::string> keys;
+        std::vector<Job> jobs;
+        std::vector<StatusEnum> lastStatus;
+        std::vector<ptime> lastChange;
+        std::vector<std::string> pollKeys;
+
+        {
+            boost::mutex::scoped_lock lock(mMutex);
+            while (mJobs.empty())
+            {
+                mWatchCondition.wait(lock);
+            }
+
+            // Only the unfinished jobs that are due are polled
+            ptime now = microsec_clock::universal_time();
+            for (std::map<std::string, WatchedJob>::const_iterator iter = mJobs.begin();
+                 iter != mJobs.end(); ++iter)
+            {
+                if (iter->second.mState.mFinal)
+                {
+                    continue;
+                }
+
+                pollKeys.push_back(iter->first);
+
+                if (iter->second.mNextPoll.is_not_a_date_time() || iter->second.mNextPoll <= now)
+                {
+                    keys.push_back(iter->first);
+                    jobs.push_back(iter->second.mJob);
+                    lastStatus.push_back(iter->second.mState.mStatus);
+                    lastChange.push_back(iter->second.mLastChange);
+                }
+            }
+        }
+
+        // Query without the lock, sessions keep subscribing meanwhile
+        pruneLogParsers(pollKeys);
+
+        // A job first watched may have finished before, the cluster is only asked
+        // about the others
+        std::vector<JobState> states(keys.size());
+        std::vector<bool> final(keys.size(), false);
+        std::vector<bool> answered(keys.size(), true);
+        std::vector<std::string> pollJobKeys;
+        std::vector<Job> pollJobList;
+        std::vector<int> pollIndices;
+
+        for (size_t i = 0; i < keys.size(); i++)
+        {
+            if (lastStatus[i] == STATUS_UNSET &&
+                JobStatusCache::instance().getState(jobs[i].mClusterDir, keys[i], states[i]))
+            {
+                final[i] = true;
+            }
+            else
+            {
+                pollJobKeys.push_back(keys[i]);
+                pollJobList.push_back(jobs[i]);
+                pollIndices.push_back((int)i);
+            }
+        }
+
+        std::vector<JobState> polledStates;
+        std::vector<bool> polledFinal;
+        std::vector<bool> polledAnswered;
+        pollJobs(pollJobKeys, pollJobList, polledStates, polledFinal, polledAnswered);
+
+        for (size_t j = 0; j < pollIndices.size(); j++)
+        {
+            int i = pollIndices[j];
+            states[i] = polledStates[j];
+            answered[i] = polledAnswered[j];
+            if (!answered[i])
+            {
+                continue;
+            }
+
+            // A job that ended without shutting down its meta log is only taken as
+            // failed for good once it has been failed for the whole grace period
+            // and the cluster, asked again now, still does not know it
+            final[i] = polledFinal[j] ||
+                       (states[i].mStatus == STATUS_COMPLETED_FAILURE &&
+                        lastStatus[i] == STATUS_COMPLETED_FAILURE &&
+                        !lastChange[i].is_not_a_date_time() &&
+                        microsec_clock::universal_time() - lastChange[i] >= milliseconds((long)FAILURE_GRACE_MS));
+
+            states[i].mFinal = final[i];
+            if (final[i])
+            {
+                JobStatusCache::instance().putState(jobs[i].mClusterDir, keys[i], states[i]);
+            }
+        }
+
+        {
+            boost::mutex::scoped_lock lock(mMutex);
+
+            ptime now = microsec_clock::universal_time();
+            JobStateMap changed;
+            for (size_t i = 0; i < keys.size(); i++)
+            {
+                std::map<std::string, WatchedJob>::iterator iter = mJobs.find(keys[i]);
+                if (iter == mJobs.end())
+                {
+                    continue;
+                }
+
+                // A job the cluster could not be asked about keeps its last state
+                WatchedJob& watchedJob = iter->second;
+                if (answered[i] && isChanged(watchedJob.mState, states[i]))
+                {
+                    watchedJob.mState = states[i];
+                    watchedJob.mLastChange = now;
+                    changed.insert(changed.end(), std::make_pair(keys[i], states[i]));
+                }
+
+                watchedJob.mNextPoll = now + getPollInterval(watchedJob.mState, now - watchedJob.mLastChange);
+            }
+
+            // Each subscription is posted the changes of its jobs in one callback
+            for (std::map<int, Subscription>::const_iterator iter = mSubscriptions.begin();
+                 !changed.empty() && iter != mSubscriptions.end(); ++iter)
+            {
+                const std::vector<std::string>& subscriptionKeys = iter->second.mKeys;
+                JobStateMap subscriptionChanged;
+
+                for (size_t i = 0; i < subscriptionKeys.size(); i++)
+                {
+                    JobStateMap::const_iterator changedIter = changed.find(subscriptionKeys[i]);
+                    if (changedIter != changed.end())
+                    {
+                        subscriptionChanged.insert(subscriptionChanged.end(), *changedIter);
+                    }
+                }
+
+                postStates(iter->second, subscriptionChanged);
+            }
+        }
+
+        boost::this_thread::sleep(boost::posix_time::milliseconds((long)POLL_INTERVAL_MS));
+    }
+}
+
+///
+//  Get the state of jobs
+//
+void JobStatusPoller::pollJobs(const std::vector<std::string>& keys, const std::vector<Job>& jobs,
+                               std::vector<JobState>& states, std::vector<bool>& final,
+                               std::vector<bool>& answered)
+{
+    JobState unknown;
+    unknown.mStatus = STATUS_UNKNOWN;
+    unknown.mStage = -1;
+    unknown.mPercentComplete = -1;
+    unknown.mFinal = false;
+    states.assign(jobs.size(), unknown);
+    final.assign(jobs.size(), false);
+    answered.assign(jobs.size(), true);
+
+    // A job whose meta log shut down is finished, the cluster is only asked about
+    // the others, in one batch per cluster backend.
+    std::vector<MetaLogParser*> parsers(jobs.size());
+    std::vector<bool> logExists(jobs.size());
+    std::map<std::string, std::vector<int> > batches;
+
+    for (size_t i = 0; i < jobs.size(); i++)
+    {
+        parsers[i] = &getLogParser(keys[i], jobs[i]);
+
+        // Only what was appended since the last poll is read
+        logExists[i] = parsers[i]->update();
+
+        if (logExists[i] && parsers[i]->isShutDown())
+        {
+            states[i].mStatus = (parsers[i]->getExitCode() == 0) ? STATUS_COMPLETED_SUCCESS : STATUS_COMPLETED_FAILURE;
+            setStage(*parsers[i], states[i]);
+            final[i] = true;
+        }
+        else
+        {
+            batches[jobs[i].mClusterType + ":" + jobs[i].mClusterHeadNode + ":" + jobs[i].mScriptDir].push_back((int)i);
+        }
+    }
+
+    for (std::map<std::string, std::vector<int> >::const_iterator iter = batches.begin();
+         iter != batches.end(); ++iter)
+    {
+        bool queried = queryCluster(jobs, iter->second, states);
+
+        for (size_t j = 0; j < iter->second.size(); j++)
+        {
+            int i = iter->second[j];
+
+            // Not being able to ask the cluster says nothing about the job
+            if (!queried)
+            {
+                answered[i] = false;
+                continue;
+            }
+
+            // A job the cluster does not know either has not been queued yet or
+            // ended without shutting down cleanly
+            if (states[i].mStatus == STATUS_UNKNOWN)
+            {
+                states[i].mStatus = logExists[i] ? STATUS_COMPLETED_FAILURE : STATUS_WAITING;
+            }
+
+            if (states[i].mStatus != STATUS_WAITING && states[i].mStatus != STATUS_QUEUED)
+            {
+                setStage(*parsers[i], states[i]);
+            }
+        }
+    }
+}
+
+///
+//  Drop the meta log parsers of jobs no longer polled
+//
+void JobStatusPoller::pruneLogParsers(const std::vector<std::string>& keys)
+{
+    // The keys are in map order
+    std::map<std::string, boost::shared_ptr<MetaLogParser> >::iterator parserIter = mLogParsers.begin();
+    while (parserIter != mLogParsers.end())
+    {
+        if (!std::binary_search(keys.begin(), keys.end(), parserIter->first))
+        {
+            mLogParsers.erase(parserIter++);
+        }
+        else
+        {
+            ++parserIter;
+        }
+    }
+}
+
+///
+//  Get the interval until the next poll of a job
+//
+time_duration JobStatusPoller::getPollInterval(const JobState& state, const time_duration& unchanged)
+{
+    // A job whose state just changed is likely to change again soon, one that has
+    // sat in the queue for hours is not
+    int minIntervalMs = POLL_INTERVAL_MS;
+    int maxIntervalMs = MAX_RUNNING_POLL_INTERVAL_MS;
+
+    if (state.mStatus == STATUS_WAITING || state.mStatus == STATUS_QUEUED)
+    {
+        minIntervalMs = QUEUED_POLL_INTERVAL_MS;
+        maxIntervalMs = MAX_QUEUED_POLL_INTERVAL_MS;
+    }
+    else if (state.mStatus == STATUS_COMPLETED_FAILURE)
+    {
+        // Checked a few times over the grace period before it is final
+        return milliseconds((long)FAILURE_POLL_INTERVAL_MS);
+    }
+
+    boost::int64_t intervalMs = minIntervalMs;
+    if (!unchanged.is_special())
+    {
+        intervalMs += unchanged.total_milliseconds() / POLL_BACKOFF_DIVISOR;
+    }
+
+    return milliseconds((long)std::min(intervalMs, (boost::int64_t)maxIntervalMs));
+}
+
+///
+//  Query the cluster for the status of jobs sharing a backend
+//
+bool JobStatusPoller::queryCluster(const std::vector<Job>& jobs, const std::vector<int>& indices,
+                                   std::vector<JobState>& states)
+{
+    const Job& first = jobs[indices[0]];
+    boost::shared_ptr<ClusterBackend> backend = ClusterBackend::getBackend(first.mClusterType,
+                                                                           first.mClusterHeadNode,
+                                                                           first.mScriptDir);
+
+    std::vector<ClusterBackend::JobRef> jobRefs(indices.size());
+    for (size_t i = 0; i < indices.size(); i++)
+    {
+        jobRefs[i].mJobId = jobs[indices[i]].mJobIDPrefix + jobs[indices[i]].mJobId;
+        jobRefs[i].mClusterShFile = jobs[indices[i]].mClusterShFile;
+    }
+
+    std::vector<ClusterBackend::JobStateEnum> jobStates;
+    if (!backend->queryStatus(jobRefs, jobStates))
+    {
+        return false;
+    }
+
+    for (size_t i = 0; i < indices.size(); i++)
+    {
+        if (jobStates[i] == ClusterBackend::JOB_QUEUED)
+        {
+            states[indices[i]].mStatus = STATUS_QUEUED;
+        }
+        else if (jobStates[i] == ClusterBackend::JOB_RUNNING)
+        {
+            states[indices[i]].mStatus = STATUS_RUNNING;
+        }
+    }
+
+    return true;
+}
+
+///
+//  Get the meta log parser of a job, created on first use
+//
+MetaLogParser& JobStatusPoller::getLogParser(const std::string& key, const Job& job)
+{
+    boost::shared_ptr<MetaLogParser>& parser = mLogParsers[key];
+    if (parser == NULL)
+    {
+        std::string metaScriptLog = path(job.mClusterShFile).branch_path().string() + "/" + job.mMetaScript + ".std";
+        parser.reset(new MetaLogParser(metaScriptLog, job.mStages));
+    }
+
+    return *parser;
+}
+
+///
+//  Set the stage of a job state from its meta log
+//
+void JobStatusPoller::setStage(const MetaLogParser& parser, JobState& state)
+{
+    state.mStage = parser.getStage();
+    state.mStageText = parser.getStageText();
+    state.mPercentComplete = parser.getPercentComplete();
+}
+
+///
+//  Get whether two job states differ
+//
+bool JobStatusPoller::isChanged(const JobState& state1, const JobState& state2)
+{
+    return state1.mStatus != state2.mStatus ||
+           state1.mStage != state2.mStage ||
+           state1.mStageText != state2.mStageText ||
+           state1.mPercentComplete != state2.mPercentComplete ||
+           state1.mFinal != state2.mFinal;
+}
+
+///
+//  Call a status callback
+//
+void JobStatusPoller::deliverStatus(StatusCallback callback, JobState state, IOExecutor::StatusEnum ioStatus)
+{
+    callback(state);
+}
+
+///
+//  Call a job states callback
+//
+void JobStatusPoller::deliverStates(JobStatesCallback callback, JobStateMap states, IOExecutor::StatusEnum ioStatus)
+{
+    callback(states);
+}
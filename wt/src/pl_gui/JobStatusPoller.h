@@ -0,0 +1,337 @@
+//
+//
+//  Description:
+//      Definition of the job status poller.  A single poller per server process
+//      watches every job that any session is showing the status of.  Once per
+//      interval it queries the cluster for all of them in one batched shell run,
+//      instead of each session forking cluster_status.bash for its own job every
+//      second.  Sessions subscribe to a job and are notified, by server push, only
+//      when its status changes.  The meta logs of running and finished jobs are
+//      parsed natively and incrementally for the exit code and current stage.
+//
+//      Finished jobs are kept in the JobStatusCache and never polled again.  The
+//      others are polled less often the longer their state stays the same, queued
+//      jobs less often than running ones.
+//
+//  Author:
+//      Dan Ginsburg
+//
+//  Children's Hospital Boston
+//  GPL v2
+//
+#ifndef JOBSTATUSPOLLER_H
+#define JOBSTATUSPOLLER_H
+
+#include "IOExecutor.h"
+#include "MetaLogParser.h"
+#include <boost/function.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include <map>
+#include <string>
+#include <vector>
+
+///
+/// \class JobStatusPoller
+/// \brief Singleton that polls the status of every watched cluster job in batches
+///
+class JobStatusPoller
+{
+public:
+
+    // Status enumerant
+    typedef enum
+    {
+        STATUS_UNSET = -1,
+        STATUS_UNKNOWN,
+        STATUS_WAITING,
+        STATUS_QUEUED,
+        STATUS_RUNNING,
+        STATUS_COMPLETED_FAILURE,
+        STATUS_COMPLETED_SUCCESS,
+
+        NUM_STATUS
+
+    } StatusEnum;
+
+    /// Job to watch
+    typedef struct
+    {
+        /// Job ID, without the prefix
+        std::string mJobId;
+
+        /// Cluster sh file
+        std::string mClusterShFile;
+
+        /// Meta script
+        std::string mMetaScript;
+
+        /// Job ID prefix of the cluster
+        std::string mJobIDPrefix;
+
+        /// Cluster type
+        std::string mClusterType;
+
+        /// Cluster head node, empty for the local host
+        std::string mClusterHeadNode;
+
+        /// Directory holding the cluster scripts
+        std::string mScriptDir;
+
+        /// Stages the job runs, in order, empty if not known
+        std::string mStages;
+
+        /// Cluster directory, where the final states of jobs are kept across
+        /// restarts (empty to keep them in memory only)
+        std::string mClusterDir;
+
+    } Job;
+
+    /// State of a job
+    typedef struct
+    {
+        /// Status
+        StatusEnum mStatus;
+
+        /// Current stage, -1 if not known
+        int mStage;
+
+        /// Description of the current stage
+        std::string mStageText;
+
+        /// Percent complete, -1 if not known
+        int mPercentComplete;
+
+        /// Whether the job finished and its state is final.  A failure may be
+        /// reported for a while before it is final.
+        bool mFinal;
+
+    } JobState;
+
+    /// Status callback, runs with the session's update lock held
+    typedef boost::function<void (const JobState&)> StatusCallback;
+
+    /// States of jobs by key
+    typedef std::map<std::string, JobState> JobStateMap;
+
+    /// Callback with the states of several jobs, runs with the session's update lock held
+    typedef boost::function<void (const JobStateMap&)> JobStatesCallback;
+
+    /// Interval between polls of the cluster, the shortest interval between polls of a job
+    static const int POLL_INTERVAL_MS = 1000;
+
+    /// Longest interval between polls of a running job
+    static const int MAX_RUNNING_POLL_INTERVAL_MS = 60000;
+
+    /// Shortest interval between polls of a waiting or queued job
+    static const int QUEUED_POLL_INTERVAL_MS = 5000;
+
+    /// Longest interval between polls of a waiting or queued job
+    static const int MAX_QUEUED_POLL_INTERVAL_MS = 300000;
+
+    /// The interval between polls of a job grows by the time since its state last
+    /// changed divided by this
+    static const int POLL_BACKOFF_DIVISOR = 10;
+
+    /// Time a job must stay unknown to the cluster, with a meta log that did not
+    /// shut down, before its failure is final
+    static const int FAILURE_GRACE_MS = 300000;
+
+    /// Interval between polls of a job that failed but is not final yet
+    static const int FAILURE_POLL_INTERVAL_MS = 30000;
+
+    ///
+    /// Get the process-wide poller instance
+    ///
+    static JobStatusPoller& instance();
+
+    ///
+    /// Subscribe to the status of a job.  The callback is posted with the current
+    /// state once it is known and after that on every change.
+    /// \param app Application whose session the callback runs in
+    /// \param clientId IOExecutor client id the callbacks are posted for
+    /// \param job Job to watch
+    /// \param callback Status callback
+    /// \return Subscription id
+    ///
+    int subscribe(WApplication *app, int clientId, const Job& job, const StatusCallback& callback);
+
+    ///
+    /// Subscribe to the status of a set of jobs.  The states of all the jobs that
+    /// changed in a poll are posted in one callback.
+    /// \param app Application whose session the callback runs in
+    /// \param clientId IOExecutor client id the callbacks are posted for
+    /// \param jobs Jobs to watch
+    /// \param callback Callback with the states by job key
+    /// \return Subscription id
+    ///
+    int subscribeJobs(WApplication *app, int clientId, const std::vector<Job>& jobs,
+                      const JobStatesCallback& callback);
+
+    ///
+    /// Replace the jobs of a subscription made with subscribeJobs().  The known
+    /// states of jobs new to the subscription are posted at once.
+    ///
+    void setJobs(int subscriptionId, const std::vector<Job>& jobs);
+
+    ///
+    /// Unsubscribe.  Callbacks already posted are dropped by cancelling the client.
+    ///
+    void unsubscribe(int subscriptionId);
+
+    ///
+    /// Get the key identifying a job
+    ///
+    static std::string getKey(const Job& job);
+
+private:
+
+    ///
+    /// Constructor
+    ///
+    JobStatusPoller();
+
+    ///
+    /// Destructor
+    ///
+    virtual ~JobStatusPoller();
+
+    /// Job watched by one or more sessions
+    typedef struct
+    {
+        /// Job
+        Job mJob;
+
+        /// Last state polled
+        JobState mState;
+
+        /// Number of subscriptions to the job
+        int mNumSubscriptions;
+
+        /// Time the state last changed
+        boost::posix_time::ptime mLastChange;
+
+        /// Time of the next poll, not_a_date_time to poll at once
+        boost::posix_time::ptime mNextPoll;
+
+    } WatchedJob;
+
+    /// Subscription of a session to one or more jobs
+    typedef struct
+    {
+        /// Keys of the jobs watched, sorted
+        std::vector<std::string> mKeys;
+
+        /// Application the callback runs in
+        WApplication *mApp;
+
+        /// IOExecutor client id the callback is posted for
+        int mClientId;
+
+        /// Status callback of a single job subscription
+        StatusCallback mCallback;
+
+        /// Callback of a subscription to a set of jobs
+        JobStatesCallback mStatesCallback;
+
+    } Subscription;
+
+    ///
+    /// Add a subscription to jobs.  Call with mMutex held.
+    /// \param known Filled with the states already known of the jobs
+    ///
+    void watchJobs(Subscription& subscription, const std::vector<Job>& jobs, JobStateMap& known);
+
+    ///
+    /// Remove a subscription from the jobs with keys.  Call with mMutex held.
+    ///
+    void releaseJobs(const std::vector<std::string>& keys);
+
+    ///
+    /// Post the states of jobs to a subscription.  Call with mMutex held.
+    ///
+    static void postStates(const Subscription& subscription, const JobStateMap& states);
+
+    ///
+    /// Poll the watched jobs (poller thread)
+    ///
+    void runPoller();
+
+    ///
+    /// Get the state of jobs (poller thread)
+    /// \param final Filled with whether each job is known to have finished from its meta log
+    /// \param answered Filled with false for each job the cluster could not be asked about
+    ///
+    void pollJobs(const std::vector<std::string>& keys, const std::vector<Job>& jobs,
+                  std::vector<JobState>& states, std::vector<bool>& final,
+                  std::vector<bool>& answered);
+
+    ///
+    /// Drop the meta log parsers of jobs no longer polled (poller thread)
+    /// \param keys Sorted keys of the jobs still polled
+    ///
+    void pruneLogParsers(const std::vector<std::string>& keys);
+
+    ///
+    /// Get the interval until the next poll of a job
+    /// \param state Current state of the job
+    /// \param unchanged Time the state has stayed the same
+    ///
+    static boost::posix_time::time_duration getPollInterval(const JobState& state,
+                                                            const boost::posix_time::time_duration& unchanged);
+
+    ///
+    /// Query the cluster for the status of jobs sharing a cluster backend, in one
+    /// batch.  Jobs the cluster does not know are left STATUS_UNKNOWN.
+    /// \return false if the cluster could not be asked
+    ///
+    static bool queryCluster(const std::vector<Job>& jobs, const std::vector<int>& indices,
+                             std::vector<JobState>& states);
+
+    ///
+    /// Get the meta log parser of a job, created on first use (poller thread)
+    ///
+    MetaLogParser& getLogParser(const std::string& key, const Job& job);
+
+    ///
+    /// Set the stage of a job state from its meta log
+    ///
+    static void setStage(const MetaLogParser& parser, JobState& state);
+
+    ///
+    /// Get whether two job states differ
+    ///
+    static bool isChanged(const JobState& state1, const JobState& state2);
+
+    ///
+    /// Call a status callback (IOExecutor completion callback)
+    ///
+    static void deliverStatus(StatusCallback callback, JobState state, IOExecutor::StatusEnum ioStatus);
+
+    ///
+    /// Call a job states callback (IOExecutor completion callback)
+    ///
+    static void deliverStates(JobStatesCallback callback, JobStateMap states, IOExecutor::StatusEnum ioStatus);
+
+    /// Watched jobs by key
+    std::map<std::string, WatchedJob> mJobs;
+
+    /// Subscriptions by id
+    std::map<int, Subscription> mSubscriptions;
+
+    /// Id of the next subscription
+    int mNextSubscriptionId;
+
+    /// Mutex protecting all of the above
+    boost::mutex mMutex;
+
+    /// Signalled when a job is subscribed to
+    boost::condition mWatchCondition;
+
+    /// Meta log parsers of the polled jobs by key, used by the poller thread only
+    std::map<std::string, boost::shared_ptr<MetaLogParser> > mLogParsers;
+};
+
+#endif // JOBSTATUSPOLLER_H
@@ -0,0 +1,237 @@
+//
+//
+//  Description:
+//      Implementation of the local cluster backend.  A fake scheduler that runs jobs
+//      as processes on the server itself, as many at once as there are cores, so
+//      that status and submission throughput can be measured on a single box.
+//
+//      Jobs only reach it through ClusterBackend::submit(), from pl_cluster_bench
+//      (ClusterBench.cpp).  The results pages submit through pl_batch_web.bash,
+//      which has no local scheduler, so clusterType is not set to "local" in
+//      pl_gui.conf.
+//
+//  Author:
+//      Dan Ginsburg
+//
+//  Children's Hospital Boston
+//  GPL v2
+//
+#include "LocalClusterBackend.h"
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+#include <errno.h>
+#include <sstream>
+#include <signal.h>
+#include <stdlib.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+///
+//  Namespaces
+//
+using namespace std;
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Constructor/Destructor
+//
+//
+
+///
+//  Constructor
+//
+LocalClusterBackend::LocalClusterBackend(const std::string& scriptDir) :
+    mScriptDir(scriptDir),
+    mNumRunning(0)
+{
+    // Finished jobs are remembered across restarts (JobStatusCache), so the job
+    // IDs of one run of the server must not be reused by the next
+    mNextJobId = (int)time(NULL);
+
+    mNumSlots = boost::thread::hardware_concurrency();
+    if (mNumSlots < 1)
+    {
+        mNumSlots = 1;
+    }
+}
+
+///
+//  Destructor
+//
+LocalClusterBackend::~LocalClusterBackend()
+{
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Public Members
+//
+//
+
+///
+//  Get the state of jobs in the scheduler
+//
+bool LocalClusterBackend::queryStatus(const std::vector<JobRef>& jobs, std::vector<JobStateEnum>& states)
+{
+    boost::mutex::scoped_lock lock(mMutex);
+
+    states.assign(jobs.size(), JOB_NOT_FOUND);
+    for (size_t i = 0; i < jobs.size(); i++)
+    {
+        std::map<int, LocalJob>::const_iterator iter = mJobs.find(getJobNumber(jobs[i].mJobId));
+        if (iter != mJobs.end())
+        {
+            states[i] = iter->second.mState;
+        }
+    }
+
+    return true;
+}
+
+///
+//  Submit jobs to the scheduler
+//
+bool LocalClusterBackend::submit(const std::vector<std::string>& commands, std::vector<std::string>& jobIds)
+{
+    boost::mutex::scoped_lock lock(mMutex);
+
+    jobIds.clear();
+    for (size_t i = 0; i < commands.size(); i++)
+    {
+        LocalJob job;
+        job.mCommand = commands[i];
+        job.mState = JOB_QUEUED;
+        job.mPid = -1;
+
+        int jobId = mNextJobId++;
+        mJobs[jobId] = job;
+        mQueue.push_back(jobId);
+
+        std::ostringstream jobIdStream;
+        jobIdStream << jobId;
+        jobIds.push_back(jobIdStream.str());
+    }
+
+    startJobs();
+
+    return true;
+}
+
+///
+//  Kill jobs
+//
+void LocalClusterBackend::kill(const std::vector<JobRef>& jobs)
+{
+    boost::mutex::scoped_lock lock(mMutex);
+
+    for (size_t i = 0; i < jobs.size(); i++)
+    {
+        int jobId = getJobNumber(jobs[i].mJobId);
+        std::map<int, LocalJob>::iterator iter = mJobs.find(jobId);
+        if (iter == mJobs.end())
+        {
+            continue;
+        }
+
+        // A running job is removed by its thread once the process exits
+        if (iter->second.mState == JOB_RUNNING)
+        {
+            ::kill(iter->second.mPid, SIGTERM);
+        }
+        else
+        {
+            for (std::deque<int>::iterator queueIter = mQueue.begin(); queueIter != mQueue.end(); ++queueIter)
+            {
+                if (*queueIter == jobId)
+                {
+                    mQueue.erase(queueIter);
+                    break;
+                }
+            }
+            mJobs.erase(iter);
+        }
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Private Members
+//
+//
+
+///
+//  Start queued jobs while slots are free
+//
+void LocalClusterBackend::startJobs()
+{
+    while (mNumRunning < mNumSlots && !mQueue.empty())
+    {
+        int jobId = mQueue.front();
+        mQueue.pop_front();
+
+        LocalJob& job = mJobs[jobId];
+
+        pid_t pid = fork();
+        if (pid == 0)
+        {
+            // Only standard streams are passed on, not the server's sockets and files
+            long maxFd = sysconf(_SC_OPEN_MAX);
+            for (int fd = STDERR_FILENO + 1; fd < maxFd; fd++)
+            {
+                close(fd);
+            }
+
+            if (mScriptDir != "" && chdir(mScriptDir.c_str()) != 0)
+            {
+                _exit(127);
+            }
+            execl("/bin/sh", "sh", "-c", job.mCommand.c_str(), (char*)NULL);
+            _exit(127);
+        }
+
+        if (pid < 0)
+        {
+            mJobs.erase(jobId);
+            continue;
+        }
+
+        job.mState = JOB_RUNNING;
+        job.mPid = pid;
+        mNumRunning++;
+
+        boost::thread(boost::bind(&LocalClusterBackend::runJob, this, jobId, pid));
+    }
+}
+
+///
+//  Thread entry of a running job
+//
+void LocalClusterBackend::runJob(int jobId, pid_t pid)
+{
+    while (waitpid(pid, NULL, 0) < 0 && errno == EINTR)
+    {
+    }
+
+    boost::mutex::scoped_lock lock(mMutex);
+
+    mJobs.erase(jobId);
+    mNumRunning--;
+    startJobs();
+}
+
+///
+//  Get the number of a job ID
+//
+int LocalClusterBackend::getJobNumber(const std::string& jobId)
+{
+    size_t start = jobId.find_last_not_of("0123456789");
+    start = (start == std::string::npos) ? 0 : start + 1;
+
+    if (start >= jobId.size())
+    {
+        return -1;
+    }
+
+    return atoi(jobId.c_str() + start);
+}
@@ -0,0 +1,118 @@
+//
+//
+//  Description:
+//      Definition of the local cluster backend.  A fake scheduler that runs jobs
+//      as processes on the server itself, as many at once as there are cores, so
+//      that status and submission throughput can be measured on a single box.
+//
+//      Jobs only reach it through ClusterBackend::submit(), from pl_cluster_bench
+//      (ClusterBench.cpp).  The results pages submit through pl_batch_web.bash,
+//      which has no local scheduler, so clusterType is not set to "local" in
+//      pl_gui.conf.
+//
+//  Author:
+//      Dan Ginsburg
+//
+//  Children's Hospital Boston
+//  GPL v2
+//
+#ifndef LOCALCLUSTERBACKEND_H
+#define LOCALCLUSTERBACKEND_H
+
+#include "ClusterBackend.h"
+#include <boost/thread/mutex.hpp>
+#include <sys/types.h>
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+
+///
+/// \class LocalClusterBackend
+/// \brief Fake scheduler running jobs as local processes
+///
+class LocalClusterBackend : public ClusterBackend
+{
+public:
+
+    ///
+    /// Constructor
+    /// \param scriptDir Directory the jobs are run from
+    ///
+    LocalClusterBackend(const std::string& scriptDir);
+
+    ///
+    /// Destructor
+    ///
+    virtual ~LocalClusterBackend();
+
+    ///
+    /// Get the state of jobs in the scheduler.  The job ID may carry the prefix
+    /// of the cluster, only its trailing number is matched.
+    ///
+    virtual bool queryStatus(const std::vector<JobRef>& jobs, std::vector<JobStateEnum>& states);
+
+    ///
+    /// Submit jobs to the scheduler, each command is run with /bin/sh -c
+    ///
+    virtual bool submit(const std::vector<std::string>& commands, std::vector<std::string>& jobIds);
+
+    ///
+    /// Kill jobs
+    ///
+    virtual void kill(const std::vector<JobRef>& jobs);
+
+private:
+
+    /// Job in the scheduler
+    typedef struct
+    {
+        /// Shell command
+        std::string mCommand;
+
+        /// Queued or running
+        JobStateEnum mState;
+
+        /// Process id while running
+        pid_t mPid;
+
+    } LocalJob;
+
+    ///
+    /// Start queued jobs while slots are free.  Call with mMutex held.
+    ///
+    void startJobs();
+
+    ///
+    /// Thread entry of a running job, waits for its process and frees the slot
+    ///
+    void runJob(int jobId, pid_t pid);
+
+    ///
+    /// Get the number of a job ID, -1 if it has none
+    ///
+    static int getJobNumber(const std::string& jobId);
+
+    /// Directory the jobs are run from
+    std::string mScriptDir;
+
+    /// Jobs known to the scheduler by number
+    std::map<int, LocalJob> mJobs;
+
+    /// Queued jobs, in order
+    std::deque<int> mQueue;
+
+    /// Number of jobs that may run at once
+    int mNumSlots;
+
+    /// Number of jobs running
+    int mNumRunning;
+
+    /// Number of the next job submitted
+    int mNextJobId;
+
+    /// Mutex protecting the scheduler
+    boost::mutex mMutex;
+};
+
+#endif // LOCALCLUSTERBACKEND_H
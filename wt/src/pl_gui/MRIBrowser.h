@@ -14,9 +14,7 @@
 
 #include <Wt/WContainerWidget>
 #include <Wt/WTreeView>
-#include <Wt/WStandardItemModel>
-#include <Wt/WSortFilterProxyModel>
-#include <mxml.h>
+#include <boost/shared_ptr.hpp>
 
 #include <string>
 #include <list>
@@ -27,8 +25,9 @@
 #include "QtFileSystemWatcherThread.h"
 #endif
 
-class MRIFilterProxyModel;
-class PermissionsXML;
+class MRIDCatalog;
+class MRIDCatalogModel;
+class MRIDSuggestionModel;
 namespace Wt
 {
     class WPushButton;
@@ -97,13 +96,7 @@ public:
         MANUFACTURER_ROLE,
         MODEL_ROLE,
         SOFTWARE_VER_ROLE,
-        NUM_SCANS_ROLE,
-        NUM_USERS_ROLE,
-        NUM_GROUPS_ROLE,
-        FIRST_SCAN_ROLE_INDEX,
-        FIRST_USER_ROLE_INDEX,
-        FIRST_GROUP_ROLE_INDEX,
-        VARIABLE_DATA_START_ROLE
+        SCANS_ROLE
     } UserRoleEnum;
 
     /// MRI Field
@@ -168,6 +161,12 @@ public:
     ///
     std::string getMRIDFromScanDir(const std::string& scanDir) const;
 
+    ///
+    /// Get the MRID catalog currently shown by the browser, for lookups by scan
+    /// directory or MRID (see MRIDCatalog::findDirectory and findPatientID)
+    ///
+    boost::shared_ptr<const MRIDCatalog> getCatalog() const;
+
     ///
     /// Signal accessor for MRI selection
     ///
@@ -215,7 +214,7 @@ private:
     static const MRISearchType mSearchType[];
 
     ///
-    /// Populate the MRIDs model by reading the dcm_MRID.xml file.
+    /// Populate the MRIDs model from the shared catalog for the dcm_MRID.xml file.
     ///
     void populateMRIDs(const std::string& mridLogFile);
 
@@ -225,27 +224,15 @@ private:
     void mriChanged();
 
     ///
-    /// Search clicked [slot]
-    ///
-    void searchClicked();
-
-    ///
-    ///  Create an MRI item.
+    ///  Prefetch the studies of the rows around a row of the view, replacing the
+    ///  previous prefetch
     ///
-    WStandardItem *createMRIItem(const std::string& MRID,
-                                 const std::string& scanDir,
-                                 const std::string& age);
+    void prefetchStudies(int row);
 
     ///
-    ///  Set data in the model from an XML node
-    ///
-    void setDataColumn(mxml_node_t *node, const char* name, int row, int col, int role, std::string errorReplaceStr ="", std::string prependStr = "");
-
-    ///
-    ///  Set multiple data entries in the model from a series of like-named XML nodes
+    /// Search clicked [slot]
     ///
-    void setMultiDataColumn(mxml_node_t *node, const char* name, int row, int col, int firstRole, int numberRole,
-                            int *numVariableRoles);
+    void searchClicked();
 
 private:
 
@@ -259,10 +246,7 @@ private:
     WTreeView *mMRITreeView;
 
     /// MRID Model
-    WStandardItemModel *mMRIModel;
-
-    /// Sort-filter proxy model
-    MRIFilterProxyModel *mSortFilterProxyModel;
+    MRIDCatalogModel *mMRIModel;
 
     /// Search button
     WPushButton *mSearchButton;
@@ -284,82 +268,11 @@ private:
     /// Suggestion popup box
     WSuggestionPopup* mPopup;
 
-    /// Permissions XML file
-    PermissionsXML *mPermissionsXML;
-};
-
-///
-/// \class MRIFilterProxyModel
-/// \brief Override WSortFilterProxyModel class to provide non-regexp searched
-///
-class MRIFilterProxyModel : public WSortFilterProxyModel
-{
-public:
-    ///
-    /// Constructor
-    ///
-    MRIFilterProxyModel(PermissionsXML *permissionsXML, WObject *parent = 0);
-
-    ///
-    /// Destructor
-    ///
-    virtual ~MRIFilterProxyModel();
-
-    ///
-    /// Set filter file - a file that specifies a set of patterns to filter the list of MRIs
-    ///
-    void setFilterFile(const std::string& path);
-
-protected:
-
-    ///
-    /// Compare search term
-    ///
-    bool compareSearchTerm(std::string searchTerm, std::string expr, MRIBrowser::MRISearchTypeEnum searchType) const;
-
-    ///
-    /// Check to see whether the row matches the project file search criteria
-    ///
-    bool filterByProjectFile(int sourceRow, const WModelIndex& sourceParent) const;
-
-    ///
-    /// Check to see whether the row is accessible to current user/group
-    ///
-    bool filterByUserGroup(int sourceRow, const WModelIndex& sourceParent) const;
-
-    ///
-    /// Custom filter, override base class implementation
-    ///
-    virtual bool filterAcceptRow(int sourceRow, const WModelIndex& sourceParent) const;
-
-protected:
-
-    /// Search item
-    typedef struct
-    {
-        /// Role
-        int mRole;
-
-        /// Search Type
-        MRIBrowser::MRISearchTypeEnum mSearchType;
-
-        /// Search expression
-        std::string mExpr;
-
-    } SearchItem;
-
-    /// List of search items
-    std::list<SearchItem> mSearchItems[MRIBrowser::NUM_FIELDS];
-
-    /// Number of search terms
-    int mNumSearchTerms;
-
-    /// Type to match (any or all)
-    MRIBrowser::MRISearchMatch mSearchMatchType;
-
-    /// User/group permissions XML file parser
-    PermissionsXML *mPermissionsXML;
+    /// Completions shown in the suggestion popup
+    MRIDSuggestionModel *mSuggestionModel;
 
+    /// Id of the browser in the study prefetcher
+    int mPrefetchClientId;
 };
 
 #endif // MRIBROWSER_H
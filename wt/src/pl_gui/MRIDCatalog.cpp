@@ -0,0 +1,1519 @@
+//
+//
+//  Description:
+//      Implementation of the MRID catalog.  The catalog is an immutable snapshot of all
+//      of the patient records in dcm_MRID.xml.  A single catalog is shared between
+//      all of the sessions in the server process (see MRIDCatalogCache).
+//
+//      Records are stored by column rather than by row.  Every string in the catalog
+//      lives in one contiguous character buffer and is referred to by an integer id.
+//
+//      Each record remembers its byte offset in the file and a hash of its XML text.
+//      When the file is reloaded, records whose text is unchanged are copied from the
+//      previous catalog instead of being parsed again.
+//
+//      The binary snapshot is a fixed size header followed by the catalog's arrays,
+//      each aligned to 8 bytes.  The header holds the offset and size of every array
+//      along with the modification time and size of the XML file it was built from.
+//      Values are stored in native byte order, a snapshot is only ever read back on
+//      the machine that wrote it.
+//
+//  Author:
+//      Dan Ginsburg
+//
+//  Children's Hospital Boston
+//  GPL v2
+//
+#include "MRIDCatalog.h"
+#include "RowBitmap.h"
+#include "XMLRecordParser.h"
+#include <Wt/WApplication>
+#include <Wt/WLogger>
+#include <boost/unordered_map.hpp>
+#include <algorithm>
+#include <sstream>
+#include <ctype.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+///
+//  Namespaces
+//
+using namespace Wt;
+using namespace std;
+
+///
+//  Static constants
+//
+
+const int MRIDCatalog::EMPTY_STRING_ID;
+const int MRIDCatalog::INVALID_VALUE;
+
+// Which single valued fields are interned.  These have few distinct values across
+// the catalog so storing each value once saves a large amount of memory.
+const bool MRIDCatalog::mInternField[MRIBrowser::NUM_FIELDS] =
+{
+    false,      // PATIENT_ID
+    true,       // SCAN (unused, stored as a list)
+    false,      // DIRECTORY
+    true,       // AGE
+    false,      // NAME
+    true,       // SEX
+    false,      // BIRTHDAY
+    false,      // SCANDATE
+    true,       // MANUFACTURER
+    true,       // MODEL
+    true,       // SOFTWARE_VER
+};
+
+// Which fields also have a typed value column
+const MRIDCatalog::ValueTypeEnum MRIDCatalog::mValueType[MRIBrowser::NUM_FIELDS] =
+{
+    VALUE_NONE,     // PATIENT_ID
+    VALUE_NONE,     // SCAN
+    VALUE_NONE,     // DIRECTORY
+    VALUE_AGE,      // AGE
+    VALUE_NONE,     // NAME
+    VALUE_NONE,     // SEX
+    VALUE_DATE,     // BIRTHDAY
+    VALUE_DATE,     // SCANDATE
+    VALUE_NONE,     // MANUFACTURER
+    VALUE_NONE,     // MODEL
+    VALUE_NONE,     // SOFTWARE_VER
+};
+
+///
+//  Sort order functor for catalog rows
+//
+class MRIDRowLess
+{
+public:
+    MRIDRowLess(const MRIDCatalog *catalog) :
+        mCatalog(catalog)
+    {
+    }
+
+    bool operator()(int row1, int row2) const
+    {
+        return mCatalog->compareRows(row1, row2) < 0;
+    }
+
+private:
+    const MRIDCatalog *mCatalog;
+};
+
+///
+//  Sort order functor for interned string ids
+//
+class MRIDStringLess
+{
+public:
+    MRIDStringLess(const MRIDCatalog *catalog) :
+        mCatalog(catalog)
+    {
+    }
+
+    bool operator()(int id1, int id2) const
+    {
+        return strcmp(mCatalog->getString(id1), mCatalog->getString(id2)) < 0;
+    }
+
+private:
+    const MRIDCatalog *mCatalog;
+};
+
+///
+//  Sort order functor for the rows of a typed value column
+//
+class MRIDValueLess
+{
+public:
+    MRIDValueLess(const std::vector<int>& values) :
+        mValues(values)
+    {
+    }
+
+    bool operator()(int row1, int row2) const
+    {
+        return mValues[row1] < mValues[row2];
+    }
+
+private:
+    const std::vector<int>& mValues;
+};
+
+///
+//  Comparison of a row's typed value against a value, for std::lower_bound
+//
+class MRIDRowValueLess
+{
+public:
+    MRIDRowValueLess(const MRIDCatalog *catalog, int field) :
+        mCatalog(catalog),
+        mField(field)
+    {
+    }
+
+    bool operator()(int row, int value) const
+    {
+        return mCatalog->getValue(row, mField) < value;
+    }
+
+private:
+    const MRIDCatalog *mCatalog;
+    int mField;
+};
+
+///
+//  Comparison of a value against a row's typed value, for std::upper_bound
+//
+class MRIDValueRowLess
+{
+public:
+    MRIDValueRowLess(const MRIDCatalog *catalog, int field) :
+        mCatalog(catalog),
+        mField(field)
+    {
+    }
+
+    bool operator()(int value, int row) const
+    {
+        return value < mCatalog->getValue(row, mField);
+    }
+
+private:
+    const MRIDCatalog *mCatalog;
+    int mField;
+};
+
+///
+//  Number of days in a month of the proleptic Gregorian calendar
+//
+static int daysInMonth(int year, int month)
+{
+    static const int days[12] = { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+
+    if (month == 2 && year % 4 == 0 && (year % 100 != 0 || year % 400 == 0))
+    {
+        return 29;
+    }
+    return days[month - 1];
+}
+
+///
+//  Number of days from 1970-01-01 to a date in the proleptic Gregorian calendar
+//
+static int daysFromCivil(int year, int month, int day)
+{
+    year -= (month <= 2) ? 1 : 0;
+    int era = (year >= 0 ? year : year - 399) / 400;
+    int yearOfEra = year - era * 400;
+    int dayOfYear = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    int dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+
+    return era * 146097 + dayOfEra - 719468;
+}
+
+///
+//  Snapshot file layout
+//
+
+// Bump whenever the layout or the meaning of any array changes
+static const boost::uint32_t SNAPSHOT_VERSION = 4;
+
+static const char SNAPSHOT_MAGIC[8] = { 'M', 'R', 'I', 'D', 'C', 'A', 'T', '\0' };
+
+// Arrays stored in the snapshot, in file order
+enum
+{
+    SNAPSHOT_DICOM_DIR = 0,
+    SNAPSHOT_RECORD_OFFSETS,
+    SNAPSHOT_RECORD_HASHES,
+    SNAPSHOT_STRING_DATA,
+    SNAPSHOT_STRING_OFFSETS,
+    SNAPSHOT_INTERNED_IDS,
+    SNAPSHOT_SORTED_ROWS,
+    SNAPSHOT_COLUMNS,
+    SNAPSHOT_LIST_OFFSETS = SNAPSHOT_COLUMNS + MRIBrowser::NUM_FIELDS,
+    SNAPSHOT_LIST_VALUES = SNAPSHOT_LIST_OFFSETS + MRIDCatalog::NUM_LISTS,
+    SNAPSHOT_VALUES = SNAPSHOT_LIST_VALUES + MRIDCatalog::NUM_LISTS,
+    SNAPSHOT_VALUE_ORDER = SNAPSHOT_VALUES + MRIBrowser::NUM_FIELDS,
+
+    NUM_SNAPSHOT_SECTIONS = SNAPSHOT_VALUE_ORDER + MRIBrowser::NUM_FIELDS
+};
+
+// Location of one array in the snapshot
+typedef struct
+{
+    boost::uint64_t mOffset;
+    boost::uint64_t mSize;
+} SnapshotSection;
+
+// Snapshot file header
+typedef struct
+{
+    char mMagic[8];
+    boost::uint32_t mVersion;
+    boost::uint32_t mNumSections;
+    boost::int64_t mSourceModTime;
+    boost::int64_t mSourceModTimeNsec;
+    boost::uint64_t mSourceInode;
+    boost::uint64_t mSourceFileSize;
+    boost::int64_t mNumRecords;
+    SnapshotSection mSections[NUM_SNAPSHOT_SECTIONS];
+} SnapshotHeader;
+
+///
+//  Append an array to a snapshot file, aligned to 8 bytes
+//
+static bool writeSnapshotSection(FILE *fp, SnapshotSection& section, const void *data, size_t size)
+{
+    static const char padding[8] = { 0 };
+
+    long pos = ftell(fp);
+    if (pos < 0)
+    {
+        return false;
+    }
+
+    size_t padSize = (8 - (size_t)pos % 8) % 8;
+    if (padSize > 0 && fwrite(padding, 1, padSize, fp) != padSize)
+    {
+        return false;
+    }
+
+    section.mOffset = (boost::uint64_t)pos + padSize;
+    section.mSize = size;
+
+    return size == 0 || fwrite(data, 1, size, fp) == size;
+}
+
+///
+//  Check that an array in a mapped snapshot lies within the file and has the expected size
+//
+static bool checkSnapshotSection(const SnapshotSection& section, size_t fileSize, size_t expectedSize)
+{
+    return section.mOffset % 8 == 0 &&
+           section.mOffset <= fileSize &&
+           section.mSize <= fileSize - section.mOffset &&
+           section.mSize == expectedSize;
+}
+
+///
+//  Check that every id in a mapped array is in [0, limit)
+//
+static bool checkSnapshotIds(const char *base, const SnapshotSection& section, size_t limit)
+{
+    const int *ids = (const int*)(base + section.mOffset);
+    size_t count = (size_t)(section.mSize / sizeof(int));
+
+    for (size_t i = 0; i < count; i++)
+    {
+        if (ids[i] < 0 || (size_t)ids[i] >= limit)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+///
+//  Check that the offsets in a mapped array start at 0, never decrease (or always
+//  increase, if strict) and end at limit
+//
+static bool checkSnapshotOffsets(const char *base, const SnapshotSection& section, size_t limit, bool strict)
+{
+    const int *offsets = (const int*)(base + section.mOffset);
+    size_t count = (size_t)(section.mSize / sizeof(int));
+
+    if (count == 0 || offsets[0] != 0 || (size_t)offsets[count - 1] != limit)
+    {
+        return false;
+    }
+
+    for (size_t i = 1; i < count; i++)
+    {
+        if (offsets[i] < offsets[i - 1] || (strict && offsets[i] == offsets[i - 1]))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Constructor/Destructor
+//
+//
+
+///
+//  Constructor
+//
+MRIDCatalog::MRIDCatalog() :
+    mSnapshotData(NULL),
+    mSnapshotSize(0)
+{
+    clear();
+}
+
+///
+//  Destructor
+//
+MRIDCatalog::~MRIDCatalog()
+{
+    unmapSnapshot();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Public Members
+//
+//
+
+///
+//  Load the catalog from the dcm_MRID.xml file
+//
+bool MRIDCatalog::loadFromFile(const std::string& mridXMLFile, const std::string& dicomDir,
+                               const MRIDCatalog *previous)
+{
+    clear();
+    mDicomDir = dicomDir;
+
+    XMLRecordParser parser("PatientRecord");
+    if (!parser.mapFile(mridXMLFile))
+    {
+       WApplication::instance()->log("error") << "Failed opening MRID log file for reading: " << mridXMLFile;
+       return false;
+    }
+
+    std::vector<XMLRecordParser::Record> records;
+    if (!parser.findRecords(records))
+    {
+        WApplication::instance()->log("error") << "Truncated PatientRecord in MRID log file: " << mridXMLFile;
+    }
+
+    // Records can only be reused if they were loaded against the same DICOM directory
+    if (previous != NULL && previous->mDicomDir != dicomDir)
+    {
+        previous = NULL;
+    }
+
+    // Previous records by hash, only built if a record is not found at its old offset
+    boost::unordered_map<boost::uint64_t, int> previousRows;
+
+    // Look for an identical record in the previous catalog, first at the same
+    // position (the common case of records being appended) and then anywhere.
+    // Only the records that are not found are parsed.
+    std::vector<int> copiedRows(records.size(), -1);
+    std::vector<XMLRecordParser::Record> parsedRecords;
+    for (size_t i = 0; i < records.size() && previous != NULL; i++)
+    {
+        const XMLRecordParser::Record& record = records[i];
+
+        if (i < (size_t)previous->mNumRecords &&
+            previous->mRecordOffsetData[i] == record.mOffset &&
+            previous->mRecordHashData[i] == record.mHash)
+        {
+            copiedRows[i] = (int)i;
+            continue;
+        }
+
+        if (previousRows.empty())
+        {
+            for (int row = 0; row < previous->mNumRecords; row++)
+            {
+                previousRows[previous->mRecordHashData[row]] = row;
+            }
+        }
+
+        boost::unordered_map<boost::uint64_t, int>::const_iterator iter = previousRows.find(record.mHash);
+        if (iter != previousRows.end())
+        {
+            copiedRows[i] = iter->second;
+        }
+    }
+
+    for (size_t i = 0; i < records.size(); i++)
+    {
+        if (copiedRows[i] < 0)
+        {
+            parsedRecords.push_back(records[i]);
+        }
+    }
+
+    // Parse a pass of records at a time on all cores, then append them in file
+    // order.  Only one pass of parsed elements is held in memory at a time.
+    size_t parsedRecord = 0;
+    size_t passEnd = 0;
+    for (size_t i = 0; i < records.size(); i++)
+    {
+        const XMLRecordParser::Record& record = records[i];
+        bool added = true;
+
+        if (copiedRows[i] >= 0)
+        {
+            copyRecord(*previous, copiedRows[i]);
+        }
+        else
+        {
+            if (parsedRecord == passEnd)
+            {
+                size_t count = std::min(XMLRecordParser::RECORDS_PER_PASS, parsedRecords.size() - parsedRecord);
+                parser.parseRecords(parsedRecords, parsedRecord, count);
+                passEnd = parsedRecord + count;
+            }
+
+            added = parser.isRecordValid(parsedRecord);
+            if (added)
+            {
+                parseRecord(parser, parsedRecord, dicomDir);
+            }
+            parsedRecord++;
+            mNumParsedRecords++;
+        }
+
+        if (added)
+        {
+            mRecordOffsets.push_back(record.mOffset);
+            mRecordHashes.push_back(record.mHash);
+            mNumRecords++;
+        }
+        else
+        {
+            WApplication::instance()->log("error") << "Failed parsing PatientRecord at offset " << record.mOffset << " in MRID log file: " << mridXMLFile;
+        }
+    }
+
+    // Build the sort order and search index alongside the catalog so that they are
+    // shared as well
+    bindArrays();
+    buildSortedRows();
+    buildInternedIds();
+    buildValues();
+    bindArrays();
+    buildDirectoryIndex();
+    mTextIndex.build(*this);
+
+    // Interned strings are looked up through mInternedIds from here on
+    boost::unordered_map<std::string, int>().swap(mInternedStrings);
+
+    return true;
+}
+
+///
+//  Save the catalog to a binary snapshot file
+//
+bool MRIDCatalog::saveSnapshot(const std::string& snapshotFile, const SourceVersion& source) const
+{
+    std::ostringstream tmpFile;
+    tmpFile << snapshotFile << ".tmp." << getpid();
+
+    FILE *fp = fopen(tmpFile.str().c_str(), "wb");
+    if (fp == NULL)
+    {
+        return false;
+    }
+
+    SnapshotHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.mMagic, SNAPSHOT_MAGIC, sizeof(header.mMagic));
+    header.mVersion = SNAPSHOT_VERSION;
+    header.mNumSections = NUM_SNAPSHOT_SECTIONS;
+    header.mSourceModTime = source.mModTime;
+    header.mSourceModTimeNsec = source.mModTimeNsec;
+    header.mSourceInode = source.mInode;
+    header.mSourceFileSize = source.mFileSize;
+    header.mNumRecords = mNumRecords;
+
+    // The header is written again once the section locations are known
+    bool success = (fwrite(&header, sizeof(header), 1, fp) == 1);
+
+    SnapshotSection *sections = header.mSections;
+    success = success &&
+        writeSnapshotSection(fp, sections[SNAPSHOT_DICOM_DIR], mDicomDir.c_str(), mDicomDir.size()) &&
+        writeSnapshotSection(fp, sections[SNAPSHOT_RECORD_OFFSETS], mRecordOffsetData.data(), mRecordOffsetData.size() * sizeof(boost::uint64_t)) &&
+        writeSnapshotSection(fp, sections[SNAPSHOT_RECORD_HASHES], mRecordHashData.data(), mRecordHashData.size() * sizeof(boost::uint64_t)) &&
+        writeSnapshotSection(fp, sections[SNAPSHOT_STRING_DATA], mStringCharData.data(), mStringCharData.size()) &&
+        writeSnapshotSection(fp, sections[SNAPSHOT_STRING_OFFSETS], mStringOffsetData.data(), mStringOffsetData.size() * sizeof(int)) &&
+        writeSnapshotSection(fp, sections[SNAPSHOT_INTERNED_IDS], mInternedIdData.data(), mInternedIdData.size() * sizeof(int)) &&
+        writeSnapshotSection(fp, sections[SNAPSHOT_SORTED_ROWS], mSortedRowData.data(), mSortedRowData.size() * sizeof(int));
+
+    for (int field = 0; field < MRIBrowser::NUM_FIELDS && success; field++)
+    {
+        success = writeSnapshotSection(fp, sections[SNAPSHOT_COLUMNS + field],
+                                       mColumnData[field].data(), mColumnData[field].size() * sizeof(int));
+    }
+
+    for (int field = 0; field < MRIBrowser::NUM_FIELDS && success; field++)
+    {
+        success = writeSnapshotSection(fp, sections[SNAPSHOT_VALUES + field],
+                                       mValueData[field].data(), mValueData[field].size() * sizeof(int)) &&
+                  writeSnapshotSection(fp, sections[SNAPSHOT_VALUE_ORDER + field],
+                                       mValueOrderData[field].data(), mValueOrderData[field].size() * sizeof(int));
+    }
+
+    for (int list = 0; list < NUM_LISTS && success; list++)
+    {
+        success = writeSnapshotSection(fp, sections[SNAPSHOT_LIST_OFFSETS + list],
+                                       mListOffsetData[list].data(), mListOffsetData[list].size() * sizeof(int)) &&
+                  writeSnapshotSection(fp, sections[SNAPSHOT_LIST_VALUES + list],
+                                       mListValueData[list].data(), mListValueData[list].size() * sizeof(int));
+    }
+
+    success = success &&
+        fseek(fp, 0, SEEK_SET) == 0 &&
+        fwrite(&header, sizeof(header), 1, fp) == 1;
+
+    if (fclose(fp) != 0)
+    {
+        success = false;
+    }
+
+    // Replace the snapshot atomically, anyone who has the old one mapped keeps it
+    if (!success || rename(tmpFile.str().c_str(), snapshotFile.c_str()) != 0)
+    {
+        remove(tmpFile.str().c_str());
+        return false;
+    }
+
+    return true;
+}
+
+///
+//  Map a binary snapshot file into memory as the catalog
+//
+bool MRIDCatalog::loadSnapshot(const std::string& snapshotFile, const std::string& dicomDir,
+                               const SourceVersion& source)
+{
+    clear();
+
+    int fd = open(snapshotFile.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        return false;
+    }
+
+    struct stat fileStat;
+    if (fstat(fd, &fileStat) != 0 || fileStat.st_size < (off_t)sizeof(SnapshotHeader))
+    {
+        close(fd);
+        return false;
+    }
+
+    size_t fileSize = (size_t)fileStat.st_size;
+    void *data = mmap(NULL, fileSize, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (data == MAP_FAILED)
+    {
+        return false;
+    }
+
+    mSnapshotData = data;
+    mSnapshotSize = fileSize;
+
+    const char *base = (const char*)data;
+    const SnapshotHeader *header = (const SnapshotHeader*)data;
+    const SnapshotSection *sections = header->mSections;
+
+    // The snapshot must have been written for the current XML file
+    if (memcmp(header->mMagic, SNAPSHOT_MAGIC, sizeof(header->mMagic)) != 0 ||
+        header->mVersion != SNAPSHOT_VERSION ||
+        header->mNumSections != NUM_SNAPSHOT_SECTIONS ||
+        header->mSourceModTime != source.mModTime ||
+        header->mSourceModTimeNsec != source.mModTimeNsec ||
+        header->mSourceInode != source.mInode ||
+        header->mSourceFileSize != source.mFileSize ||
+        header->mNumRecords < 0 ||
+        header->mNumRecords > (boost::int64_t)(fileSize / sizeof(int)))
+    {
+        clear();
+        return false;
+    }
+
+    size_t numRecords = (size_t)header->mNumRecords;
+    const SnapshotSection& dicomDirSection = sections[SNAPSHOT_DICOM_DIR];
+    const SnapshotSection& stringDataSection = sections[SNAPSHOT_STRING_DATA];
+    const SnapshotSection& stringOffsetSection = sections[SNAPSHOT_STRING_OFFSETS];
+    const SnapshotSection& internedIdSection = sections[SNAPSHOT_INTERNED_IDS];
+
+    // Check that every array lies within the file and has the size the header implies
+    bool valid =
+        checkSnapshotSection(dicomDirSection, fileSize, dicomDir.size()) &&
+        memcmp(base + dicomDirSection.mOffset, dicomDir.c_str(), dicomDir.size()) == 0 &&
+        checkSnapshotSection(sections[SNAPSHOT_RECORD_OFFSETS], fileSize, numRecords * sizeof(boost::uint64_t)) &&
+        checkSnapshotSection(sections[SNAPSHOT_RECORD_HASHES], fileSize, numRecords * sizeof(boost::uint64_t)) &&
+        checkSnapshotSection(stringDataSection, fileSize, stringDataSection.mSize) &&
+        checkSnapshotSection(stringOffsetSection, fileSize, stringOffsetSection.mSize) &&
+        checkSnapshotSection(internedIdSection, fileSize, internedIdSection.mSize - internedIdSection.mSize % sizeof(int)) &&
+        checkSnapshotSection(sections[SNAPSHOT_SORTED_ROWS], fileSize, numRecords * sizeof(int));
+
+    for (int field = 0; field < MRIBrowser::NUM_FIELDS && valid; field++)
+    {
+        const SnapshotSection& valueOrderSection = sections[SNAPSHOT_VALUE_ORDER + field];
+        size_t numValues = (mValueType[field] != VALUE_NONE) ? numRecords : 0;
+
+        valid = checkSnapshotSection(sections[SNAPSHOT_COLUMNS + field], fileSize, numRecords * sizeof(int)) &&
+                checkSnapshotSection(sections[SNAPSHOT_VALUES + field], fileSize, numValues * sizeof(int)) &&
+                checkSnapshotSection(valueOrderSection, fileSize, valueOrderSection.mSize - valueOrderSection.mSize % sizeof(int)) &&
+                valueOrderSection.mSize <= numValues * sizeof(int);
+    }
+
+    for (int list = 0; list < NUM_LISTS && valid; list++)
+    {
+        const SnapshotSection& listValueSection = sections[SNAPSHOT_LIST_VALUES + list];
+
+        valid = checkSnapshotSection(sections[SNAPSHOT_LIST_OFFSETS + list], fileSize, (numRecords + 1) * sizeof(int)) &&
+                checkSnapshotSection(listValueSection, fileSize, listValueSection.mSize - listValueSection.mSize % sizeof(int)) &&
+                ((const int*)(base + sections[SNAPSHOT_LIST_OFFSETS + list].mOffset))[numRecords] == (int)(listValueSection.mSize / sizeof(int));
+    }
+
+    // The string table must start with the empty string and end at the end of the data
+    size_t numStringOffsets = (size_t)(stringOffsetSection.mSize / sizeof(int));
+    valid = valid &&
+        stringOffsetSection.mSize % sizeof(int) == 0 &&
+        numStringOffsets >= 2 &&
+        stringDataSection.mSize > 0 &&
+        base[stringDataSection.mOffset + stringDataSection.mSize - 1] == '\0' &&
+        ((const int*)(base + stringOffsetSection.mOffset))[0] == 0 &&
+        ((const int*)(base + stringOffsetSection.mOffset))[numStringOffsets - 1] == (int)stringDataSection.mSize;
+
+    // The sizes are right, now check what the arrays hold so that no id or offset
+    // read later can point outside the mapping.  Every string holds at least its
+    // NUL, so the string offsets always increase.
+    size_t numStrings = numStringOffsets - 1;
+    valid = valid &&
+        checkSnapshotOffsets(base, stringOffsetSection, (size_t)stringDataSection.mSize, true) &&
+        checkSnapshotIds(base, internedIdSection, numStrings) &&
+        checkSnapshotIds(base, sections[SNAPSHOT_SORTED_ROWS], numRecords);
+
+    for (int field = 0; field < MRIBrowser::NUM_FIELDS && valid; field++)
+    {
+        valid = checkSnapshotIds(base, sections[SNAPSHOT_COLUMNS + field], numStrings) &&
+                checkSnapshotIds(base, sections[SNAPSHOT_VALUE_ORDER + field], numRecords);
+    }
+
+    for (int list = 0; list < NUM_LISTS && valid; list++)
+    {
+        const SnapshotSection& listValueSection = sections[SNAPSHOT_LIST_VALUES + list];
+
+        valid = checkSnapshotOffsets(base, sections[SNAPSHOT_LIST_OFFSETS + list],
+                                     (size_t)(listValueSection.mSize / sizeof(int)), false) &&
+                checkSnapshotIds(base, listValueSection, numStrings);
+    }
+
+    if (!valid)
+    {
+        clear();
+        return false;
+    }
+
+    // Point the views at the mapping, nothing is copied or parsed
+    mNumRecords = (int)numRecords;
+    mDicomDir = dicomDir;
+
+    mRecordOffsetData.bind((const boost::uint64_t*)(base + sections[SNAPSHOT_RECORD_OFFSETS].mOffset), numRecords);
+    mRecordHashData.bind((const boost::uint64_t*)(base + sections[SNAPSHOT_RECORD_HASHES].mOffset), numRecords);
+    mStringCharData.bind(base + stringDataSection.mOffset, (size_t)stringDataSection.mSize);
+    mStringOffsetData.bind((const int*)(base + stringOffsetSection.mOffset), numStringOffsets);
+    mInternedIdData.bind((const int*)(base + internedIdSection.mOffset), (size_t)(internedIdSection.mSize / sizeof(int)));
+    mSortedRowData.bind((const int*)(base + sections[SNAPSHOT_SORTED_ROWS].mOffset), numRecords);
+
+    for (int field = 0; field < MRIBrowser::NUM_FIELDS; field++)
+    {
+        const SnapshotSection& valueSection = sections[SNAPSHOT_VALUES + field];
+        const SnapshotSection& valueOrderSection = sections[SNAPSHOT_VALUE_ORDER + field];
+
+        mColumnData[field].bind((const int*)(base + sections[SNAPSHOT_COLUMNS + field].mOffset), numRecords);
+        mValueData[field].bind((const int*)(base + valueSection.mOffset), (size_t)(valueSection.mSize / sizeof(int)));
+        mValueOrderData[field].bind((const int*)(base + valueOrderSection.mOffset), (size_t)(valueOrderSection.mSize / sizeof(int)));
+    }
+
+    for (int list = 0; list < NUM_LISTS; list++)
+    {
+        const SnapshotSection& listValueSection = sections[SNAPSHOT_LIST_VALUES + list];
+
+        mListOffsetData[list].bind((const int*)(base + sections[SNAPSHOT_LIST_OFFSETS + list].mOffset), numRecords + 1);
+        mListValueData[list].bind((const int*)(base + listValueSection.mOffset), (size_t)(listValueSection.mSize / sizeof(int)));
+    }
+
+    buildDirectoryIndex();
+    mTextIndex.build(*this);
+
+    return true;
+}
+
+///
+//  Get the version of an XML file
+//
+bool MRIDCatalog::getSourceVersion(const std::string& file, SourceVersion& version)
+{
+    memset(&version, 0, sizeof(version));
+
+    struct stat fileStat;
+    if (stat(file.c_str(), &fileStat) != 0)
+    {
+        return false;
+    }
+
+    version.mModTime = (boost::int64_t)fileStat.st_mtime;
+#if defined(__APPLE__)
+    version.mModTimeNsec = (boost::int64_t)fileStat.st_mtimespec.tv_nsec;
+#elif defined(__linux__)
+    version.mModTimeNsec = (boost::int64_t)fileStat.st_mtim.tv_nsec;
+#endif
+    version.mInode = (boost::uint64_t)fileStat.st_ino;
+    version.mFileSize = (boost::uint64_t)fileStat.st_size;
+
+    return true;
+}
+
+///
+//  Get whether two versions of an XML file are the same
+//
+bool MRIDCatalog::isSameVersion(const SourceVersion& version1, const SourceVersion& version2)
+{
+    return version1.mModTime == version2.mModTime &&
+           version1.mModTimeNsec == version2.mModTimeNsec &&
+           version1.mInode == version2.mInode &&
+           version1.mFileSize == version2.mFileSize;
+}
+
+///
+//  Compute the changes from a previous catalog to this one
+//
+void MRIDCatalog::computeDelta(const MRIDCatalog& previous, Delta& delta) const
+{
+    delta.mRowMap.assign(previous.mNumRecords, -1);
+    delta.mInserted.clear();
+    delta.mUpdated.clear();
+    delta.mDeleted.clear();
+
+    boost::unordered_map<std::string, int> previousRows;
+    for (int row = 0; row < previous.mNumRecords; row++)
+    {
+        previousRows[previous.getRecordKey(row)] = row;
+    }
+
+    for (int row = 0; row < mNumRecords; row++)
+    {
+        boost::unordered_map<std::string, int>::iterator iter = previousRows.find(getRecordKey(row));
+        if (iter == previousRows.end())
+        {
+            delta.mInserted.push_back(row);
+            continue;
+        }
+
+        int previousRow = iter->second;
+        delta.mRowMap[previousRow] = row;
+        if (previous.mRecordHashData[previousRow] != mRecordHashData[row])
+        {
+            delta.mUpdated.push_back(row);
+        }
+
+        // Each previous record matches at most one record
+        previousRows.erase(iter);
+    }
+
+    for (int row = 0; row < previous.mNumRecords; row++)
+    {
+        if (delta.mRowMap[row] < 0)
+        {
+            delta.mDeleted.push_back(row);
+        }
+    }
+}
+
+///
+//  Parse a string into a typed value
+//
+bool MRIDCatalog::parseValue(ValueTypeEnum type, const char *str, int& value)
+{
+    const char *cur = str;
+    while (isspace((unsigned char)*cur))
+    {
+        cur++;
+    }
+
+    if (type == VALUE_AGE)
+    {
+        // DICOM age strings are a number followed by a unit (D, W, M or Y).  Months and
+        // years use the mean Gregorian lengths so that 12M and 1Y compare equal.
+        if (!isdigit((unsigned char)*cur))
+        {
+            return false;
+        }
+
+        long number = 0;
+        while (isdigit((unsigned char)*cur))
+        {
+            number = number * 10 + (*cur - '0');
+            if (number > 1000000)
+            {
+                return false;
+            }
+            cur++;
+        }
+
+        while (isspace((unsigned char)*cur))
+        {
+            cur++;
+        }
+
+        long days;
+        switch (toupper((unsigned char)*cur))
+        {
+        case 'D':
+            days = number;
+            cur++;
+            break;
+        case 'W':
+            days = number * 7;
+            cur++;
+            break;
+        case 'M':
+            days = number * 36525 / 1200;
+            cur++;
+            break;
+        case 'Y':
+            days = number * 36525 / 100;
+            cur++;
+            break;
+        case '\0':
+            days = number * 36525 / 100;
+            break;
+        default:
+            return false;
+        }
+
+        while (isspace((unsigned char)*cur))
+        {
+            cur++;
+        }
+
+        if (*cur != '\0')
+        {
+            return false;
+        }
+
+        value = (int)days;
+        return true;
+    }
+    else if (type == VALUE_DATE)
+    {
+        // Split into groups of digits, anything else is a separator
+        int groups[3];
+        int groupLengths[3];
+        int numGroups = 0;
+
+        while (*cur != '\0' && numGroups < 3)
+        {
+            if (!isdigit((unsigned char)*cur))
+            {
+                cur++;
+                continue;
+            }
+
+            groups[numGroups] = 0;
+            groupLengths[numGroups] = 0;
+            while (isdigit((unsigned char)*cur) && groupLengths[numGroups] < 9)
+            {
+                groups[numGroups] = groups[numGroups] * 10 + (*cur - '0');
+                groupLengths[numGroups]++;
+                cur++;
+            }
+            numGroups++;
+        }
+
+        int year, month, day;
+        if (numGroups >= 1 && groupLengths[0] == 8)
+        {
+            // YYYYMMDD, optionally followed by a time
+            year = groups[0] / 10000;
+            month = (groups[0] / 100) % 100;
+            day = groups[0] % 100;
+        }
+        else if (numGroups == 3 && groupLengths[0] == 4)
+        {
+            // YYYY-MM-DD
+            year = groups[0];
+            month = groups[1];
+            day = groups[2];
+        }
+        else if (numGroups == 3 && groupLengths[2] == 4)
+        {
+            // MM/DD/YYYY
+            month = groups[0];
+            day = groups[1];
+            year = groups[2];
+        }
+        else
+        {
+            return false;
+        }
+
+        if (month < 1 || month > 12 || day < 1 || day > daysInMonth(year, month))
+        {
+            return false;
+        }
+
+        value = daysFromCivil(year, month, day);
+        return true;
+    }
+
+    return false;
+}
+
+///
+//  Find the rows whose typed value of a field is in a range
+//
+void MRIDCatalog::findValueRange(int field, int minValue, int maxValue, RowBitmap& rows) const
+{
+    const Array<int>& order = mValueOrderData[field];
+    if (order.size() == 0 || minValue > maxValue)
+    {
+        return;
+    }
+
+    const int *first = std::lower_bound(order.data(), order.data() + order.size(), minValue,
+                                        MRIDRowValueLess(this, field));
+    const int *last = std::upper_bound(first, order.data() + order.size(), maxValue,
+                                       MRIDValueRowLess(this, field));
+
+    for (const int *row = first; row != last; row++)
+    {
+        rows.set(*row);
+    }
+}
+
+///
+//  Normalize a directory path for comparison
+//
+std::string MRIDCatalog::normalizeDirectory(const std::string& dir)
+{
+    std::vector<std::string> components;
+    size_t pos = 0;
+
+    while (pos <= dir.size())
+    {
+        size_t end = dir.find('/', pos);
+        if (end == std::string::npos)
+        {
+            end = dir.size();
+        }
+
+        std::string component = dir.substr(pos, end - pos);
+        if (component == "..")
+        {
+            if (!components.empty() && components.back() != "..")
+            {
+                components.pop_back();
+            }
+            else
+            {
+                components.push_back(component);
+            }
+        }
+        else if (!component.empty() && component != ".")
+        {
+            components.push_back(component);
+        }
+
+        pos = end + 1;
+    }
+
+    std::string result = (!dir.empty() && dir[0] == '/') ? "/" : "";
+    for (size_t i = 0; i < components.size(); i++)
+    {
+        if (i > 0)
+        {
+            result += "/";
+        }
+        result += components[i];
+    }
+
+    return result;
+}
+
+///
+//  Find the record of a scan directory
+//
+int MRIDCatalog::findDirectory(const std::string& dir) const
+{
+    boost::unordered_map<std::string, int>::const_iterator iter = mDirectoryRows.find(normalizeDirectory(dir));
+    if (iter != mDirectoryRows.end())
+    {
+        return iter->second;
+    }
+
+    return -1;
+}
+
+///
+//  Find the records of a Patient ID (MRID)
+//
+void MRIDCatalog::findPatientID(const std::string& patientID, std::vector<int>& rows) const
+{
+    rows.clear();
+
+    // The sort order is by Patient ID, then directory, so the records of a Patient ID
+    // are a contiguous run
+    size_t first = 0;
+    size_t last = mSortedRowData.size();
+    while (first < last)
+    {
+        size_t middle = first + (last - first) / 2;
+        if (strcmp(getField(mSortedRowData[middle], MRIBrowser::PATIENT_ID), patientID.c_str()) < 0)
+        {
+            first = middle + 1;
+        }
+        else
+        {
+            last = middle;
+        }
+    }
+
+    for (size_t i = first; i < mSortedRowData.size(); i++)
+    {
+        int row = mSortedRowData[i];
+        if (strcmp(getField(row, MRIBrowser::PATIENT_ID), patientID.c_str()) != 0)
+        {
+            break;
+        }
+
+        rows.push_back(row);
+    }
+}
+
+///
+//  Compare two rows in sorted (Patient ID) order
+//
+int MRIDCatalog::compareRows(int row1, int row2) const
+{
+    int result = strcmp(getField(row1, MRIBrowser::PATIENT_ID), getField(row2, MRIBrowser::PATIENT_ID));
+    if (result != 0)
+    {
+        return result;
+    }
+
+    // Same patient, order the studies by directory so that the order does not
+    // depend on where the records are in the file
+    return strcmp(getField(row1, MRIBrowser::DIRECTORY), getField(row2, MRIBrowser::DIRECTORY));
+}
+
+///
+//  Find the id of an interned string
+//
+int MRIDCatalog::findString(const std::string& str) const
+{
+    if (str.empty())
+    {
+        return EMPTY_STRING_ID;
+    }
+
+    // Binary search of the interned ids, which are sorted by value
+    size_t first = 0;
+    size_t last = mInternedIdData.size();
+    while (first < last)
+    {
+        size_t middle = first + (last - first) / 2;
+        int result = strcmp(getString(mInternedIdData[middle]), str.c_str());
+        if (result == 0)
+        {
+            return mInternedIdData[middle];
+        }
+        else if (result < 0)
+        {
+            first = middle + 1;
+        }
+        else
+        {
+            last = middle;
+        }
+    }
+
+    return -1;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Protected Members
+//
+//
+
+///
+//  Clear all of the catalog data
+//
+void MRIDCatalog::clear()
+{
+    unmapSnapshot();
+
+    mNumRecords = 0;
+    mNumParsedRecords = 0;
+    mDicomDir.clear();
+    mRecordOffsets.clear();
+    mRecordHashes.clear();
+
+    for (int i = 0; i < MRIBrowser::NUM_FIELDS; i++)
+    {
+        mColumns[i].clear();
+        mValues[i].clear();
+        mValueOrder[i].clear();
+    }
+
+    for (int i = 0; i < NUM_LISTS; i++)
+    {
+        mListOffsets[i].clear();
+        mListOffsets[i].push_back(0);
+        mListValues[i].clear();
+    }
+
+    mStringData.clear();
+    mStringOffsets.clear();
+    mInternedStrings.clear();
+    mInternedIds.clear();
+    mSortedRows.clear();
+    mTextIndex.clear();
+    mDirectoryRows.clear();
+
+    // String id 0 is always the empty string
+    mStringOffsets.push_back(0);
+    addString("");
+
+    bindArrays();
+}
+
+///
+//  Append a string to the string table without interning it
+//
+int MRIDCatalog::addString(const std::string& str)
+{
+    int id = (int)mStringOffsets.size() - 1;
+
+    mStringData.insert(mStringData.end(), str.begin(), str.end());
+    mStringData.push_back('\0');
+    mStringOffsets.push_back((int)mStringData.size());
+
+    return id;
+}
+
+///
+//  Add a string to the string table, sharing storage with any identical interned string
+//
+int MRIDCatalog::internString(const std::string& str)
+{
+    if (str.empty())
+    {
+        return EMPTY_STRING_ID;
+    }
+
+    boost::unordered_map<std::string, int>::const_iterator iter = mInternedStrings.find(str);
+    if (iter != mInternedStrings.end())
+    {
+        return iter->second;
+    }
+
+    int id = addString(str);
+    mInternedStrings[str] = id;
+
+    return id;
+}
+
+///
+//  Read a single valued field from a parsed record into a column
+//
+void MRIDCatalog::readField(const XMLRecordParser& parser, size_t record, int field,
+                            const std::string& errorReplaceStr, const std::string& prependStr)
+{
+    const MRIBrowser::MRIField *fieldInfo = MRIBrowser::getMRIField(field);
+    std::string value;
+
+    const XMLRecordParser::Element *element = parser.findElement(record, fieldInfo->mTagName.c_str());
+    if (element != NULL)
+    {
+        std::string dataStr = XMLRecordParser::getText(*element);
+
+        if (dataStr != "ERROR:")
+        {
+            value = prependStr + dataStr;
+        }
+        else
+        {
+            value = errorReplaceStr;
+        }
+    }
+
+    addField(field, value);
+}
+
+///
+//  Append a value to a single valued column
+//
+void MRIDCatalog::addField(int field, const std::string& value)
+{
+    if (value.empty())
+    {
+        mColumns[field].push_back(EMPTY_STRING_ID);
+    }
+    else if (mInternField[field])
+    {
+        mColumns[field].push_back(internString(value));
+    }
+    else
+    {
+        mColumns[field].push_back(addString(value));
+    }
+}
+
+///
+//  Read a series of like-named elements of a parsed record into a multi-valued list
+//
+void MRIDCatalog::readList(const XMLRecordParser& parser, size_t record, int list)
+{
+    static const char* listTagNames[NUM_LISTS] =
+    {
+        "Scan",     // SCAN_LIST
+        "User",     // USER_LIST
+        "Group",    // GROUP_LIST
+    };
+
+    size_t nameLength = strlen(listTagNames[list]);
+    int numElements = parser.getNumElements(record);
+
+    for (int i = 0; i < numElements; i++)
+    {
+        const XMLRecordParser::Element& element = parser.getElement(record, i);
+
+        if (XMLRecordParser::isElementNamed(element, listTagNames[list], nameLength))
+        {
+            std::string dataStr = XMLRecordParser::getText(element);
+
+            if (dataStr == "")
+            {
+                dataStr = "unnamed";
+            }
+
+            mListValues[list].push_back(internString(dataStr));
+        }
+    }
+
+    mListOffsets[list].push_back((int)mListValues[list].size());
+}
+
+///
+//  Append a single parsed <PatientRecord> to the catalog
+//
+void MRIDCatalog::parseRecord(const XMLRecordParser& parser, size_t record, const std::string& dicomDir)
+{
+    readField(parser, record, MRIBrowser::PATIENT_ID);
+    readField(parser, record, MRIBrowser::DIRECTORY, "", dicomDir + std::string("/"));
+    readField(parser, record, MRIBrowser::AGE, "UNKNOWN_AGE");
+    readField(parser, record, MRIBrowser::NAME);
+    readField(parser, record, MRIBrowser::SEX);
+    readField(parser, record, MRIBrowser::BIRTHDAY);
+    readField(parser, record, MRIBrowser::SCANDATE);
+    readField(parser, record, MRIBrowser::MANUFACTURER);
+    readField(parser, record, MRIBrowser::MODEL);
+    readField(parser, record, MRIBrowser::SOFTWARE_VER);
+
+    // Scans are a list, keep the column aligned
+    mColumns[MRIBrowser::SCAN].push_back(EMPTY_STRING_ID);
+
+    readList(parser, record, SCAN_LIST);
+    readList(parser, record, USER_LIST);
+    readList(parser, record, GROUP_LIST);
+}
+
+///
+//  Append a copy of a record from another catalog
+//
+void MRIDCatalog::copyRecord(const MRIDCatalog& other, int row)
+{
+    for (int field = 0; field < MRIBrowser::NUM_FIELDS; field++)
+    {
+        if (field == MRIBrowser::SCAN)
+        {
+            mColumns[field].push_back(EMPTY_STRING_ID);
+        }
+        else
+        {
+            addField(field, other.getField(row, field));
+        }
+    }
+
+    for (int list = 0; list < NUM_LISTS; list++)
+    {
+        int numValues = other.getListSize(row, list);
+        for (int i = 0; i < numValues; i++)
+        {
+            mListValues[list].push_back(internString(other.getListValue(row, list, i)));
+        }
+        mListOffsets[list].push_back((int)mListValues[list].size());
+    }
+}
+
+///
+//  Sort the rows by Patient ID
+//
+void MRIDCatalog::buildSortedRows()
+{
+    mSortedRows.resize(mNumRecords);
+    for (int row = 0; row < mNumRecords; row++)
+    {
+        mSortedRows[row] = row;
+    }
+
+    std::stable_sort(mSortedRows.begin(), mSortedRows.end(), MRIDRowLess(this));
+}
+
+///
+//  Build the list of interned string ids sorted by value
+//
+void MRIDCatalog::buildInternedIds()
+{
+    mInternedIds.clear();
+    mInternedIds.reserve(mInternedStrings.size());
+
+    for (boost::unordered_map<std::string, int>::const_iterator iter = mInternedStrings.begin();
+         iter != mInternedStrings.end(); iter++)
+    {
+        mInternedIds.push_back(iter->second);
+    }
+
+    std::sort(mInternedIds.begin(), mInternedIds.end(), MRIDStringLess(this));
+}
+
+///
+//  Parse the typed value columns and sort their permutations
+//
+void MRIDCatalog::buildValues()
+{
+    for (int field = 0; field < MRIBrowser::NUM_FIELDS; field++)
+    {
+        mValues[field].clear();
+        mValueOrder[field].clear();
+
+        if (mValueType[field] == VALUE_NONE)
+        {
+            continue;
+        }
+
+        // Interned fields (age) have few distinct strings, parse each only once
+        std::vector<int> parsedIds;
+        if (mInternField[field])
+        {
+            parsedIds.assign(getNumStrings(), INVALID_VALUE);
+        }
+
+        mValues[field].resize(mNumRecords, INVALID_VALUE);
+        for (int row = 0; row < mNumRecords; row++)
+        {
+            int id = getFieldId(row, field);
+            if (id == EMPTY_STRING_ID)
+            {
+                continue;
+            }
+
+            int value = INVALID_VALUE;
+            if (!parsedIds.empty() && parsedIds[id] != INVALID_VALUE)
+            {
+                value = parsedIds[id];
+            }
+            else if (parseValue(mValueType[field], getString(id), value) && !parsedIds.empty())
+            {
+                parsedIds[id] = value;
+            }
+
+            mValues[field][row] = value;
+            if (value != INVALID_VALUE)
+            {
+                mValueOrder[field].push_back(row);
+            }
+        }
+
+        std::stable_sort(mValueOrder[field].begin(), mValueOrder[field].end(), MRIDValueLess(mValues[field]));
+    }
+}
+
+///
+//  Build the hash index of normalized directories
+//
+void MRIDCatalog::buildDirectoryIndex()
+{
+    mDirectoryRows.clear();
+    mDirectoryRows.rehash(mNumRecords);
+
+    for (int row = 0; row < mNumRecords; row++)
+    {
+        if (getFieldId(row, MRIBrowser::PATIENT_ID) == EMPTY_STRING_ID ||
+            getFieldId(row, MRIBrowser::DIRECTORY) == EMPTY_STRING_ID)
+        {
+            continue;
+        }
+
+        // The first record of a directory wins, as with the linear search this replaces
+        mDirectoryRows.insert(std::make_pair(normalizeDirectory(getField(row, MRIBrowser::DIRECTORY)), row));
+    }
+}
+
+///
+//  Point the array views at the arrays owned by the catalog
+//
+void MRIDCatalog::bindArrays()
+{
+    mRecordOffsetData.bind(mRecordOffsets);
+    mRecordHashData.bind(mRecordHashes);
+
+    for (int field = 0; field < MRIBrowser::NUM_FIELDS; field++)
+    {
+        mColumnData[field].bind(mColumns[field]);
+        mValueData[field].bind(mValues[field]);
+        mValueOrderData[field].bind(mValueOrder[field]);
+    }
+
+    for (int list = 0; list < NUM_LISTS; list++)
+    {
+        mListOffsetData[list].bind(mListOffsets[list]);
+        mListValueData[list].bind(mListValues[list]);
+    }
+
+    mStringCharData.bind(mStringData);
+    mStringOffsetData.bind(mStringOffsets);
+    mInternedIdData.bind(mInternedIds);
+    mSortedRowData.bind(mSortedRows);
+}
+
+///
+//  Unmap the snapshot file, if one is mapped
+//
+void MRIDCatalog::unmapSnapshot()
+{
+    if (mSnapshotData != NULL)
+    {
+        munmap(mSnapshotData, mSnapshotSize);
+        mSnapshotData = NULL;
+        mSnapshotSize = 0;
+    }
+}
+
+///
+//  Get the key that identifies a record across reloads
+//
+std::string MRIDCatalog::getRecordKey(int row) const
+{
+    // Each study has its own directory, the Patient ID is not unique across studies
+    int id = getFieldId(row, MRIBrowser::DIRECTORY);
+    if (id == EMPTY_STRING_ID)
+    {
+        id = getFieldId(row, MRIBrowser::PATIENT_ID);
+    }
+
+    return getString(id);
+}
@@ -0,0 +1,539 @@
+//
+//
+//  Description:
+//      Definition of the MRID catalog.  The catalog is an immutable snapshot of all
+//      of the patient records in dcm_MRID.xml.  A single catalog is shared between
+//      all of the sessions in the server process (see MRIDCatalogCache).
+//
+//      Records are stored by column rather than by row.  Every string in the catalog
+//      lives in one contiguous character buffer and is referred to by an integer id.
+//      Low-cardinality fields (sex, scanner, software version, ...) and the scan, user
+//      and group names are interned so that each distinct value is stored only once.
+//      The multi-valued scan/user/group lists are stored in CSR form: a per-record
+//      offset array into a flat array of string ids.
+//
+//      Dates and ages are also parsed into typed integer columns (days since the epoch,
+//      age in days), each with a permutation of the rows sorted by value, so that range
+//      searches are answered by binary search.
+//
+//      Each record remembers its byte offset in the file and a hash of its XML text so
+//      that a reload only parses the records that were added or changed.
+//
+//      A catalog can be saved to a binary snapshot file and mapped back into memory
+//      without any parsing.  The snapshot holds the same arrays that the catalog is
+//      made of, so a mapped catalog reads its columns directly from the mapping.
+//
+//  Author:
+//      Dan Ginsburg
+//
+//  Children's Hospital Boston
+//  GPL v2
+//
+#ifndef MRIDCATALOG_H
+#define MRIDCATALOG_H
+
+#include "MRIBrowser.h"
+#include "MRIDTextIndex.h"
+#include <boost/unordered_map.hpp>
+#include <boost/cstdint.hpp>
+#include <climits>
+#include <ctime>
+#include <string>
+#include <vector>
+
+class RowBitmap;
+class XMLRecordParser;
+
+///
+/// \class MRIDCatalog
+/// \brief Immutable, column oriented snapshot of the records in dcm_MRID.xml
+///
+class MRIDCatalog
+{
+public:
+
+    /// Multi-valued lists stored per record
+    typedef enum
+    {
+        SCAN_LIST = 0,
+        USER_LIST,
+        GROUP_LIST,
+
+        NUM_LISTS
+    } ListEnum;
+
+    /// Types of the typed value columns
+    typedef enum
+    {
+        VALUE_NONE = 0,     // Field has no typed column
+        VALUE_DATE,         // Days since 1970-01-01
+        VALUE_AGE           // Age in days
+
+    } ValueTypeEnum;
+
+    /// String id of the empty string
+    static const int EMPTY_STRING_ID = 0;
+
+    /// Typed value of a field that is empty or could not be parsed
+    static const int INVALID_VALUE = INT_MIN;
+
+    /// Changes between two catalog snapshots
+    typedef struct
+    {
+        /// Row in the new catalog of each previous row, -1 if it was deleted
+        std::vector<int> mRowMap;
+
+        /// Rows in the new catalog that were not in the previous catalog
+        std::vector<int> mInserted;
+
+        /// Rows in the new catalog whose record changed
+        std::vector<int> mUpdated;
+
+        /// Rows in the previous catalog that are no longer present
+        std::vector<int> mDeleted;
+
+    } Delta;
+
+    /// Version of the XML file a catalog was loaded from
+    typedef struct
+    {
+        /// Modification time, in seconds
+        boost::int64_t mModTime;
+
+        /// Nanoseconds of the modification time, 0 where not available
+        boost::int64_t mModTimeNsec;
+
+        /// Inode, changes when the file is replaced by a rename
+        boost::uint64_t mInode;
+
+        /// Size
+        boost::uint64_t mFileSize;
+
+    } SourceVersion;
+
+    ///
+    /// Constructor
+    ///
+    MRIDCatalog();
+
+    ///
+    /// Destructor
+    ///
+    virtual ~MRIDCatalog();
+
+    ///
+    /// Load the catalog from the dcm_MRID.xml file
+    /// \param mridXMLFile Full path to dcm_MRID.xml
+    /// \param dicomDir Base DICOM directory, prepended to each record's directory
+    /// \param previous Previously loaded catalog of the same file, records whose XML
+    ///                 is unchanged are copied from it instead of being parsed
+    /// \return Whether loading was successful
+    ///
+    bool loadFromFile(const std::string& mridXMLFile, const std::string& dicomDir,
+                      const MRIDCatalog *previous = NULL);
+
+    ///
+    /// Save the catalog to a binary snapshot file.  The file is written under a
+    /// temporary name and renamed into place, so readers never see a partial file.
+    /// \param snapshotFile Full path to the snapshot file
+    /// \param source Version of the XML file the catalog was loaded from
+    /// \return Whether saving was successful
+    ///
+    bool saveSnapshot(const std::string& snapshotFile, const SourceVersion& source) const;
+
+    ///
+    /// Map a binary snapshot file into memory as the catalog.  The snapshot is only
+    /// used if it was written for the same version of the XML file and the same
+    /// DICOM directory, and every id and offset in it is in range.
+    /// \param snapshotFile Full path to the snapshot file
+    /// \param dicomDir Base DICOM directory
+    /// \param source Version of the current XML file
+    /// \return Whether the snapshot was current and valid
+    ///
+    bool loadSnapshot(const std::string& snapshotFile, const std::string& dicomDir,
+                      const SourceVersion& source);
+
+    ///
+    /// Get the version of an XML file
+    /// \param file Full path to the file
+    /// \param version Output, version of the file (all zero if it could not be read)
+    /// \return Whether the file could be read
+    ///
+    static bool getSourceVersion(const std::string& file, SourceVersion& version);
+
+    ///
+    /// Get whether two versions of an XML file are the same
+    ///
+    static bool isSameVersion(const SourceVersion& version1, const SourceVersion& version2);
+
+    ///
+    /// Compute the changes from a previous catalog to this one.  Records are matched
+    /// by their directory and compared by the hash of their XML.
+    /// \param previous Previous catalog snapshot
+    /// \param delta Output, changes from previous to this catalog
+    ///
+    void computeDelta(const MRIDCatalog& previous, Delta& delta) const;
+
+    ///
+    /// Get the number of records in the catalog
+    ///
+    int getNumRecords() const                   {   return mNumRecords;     }
+
+    ///
+    /// Get the number of records that had to be parsed by the last load
+    ///
+    int getNumParsedRecords() const             {   return mNumParsedRecords;   }
+
+    ///
+    /// Get the string id of a single valued field
+    /// \param row Record index
+    /// \param field MRIBrowser::MRIFieldEnum (not MRIBrowser::SCAN, which is a list)
+    ///
+    int getFieldId(int row, int field) const    {   return mColumnData[field][row];    }
+
+    ///
+    /// Get the value of a single valued field
+    ///
+    const char* getField(int row, int field) const      {   return getString(mColumnData[field][row]);  }
+
+    ///
+    /// Get the number of entries in a multi-valued list for a record
+    ///
+    int getListSize(int row, int list) const
+    {
+        return mListOffsetData[list][row + 1] - mListOffsetData[list][row];
+    }
+
+    ///
+    /// Get the string id of an entry in a multi-valued list
+    ///
+    int getListId(int row, int list, int index) const
+    {
+        return mListValueData[list][mListOffsetData[list][row] + index];
+    }
+
+    ///
+    /// Get the value of an entry in a multi-valued list
+    ///
+    const char* getListValue(int row, int list, int index) const
+    {
+        return getString(getListId(row, list, index));
+    }
+
+    ///
+    /// Get a string from the string table
+    ///
+    const char* getString(int id) const         {   return &mStringCharData[mStringOffsetData[id]];   }
+
+    ///
+    /// Get the length of a string in the string table
+    ///
+    int getStringLength(int id) const           {   return mStringOffsetData[id + 1] - mStringOffsetData[id] - 1; }
+
+    ///
+    /// Get the number of strings in the string table
+    ///
+    int getNumStrings() const                   {   return (int)mStringOffsetData.size() - 1;  }
+
+    ///
+    /// Whether the values of a single valued field are interned
+    ///
+    static bool isInternedField(int field)      {   return mInternField[field];     }
+
+    ///
+    /// Find the id of an interned string (list entries and low-cardinality fields)
+    /// \return String id, or -1 if the string is not interned in this catalog
+    ///
+    int findString(const std::string& str) const;
+
+    ///
+    /// Get the type of the typed value column of a field
+    ///
+    static ValueTypeEnum getValueType(int field)    {   return mValueType[field];   }
+
+    ///
+    /// Parse a string into a typed value
+    /// \param type Value type
+    /// \param str String to parse, a date (YYYYMMDD, YYYY-MM-DD, MM/DD/YYYY) or an
+    ///            age (DICOM style nnnD, nnnW, nnnM or nnnY, plain numbers are years)
+    /// \param value Output, parsed value
+    /// \return Whether the string could be parsed
+    ///
+    static bool parseValue(ValueTypeEnum type, const char *str, int& value);
+
+    ///
+    /// Get the typed value of a field (only for fields with a typed column)
+    /// \return Value, or INVALID_VALUE if the field is empty or could not be parsed
+    ///
+    int getValue(int row, int field) const      {   return mValueData[field][row];  }
+
+    ///
+    /// Find the rows whose typed value of a field is in a range, by binary search of
+    /// the field's sorted permutation.  Rows without a valid value are never included.
+    /// \param field Field with a typed column
+    /// \param minValue Smallest value to include
+    /// \param maxValue Largest value to include
+    /// \param rows Output, bits are set for the rows in the range (others are unchanged)
+    ///
+    void findValueRange(int field, int minValue, int maxValue, RowBitmap& rows) const;
+
+    ///
+    /// Normalize a directory path for comparison: repeated and trailing slashes and
+    /// "." components are removed and ".." components are resolved lexically
+    ///
+    static std::string normalizeDirectory(const std::string& dir);
+
+    ///
+    /// Find the record of a scan directory, using a hash index of the normalized
+    /// directories
+    /// \param dir Full scan directory
+    /// \return Row of the first record with that directory, or -1 if there is none
+    ///
+    int findDirectory(const std::string& dir) const;
+
+    ///
+    /// Find the records of a Patient ID (MRID), by binary search of the sort order
+    /// \param patientID Patient ID
+    /// \param rows Output, rows of the records ordered by directory
+    ///
+    void findPatientID(const std::string& patientID, std::vector<int>& rows) const;
+
+    ///
+    /// Get the row at a position of the catalog sorted by Patient ID
+    ///
+    int getSortedRow(int position) const        {   return mSortedRowData[position];   }
+
+    ///
+    /// Compare two rows in sorted (Patient ID) order
+    /// \return Negative, zero or positive as with strcmp
+    ///
+    int compareRows(int row1, int row2) const;
+
+    ///
+    /// Get the free-text index over Patient ID, name and scan names
+    ///
+    const MRIDTextIndex& getTextIndex() const   {   return mTextIndex;  }
+
+protected:
+
+    ///
+    /// Read-only view of an array that is either owned by the catalog or mapped
+    /// from a snapshot file
+    ///
+    template <typename T>
+    class Array
+    {
+    public:
+        Array() :
+            mData(NULL),
+            mSize(0)
+        {
+        }
+
+        void bind(const T *data, size_t size)
+        {
+            mData = data;
+            mSize = size;
+        }
+
+        void bind(const std::vector<T>& values)
+        {
+            bind(values.empty() ? NULL : &values[0], values.size());
+        }
+
+        const T& operator[](size_t index) const     {   return mData[index];    }
+        size_t size() const                         {   return mSize;   }
+        const T* data() const                       {   return mData;   }
+
+    private:
+        const T *mData;
+        size_t mSize;
+    };
+
+    ///
+    /// Clear all of the catalog data
+    ///
+    void clear();
+
+    ///
+    /// Append a string to the string table without interning it
+    /// \return Id of the new string
+    ///
+    int addString(const std::string& str);
+
+    ///
+    /// Add a string to the string table, sharing storage with any identical
+    /// interned string
+    /// \return Id of the string
+    ///
+    int internString(const std::string& str);
+
+    ///
+    /// Append a single parsed <PatientRecord> to the catalog
+    ///
+    void parseRecord(const XMLRecordParser& parser, size_t record, const std::string& dicomDir);
+
+    ///
+    /// Append a copy of a record from another catalog
+    ///
+    void copyRecord(const MRIDCatalog& other, int row);
+
+    ///
+    /// Get the key that identifies a record across reloads
+    ///
+    std::string getRecordKey(int row) const;
+
+    ///
+    /// Sort the rows by Patient ID
+    ///
+    void buildSortedRows();
+
+    ///
+    /// Build the list of interned string ids sorted by value
+    ///
+    void buildInternedIds();
+
+    ///
+    /// Parse the typed value columns and sort their permutations
+    ///
+    void buildValues();
+
+    ///
+    /// Build the hash index of normalized directories
+    ///
+    void buildDirectoryIndex();
+
+    ///
+    /// Point the array views at the arrays owned by the catalog
+    ///
+    void bindArrays();
+
+    ///
+    /// Unmap the snapshot file, if one is mapped
+    ///
+    void unmapSnapshot();
+
+    ///
+    /// Append a value to a single valued column
+    ///
+    void addField(int field, const std::string& value);
+
+    ///
+    /// Read a single valued field from a parsed record into a column
+    ///
+    void readField(const XMLRecordParser& parser, size_t record, int field,
+                   const std::string& errorReplaceStr = "", const std::string& prependStr = "");
+
+    ///
+    /// Read a series of like-named elements of a parsed record into a multi-valued list
+    ///
+    void readList(const XMLRecordParser& parser, size_t record, int list);
+
+protected:
+
+    /// Number of records
+    int mNumRecords;
+
+    /// Number of records parsed by the last load (the rest were copied)
+    int mNumParsedRecords;
+
+    /// DICOM directory the catalog was loaded against
+    std::string mDicomDir;
+
+    //
+    //  Arrays owned by the catalog when it is loaded from XML
+    //
+
+    /// Byte offset of each record in dcm_MRID.xml
+    std::vector<boost::uint64_t> mRecordOffsets;
+
+    /// Hash of the XML text of each record
+    std::vector<boost::uint64_t> mRecordHashes;
+
+    /// Single valued columns of string ids, indexed by MRIBrowser::MRIFieldEnum
+    std::vector<int> mColumns[MRIBrowser::NUM_FIELDS];
+
+    /// Whether each column is interned
+    static const bool mInternField[MRIBrowser::NUM_FIELDS];
+
+    /// Type of the typed value column of each field
+    static const ValueTypeEnum mValueType[MRIBrowser::NUM_FIELDS];
+
+    /// Typed value columns, empty for fields without one
+    std::vector<int> mValues[MRIBrowser::NUM_FIELDS];
+
+    /// Rows with a valid typed value sorted by value, empty for fields without one
+    std::vector<int> mValueOrder[MRIBrowser::NUM_FIELDS];
+
+    /// Multi-valued list offsets (mNumRecords + 1 entries), indexed by ListEnum
+    std::vector<int> mListOffsets[NUM_LISTS];
+
+    /// Multi-valued list string ids, indexed by ListEnum
+    std::vector<int> mListValues[NUM_LISTS];
+
+    /// NUL terminated string data
+    std::vector<char> mStringData;
+
+    /// Offset of each string in mStringData (one extra entry marks the end)
+    std::vector<int> mStringOffsets;
+
+    /// Map of interned strings to their ids, only used while loading
+    boost::unordered_map<std::string, int> mInternedStrings;
+
+    /// Interned string ids sorted by value
+    std::vector<int> mInternedIds;
+
+    /// Rows sorted by Patient ID, shared by every session's view of the catalog
+    std::vector<int> mSortedRows;
+
+    //
+    //  Views of the arrays, either the ones above or the mapped snapshot
+    //
+
+    /// View of mRecordOffsets
+    Array<boost::uint64_t> mRecordOffsetData;
+
+    /// View of mRecordHashes
+    Array<boost::uint64_t> mRecordHashData;
+
+    /// View of mColumns
+    Array<int> mColumnData[MRIBrowser::NUM_FIELDS];
+
+    /// View of mValues
+    Array<int> mValueData[MRIBrowser::NUM_FIELDS];
+
+    /// View of mValueOrder
+    Array<int> mValueOrderData[MRIBrowser::NUM_FIELDS];
+
+    /// View of mListOffsets
+    Array<int> mListOffsetData[NUM_LISTS];
+
+    /// View of mListValues
+    Array<int> mListValueData[NUM_LISTS];
+
+    /// View of mStringData
+    Array<char> mStringCharData;
+
+    /// View of mStringOffsets
+    Array<int> mStringOffsetData;
+
+    /// View of mInternedIds
+    Array<int> mInternedIdData;
+
+    /// View of mSortedRows
+    Array<int> mSortedRowData;
+
+    /// Mapped snapshot file, NULL if the catalog was loaded from XML
+    void *mSnapshotData;
+
+    /// Size of the mapped snapshot file
+    size_t mSnapshotSize;
+
+    /// Free-text search index
+    MRIDTextIndex mTextIndex;
+
+    /// Row of each normalized directory
+    boost::unordered_map<std::string, int> mDirectoryRows;
+};
+
+#endif // MRIDCATALOG_H
@@ -0,0 +1,188 @@
+//
+//
+//  Description:
+//      Implementation of the process-wide MRID catalog cache.  Every session shares the
+//      same immutable MRIDCatalog snapshot through a reference-counted pointer.  When
+//      dcm_MRID.xml changes on disk a new snapshot is loaded incrementally from the
+//      previous one and swapped in; sessions that still hold the old snapshot keep
+//      using it until they refresh.
+//
+//      Each catalog is also saved to a binary snapshot file next to dcm_MRID.xml.  On
+//      startup the snapshot is mapped into memory instead of parsing the XML, as long
+//      as it was written for the current version of the XML file.  Saving is done in
+//      a background thread so that no session waits on it.
+//
+//  Author:
+//      Dan Ginsburg
+//
+//  Children's Hospital Boston
+//  GPL v2
+//
+#include "MRIDCatalogCache.h"
+#include "MRIDCatalog.h"
+#include <Wt/WApplication>
+#include <Wt/WLogger>
+#include <boost/thread/thread.hpp>
+#include <boost/bind.hpp>
+
+///
+//  Namespaces
+//
+using namespace Wt;
+using namespace std;
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Constructor/Destructor
+//
+//
+
+///
+//  Constructor
+//
+MRIDCatalogCache::MRIDCatalogCache()
+{
+}
+
+///
+//  Destructor
+//
+MRIDCatalogCache::~MRIDCatalogCache()
+{
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Public Members
+//
+//
+
+///
+//  Get the process-wide cache instance
+//
+MRIDCatalogCache& MRIDCatalogCache::instance()
+{
+    static MRIDCatalogCache cache;
+    return cache;
+}
+
+///
+//  Get the current catalog for an MRID XML file
+//
+boost::shared_ptr<const MRIDCatalog> MRIDCatalogCache::getCatalog(const std::string& mridXMLFile, const std::string& dicomDir)
+{
+    // A missing file has an all zero version, the load reports the error
+    MRIDCatalog::SourceVersion source;
+    MRIDCatalog::getSourceVersion(mridXMLFile, source);
+
+    // Fast path: the cached snapshot is still current
+    {
+        boost::mutex::scoped_lock lock(mEntriesMutex);
+        std::map<std::string, CacheEntry>::const_iterator iter = mEntries.find(mridXMLFile);
+        if (iter != mEntries.end() &&
+            MRIDCatalog::isSameVersion(iter->second.mSource, source))
+        {
+            return iter->second.mCatalog;
+        }
+    }
+
+    // Only one session loads at a time.  Anyone who was waiting on the load
+    // picks up the snapshot that was just built rather than parsing again.
+    boost::mutex::scoped_lock loadLock(mLoadMutex);
+    boost::shared_ptr<const MRIDCatalog> previous;
+    {
+        boost::mutex::scoped_lock lock(mEntriesMutex);
+        std::map<std::string, CacheEntry>::const_iterator iter = mEntries.find(mridXMLFile);
+        if (iter != mEntries.end())
+        {
+            if (MRIDCatalog::isSameVersion(iter->second.mSource, source))
+            {
+                return iter->second.mCatalog;
+            }
+
+            previous = iter->second.mCatalog;
+        }
+    }
+
+    boost::shared_ptr<MRIDCatalog> catalog(new MRIDCatalog());
+    std::string snapshotFile = getSnapshotFile(mridXMLFile);
+
+    // On first use, map the snapshot if it is current rather than parsing the XML
+    if (previous == NULL && catalog->loadSnapshot(snapshotFile, dicomDir, source))
+    {
+        WApplication::instance()->log("info") << "Mapped MRID catalog snapshot " << snapshotFile << " ("
+                                              << catalog->getNumRecords() << " records)";
+    }
+    else
+    {
+        // Records that did not change are copied from the previous snapshot, only new
+        // and modified records are parsed
+        if (catalog->loadFromFile(mridXMLFile, dicomDir, previous.get()))
+        {
+            startSnapshotSave(catalog, snapshotFile, source);
+        }
+
+        WApplication::instance()->log("info") << "Loaded MRID catalog " << mridXMLFile << " ("
+                                              << catalog->getNumRecords() << " records, "
+                                              << catalog->getNumParsedRecords() << " parsed)";
+    }
+
+    // Swap in the new snapshot.  Sessions holding the previous snapshot keep
+    // their reference until they refresh.
+    CacheEntry entry;
+    entry.mCatalog = catalog;
+    entry.mSource = source;
+
+    boost::mutex::scoped_lock lock(mEntriesMutex);
+    mEntries[mridXMLFile] = entry;
+
+    return entry.mCatalog;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Private Members
+//
+//
+
+///
+//  Get the snapshot file for an MRID XML file
+//
+std::string MRIDCatalogCache::getSnapshotFile(const std::string& mridXMLFile)
+{
+    return mridXMLFile + ".snapshot";
+}
+
+///
+//  Start saving the snapshot of a catalog in a background thread
+//
+void MRIDCatalogCache::startSnapshotSave(boost::shared_ptr<const MRIDCatalog> catalog, const std::string& snapshotFile,
+                                         const MRIDCatalog::SourceVersion& source)
+{
+    {
+        boost::mutex::scoped_lock lock(mSnapshotMutex);
+        if (!mPendingSnapshots.insert(snapshotFile).second)
+        {
+            // A stale snapshot is only a missed shortcut, it is never used for the
+            // wrong version of the XML file
+            return;
+        }
+    }
+
+    // The thread holds its own reference to the catalog and runs detached
+    boost::thread(boost::bind(&MRIDCatalogCache::saveSnapshot, this, catalog, snapshotFile, source));
+}
+
+///
+//  Save the snapshot of a catalog (background thread)
+//
+void MRIDCatalogCache::saveSnapshot(boost::shared_ptr<const MRIDCatalog> catalog, const std::string& snapshotFile,
+                                    const MRIDCatalog::SourceVersion& source)
+{
+    // There is no session to log to from here.  If the directory is not writable the
+    // snapshot is simply missing and the XML is parsed on the next start.
+    catalog->saveSnapshot(snapshotFile, source);
+
+    boost::mutex::scoped_lock lock(mSnapshotMutex);
+    mPendingSnapshots.erase(snapshotFile);
+}
@@ -0,0 +1,108 @@
+//
+//
+//  Description:
+//      Definition of the process-wide MRID catalog cache.  Every session shares the
+//      same immutable MRIDCatalog snapshot through a reference-counted pointer.  When
+//      dcm_MRID.xml changes on disk a new snapshot is loaded and swapped in; sessions
+//      that still hold the old snapshot keep using it until they refresh.
+//
+//      Each catalog is also saved to a binary snapshot file next to dcm_MRID.xml.  On
+//      startup the snapshot is mapped into memory instead of parsing the XML, as long
+//      as it was written for the current version of the XML file.
+//
+//  Author:
+//      Dan Ginsburg
+//
+//  Children's Hospital Boston
+//  GPL v2
+//
+#ifndef MRIDCATALOGCACHE_H
+#define MRIDCATALOGCACHE_H
+
+#include "MRIDCatalog.h"
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <map>
+#include <set>
+#include <string>
+
+///
+/// \class MRIDCatalogCache
+/// \brief Singleton that holds the shared MRIDCatalog snapshot for each dcm_MRID.xml file
+///
+class MRIDCatalogCache
+{
+public:
+
+    ///
+    /// Get the process-wide cache instance
+    ///
+    static MRIDCatalogCache& instance();
+
+    ///
+    /// Get the current catalog for an MRID XML file.  The file is loaded on first
+    /// use and reloaded whenever its modification time, inode or size change.
+    /// \param mridXMLFile Full path to dcm_MRID.xml
+    /// \param dicomDir Base DICOM directory
+    /// \return Shared catalog snapshot (never NULL, empty if the file could not be read)
+    ///
+    boost::shared_ptr<const MRIDCatalog> getCatalog(const std::string& mridXMLFile, const std::string& dicomDir);
+
+private:
+
+    ///
+    /// Constructor
+    ///
+    MRIDCatalogCache();
+
+    ///
+    /// Destructor
+    ///
+    virtual ~MRIDCatalogCache();
+
+    ///
+    /// Get the snapshot file for an MRID XML file
+    ///
+    static std::string getSnapshotFile(const std::string& mridXMLFile);
+
+    ///
+    /// Start saving the snapshot of a catalog in a background thread, unless a
+    /// save of the same snapshot file is already running
+    ///
+    void startSnapshotSave(boost::shared_ptr<const MRIDCatalog> catalog, const std::string& snapshotFile,
+                           const MRIDCatalog::SourceVersion& source);
+
+    ///
+    /// Save the snapshot of a catalog (background thread)
+    ///
+    void saveSnapshot(boost::shared_ptr<const MRIDCatalog> catalog, const std::string& snapshotFile,
+                      const MRIDCatalog::SourceVersion& source);
+
+    /// Cached catalog for a single file
+    typedef struct
+    {
+        /// Current snapshot
+        boost::shared_ptr<const MRIDCatalog> mCatalog;
+
+        /// Version of the file the snapshot was loaded from
+        MRIDCatalog::SourceVersion mSource;
+
+    } CacheEntry;
+
+    /// Cached catalogs, keyed by file path
+    std::map<std::string, CacheEntry> mEntries;
+
+    /// Mutex protecting mEntries
+    boost::mutex mEntriesMutex;
+
+    /// Mutex serializing loads, so that only one session parses a changed file
+    boost::mutex mLoadMutex;
+
+    /// Snapshot files that are being saved
+    std::set<std::string> mPendingSnapshots;
+
+    /// Mutex protecting mPendingSnapshots
+    boost::mutex mSnapshotMutex;
+};
+
+#endif // MRIDCATALOGCACHE_H
@@ -0,0 +1,496 @@
+//
+//
+//  Description:
+//      Implementation of the MRID catalog model.  This is a lazy, per-session item model
+//      over the shared MRIDCatalog snapshot.  The only per-session state is the list of
+//      catalog rows that pass the session's filters, in sorted order; every data()
+//      request is answered directly from the catalog columns, so rows are only
+//      materialized for the part of the list that a view actually renders.
+//
+//  Author:
+//      Dan Ginsburg
+//
+//  Children's Hospital Boston
+//  GPL v2
+//
+#include "PipelineApp.h"
+#include "ConfigOptions.h"
+#include "MRIDCatalogModel.h"
+#include "MRIDCatalog.h"
+#include "MRIDVisibilityCache.h"
+#include "MRIBrowser.h"
+#include "ProjectFilter.h"
+#include "ProjectXML.h"
+#include <Wt/WApplication>
+#include <Wt/WLogger>
+#include <Wt/WString>
+#include <sstream>
+#include <string.h>
+
+///
+//  Namespaces
+//
+using namespace Wt;
+using namespace std;
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Constructor/Destructor
+//
+//
+
+///
+//  Constructor
+//
+MRIDCatalogModel::MRIDCatalogModel(WObject *parent) :
+    WAbstractTableModel(parent)
+{
+    mProjectFilter = new ProjectFilter();
+}
+
+///
+//  Destructor
+//
+MRIDCatalogModel::~MRIDCatalogModel()
+{
+    delete mProjectFilter;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Public Members
+//
+//
+
+///
+//  Set the catalog that backs the model, resetting the model
+//
+void MRIDCatalogModel::setCatalog(boost::shared_ptr<const MRIDCatalog> catalog)
+{
+    mCatalog = catalog;
+
+    updateProjectRows();
+    updateVisibleRows();
+    updateSearchRows();
+
+    refilter();
+}
+
+///
+//  Move the model to a newer snapshot of the catalog
+//
+void MRIDCatalogModel::updateCatalog(boost::shared_ptr<const MRIDCatalog> catalog)
+{
+    if (catalog == mCatalog)
+    {
+        return;
+    }
+
+    if (mCatalog == NULL || catalog == NULL)
+    {
+        setCatalog(catalog);
+        return;
+    }
+
+    boost::shared_ptr<const MRIDCatalog> previous = mCatalog;
+    MRIDCatalog::Delta delta;
+    catalog->computeDelta(*previous, delta);
+
+    // Work out the new list of rows with the filters evaluated over the new catalog
+    mCatalog = catalog;
+    updateProjectRows();
+    updateVisibleRows();
+    updateSearchRows();
+
+    std::vector<int> newRows;
+    buildRows(newRows);
+
+    std::vector<char> inNewRows(catalog->getNumRecords(), 0);
+    for (size_t i = 0; i < newRows.size(); i++)
+    {
+        inNewRows[newRows[i]] = 1;
+    }
+
+    // A current row is kept if its record is still present, still passes the filters
+    // and still sorts the same way.  The kept rows are then already in the same
+    // relative order as the new list.
+    std::vector<char> keep(mRows.size(), 0);
+    std::vector<int> keptRows;
+    for (size_t i = 0; i < mRows.size(); i++)
+    {
+        int row = delta.mRowMap[mRows[i]];
+        if (row >= 0 && inNewRows[row] &&
+            strcmp(previous->getField(mRows[i], MRIBrowser::PATIENT_ID), catalog->getField(row, MRIBrowser::PATIENT_ID)) == 0)
+        {
+            keep[i] = 1;
+            keptRows.push_back(row);
+        }
+    }
+
+    size_t kept = 0;
+    for (size_t i = 0; i < newRows.size() && kept < keptRows.size(); i++)
+    {
+        if (newRows[i] == keptRows[kept])
+        {
+            kept++;
+        }
+    }
+
+    if (kept != keptRows.size())
+    {
+        // Rows with equal sort keys changed order, fall back to a reset
+        mRows.swap(newRows);
+        reset();
+        return;
+    }
+
+    // Remove rows from the bottom up and in contiguous runs so that the remaining
+    // model rows stay valid.  mRows still holds rows of the previous catalog, which
+    // stays installed until the removals are done in case the views read them.
+    mCatalog = previous;
+    int modelRow = (int)mRows.size() - 1;
+    while (modelRow >= 0)
+    {
+        if (keep[modelRow])
+        {
+            modelRow--;
+            continue;
+        }
+
+        int last = modelRow;
+        while (modelRow > 0 && !keep[modelRow - 1])
+        {
+            modelRow--;
+        }
+
+        beginRemoveRows(WModelIndex(), modelRow, last);
+        mRows.erase(mRows.begin() + modelRow, mRows.begin() + last + 1);
+        endRemoveRows();
+
+        modelRow--;
+    }
+    mCatalog = catalog;
+    mRows = keptRows;
+
+    // Insert the new rows at their sorted positions, in contiguous runs
+    size_t next = 0;
+    kept = 0;
+    while (next < newRows.size())
+    {
+        if (kept < keptRows.size() && newRows[next] == keptRows[kept])
+        {
+            next++;
+            kept++;
+            continue;
+        }
+
+        size_t first = next;
+        while (next < newRows.size() && !(kept < keptRows.size() && newRows[next] == keptRows[kept]))
+        {
+            next++;
+        }
+
+        beginInsertRows(WModelIndex(), (int)first, (int)next - 1);
+        mRows.insert(mRows.begin() + first, newRows.begin() + first, newRows.begin() + next);
+        endInsertRows();
+    }
+
+    // Signal the records that changed but kept their place
+    if (!delta.mUpdated.empty())
+    {
+        std::vector<int> modelRows(mCatalog->getNumRecords(), -1);
+        for (size_t i = 0; i < mRows.size(); i++)
+        {
+            modelRows[mRows[i]] = (int)i;
+        }
+
+        for (size_t i = 0; i < delta.mUpdated.size(); i++)
+        {
+            int updatedRow = modelRows[delta.mUpdated[i]];
+            if (updatedRow >= 0)
+            {
+                dataChanged().emit(index(updatedRow, 0), index(updatedRow, 0));
+            }
+        }
+    }
+}
+
+///
+//  Set filter file - a file that specifies a set of patterns to filter the list of MRIs
+//
+void MRIDCatalogModel::setFilterFile(const std::string& path)
+{
+    mProjectFilter->clear();
+
+    if (path != "")
+    {
+        ProjectXML projectXML;
+
+        if (projectXML.loadFromFile(path))
+        {
+            // Compile the search terms once, they are evaluated over the whole catalog
+            // in a single pass rather than row by row
+            mProjectFilter->compile(projectXML);
+        }
+        else
+        {
+            WApplication::instance()->log("error") << "Cound not open/parse project XML file: " << path;
+        }
+    }
+
+    updateProjectRows();
+    refilter();
+}
+
+///
+//  Set the user that rows are filtered for (user/group access)
+//
+void MRIDCatalogModel::setCurrentUser(const std::string& userName)
+{
+    mUserName = userName;
+
+    updateVisibleRows();
+    refilter();
+}
+
+///
+//  Set the search text entered by the user, empty for no search
+//
+void MRIDCatalogModel::setSearchText(const std::string& searchText)
+{
+    mSearchText = searchText;
+
+    updateSearchRows();
+    refilter();
+}
+
+///
+//  Whether a catalog row passes the project and user filters
+//
+bool MRIDCatalogModel::isRowAvailable(int row) const
+{
+    if (mCatalog == NULL || mCatalog->getFieldId(row, MRIBrowser::PATIENT_ID) == MRIDCatalog::EMPTY_STRING_ID)
+        return false;
+
+    // First, see if it matches anything in the project filter search criteria
+    if (!mProjectRows.test(row))
+        return false;
+
+    // Next, see if it matches on the user/group access
+    if (!mVisibleRows->test(row))
+        return false;
+
+    return true;
+}
+
+///
+//  Return the number of columns
+//
+int MRIDCatalogModel::columnCount(const WModelIndex& parent) const
+{
+    return parent.isValid() ? 0 : 1;
+}
+
+///
+//  Return the number of rows
+//
+int MRIDCatalogModel::rowCount(const WModelIndex& parent) const
+{
+    if (parent.isValid() || mCatalog == NULL)
+    {
+        return 0;
+    }
+
+    return (int)mRows.size();
+}
+
+///
+//  Return the data for an index in the given role
+//
+boost::any MRIDCatalogModel::data(const WModelIndex& index, int role) const
+{
+    if (!index.isValid() || mCatalog == NULL || index.row() >= (int)mRows.size())
+    {
+        return boost::any();
+    }
+
+    int row = mRows[index.row()];
+
+    switch (role)
+    {
+    case DisplayRole:
+        return stringData(row, MRIBrowser::PATIENT_ID);
+    case DecorationRole:
+        return boost::any(std::string("icons/folder.gif"));
+    case MRIBrowser::DIR_ROLE:
+        return stringData(row, MRIBrowser::DIRECTORY);
+    case MRIBrowser::AGE_ROLE:
+        return stringData(row, MRIBrowser::AGE);
+    case MRIBrowser::NAME_ROLE:
+        return stringData(row, MRIBrowser::NAME);
+    case MRIBrowser::SEX_ROLE:
+        return stringData(row, MRIBrowser::SEX);
+    case MRIBrowser::BIRTHDAY_ROLE:
+        return stringData(row, MRIBrowser::BIRTHDAY);
+    case MRIBrowser::SCANDATE_ROLE:
+        return stringData(row, MRIBrowser::SCANDATE);
+    case MRIBrowser::MANUFACTURER_ROLE:
+        return stringData(row, MRIBrowser::MANUFACTURER);
+    case MRIBrowser::MODEL_ROLE:
+        return stringData(row, MRIBrowser::MODEL);
+    case MRIBrowser::SOFTWARE_VER_ROLE:
+        return stringData(row, MRIBrowser::SOFTWARE_VER);
+    case MRIBrowser::SCANS_ROLE:
+        {
+            int numScans = mCatalog->getListSize(row, MRIDCatalog::SCAN_LIST);
+            if (numScans == 0)
+            {
+                return boost::any();
+            }
+
+            std::string scans;
+            for (int i = 0; i < numScans; i++)
+            {
+                if (i > 0)
+                {
+                    scans += ", ";
+                }
+                scans += mCatalog->getListValue(row, MRIDCatalog::SCAN_LIST, i);
+            }
+            return boost::any(WString::fromUTF8(scans));
+        }
+    default:
+        break;
+    }
+
+    return boost::any();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Protected Members
+//
+//
+
+///
+//  Return a single valued field as model data, empty if the field is not set
+//
+boost::any MRIDCatalogModel::stringData(int row, int field) const
+{
+    int id = mCatalog->getFieldId(row, field);
+    if (id == MRIDCatalog::EMPTY_STRING_ID)
+    {
+        return boost::any();
+    }
+
+    return boost::any(WString::fromUTF8(mCatalog->getString(id)));
+}
+
+///
+//  Evaluate the project filter over the current catalog
+//
+void MRIDCatalogModel::updateProjectRows()
+{
+    if (mCatalog == NULL)
+    {
+        mProjectRows.reset(0);
+        return;
+    }
+
+    mProjectFilter->evaluate(*mCatalog, mProjectRows);
+}
+
+///
+//  Look up the rows visible to the current user in the current catalog
+//
+void MRIDCatalogModel::updateVisibleRows()
+{
+    if (mCatalog == NULL)
+    {
+        mVisibleRows.reset();
+        return;
+    }
+
+    // The visible rows for the user are computed once per catalog and permissions file
+    // and shared between sessions
+    mVisibleRows = MRIDVisibilityCache::instance().getVisibleRows(mUserName, mCatalog,
+                                                                  getConfigOptionsPtr()->GetPermissionsFile(),
+                                                                  getConfigOptionsPtr()->GetAdminGroup());
+}
+
+///
+//  Evaluate the search text over the current catalog
+//
+void MRIDCatalogModel::updateSearchRows()
+{
+    if (mCatalog == NULL || mSearchText.empty())
+    {
+        mSearchRows.reset(0);
+        return;
+    }
+
+    mSearchRows.reset(mCatalog->getNumRecords(), false);
+
+    //
+    // Break search pattern into multiple tokens separated by spaces, a row
+    // matches if any of the tokens matches
+    //
+    istringstream istr(mSearchText, ios_base::out);
+    std::string curSearchPattern;
+    while (getline(istr, curSearchPattern, ' '))
+    {
+        if (curSearchPattern != "" && curSearchPattern != " " && curSearchPattern != "\n")
+        {
+            mCatalog->getTextIndex().findRows(*mCatalog, curSearchPattern, mSearchRows);
+        }
+    }
+}
+
+///
+//  Whether a catalog row passes all of the filters
+//
+bool MRIDCatalogModel::acceptRow(int row) const
+{
+    if (!isRowAvailable(row))
+        return false;
+
+    // Finally, if the user provided a filter in the UI, match on final
+    // user specified filter
+    if (!mSearchText.empty() && !mSearchRows.test(row))
+        return false;
+
+    return true;
+}
+
+///
+//  Build the sorted list of catalog rows that pass all of the filters
+//
+void MRIDCatalogModel::buildRows(std::vector<int>& rows) const
+{
+    rows.clear();
+
+    if (mCatalog == NULL)
+    {
+        return;
+    }
+
+    // Walking the catalog's shared sort order keeps the result sorted
+    int numRecords = mCatalog->getNumRecords();
+    for (int i = 0; i < numRecords; i++)
+    {
+        int row = mCatalog->getSortedRow(i);
+        if (acceptRow(row))
+        {
+            rows.push_back(row);
+        }
+    }
+}
+
+///
+//  Rebuild the rows after a filter changed, resetting the model
+//
+void MRIDCatalogModel::refilter()
+{
+    buildRows(mRows);
+    reset();
+}
@@ -0,0 +1,170 @@
+//
+//
+//  Description:
+//      Definition of the MRID catalog model.  This is a lazy, per-session item model
+//      over the shared MRIDCatalog snapshot.  The only per-session state is the list of
+//      catalog rows that pass the session's filters, in sorted order; every data()
+//      request is answered directly from the catalog columns, so rows are only
+//      materialized for the part of the list that a view actually renders.
+//
+//  Author:
+//      Dan Ginsburg
+//
+//  Children's Hospital Boston
+//  GPL v2
+//
+#ifndef MRIDCATALOGMODEL_H
+#define MRIDCATALOGMODEL_H
+
+#include <Wt/WAbstractTableModel>
+#include <boost/shared_ptr.hpp>
+#include <string>
+#include <vector>
+#include "RowBitmap.h"
+
+class MRIDCatalog;
+class ProjectFilter;
+
+using namespace Wt;
+
+///
+/// \class MRIDCatalogModel
+/// \brief Sorted, filtered item model view over a shared MRIDCatalog
+///
+class MRIDCatalogModel : public WAbstractTableModel
+{
+public:
+
+    ///
+    /// Constructor
+    ///
+    MRIDCatalogModel(WObject *parent = 0);
+
+    ///
+    /// Destructor
+    ///
+    virtual ~MRIDCatalogModel();
+
+    ///
+    /// Set the catalog that backs the model, resetting the model
+    ///
+    void setCatalog(boost::shared_ptr<const MRIDCatalog> catalog);
+
+    ///
+    /// Move the model to a newer snapshot of the catalog.  Only the rows that were
+    /// inserted, updated or deleted are signalled, so views keep their state.
+    ///
+    void updateCatalog(boost::shared_ptr<const MRIDCatalog> catalog);
+
+    ///
+    /// Get the catalog that backs the model
+    ///
+    const boost::shared_ptr<const MRIDCatalog>& getCatalog() const  {   return mCatalog;    }
+
+    ///
+    /// Get the catalog row displayed in a model row
+    ///
+    int getCatalogRow(int modelRow) const       {   return mRows[modelRow];    }
+
+    ///
+    /// Set filter file - a file that specifies a set of patterns to filter the list of MRIs
+    ///
+    void setFilterFile(const std::string& path);
+
+    ///
+    /// Set the user that rows are filtered for (user/group access)
+    ///
+    void setCurrentUser(const std::string& userName);
+
+    ///
+    /// Set the search text entered by the user, empty for no search.  Multiple
+    /// search expressions are separated by spaces.
+    ///
+    void setSearchText(const std::string& searchText);
+
+    ///
+    /// Whether a catalog row passes the project and user filters, regardless of the
+    /// search text
+    ///
+    bool isRowAvailable(int row) const;
+
+    ///
+    /// Return the number of columns
+    ///
+    virtual int columnCount(const WModelIndex& parent = WModelIndex()) const;
+
+    ///
+    /// Return the number of rows
+    ///
+    virtual int rowCount(const WModelIndex& parent = WModelIndex()) const;
+
+    ///
+    /// Return the data for an index in the given role
+    ///
+    virtual boost::any data(const WModelIndex& index, int role = DisplayRole) const;
+
+protected:
+
+    ///
+    /// Return a single valued field as model data, empty if the field is not set
+    ///
+    boost::any stringData(int row, int field) const;
+
+    ///
+    /// Evaluate the project filter over the current catalog
+    ///
+    void updateProjectRows();
+
+    ///
+    /// Look up the rows visible to the current user in the current catalog
+    ///
+    void updateVisibleRows();
+
+    ///
+    /// Evaluate the search text over the current catalog
+    ///
+    void updateSearchRows();
+
+    ///
+    /// Whether a catalog row passes all of the filters
+    ///
+    bool acceptRow(int row) const;
+
+    ///
+    /// Build the sorted list of catalog rows that pass all of the filters
+    ///
+    void buildRows(std::vector<int>& rows) const;
+
+    ///
+    /// Rebuild the rows after a filter changed, resetting the model
+    ///
+    void refilter();
+
+protected:
+
+    /// Shared catalog snapshot
+    boost::shared_ptr<const MRIDCatalog> mCatalog;
+
+    /// Catalog row of each model row, in sorted order
+    std::vector<int> mRows;
+
+    /// Project file search terms compiled against the catalog
+    ProjectFilter *mProjectFilter;
+
+    /// Rows of the catalog that pass the project filter
+    RowBitmap mProjectRows;
+
+    /// User that rows are filtered for
+    std::string mUserName;
+
+    /// Rows of the catalog visible to the user
+    boost::shared_ptr<const RowBitmap> mVisibleRows;
+
+    /// Search text entered by the user
+    std::string mSearchText;
+
+    /// Rows of the catalog that match the search text
+    RowBitmap mSearchRows;
+};
+
+#endif // MRIDCATALOGMODEL_H
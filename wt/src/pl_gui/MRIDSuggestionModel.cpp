@@ -0,0 +1,156 @@
+//
+//
+//  Description:
+//      Implementation of the MRID suggestion model.  Supplies the completions for the
+//      MRID search popup.  The popup asks for the completions of what the user has
+//      typed so far and the model answers with at most a fixed number of Patient IDs,
+//      patient names and scan names starting with it, found by prefix search of the
+//      catalog's text index.  Only records the user can see in the MRID list are
+//      suggested.
+//
+//  Author:
+//      Dan Ginsburg
+//
+//  Children's Hospital Boston
+//  GPL v2
+//
+#include "MRIDSuggestionModel.h"
+#include "MRIDCatalog.h"
+#include "MRIDCatalogModel.h"
+#include "MRIDTextIndex.h"
+#include <string.h>
+
+///
+//  Namespaces
+//
+using namespace Wt;
+using namespace std;
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Constructor/Destructor
+//
+//
+
+///
+//  Constructor
+//
+MRIDSuggestionModel::MRIDSuggestionModel(MRIDCatalogModel *catalogModel, int maxSuggestions, WObject *parent) :
+    WAbstractTableModel(parent),
+    mCatalogModel(catalogModel),
+    mMaxSuggestions(maxSuggestions),
+    mPartial(false)
+{
+}
+
+///
+//  Destructor
+//
+MRIDSuggestionModel::~MRIDSuggestionModel()
+{
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Public Members
+//
+//
+
+///
+//  Fill the model with the completions of a prefix
+//
+void MRIDSuggestionModel::filter(const WString& prefix)
+{
+    mSuggestions.clear();
+    mPartial = false;
+
+    const boost::shared_ptr<const MRIDCatalog>& catalog = mCatalogModel->getCatalog();
+    std::string prefixStr = prefix.toUTF8();
+
+    if (catalog != NULL && !prefixStr.empty())
+    {
+        const MRIDTextIndex& textIndex = catalog->getTextIndex();
+        int first, last;
+        textIndex.findPrefix(prefixStr, first, last);
+
+        // Entries are in sorted order with identical strings next to each other, so
+        // duplicates (a Patient ID with several studies) only need comparing with the
+        // previous suggestion
+        for (int position = first; position < last; position++)
+        {
+            int entry = textIndex.getSortedEntry(position);
+            const char *str = catalog->getString(textIndex.getEntryStringId(entry));
+
+            if (!mSuggestions.empty() && mSuggestions.back() == str)
+            {
+                continue;
+            }
+
+            bool available = false;
+            for (int i = 0; i < textIndex.getEntryNumRows(entry) && !available; i++)
+            {
+                available = mCatalogModel->isRowAvailable(textIndex.getEntryRow(entry, i));
+            }
+
+            if (!available)
+            {
+                continue;
+            }
+
+            if ((int)mSuggestions.size() == mMaxSuggestions)
+            {
+                mPartial = true;
+                break;
+            }
+
+            mSuggestions.push_back(str);
+        }
+    }
+
+    reset();
+}
+
+///
+//  Return the number of columns
+//
+int MRIDSuggestionModel::columnCount(const WModelIndex& parent) const
+{
+    return parent.isValid() ? 0 : 1;
+}
+
+///
+//  Return the number of rows
+//
+int MRIDSuggestionModel::rowCount(const WModelIndex& parent) const
+{
+    return parent.isValid() ? 0 : (int)mSuggestions.size();
+}
+
+///
+//  Return the data for an index in the given role
+//
+boost::any MRIDSuggestionModel::data(const WModelIndex& index, int role) const
+{
+    if (!index.isValid() || index.row() >= (int)mSuggestions.size())
+    {
+        return boost::any();
+    }
+
+    switch (role)
+    {
+    case DisplayRole:
+        return boost::any(WString::fromUTF8(mSuggestions[index.row()]));
+    case StyleClassRole:
+        // Tells the popup that the list is truncated, so that it asks for the
+        // completions again as the user types more
+        if (mPartial && index.row() == (int)mSuggestions.size() - 1)
+        {
+            return boost::any(WString::fromUTF8("Wt-more-data"));
+        }
+        break;
+    default:
+        break;
+    }
+
+    return boost::any();
+}
@@ -0,0 +1,86 @@
+//
+//
+//  Description:
+//      Definition of the MRID suggestion model.  Supplies the completions for the MRID
+//      search popup.  The popup asks for the completions of what the user has typed
+//      so far and the model answers with at most a fixed number of Patient IDs,
+//      patient names and scan names starting with it, found by prefix search of the
+//      catalog's text index.  Only records the user can see in the MRID list are
+//      suggested.
+//
+//  Author:
+//      Dan Ginsburg
+//
+//  Children's Hospital Boston
+//  GPL v2
+//
+#ifndef MRIDSUGGESTIONMODEL_H
+#define MRIDSUGGESTIONMODEL_H
+
+#include <Wt/WAbstractTableModel>
+#include <Wt/WString>
+#include <string>
+#include <vector>
+
+class MRIDCatalogModel;
+
+using namespace Wt;
+
+///
+/// \class MRIDSuggestionModel
+/// \brief Bounded list of search completions for a WSuggestionPopup
+///
+class MRIDSuggestionModel : public WAbstractTableModel
+{
+public:
+
+    ///
+    /// Constructor
+    /// \param catalogModel Model of the MRID list, used for the catalog and for the
+    ///                     project and user filters
+    /// \param maxSuggestions Maximum number of suggestions returned for a prefix
+    /// \param parent Parent object
+    ///
+    MRIDSuggestionModel(MRIDCatalogModel *catalogModel, int maxSuggestions, WObject *parent = 0);
+
+    ///
+    /// Destructor
+    ///
+    virtual ~MRIDSuggestionModel();
+
+    ///
+    /// Fill the model with the completions of a prefix [slot for WSuggestionPopup::filterModel]
+    ///
+    void filter(const WString& prefix);
+
+    ///
+    /// Return the number of columns
+    ///
+    virtual int columnCount(const WModelIndex& parent = WModelIndex()) const;
+
+    ///
+    /// Return the number of rows
+    ///
+    virtual int rowCount(const WModelIndex& parent = WModelIndex()) const;
+
+    ///
+    /// Return the data for an index in the given role
+    ///
+    virtual boost::any data(const WModelIndex& index, int role = DisplayRole) const;
+
+private:
+
+    /// Model of the MRID list
+    MRIDCatalogModel *mCatalogModel;
+
+    /// Maximum number of suggestions
+    int mMaxSuggestions;
+
+    /// Current suggestions
+    std::vector<std::string> mSuggestions;
+
+    /// Whether there are more completions than mSuggestions holds
+    bool mPartial;
+};
+
+#endif // MRIDSUGGESTIONMODEL_H
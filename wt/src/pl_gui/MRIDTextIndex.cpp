@@ -0,0 +1,398 @@
+//
+//
+//  Description:
+//      Implementation of the MRID free-text index.  A trigram inverted index over the
+//      distinct Patient ID, patient name and scan name strings of an MRIDCatalog, used
+//      to answer substring searches without scanning every record.  The entries are
+//      also kept in sorted order to answer prefix searches for search suggestions.
+//
+//  Author:
+//      Dan Ginsburg
+//
+//  Children's Hospital Boston
+//  GPL v2
+//
+#include "MRIDTextIndex.h"
+#include "MRIDCatalog.h"
+#include "RowBitmap.h"
+#include <boost/regex.hpp>
+#include <algorithm>
+#include <iterator>
+#include <ctype.h>
+#include <string.h>
+
+///
+//  Namespaces
+//
+using namespace std;
+
+///
+//  Static helpers
+//
+
+///
+//  Pack three characters into a trigram key
+//
+static inline boost::uint32_t makeTrigram(const char* str)
+{
+    return ((boost::uint32_t)(unsigned char)str[0] << 16) |
+           ((boost::uint32_t)(unsigned char)str[1] << 8) |
+           ((boost::uint32_t)(unsigned char)str[2]);
+}
+
+///
+//  Lowercase a string
+//
+static std::string toLower(const char* str)
+{
+    std::string lower(str);
+    for (size_t i = 0; i < lower.size(); i++)
+    {
+        lower[i] = (char)tolower((unsigned char)lower[i]);
+    }
+    return lower;
+}
+
+///
+//  Sort order functor for index entries
+//
+class MRIDEntryLess
+{
+public:
+    MRIDEntryLess(const MRIDCatalog& catalog, const std::vector<int>& entryStringIds,
+                  const std::vector<char>& lowerText, const std::vector<int>& lowerOffsets) :
+        mCatalog(catalog),
+        mEntryStringIds(entryStringIds),
+        mLowerText(lowerText),
+        mLowerOffsets(lowerOffsets)
+    {
+    }
+
+    bool operator()(int entry1, int entry2) const
+    {
+        int result = strcmp(&mLowerText[mLowerOffsets[entry1]], &mLowerText[mLowerOffsets[entry2]]);
+        if (result != 0)
+        {
+            return result < 0;
+        }
+
+        // Keep strings that differ only in case apart, and identical strings together
+        return strcmp(mCatalog.getString(mEntryStringIds[entry1]), mCatalog.getString(mEntryStringIds[entry2])) < 0;
+    }
+
+private:
+    const MRIDCatalog& mCatalog;
+    const std::vector<int>& mEntryStringIds;
+    const std::vector<char>& mLowerText;
+    const std::vector<int>& mLowerOffsets;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Constructor/Destructor
+//
+//
+
+///
+//  Constructor
+//
+MRIDTextIndex::MRIDTextIndex()
+{
+    clear();
+}
+
+///
+//  Destructor
+//
+MRIDTextIndex::~MRIDTextIndex()
+{
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Public Members
+//
+//
+
+///
+//  Build the index for a catalog
+//
+void MRIDTextIndex::build(const MRIDCatalog& catalog)
+{
+    clear();
+
+    // Collect (string id, row) for every indexed string.  Scan names are interned, so
+    // indexing distinct strings rather than rows keeps the index small.
+    std::vector< std::pair<int, int> > stringRows;
+    for (int row = 0; row < catalog.getNumRecords(); row++)
+    {
+        int id = catalog.getFieldId(row, MRIBrowser::PATIENT_ID);
+        if (id != MRIDCatalog::EMPTY_STRING_ID)
+        {
+            stringRows.push_back(std::make_pair(id, row));
+        }
+
+        id = catalog.getFieldId(row, MRIBrowser::NAME);
+        if (id != MRIDCatalog::EMPTY_STRING_ID)
+        {
+            stringRows.push_back(std::make_pair(id, row));
+        }
+
+        int numScans = catalog.getListSize(row, MRIDCatalog::SCAN_LIST);
+        for (int scan = 0; scan < numScans; scan++)
+        {
+            id = catalog.getListId(row, MRIDCatalog::SCAN_LIST, scan);
+            if (id != MRIDCatalog::EMPTY_STRING_ID)
+            {
+                stringRows.push_back(std::make_pair(id, row));
+            }
+        }
+    }
+
+    std::sort(stringRows.begin(), stringRows.end());
+    stringRows.erase(std::unique(stringRows.begin(), stringRows.end()), stringRows.end());
+
+    // Build the entries and the rows that reference each entry
+    std::vector< std::pair<boost::uint32_t, int> > trigramEntries;
+    for (size_t i = 0; i < stringRows.size(); i++)
+    {
+        if (i == 0 || stringRows[i].first != stringRows[i - 1].first)
+        {
+            int entry = (int)mEntryStringIds.size();
+            if (entry > 0)
+            {
+                mEntryRowOffsets.push_back((int)mEntryRows.size());
+            }
+            mEntryStringIds.push_back(stringRows[i].first);
+
+            std::string lower = toLower(catalog.getString(stringRows[i].first));
+            mLowerOffsets.push_back((int)mLowerText.size());
+            mLowerText.insert(mLowerText.end(), lower.begin(), lower.end());
+            mLowerText.push_back('\0');
+
+            for (size_t c = 0; c + 3 <= lower.size(); c++)
+            {
+                trigramEntries.push_back(std::make_pair(makeTrigram(&lower[c]), entry));
+            }
+        }
+
+        mEntryRows.push_back(stringRows[i].second);
+    }
+    mEntryRowOffsets.push_back((int)mEntryRows.size());
+
+    // Sort the entries for prefix search
+    mSortedEntries.resize(mEntryStringIds.size());
+    for (size_t entry = 0; entry < mEntryStringIds.size(); entry++)
+    {
+        mSortedEntries[entry] = (int)entry;
+    }
+    std::sort(mSortedEntries.begin(), mSortedEntries.end(),
+              MRIDEntryLess(catalog, mEntryStringIds, mLowerText, mLowerOffsets));
+
+    // Build the posting lists
+    std::sort(trigramEntries.begin(), trigramEntries.end());
+    trigramEntries.erase(std::unique(trigramEntries.begin(), trigramEntries.end()), trigramEntries.end());
+
+    for (size_t i = 0; i < trigramEntries.size(); i++)
+    {
+        if (i == 0 || trigramEntries[i].first != trigramEntries[i - 1].first)
+        {
+            if (i > 0)
+            {
+                mPostingOffsets.push_back((int)mPostings.size());
+            }
+            mTrigrams.push_back(trigramEntries[i].first);
+        }
+
+        mPostings.push_back(trigramEntries[i].second);
+    }
+    mPostingOffsets.push_back((int)mPostings.size());
+}
+
+///
+//  Clear the index
+//
+void MRIDTextIndex::clear()
+{
+    mEntryStringIds.clear();
+    mEntryRowOffsets.clear();
+    mEntryRowOffsets.push_back(0);
+    mEntryRows.clear();
+    mLowerText.clear();
+    mLowerOffsets.clear();
+    mSortedEntries.clear();
+    mTrigrams.clear();
+    mPostingOffsets.clear();
+    mPostingOffsets.push_back(0);
+    mPostings.clear();
+}
+
+///
+//  Find the rows where the Patient ID, name or a scan name matches a search token
+//
+void MRIDTextIndex::findRows(const MRIDCatalog& catalog, const std::string& token, RowBitmap& rows) const
+{
+    if (token.empty())
+        return;
+
+    std::string lowerToken = toLower(token.c_str());
+    int numEntries = (int)mEntryStringIds.size();
+
+    // Regular expression: scan the distinct indexed strings, the same match that the
+    // search box has always done (whole string regex or case insensitive substring)
+    if (isRegExp(token))
+    {
+        boost::regex regExp;
+        bool validRegExp = true;
+        try
+        {
+            regExp.assign(token);
+        }
+        catch (boost::regex_error&)
+        {
+            validRegExp = false;
+        }
+
+        for (int entry = 0; entry < numEntries; entry++)
+        {
+            if ((validRegExp && boost::regex_match(catalog.getString(mEntryStringIds[entry]), regExp)) ||
+                strstr(getLowerText(entry), lowerToken.c_str()) != NULL)
+            {
+                addEntryRows(entry, rows);
+            }
+        }
+        return;
+    }
+
+    // Too short to have a trigram, verify every entry
+    if (lowerToken.size() < 3)
+    {
+        for (int entry = 0; entry < numEntries; entry++)
+        {
+            if (strstr(getLowerText(entry), lowerToken.c_str()) != NULL)
+            {
+                addEntryRows(entry, rows);
+            }
+        }
+        return;
+    }
+
+    // Gather the posting list for each trigram of the token, shortest first
+    std::vector< std::pair<int, const int*> > postingLists;
+    for (size_t c = 0; c + 3 <= lowerToken.size(); c++)
+    {
+        const int* begin;
+        const int* end;
+        if (!getPostings(makeTrigram(&lowerToken[c]), &begin, &end))
+        {
+            // Trigram does not occur anywhere, no matches
+            return;
+        }
+        postingLists.push_back(std::make_pair((int)(end - begin), begin));
+    }
+    std::sort(postingLists.begin(), postingLists.end());
+
+    // Intersect the posting lists to get the candidate entries
+    std::vector<int> candidates(postingLists[0].second, postingLists[0].second + postingLists[0].first);
+    for (size_t i = 1; i < postingLists.size() && !candidates.empty(); i++)
+    {
+        const int* list = postingLists[i].second;
+        const int* listEnd = list + postingLists[i].first;
+        std::vector<int> intersection;
+        std::set_intersection(candidates.begin(), candidates.end(), list, listEnd,
+                              std::back_inserter(intersection));
+        candidates.swap(intersection);
+    }
+
+    // Trigrams can match out of order, verify each candidate
+    for (size_t i = 0; i < candidates.size(); i++)
+    {
+        if (strstr(getLowerText(candidates[i]), lowerToken.c_str()) != NULL)
+        {
+            addEntryRows(candidates[i], rows);
+        }
+    }
+}
+
+///
+//  Whether a search token contains regular expression syntax
+//
+bool MRIDTextIndex::isRegExp(const std::string& token)
+{
+    return token.find_first_of(".[]{}()\\*+?|^$") != std::string::npos;
+}
+
+///
+//  Find the entries whose text starts with a prefix (case insensitive)
+//
+void MRIDTextIndex::findPrefix(const std::string& prefix, int& first, int& last) const
+{
+    std::string lowerPrefix = toLower(prefix.c_str());
+
+    // First entry not less than the prefix
+    size_t low = 0;
+    size_t high = mSortedEntries.size();
+    while (low < high)
+    {
+        size_t middle = low + (high - low) / 2;
+        if (strcmp(getLowerText(mSortedEntries[middle]), lowerPrefix.c_str()) < 0)
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+    first = (int)low;
+
+    // First entry after the ones starting with the prefix
+    high = mSortedEntries.size();
+    while (low < high)
+    {
+        size_t middle = low + (high - low) / 2;
+        if (strncmp(getLowerText(mSortedEntries[middle]), lowerPrefix.c_str(), lowerPrefix.size()) <= 0)
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+    last = (int)low;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Protected Members
+//
+//
+
+///
+//  Get the posting list of a trigram
+//
+bool MRIDTextIndex::getPostings(boost::uint32_t trigram, const int** begin, const int** end) const
+{
+    std::vector<boost::uint32_t>::const_iterator iter = std::lower_bound(mTrigrams.begin(), mTrigrams.end(), trigram);
+    if (iter == mTrigrams.end() || *iter != trigram)
+    {
+        return false;
+    }
+
+    int index = (int)(iter - mTrigrams.begin());
+    *begin = &mPostings[0] + mPostingOffsets[index];
+    *end = &mPostings[0] + mPostingOffsets[index + 1];
+    return true;
+}
+
+///
+//  Mark the rows that reference an entry
+//
+void MRIDTextIndex::addEntryRows(int entry, RowBitmap& rows) const
+{
+    for (int i = mEntryRowOffsets[entry]; i < mEntryRowOffsets[entry + 1]; i++)
+    {
+        rows.set(mEntryRows[i]);
+    }
+}
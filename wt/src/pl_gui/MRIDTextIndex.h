@@ -0,0 +1,145 @@
+//
+//
+//  Description:
+//      Definition of the MRID free-text index.  A trigram inverted index over the
+//      distinct Patient ID, patient name and scan name strings of an MRIDCatalog, used
+//      to answer substring searches without scanning every record.
+//
+//  Author:
+//      Dan Ginsburg
+//
+//  Children's Hospital Boston
+//  GPL v2
+//
+#ifndef MRIDTEXTINDEX_H
+#define MRIDTEXTINDEX_H
+
+#include <boost/cstdint.hpp>
+#include <string>
+#include <vector>
+
+class MRIDCatalog;
+class RowBitmap;
+
+///
+/// \class MRIDTextIndex
+/// \brief Trigram index for case insensitive substring search of an MRIDCatalog
+///
+class MRIDTextIndex
+{
+public:
+
+    ///
+    /// Constructor
+    ///
+    MRIDTextIndex();
+
+    ///
+    /// Destructor
+    ///
+    virtual ~MRIDTextIndex();
+
+    ///
+    /// Build the index for a catalog
+    ///
+    void build(const MRIDCatalog& catalog);
+
+    ///
+    /// Clear the index
+    ///
+    void clear();
+
+    ///
+    /// Find the rows where the Patient ID, name or a scan name matches a search token.
+    /// Plain text is a case insensitive substring search answered from the index.  A
+    /// token containing regular expression syntax also matches strings that the whole
+    /// regular expression matches, which requires a scan of the indexed strings.
+    /// \param catalog Catalog the index was built from
+    /// \param token Search token
+    /// \param rows Matching rows are added (set) in this bitmap
+    ///
+    void findRows(const MRIDCatalog& catalog, const std::string& token, RowBitmap& rows) const;
+
+    ///
+    /// Whether a search token contains regular expression syntax
+    ///
+    static bool isRegExp(const std::string& token);
+
+    ///
+    /// Find the entries whose text starts with a prefix (case insensitive), by binary
+    /// search of the entries sorted by text
+    /// \param prefix Prefix
+    /// \param first Output, first matching position in the sorted entries
+    /// \param last Output, one past the last matching position in the sorted entries
+    ///
+    void findPrefix(const std::string& prefix, int& first, int& last) const;
+
+    ///
+    /// Get the entry at a position of the entries sorted by text
+    ///
+    int getSortedEntry(int position) const      {   return mSortedEntries[position];    }
+
+    ///
+    /// Get the catalog string id of an entry
+    ///
+    int getEntryStringId(int entry) const       {   return mEntryStringIds[entry];  }
+
+    ///
+    /// Get the number of rows that reference an entry
+    ///
+    int getEntryNumRows(int entry) const        {   return mEntryRowOffsets[entry + 1] - mEntryRowOffsets[entry];   }
+
+    ///
+    /// Get a row that references an entry
+    ///
+    int getEntryRow(int entry, int index) const {   return mEntryRows[mEntryRowOffsets[entry] + index];     }
+
+protected:
+
+    ///
+    /// Get the posting list of a trigram
+    /// \return false if the trigram does not occur in the index
+    ///
+    bool getPostings(boost::uint32_t trigram, const int** begin, const int** end) const;
+
+    ///
+    /// Get the lowercased text of an entry
+    ///
+    const char* getLowerText(int entry) const   {   return &mLowerText[mLowerOffsets[entry]];   }
+
+    ///
+    /// Mark the rows that reference an entry
+    ///
+    void addEntryRows(int entry, RowBitmap& rows) const;
+
+protected:
+
+    /// Catalog string id of each entry (distinct indexed strings)
+    std::vector<int> mEntryStringIds;
+
+    /// Rows referencing each entry, CSR offsets (one extra entry marks the end)
+    std::vector<int> mEntryRowOffsets;
+
+    /// Rows referencing each entry
+    std::vector<int> mEntryRows;
+
+    /// Lowercased, NUL terminated text of each entry
+    std::vector<char> mLowerText;
+
+    /// Offset of each entry in mLowerText
+    std::vector<int> mLowerOffsets;
+
+    /// Entries sorted by lowercased text, then by catalog string
+    std::vector<int> mSortedEntries;
+
+    /// Sorted distinct trigrams
+    std::vector<boost::uint32_t> mTrigrams;
+
+    /// Posting list offsets for each trigram (one extra entry marks the end)
+    std::vector<int> mPostingOffsets;
+
+    /// Posting lists, sorted entry indices
+    std::vector<int> mPostings;
+};
+
+#endif // MRIDTEXTINDEX_H
@@ -0,0 +1,205 @@
+//
+//
+//  Description:
+//      Implementation of the MRID visibility cache.  For each user, holds a bitmap of the
+//      catalog rows that the user is allowed to see according to the permissions file.
+//      Bitmaps are shared by all sessions of the same user and recomputed only when the
+//      catalog or the permissions file changes.
+//
+//  Author:
+//      Dan Ginsburg
+//
+//  Children's Hospital Boston
+//  GPL v2
+//
+#include "MRIDVisibilityCache.h"
+#include "MRIDCatalog.h"
+#include "PermissionsXML.h"
+#include "RowBitmap.h"
+#include <boost/filesystem.hpp>
+#include <set>
+#include <vector>
+
+///
+//  Namespaces
+//
+using namespace std;
+using namespace boost::filesystem;
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Constructor/Destructor
+//
+//
+
+///
+//  Constructor
+//
+MRIDVisibilityCache::MRIDVisibilityCache() :
+    mPermissionsModTime(0),
+    mPermissionsFileSize(0)
+{
+}
+
+///
+//  Destructor
+//
+MRIDVisibilityCache::~MRIDVisibilityCache()
+{
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Public Members
+//
+//
+
+///
+//  Get the process-wide cache instance
+//
+MRIDVisibilityCache& MRIDVisibilityCache::instance()
+{
+    static MRIDVisibilityCache cache;
+    return cache;
+}
+
+///
+//  Get the rows of a catalog that a user is allowed to see
+//
+boost::shared_ptr<const RowBitmap> MRIDVisibilityCache::getVisibleRows(const std::string& userName,
+                                                                       const boost::shared_ptr<const MRIDCatalog>& catalog,
+                                                                       const std::string& permissionsFile,
+                                                                       const std::string& adminGroup)
+{
+    boost::mutex::scoped_lock lock(mMutex);
+
+    updatePermissions(permissionsFile, adminGroup);
+
+    std::map<std::string, CacheEntry>::const_iterator iter = mEntries.find(userName);
+    if (iter != mEntries.end() && iter->second.mCatalog.lock() == catalog)
+    {
+        return iter->second.mVisibleRows;
+    }
+
+    CacheEntry entry;
+    entry.mCatalog = catalog;
+    entry.mVisibleRows = computeVisibleRows(userName, *catalog, adminGroup);
+    mEntries[userName] = entry;
+
+    return entry.mVisibleRows;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Private Members
+//
+//
+
+///
+//  Reload the permissions file if it changed, dropping all cached bitmaps
+//
+void MRIDVisibilityCache::updatePermissions(const std::string& permissionsFile, const std::string& adminGroup)
+{
+    std::time_t modTime = 0;
+    boost::uintmax_t fileSize = 0;
+    try
+    {
+        modTime = last_write_time(permissionsFile);
+        fileSize = file_size(permissionsFile);
+    }
+    catch(...)
+    {
+        // File is missing, fall through and let the load report the error
+    }
+
+    if (mPermissionsXML != NULL &&
+        mPermissionsFile == permissionsFile &&
+        mAdminGroup == adminGroup &&
+        mPermissionsModTime == modTime &&
+        mPermissionsFileSize == fileSize)
+    {
+        return;
+    }
+
+    mPermissionsXML.reset(new PermissionsXML());
+    mPermissionsXML->loadFromFile(permissionsFile);
+
+    mPermissionsFile = permissionsFile;
+    mAdminGroup = adminGroup;
+    mPermissionsModTime = modTime;
+    mPermissionsFileSize = fileSize;
+
+    mEntries.clear();
+}
+
+///
+//  Compute the visible rows of a catalog for a user
+//
+boost::shared_ptr<const RowBitmap> MRIDVisibilityCache::computeVisibleRows(const std::string& userName,
+                                                                           const MRIDCatalog& catalog,
+                                                                           const std::string& adminGroup) const
+{
+    int numRows = catalog.getNumRecords();
+
+    // Resolve the user's groups once rather than per row
+    std::set<std::string> userGroups;
+    mPermissionsXML->getUserGroups(userName, userGroups);
+
+    // Admins can see everything
+    if (userGroups.find(adminGroup) != userGroups.end())
+    {
+        return boost::shared_ptr<const RowBitmap>(new RowBitmap(numRows, true));
+    }
+
+    boost::shared_ptr<RowBitmap> visibleRows(new RowBitmap(numRows, false));
+
+    // User and group names are interned in the catalog, so per-row checks are id comparisons
+    int userId = userName.empty() ? -1 : catalog.findString(userName);
+
+    std::vector<char> allowedGroupIds(catalog.getNumStrings(), 0);
+    bool anyGroups = false;
+    for (std::set<std::string>::const_iterator iter = userGroups.begin(); iter != userGroups.end(); iter++)
+    {
+        int groupId = catalog.findString(*iter);
+        if (groupId > MRIDCatalog::EMPTY_STRING_ID)
+        {
+            allowedGroupIds[groupId] = 1;
+            anyGroups = true;
+        }
+    }
+
+    if (userId <= MRIDCatalog::EMPTY_STRING_ID && !anyGroups)
+    {
+        return visibleRows;
+    }
+
+    for (int row = 0; row < numRows; row++)
+    {
+        bool visible = false;
+
+        if (userId > MRIDCatalog::EMPTY_STRING_ID)
+        {
+            int numUsers = catalog.getListSize(row, MRIDCatalog::USER_LIST);
+            for (int user = 0; user < numUsers && !visible; user++)
+            {
+                visible = (catalog.getListId(row, MRIDCatalog::USER_LIST, user) == userId);
+            }
+        }
+
+        if (!visible && anyGroups)
+        {
+            int numGroups = catalog.getListSize(row, MRIDCatalog::GROUP_LIST);
+            for (int group = 0; group < numGroups && !visible; group++)
+            {
+                visible = (allowedGroupIds[catalog.getListId(row, MRIDCatalog::GROUP_LIST, group)] != 0);
+            }
+        }
+
+        if (visible)
+        {
+            visibleRows->set(row);
+        }
+    }
+
+    return visibleRows;
+}
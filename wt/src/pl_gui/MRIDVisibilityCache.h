@@ -0,0 +1,117 @@
+//
+//
+//  Description:
+//      Definition of the MRID visibility cache.  For each user, holds a bitmap of the
+//      catalog rows that the user is allowed to see according to the permissions file.
+//      Bitmaps are shared by all sessions of the same user and recomputed only when the
+//      catalog or the permissions file changes.
+//
+//  Author:
+//      Dan Ginsburg
+//
+//  Children's Hospital Boston
+//  GPL v2
+//
+#ifndef MRIDVISIBILITYCACHE_H
+#define MRIDVISIBILITYCACHE_H
+
+#include <boost/shared_ptr.hpp>
+#include <boost/weak_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/cstdint.hpp>
+#include <ctime>
+#include <map>
+#include <string>
+
+class MRIDCatalog;
+class PermissionsXML;
+class RowBitmap;
+
+///
+/// \class MRIDVisibilityCache
+/// \brief Singleton that caches per-user visible row bitmaps over the MRID catalog
+///
+class MRIDVisibilityCache
+{
+public:
+
+    ///
+    /// Get the process-wide cache instance
+    ///
+    static MRIDVisibilityCache& instance();
+
+    ///
+    /// Get the rows of a catalog that a user is allowed to see.  A row is visible if
+    /// the user is listed on it, if one of the user's groups is listed on it, or if
+    /// the user is in the admin group.
+    /// \param userName User name
+    /// \param catalog Catalog snapshot
+    /// \param permissionsFile Full path to the permissions XML file
+    /// \param adminGroup Name of the admin group
+    /// \return Bitmap of visible rows (never NULL)
+    ///
+    boost::shared_ptr<const RowBitmap> getVisibleRows(const std::string& userName,
+                                                      const boost::shared_ptr<const MRIDCatalog>& catalog,
+                                                      const std::string& permissionsFile,
+                                                      const std::string& adminGroup);
+
+private:
+
+    ///
+    /// Constructor
+    ///
+    MRIDVisibilityCache();
+
+    ///
+    /// Destructor
+    ///
+    virtual ~MRIDVisibilityCache();
+
+    ///
+    /// Reload the permissions file if it changed, dropping all cached bitmaps
+    ///
+    void updatePermissions(const std::string& permissionsFile, const std::string& adminGroup);
+
+    ///
+    /// Compute the visible rows of a catalog for a user
+    ///
+    boost::shared_ptr<const RowBitmap> computeVisibleRows(const std::string& userName,
+                                                          const MRIDCatalog& catalog,
+                                                          const std::string& adminGroup) const;
+
+private:
+
+    /// Cached visibility for a single user
+    typedef struct
+    {
+        /// Catalog the bitmap was computed over
+        boost::weak_ptr<const MRIDCatalog> mCatalog;
+
+        /// Visible rows
+        boost::shared_ptr<const RowBitmap> mVisibleRows;
+
+    } CacheEntry;
+
+    /// Cached bitmaps, keyed by user name
+    std::map<std::string, CacheEntry> mEntries;
+
+    /// Shared permissions
+    boost::shared_ptr<PermissionsXML> mPermissionsXML;
+
+    /// Permissions file that is loaded
+    std::string mPermissionsFile;
+
+    /// Admin group the bitmaps were computed with
+    std::string mAdminGroup;
+
+    /// Modification time of the loaded permissions file
+    std::time_t mPermissionsModTime;
+
+    /// Size of the loaded permissions file
+    boost::uintmax_t mPermissionsFileSize;
+
+    /// Mutex protecting all of the above
+    boost::mutex mMutex;
+};
+
+#endif // MRIDVISIBILITYCACHE_H
@@ -11,6 +11,7 @@
 //
 #include "MRIInfoBox.h"
 #include "ConfigOptions.h"
+#include "StudyMetadataCache.h"
 #include <Wt/WApplication>
 #include <Wt/WLogger>
 #include <Wt/WContainerWidget>
@@ -28,6 +29,7 @@
 #include <Wt/WMessageBox>
 #include <Wt/WFont>
 #include <Wt/WCssDecorationStyle>
+#include <boost/bind.hpp>
 #include <fstream>
 #include <iostream>
 #include <string>
@@ -85,6 +87,7 @@ MRIInfoBox::~MRIInfoBox()
 //
 void MRIInfoBox::resetAll()
 {
+    mIOClient.cancel();
     mMRIInfoTextArea->setText("");
 }
 
@@ -93,41 +96,16 @@ void MRIInfoBox::resetAll()
 //
 void MRIInfoBox::setDicomFileName(std::string dcmFileName)
 {
-    string mriFileStd = dcmFileName + ".std";
-    string mriFileErr = dcmFileName + ".err";
+    // Only the most recently clicked scan is shown
+    mIOClient.cancel();
+    mMRIInfoTextArea->setText("Loading...");
 
-    std::ifstream mriFile(mriFileStd.c_str(), ios::in);
-    if (mriFile.is_open())
-    {
-        ostringstream oss;
-        oss << mriFile.rdbuf();
-
-        if (oss.str().length() > 1)
-        {
-            mMRIInfoTextArea->setText(oss.str());
-        }
-        else
-        {
-            std::ifstream errFile(mriFileErr.c_str(), ios::in);
-
-            if (errFile.is_open())
-            {
-                oss << errFile.rdbuf();
-
-                if (oss.str().length() > 1)
-                {
-                    mMRIInfoTextArea->setText(oss.str());
-                }
-                errFile.close();
-            }
-        }
-
-        mriFile.close();
-    }
-    else
-    {
-        mMRIInfoTextArea->setText("No MRI info file found.");
-    }
+    boost::shared_ptr<MRIInfoLoad> load(new MRIInfoLoad());
+    load->mDicomFileName = dcmFileName;
+    load->mFound = false;
+
+    mIOClient.submit(boost::bind(&MRIInfoBox::loadMRIInfo, load),
+                     boost::bind(&MRIInfoBox::mriInfoLoaded, this, load, _1));
 }
 
 
@@ -136,3 +114,30 @@ void MRIInfoBox::setDicomFileName(std::string dcmFileName)
 //  Private Members
 //
 //
+
+///
+//  Read the MRI info of a DICOM file (I/O thread)
+//
+void MRIInfoBox::loadMRIInfo(boost::shared_ptr<MRIInfoLoad> load)
+{
+    load->mFound = StudyMetadataCache::instance().getMRIInfo(load->mDicomFileName, load->mText);
+}
+
+///
+//  MRI info of a DICOM file read
+//
+void MRIInfoBox::mriInfoLoaded(boost::shared_ptr<MRIInfoLoad> load, IOExecutor::StatusEnum status)
+{
+    if (status == IOExecutor::IO_TIMED_OUT)
+    {
+        mMRIInfoTextArea->setText("Timed out reading MRI info file.");
+    }
+    else if (load->mFound)
+    {
+        mMRIInfoTextArea->setText(load->mText);
+    }
+    else
+    {
+        mMRIInfoTextArea->setText("No MRI info file found.");
+    }
+}
@@ -17,6 +17,8 @@
 #include <vector>
 #include <string>
 #include "GlobalEnums.h"
+#include "IOClient.h"
+#include <boost/shared_ptr.hpp>
 
 namespace Wt
 {
@@ -56,10 +58,37 @@ public:
 
 private:
 
+    /// MRI info being read for a DICOM file
+    typedef struct
+    {
+        /// DICOM file under the mri_info directory
+        std::string mDicomFileName;
+
+        /// Whether an MRI info file was found
+        bool mFound;
+
+        /// MRI info text
+        std::string mText;
+
+    } MRIInfoLoad;
+
+    ///
+    /// Read the MRI info of a DICOM file (I/O thread)
+    ///
+    static void loadMRIInfo(boost::shared_ptr<MRIInfoLoad> load);
+
+    ///
+    /// MRI info of a DICOM file read [I/O callback]
+    ///
+    void mriInfoLoaded(boost::shared_ptr<MRIInfoLoad> load, IOExecutor::StatusEnum status);
+
 private:
 
     /// MRI Info
     WTextArea *mMRIInfoTextArea;
+
+    /// Reads the MRI info off the session
+    IOClient mIOClient;
 };
 
 #endif // MRIINFOBOX_H
@@ -0,0 +1,365 @@
+//
+//
+//  Description:
+//      Implementation of the meta log parser.  Reads the <metaScript>.std log of a
+//      cluster job natively to find the "Shutting down with code" result of a
+//      finished job and the stage the pipeline is in.  The first update reads
+//      backwards from the end of the log, only as far as the last stage marker.
+//      After that only the bytes appended since the previous update are read.
+//
+//  Author:
+//      Dan Ginsburg
+//
+//  Children's Hospital Boston
+//  GPL v2
+//
+#include "MetaLogParser.h"
+#include <sys/stat.h>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <ctype.h>
+#include <stdlib.h>
+
+///
+//  Namespaces
+//
+using namespace std;
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Constructor/Destructor
+//
+//
+
+///
+//  Constructor
+//
+MetaLogParser::MetaLogParser(const std::string& logFile, const std::string& stages) :
+    mLogFile(logFile),
+    mStages(stages)
+{
+    reset();
+}
+
+///
+//  Destructor
+//
+MetaLogParser::~MetaLogParser()
+{
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Public Members
+//
+//
+
+///
+//  Read what was appended to the log since the last update
+//
+bool MetaLogParser::update()
+{
+    struct stat fileStat;
+
+    if (stat(mLogFile.c_str(), &fileStat) != 0)
+    {
+        reset();
+        return false;
+    }
+
+    boost::uint64_t size = (boost::uint64_t)fileStat.st_size;
+
+    // A log smaller than what was parsed was rewritten by a new run of the job
+    if (mOffset > 0 && (boost::uint64_t)mOffset > size)
+    {
+        reset();
+    }
+
+    if (mOffset >= 0 && (boost::uint64_t)mOffset == size)
+    {
+        return true;
+    }
+
+    ifstream ifs(mLogFile.c_str(), ios::in | ios::binary);
+    if (!ifs.is_open())
+    {
+        return false;
+    }
+
+    if (mOffset < 0)
+    {
+        scanBackward(ifs, size);
+    }
+    else
+    {
+        scanForward(ifs, size);
+    }
+
+    return true;
+}
+
+///
+//  Get the percent of the job complete
+//
+int MetaLogParser::getPercentComplete() const
+{
+    if (mShutDown)
+    {
+        return (mExitCode == 0) ? 100 : -1;
+    }
+
+    if (mStages.empty())
+    {
+        return -1;
+    }
+
+    if (mStage < 0)
+    {
+        return 0;
+    }
+
+    // The stages before the current one are complete
+    size_t stageIndex = (mStage <= 9) ? mStages.find((char)('0' + mStage)) : string::npos;
+    if (stageIndex == string::npos)
+    {
+        return -1;
+    }
+
+    return (int)(100 * stageIndex / mStages.size());
+}
+
+///
+//  Get the stages of a job from its meta script arguments
+//
+std::string MetaLogParser::getStages(const std::string& arguments)
+{
+    istringstream iss(arguments);
+    string token;
+
+    while (iss >> token)
+    {
+        if (token == "-t" || token == "--tract-meta-stages")
+        {
+            string stages;
+            iss >> stages;
+
+            string digits;
+            for (size_t i = 0; i < stages.size(); i++)
+            {
+                if (isdigit((unsigned char)stages[i]))
+                {
+                    digits += stages[i];
+                }
+            }
+            return digits;
+        }
+    }
+
+    return "";
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Private Members
+//
+//
+
+///
+//  Reset to the state of an empty log
+//
+void MetaLogParser::reset()
+{
+    mOffset = -1;
+    mShutDown = false;
+    mExitCode = -1;
+    mStage = -1;
+    mStageText = "";
+}
+
+///
+//  Read backwards from the end of the log to the last stage marker
+//
+void MetaLogParser::scanBackward(std::istream& is, boost::uint64_t size)
+{
+    std::vector<char> block(BLOCK_SIZE);
+
+    // Text not yet parsed, starting at file offset pos
+    std::string text;
+    boost::uint64_t pos = size;
+
+    // Lines up to the first newline are re-read by the next update
+    mOffset = 0;
+    bool foundNewline = false;
+
+    // Like 'tail -2', the shutdown code is only looked for in the last two lines
+    int numLines = 0;
+    bool findStage = true;
+
+    while (pos > 0 && (findStage || numLines < 2) && size - pos < (boost::uint64_t)MAX_BACKWARD_BYTES)
+    {
+        size_t count = (size_t)std::min((boost::uint64_t)BLOCK_SIZE, pos);
+        pos -= count;
+
+        is.seekg((streamoff)pos, ios::beg);
+        if (!is.read(&block[0], count))
+        {
+            break;
+        }
+        text.insert(text.begin(), block.begin(), block.begin() + count);
+
+        // Parse the complete lines, last first
+        size_t end = text.size();
+        size_t newline;
+        while (end > 0 && (newline = text.rfind('\n', end - 1)) != string::npos)
+        {
+            if (!foundNewline)
+            {
+                mOffset = (boost::int64_t)(pos + newline + 1);
+                foundNewline = true;
+            }
+
+            std::string line = text.substr(newline + 1, end - newline - 1);
+            if (!line.empty())
+            {
+                if (parseLine(line, numLines < 2, findStage))
+                {
+                    findStage = false;
+                }
+                numLines++;
+            }
+            end = newline;
+
+            if (!findStage && numLines >= 2)
+            {
+                break;
+            }
+        }
+        text.erase(end);
+    }
+
+    // The first line of the log
+    if (pos == 0 && !text.empty() && (findStage || numLines < 2))
+    {
+        parseLine(text, numLines < 2, findStage);
+    }
+}
+
+///
+//  Read forwards from the last offset to the end of the log
+//
+void MetaLogParser::scanForward(std::istream& is, boost::uint64_t size)
+{
+    std::vector<char> block(BLOCK_SIZE);
+
+    // Text of the line being read, starting at file offset mOffset
+    std::string text;
+    boost::uint64_t pos = (boost::uint64_t)mOffset;
+
+    is.seekg((streamoff)pos, ios::beg);
+
+    while (pos < size)
+    {
+        size_t count = (size_t)std::min((boost::uint64_t)BLOCK_SIZE, size - pos);
+        if (!is.read(&block[0], count))
+        {
+            break;
+        }
+        pos += count;
+        text.append(block.begin(), block.begin() + count);
+
+        size_t begin = 0;
+        size_t newline;
+        while ((newline = text.find('\n', begin)) != string::npos)
+        {
+            // A stage starting after a shutdown is a new run of the job
+            if (parseLine(text.substr(begin, newline - begin), true, true))
+            {
+                mShutDown = false;
+                mExitCode = -1;
+            }
+            begin = newline + 1;
+        }
+
+        mOffset += (boost::int64_t)begin;
+        text.erase(0, begin);
+    }
+
+    // The last line may not be finished, it is read again on the next update
+    if (!text.empty() && parseLine(text, true, true))
+    {
+        mShutDown = false;
+        mExitCode = -1;
+    }
+}
+
+///
+//  Parse a line for the shutdown code and a stage marker
+//
+bool MetaLogParser::parseLine(const std::string& line, bool checkShutdown, bool checkStage)
+{
+    // "Shutting down with code #..." at the bottom of the meta script log
+    static const std::string shutdownMarker = "Shutting down with code";
+
+    if (checkShutdown)
+    {
+        size_t found = line.find(shutdownMarker);
+        if (found != string::npos)
+        {
+            const char *code = line.c_str() + found + shutdownMarker.size();
+            char *codeEnd;
+            long exitCode = strtol(code, &codeEnd, 10);
+
+            mShutDown = true;
+            mExitCode = (codeEnd != code) ? (int)exitCode : -1;
+            return false;
+        }
+    }
+
+    if (!checkStage)
+    {
+        return false;
+    }
+
+    // Stage markers are of the form "... STAGE <n> - <description> | ..."
+    static const std::string stageMarker = "STAGE ";
+
+    for (size_t found = line.find(stageMarker); found != string::npos;
+         found = line.find(stageMarker, found + 1))
+    {
+        size_t numberBegin = found + stageMarker.size();
+        size_t numberEnd = numberBegin;
+        while (numberEnd < line.size() && isdigit((unsigned char)line[numberEnd]))
+        {
+            numberEnd++;
+        }
+
+        if (numberEnd == numberBegin)
+        {
+            continue;
+        }
+
+        size_t textBegin = line.find_first_not_of(" \t-:>", numberEnd);
+        size_t textEnd = line.find('|', numberEnd);
+        if (textEnd == string::npos)
+        {
+            textEnd = line.size();
+        }
+
+        mStage = atoi(line.c_str() + numberBegin);
+        mStageText = "";
+        if (textBegin != string::npos && textBegin < textEnd)
+        {
+            size_t textLast = line.find_last_not_of(" \t\r", textEnd - 1);
+            if (textLast != string::npos && textLast >= textBegin)
+            {
+                mStageText = line.substr(textBegin, textLast - textBegin + 1);
+            }
+        }
+
+        return true;
+    }
+
+    return false;
+}
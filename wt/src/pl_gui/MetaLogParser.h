@@ -0,0 +1,134 @@
+//
+//
+//  Description:
+//      Definition of the meta log parser.  Reads the <metaScript>.std log of a
+//      cluster job natively to find the "Shutting down with code" result of a
+//      finished job and the stage the pipeline is in.  The first update reads
+//      backwards from the end of the log, only as far as the last stage marker.
+//      After that only the bytes appended since the previous update are read.
+//
+//  Author:
+//      Dan Ginsburg
+//
+//  Children's Hospital Boston
+//  GPL v2
+//
+#ifndef METALOGPARSER_H
+#define METALOGPARSER_H
+
+#include <boost/cstdint.hpp>
+#include <iosfwd>
+#include <string>
+
+///
+/// \class MetaLogParser
+/// \brief Incrementally parses the completion and stage of a job from its meta log
+///
+class MetaLogParser
+{
+public:
+
+    /// Size of the blocks the log is read in
+    static const int BLOCK_SIZE = 4096;
+
+    /// Furthest back from the end the first update looks for a stage marker
+    static const int MAX_BACKWARD_BYTES = 4 * 1024 * 1024;
+
+    ///
+    /// Constructor
+    /// \param logFile Full path to the meta log
+    /// \param stages Stages the job runs, in order (the digits of its -t option),
+    ///               empty if not known
+    ///
+    MetaLogParser(const std::string& logFile, const std::string& stages);
+
+    ///
+    /// Destructor
+    ///
+    virtual ~MetaLogParser();
+
+    ///
+    /// Read what was appended to the log since the last update
+    /// \return false if the log does not exist (yet)
+    ///
+    bool update();
+
+    ///
+    /// Get whether the meta script has shut down
+    ///
+    bool isShutDown() const                     {   return mShutDown;       }
+
+    ///
+    /// Get the code the meta script shut down with, -1 if it could not be read
+    ///
+    int getExitCode() const                     {   return mExitCode;       }
+
+    ///
+    /// Get the current stage, -1 if no stage has started
+    ///
+    int getStage() const                        {   return mStage;          }
+
+    ///
+    /// Get the description of the current stage
+    ///
+    const std::string& getStageText() const     {   return mStageText;      }
+
+    ///
+    /// Get the percent of the job complete, -1 if it is not known
+    ///
+    int getPercentComplete() const;
+
+    ///
+    /// Get the stages of a job from its meta script arguments (the digits of -t)
+    ///
+    static std::string getStages(const std::string& arguments);
+
+private:
+
+    ///
+    /// Reset to the state of an empty log
+    ///
+    void reset();
+
+    ///
+    /// Read backwards from the end of the log to the last stage marker
+    ///
+    void scanBackward(std::istream& is, boost::uint64_t size);
+
+    ///
+    /// Read forwards from the last offset to the end of the log
+    ///
+    void scanForward(std::istream& is, boost::uint64_t size);
+
+    ///
+    /// Parse a line for the shutdown code and a stage marker
+    /// \param checkShutdown Parse the shutdown code
+    /// \param checkStage Parse the stage marker
+    /// \return true if a stage marker was parsed
+    ///
+    bool parseLine(const std::string& line, bool checkShutdown, bool checkStage);
+
+    /// Full path to the meta log
+    std::string mLogFile;
+
+    /// Stages the job runs, in order
+    std::string mStages;
+
+    /// Offset of the first byte not parsed as part of a complete line, -1 before
+    /// the first update
+    boost::int64_t mOffset;
+
+    /// Meta script shut down
+    bool mShutDown;
+
+    /// Code the meta script shut down with
+    int mExitCode;
+
+    /// Current stage
+    int mStage;
+
+    /// Description of the current stage
+    std::string mStageText;
+};
+
+#endif // METALOGPARSER_H
@@ -11,6 +11,8 @@
 //
 #include "PatientInfoBox.h"
 #include "ConfigOptions.h"
+#include "StudyMetadata.h"
+#include "StudyMetadataCache.h"
 #include <Wt/WApplication>
 #include <Wt/WLogger>
 #include <Wt/WContainerWidget>
@@ -23,6 +25,7 @@
 #include <Wt/WSelectionBox>
 #include <Wt/WPushButton>
 #include <Wt/WMessageBox>
+#include <boost/bind.hpp>
 #include <fstream>
 #include <iostream>
 #include <string>
@@ -100,6 +103,8 @@ PatientInfoBox::~PatientInfoBox()
 //
 void PatientInfoBox::resetAll()
 {
+    mIOClient.cancel();
+
     for(int row = 0; row < NUM_ROWS; row++)
     {
         mModel->setData(row, 1, boost::any(std::string("")));
@@ -111,112 +116,28 @@ void PatientInfoBox::resetAll()
 //
 void PatientInfoBox::setScanDir(std::string scanDir)
 {
-    stringstream tocURL;
+    mIOClient.cancel();
+
+    boost::shared_ptr<StudyLoad> load(new StudyLoad());
+    load->mScanDir = scanDir;
 
-    tocURL << scanDir << "/toc.txt";
+    mIOClient.submit(boost::bind(&PatientInfoBox::loadStudy, load),
+                     boost::bind(&PatientInfoBox::studyLoaded, this, load, _1));
+}
 
-    // Parse table-of-contents file
-    std::ifstream tocFile(tocURL.str().c_str());
-    ostringstream oss;
+///
+//  Set the study to display
+//
+void PatientInfoBox::setStudy(const StudyMetadata& study)
+{
+    // Any study still being read is superseded
+    mIOClient.cancel();
 
-    if (tocFile.is_open())
+    // Rows are in the same order as the study information
+    for (int row = 0; row < NUM_ROWS; row++)
     {
-        while (!tocFile.eof())
-        {
-            char buf[1024];
-            tocFile.getline( buf, sizeof(buf));
-
-            istringstream istr(string(buf), ios_base::out);
-            string firstToken;
-            istr >> firstToken;
-
-            if (firstToken == "Patient")
-            {
-                string secondToken;
-                string str;
-                istr >> secondToken;
-
-                while (!istr.eof())
-                {
-                    string tmp;
-                    istr >> tmp;
-                    str += tmp + " ";
-                }
-
-                if (secondToken == "ID")
-                {
-                    setInfoData(PATIENT_ID, str);
-                }
-                else if (secondToken == "Name")
-                {
-                    setInfoData(PATIENT_NAME, str);
-                }
-                else if (secondToken == "Age")
-                {
-                    setInfoData(PATIENT_AGE, str);
-                }
-                else if (secondToken == "Sex")
-                {
-                    setInfoData(PATIENT_SEX, str);
-                }
-                else if (secondToken == "Birthday")
-                {
-                    setInfoData(PATIENT_BIRTHDAY, str);
-                }
-            }
-            else if (firstToken == "Image")
-            {
-                string secondToken;
-                istr >> secondToken;
-
-                if (secondToken == "Scan-Date")
-                {
-                    string scanDate;
-
-                    istr >> scanDate;
-                    setInfoData(IMAGE_SCAN_DATE, scanDate);
-                }
-            }
-            else if (firstToken == "Scanner")
-            {
-                string secondToken;
-                string str;
-                istr >> secondToken;
-
-                while (!istr.eof())
-                {
-                    string tmp;
-                    istr >> tmp;
-                    str += tmp + " ";
-                }
-
-                if (secondToken == "Manufacturer")
-                {
-                    setInfoData(SCANNER_MANUFACTURER, str);
-                }
-                else if (secondToken == "Model")
-                {
-                    setInfoData(SCANNER_MODEL, str);
-                }
-            }
-            else if (firstToken == "Software")
-            {
-                string secondToken;
-                string str;
-                istr >> secondToken;
-
-                while (!istr.eof())
-                {
-                    string tmp;
-                    istr >> tmp;
-                    str += tmp + " ";
-                }
-
-                setInfoData(SOFTWARE_VERSION, str);
-            }
-        }
-        tocFile.close();
-   }
+        setInfoData((PatientEnum)row, study.getInfo((StudyMetadata::InfoEnum)row));
+    }
 }
 
 
@@ -244,3 +165,25 @@ void PatientInfoBox::setInfoData(PatientEnum patientEnum, const std::string& str
 
 	mModel->setData(patientEnum, 1, data);
 }
+
+///
+//  Read the table of contents of a study (I/O thread)
+//
+void PatientInfoBox::loadStudy(boost::shared_ptr<StudyLoad> load)
+{
+    load->mStudy = StudyMetadataCache::instance().getStudy(load->mScanDir);
+}
+
+///
+//  Table of contents of a study read
+//
+void PatientInfoBox::studyLoaded(boost::shared_ptr<StudyLoad> load, IOExecutor::StatusEnum status)
+{
+    if (status == IOExecutor::IO_TIMED_OUT)
+    {
+        WApplication::instance()->log("error") << "Timed out reading table of contents in: " << load->mScanDir;
+        return;
+    }
+
+    setStudy(*load->mStudy);
+}
@@ -17,6 +17,8 @@
 #include <vector>
 #include <string>
 #include "GlobalEnums.h"
+#include "IOClient.h"
+#include <boost/shared_ptr.hpp>
 
 namespace Wt
 {
@@ -24,6 +26,8 @@ namespace Wt
     class WStandardItemModel;
 }
 
+class StudyMetadata;
+
 using namespace Wt;
 
 ///
@@ -54,6 +58,11 @@ public:
     ///
     void setScanDir(std::string scanDir);
 
+    ///
+    /// \brief Set the study to display, already read from the scan directory
+    ///
+    void setStudy(const StudyMetadata& study);
+
 private:
     typedef enum
     {
@@ -74,6 +83,27 @@ private:
     ///
     void setInfoData(PatientEnum patientEnum, const std::string& str);
 
+    /// Table of contents being read for a study
+    typedef struct
+    {
+        /// Study directory
+        std::string mScanDir;
+
+        /// Parsed table of contents
+        boost::shared_ptr<const StudyMetadata> mStudy;
+
+    } StudyLoad;
+
+    ///
+    /// Read the table of contents of a study (I/O thread)
+    ///
+    static void loadStudy(boost::shared_ptr<StudyLoad> load);
+
+    ///
+    /// Table of contents of a study read [I/O callback]
+    ///
+    void studyLoaded(boost::shared_ptr<StudyLoad> load, IOExecutor::StatusEnum status);
+
 private:
 
 
@@ -82,6 +112,9 @@ private:
 
     /// Model data
     WStandardItemModel *mModel;
+
+    /// Reads the study's table of contents off the session
+    IOClient mIOClient;
 };
 
 #endif // SCANBROWSER_H
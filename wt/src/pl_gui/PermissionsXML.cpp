@@ -93,6 +93,30 @@ bool PermissionsXML::userInGroup(const std::string& userName, const std::string&
     return false;
 }
 
+///
+//  Get all of the groups that a user is in
+//
+void PermissionsXML::getUserGroups(const std::string& userName, std::set<std::string>& groups) const
+{
+    groups.clear();
+
+    std::map<std::string, std::list<std::string> >::const_iterator mapIter = mGroupMap.begin();
+    while (mapIter != mGroupMap.end())
+    {
+        std::list<std::string>::const_iterator iter = mapIter->second.begin();
+        while (iter != mapIter->second.end())
+        {
+            if (userName == (*iter))
+            {
+                groups.insert(mapIter->first);
+                break;
+            }
+            iter++;
+        }
+        mapIter++;
+    }
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 //
 //  Protected Members
@@ -15,6 +15,7 @@
 #include <mxml.h>
 #include <map>
 #include <list>
+#include <set>
 #include <string>
 
 ///
@@ -46,6 +47,13 @@ public:
     ///
     bool userInGroup(const std::string& userName, const std::string& groupName) const;
 
+    ///
+    /// Get all of the groups that a user is in
+    /// \param userName User name
+    /// \param groups Output, set of group names
+    ///
+    void getUserGroups(const std::string& userName, std::set<std::string>& groups) const;
+
 protected:
 
     ///
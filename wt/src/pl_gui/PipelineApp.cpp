@@ -20,6 +20,7 @@
 #include "ConfigXML.h"
 #include "LoginPage.h"
 #include "MRIBrowser.h"
+#include "IOExecutor.h"
 #include <Wt/WContainerWidget>
 #include <Wt/WStackedWidget>
 #include <Wt/WTabWidget>
@@ -200,6 +201,9 @@ void PipelineApp::finalize()
 {
     mSubjectPage->finalize();
     mResultsPage->finalize();
+
+    // Drop the completion callbacks of any filesystem reads still outstanding
+    IOExecutor::instance().detachApplication(this);
 }
 
 
@@ -31,6 +31,7 @@
 #include <Wt/WMessageBox>
 #include <signal.h>
 #include <boost/filesystem.hpp>
+#include <boost/bind.hpp>
 ///
 //  Namespaces
 //
@@ -121,23 +122,18 @@ void ProjectChooser::resetAll()
     mDeleteButton->setEnabled(false);
 
 
-    std::string userProjectDir = getConfigOptionsPtr()->GetProjectDir() + "/" +
-                                 getCurrentUserName();
-    try
-    {
-        for(directory_iterator dirIter(userProjectDir); dirIter != directory_iterator(); ++dirIter)
-        {
-            const string extension = dirIter->path().extension().string();
-            if (extension == ".xml")
-            {
-                mProjectSelectionBox->addItem(dirIter->path().string());
-            }
-        }
-    }
-    catch(...)
-    {
-        // Empty directory, which is fine
-    }
+    // A listing still loading is no longer wanted
+    mIOClient.cancel();
+
+    // Only the default project can be chosen until the projects have been listed
+    mProjectSelectionBox->disable();
+
+    boost::shared_ptr<ProjectListLoad> load(new ProjectListLoad());
+    load->mUserProjectDir = getConfigOptionsPtr()->GetProjectDir() + "/" +
+                            getCurrentUserName();
+
+    mIOClient.submit(boost::bind(&ProjectChooser::loadProjectList, load),
+                     boost::bind(&ProjectChooser::projectListLoaded, this, load, _1));
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -219,5 +215,44 @@ void ProjectChooser::handleMessageBoxFinished(StandardButton button)
     resetAll();
 }
 
+///
+//  List the projects of the user (I/O thread)
+//
+void ProjectChooser::loadProjectList(boost::shared_ptr<ProjectListLoad> load)
+{
+    try
+    {
+        for(directory_iterator dirIter(load->mUserProjectDir); dirIter != directory_iterator(); ++dirIter)
+        {
+            const string extension = dirIter->path().extension().string();
+            if (extension == ".xml")
+            {
+                load->mProjectFiles.push_back(dirIter->path().string());
+            }
+        }
+    }
+    catch(...)
+    {
+        // Empty directory, which is fine
+    }
+}
 
+///
+//  Projects of the user listed
+//
+void ProjectChooser::projectListLoaded(boost::shared_ptr<ProjectListLoad> load, IOExecutor::StatusEnum status)
+{
+    if (status == IOExecutor::IO_TIMED_OUT)
+    {
+        WApplication::instance()->log("error") << "Timed out listing projects in: " << load->mUserProjectDir;
+    }
+    else
+    {
+        for (size_t i = 0; i < load->mProjectFiles.size(); i++)
+        {
+            mProjectSelectionBox->addItem(load->mProjectFiles[i]);
+        }
+    }
 
+    mProjectSelectionBox->enable();
+}
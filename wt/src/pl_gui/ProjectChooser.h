@@ -16,6 +16,9 @@
 #include <Wt/WContainerWidget>
 #include <Wt/WDialog>
 #include <string>
+#include <vector>
+#include <boost/shared_ptr.hpp>
+#include "IOClient.h"
 
 namespace Wt
 {
@@ -89,6 +92,27 @@ private:
     ///
     void selectionChanged();
 
+    /// Projects being listed for the user
+    typedef struct
+    {
+        /// Project directory of the user
+        std::string mUserProjectDir;
+
+        /// Project files found
+        std::vector<std::string> mProjectFiles;
+
+    } ProjectListLoad;
+
+    ///
+    /// List the projects of the user (I/O thread)
+    ///
+    static void loadProjectList(boost::shared_ptr<ProjectListLoad> load);
+
+    ///
+    /// Projects of the user listed [I/O callback]
+    ///
+    void projectListLoaded(boost::shared_ptr<ProjectListLoad> load, IOExecutor::StatusEnum status);
+
     /// Project selection box
     WSelectionBox *mProjectSelectionBox;
 
@@ -97,6 +121,9 @@ private:
 
     /// Message box dialog
     WMessageBox *mMessageBox;
+
+    /// Lists the projects off the session
+    IOClient mIOClient;
 };
 
 #endif // PROJECTCHOOSER_H
@@ -0,0 +1,350 @@
+//
+//
+//  Description:
+//      Implementation of the compiled project filter.  The search terms of a project file
+//      are compiled once into a list of prebuilt matchers which are then evaluated over
+//      a whole MRID catalog in a single pass, producing a bitmap of matching rows.
+//      Range terms on dates and ages are answered from the catalog's sorted typed
+//      columns rather than by comparing strings.
+//
+//  Author:
+//      Dan Ginsburg
+//
+//  Children's Hospital Boston
+//  GPL v2
+//
+#include "ProjectFilter.h"
+#include "ProjectXML.h"
+#include "MRIDCatalog.h"
+#include "MRIDTextIndex.h"
+#include <Wt/WApplication>
+#include <Wt/WLogger>
+#include <boost/algorithm/string.hpp>
+#include <algorithm>
+#include <climits>
+#include <string.h>
+
+///
+//  Namespaces
+//
+using namespace Wt;
+using namespace std;
+
+///
+//  Static constants
+//
+
+// Number of rows sampled when estimating the selectivity of a term
+static const int SELECTIVITY_SAMPLE_ROWS = 64;
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Constructor/Destructor
+//
+//
+
+///
+//  Constructor
+//
+ProjectFilter::ProjectFilter() :
+    mSearchMatchType(MRIBrowser::ANY)
+{
+}
+
+///
+//  Destructor
+//
+ProjectFilter::~ProjectFilter()
+{
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Public Members
+//
+//
+
+///
+//  Compile the search terms of a project
+//
+void ProjectFilter::compile(ProjectXML& projectXML)
+{
+    clear();
+
+    mSearchMatchType = MRIBrowser::ANY;
+    if (projectXML.getSearchMatchType() == "all")
+    {
+        mSearchMatchType = MRIBrowser::ALL;
+    }
+
+    std::list<ProjectXML::SearchTermNode>& searchTerms = projectXML.getSearchTerms();
+    std::list<ProjectXML::SearchTermNode>::const_iterator iter = searchTerms.begin();
+
+    while(iter != searchTerms.end())
+    {
+        const ProjectXML::SearchTermNode* node = &(*iter);
+
+        for(int i = 0; i < MRIBrowser::NUM_FIELDS; i++)
+        {
+            const MRIBrowser::MRIField *field = MRIBrowser::getMRIField(i);
+            if (field == NULL || field->mTagName != node->mField)
+                continue;
+
+            for (int j = 0; j < MRIBrowser::NUM_TYPES; j++)
+            {
+                const MRIBrowser::MRISearchType *search = MRIBrowser::getMRISearchType(j);
+                if (search == NULL || search->mXMLValue != node->mType)
+                    continue;
+
+                Term term;
+                term.mField = i;
+                term.mSearchType = (MRIBrowser::MRISearchTypeEnum)j;
+                term.mExpr = node->mExpr;
+                term.mHasRegExp = false;
+                term.mHasValueRange = false;
+                term.mMinValue = 0;
+                term.mMaxValue = 0;
+
+                // A CONTAINS term matches if the expression is either a regular expression
+                // matching the whole string or a case insensitive substring.  A plain literal
+                // can only regex-match by being equal, which the substring test already covers,
+                // so only expressions with regex syntax need a compiled regex.  What counts as
+                // regex syntax is shared with the free-text search.
+                if (term.mSearchType == MRIBrowser::CONTAINS && MRIDTextIndex::isRegExp(term.mExpr))
+                {
+                    try
+                    {
+                        term.mRegExp.assign(term.mExpr);
+                        term.mHasRegExp = true;
+                    }
+                    catch (boost::regex_error&)
+                    {
+                        WApplication::instance()->log("error") << "Invalid regular expression in project search term: " << term.mExpr;
+                    }
+                }
+
+                // Range terms on dates and ages compare typed values.  Expressions that
+                // do not parse fall back to comparing strings.
+                MRIDCatalog::ValueTypeEnum valueType = MRIDCatalog::getValueType(i);
+                int value;
+                if ((term.mSearchType == MRIBrowser::GEQUAL || term.mSearchType == MRIBrowser::LEQUAL) &&
+                    valueType != MRIDCatalog::VALUE_NONE &&
+                    MRIDCatalog::parseValue(valueType, term.mExpr.c_str(), value))
+                {
+                    term.mHasValueRange = true;
+                    term.mMinValue = (term.mSearchType == MRIBrowser::GEQUAL) ? value : INT_MIN + 1;
+                    term.mMaxValue = (term.mSearchType == MRIBrowser::LEQUAL) ? value : INT_MAX;
+                }
+
+                mTerms.push_back(term);
+            }
+        }
+
+        iter++;
+    }
+}
+
+///
+//  Remove all search terms, every row will pass
+//
+void ProjectFilter::clear()
+{
+    mTerms.clear();
+    mSearchMatchType = MRIBrowser::ANY;
+}
+
+///
+//  Evaluate the filter over every row of a catalog
+//
+void ProjectFilter::evaluate(const MRIDCatalog& catalog, RowBitmap& rows) const
+{
+    int numRows = catalog.getNumRecords();
+
+    if (mTerms.empty())
+    {
+        rows.reset(numRows, true);
+        return;
+    }
+
+    // Results of a term on an interned string are cached by string id, so a term on
+    // a field such as the scanner model is evaluated once per distinct value.  Range
+    // terms look up all of their rows up front by binary search.
+    std::vector<TermState> states(mTerms.size());
+    std::vector< std::pair<double, int> > order;
+
+    for (size_t i = 0; i < mTerms.size(); i++)
+    {
+        const Term& term = mTerms[i];
+        if (term.mHasValueRange)
+        {
+            states[i].mRangeRows.reset(numRows, false);
+            catalog.findValueRange(term.mField, term.mMinValue, term.mMaxValue, states[i].mRangeRows);
+        }
+        else if (term.mField == MRIBrowser::SCAN || MRIDCatalog::isInternedField(term.mField))
+        {
+            states[i].mMemo.assign(catalog.getNumStrings(), (char)MATCH_UNKNOWN);
+        }
+
+        order.push_back(std::make_pair(estimateSelectivity(term, catalog, states[i]), (int)i));
+    }
+
+    // For ALL, evaluate the most selective terms first so that later terms only visit
+    // the rows that are still candidates.  For ANY, evaluate the least selective terms
+    // first so that later terms only visit the rows that have not matched yet.
+    std::sort(order.begin(), order.end());
+
+    if (mSearchMatchType == MRIBrowser::ALL)
+    {
+        rows.reset(numRows, true);
+
+        for (size_t i = 0; i < order.size(); i++)
+        {
+            const Term& term = mTerms[order[i].second];
+            TermState& state = states[order[i].second];
+
+            for (int row = rows.findNext(0); row != -1; row = rows.findNext(row + 1))
+            {
+                if (!matchRow(term, catalog, row, state))
+                {
+                    rows.clear(row);
+                }
+            }
+        }
+    }
+    else
+    {
+        rows.reset(numRows, false);
+
+        for (size_t i = order.size(); i > 0; i--)
+        {
+            const Term& term = mTerms[order[i - 1].second];
+            TermState& state = states[order[i - 1].second];
+
+            for (int row = 0; row < numRows; row++)
+            {
+                if (!rows.test(row) && matchRow(term, catalog, row, state))
+                {
+                    rows.set(row);
+                }
+            }
+        }
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Protected Members
+//
+//
+
+///
+//  Compare a single string against a term
+//
+bool ProjectFilter::matchString(const Term& term, const char* str) const
+{
+    if (str[0] == '\0')
+        return false;
+
+    switch(term.mSearchType)
+    {
+    case MRIBrowser::CONTAINS:
+        if (term.mHasRegExp && boost::regex_match(str, term.mRegExp))
+        {
+            return true;
+        }
+        return boost::algorithm::icontains(str, term.mExpr);
+    case MRIBrowser::EQUAL:
+        return strcmp(str, term.mExpr.c_str()) == 0;
+    case MRIBrowser::GEQUAL:
+        return strcmp(str, term.mExpr.c_str()) >= 0;
+    case MRIBrowser::LEQUAL:
+        return strcmp(str, term.mExpr.c_str()) <= 0;
+    default:
+        break;
+    }
+
+    return false;
+}
+
+///
+//  Compare a catalog string against a term, caching the result by string id
+//
+bool ProjectFilter::matchStringId(const Term& term, const MRIDCatalog& catalog, int id, TermState& state) const
+{
+    std::vector<char>& memo = state.mMemo;
+
+    if (memo.empty())
+    {
+        return matchString(term, catalog.getString(id));
+    }
+
+    if (memo[id] == MATCH_UNKNOWN)
+    {
+        memo[id] = matchString(term, catalog.getString(id)) ? MATCH_TRUE : MATCH_FALSE;
+    }
+
+    return memo[id] == MATCH_TRUE;
+}
+
+///
+//  Evaluate a term for one row of the catalog
+//
+bool ProjectFilter::matchRow(const Term& term, const MRIDCatalog& catalog, int row, TermState& state) const
+{
+    // Special handling for scan which has multiple entries, any of which can match
+    if (term.mField == MRIBrowser::SCAN)
+    {
+        int numScans = catalog.getListSize(row, MRIDCatalog::SCAN_LIST);
+        for (int scan = 0; scan < numScans; scan++)
+        {
+            if (matchStringId(term, catalog, catalog.getListId(row, MRIDCatalog::SCAN_LIST, scan), state))
+            {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    // A record that does not have the field at all is not excluded by the term
+    int id = catalog.getFieldId(row, term.mField);
+    if (id == MRIDCatalog::EMPTY_STRING_ID)
+    {
+        return true;
+    }
+
+    // A value that is not a valid date or age is never in the range
+    if (term.mHasValueRange)
+    {
+        return state.mRangeRows.test(row);
+    }
+
+    return matchStringId(term, catalog, id, state);
+}
+
+///
+//  Estimate the fraction of rows a term matches by sampling the catalog
+//
+double ProjectFilter::estimateSelectivity(const Term& term, const MRIDCatalog& catalog, TermState& state) const
+{
+    int numRows = catalog.getNumRecords();
+    if (numRows == 0)
+    {
+        return 0.0;
+    }
+
+    int step = std::max(1, numRows / SELECTIVITY_SAMPLE_ROWS);
+    int numSampled = 0;
+    int numMatched = 0;
+
+    for (int row = 0; row < numRows; row += step)
+    {
+        if (matchRow(term, catalog, row, state))
+        {
+            numMatched++;
+        }
+        numSampled++;
+    }
+
+    return (double)numMatched / (double)numSampled;
+}
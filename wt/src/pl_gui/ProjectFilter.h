@@ -0,0 +1,148 @@
+//
+//
+//  Description:
+//      Definition of the compiled project filter.  The search terms of a project file
+//      are compiled once into a list of prebuilt matchers which are then evaluated over
+//      a whole MRID catalog in a single pass, producing a bitmap of matching rows.
+//      Range terms on dates and ages are answered from the catalog's sorted typed
+//      columns rather than by comparing strings.
+//
+//  Author:
+//      Dan Ginsburg
+//
+//  Children's Hospital Boston
+//  GPL v2
+//
+#ifndef PROJECTFILTER_H
+#define PROJECTFILTER_H
+
+#include "MRIBrowser.h"
+#include "RowBitmap.h"
+#include <boost/regex.hpp>
+#include <string>
+#include <vector>
+
+class MRIDCatalog;
+class ProjectXML;
+
+///
+/// \class ProjectFilter
+/// \brief Project search terms compiled into a predicate program over an MRIDCatalog
+///
+class ProjectFilter
+{
+public:
+
+    ///
+    /// Constructor
+    ///
+    ProjectFilter();
+
+    ///
+    /// Destructor
+    ///
+    virtual ~ProjectFilter();
+
+    ///
+    /// Compile the search terms of a project
+    /// \param projectXML Loaded project file
+    ///
+    void compile(ProjectXML& projectXML);
+
+    ///
+    /// Remove all search terms, every row will pass
+    ///
+    void clear();
+
+    ///
+    /// Get the number of compiled search terms
+    ///
+    int getNumTerms() const                     {   return (int)mTerms.size();  }
+
+    ///
+    /// Evaluate the filter over every row of a catalog
+    /// \param catalog Catalog to evaluate
+    /// \param rows Output, set for each row that passes the filter
+    ///
+    void evaluate(const MRIDCatalog& catalog, RowBitmap& rows) const;
+
+protected:
+
+    /// Compiled search term
+    typedef struct
+    {
+        /// Field to search (MRIBrowser::MRIFieldEnum)
+        int mField;
+
+        /// Search type
+        MRIBrowser::MRISearchTypeEnum mSearchType;
+
+        /// Search expression
+        std::string mExpr;
+
+        /// Whether the expression contains regular expression syntax
+        bool mHasRegExp;
+
+        /// Prebuilt regular expression (CONTAINS only, if mHasRegExp)
+        boost::regex mRegExp;
+
+        /// Whether the term is a range over the field's typed column
+        bool mHasValueRange;
+
+        /// Smallest typed value that matches (if mHasValueRange)
+        int mMinValue;
+
+        /// Largest typed value that matches (if mHasValueRange)
+        int mMaxValue;
+
+    } Term;
+
+    /// State of a term while it is evaluated over a catalog
+    typedef struct
+    {
+        /// Per-string-id results (interned fields only)
+        std::vector<char> mMemo;
+
+        /// Rows in the term's value range (range terms only)
+        RowBitmap mRangeRows;
+
+    } TermState;
+
+    /// Cached per-string result of a term
+    typedef enum
+    {
+        MATCH_UNKNOWN = 0,
+        MATCH_FALSE,
+        MATCH_TRUE
+    } MatchEnum;
+
+    ///
+    /// Compare a single string against a term
+    ///
+    bool matchString(const Term& term, const char* str) const;
+
+    ///
+    /// Compare a catalog string against a term, caching the result by string id
+    ///
+    bool matchStringId(const Term& term, const MRIDCatalog& catalog, int id, TermState& state) const;
+
+    ///
+    /// Evaluate a term for one row of the catalog
+    ///
+    bool matchRow(const Term& term, const MRIDCatalog& catalog, int row, TermState& state) const;
+
+    ///
+    /// Estimate the fraction of rows a term matches by sampling the catalog
+    ///
+    double estimateSelectivity(const Term& term, const MRIDCatalog& catalog, TermState& state) const;
+
+protected:
+
+    /// Compiled search terms
+    std::vector<Term> mTerms;
+
+    /// Type to match (any or all)
+    MRIBrowser::MRISearchMatch mSearchMatchType;
+};
+
+#endif // PROJECTFILTER_H
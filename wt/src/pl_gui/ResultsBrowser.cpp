@@ -34,6 +34,7 @@
 #include <boost/filesystem.hpp>
 #include <boost/algorithm/string/trim.hpp>
 #include <boost/regex.hpp>
+#include <boost/bind.hpp>
 #include <boost/process/process.hpp>
 #include <boost/process/child.hpp>
 #include <boost/process/launch_shell.hpp>
@@ -137,16 +138,6 @@ void ResultsBrowser::resetAll()
 
     populateBrowser();
 
-    mTreeView->expandToDepth(4);
-
-    if (mModel->rowCount() == 0)
-    {
-        WStandardItem *newItem = new WStandardItem("NO RESULTS FOUND");
-        newItem->setFlags(newItem->flags().clear(ItemIsSelectable));
-        newItem->setIcon("icons/folder.gif");
-        mModel->appendRow(newItem);
-    }
-
     mDownloadStack->setCurrentIndex(0);
     if (mTarBuffer != NULL)
     {
@@ -188,87 +179,194 @@ void ResultsBrowser::setPipelineName(const std::string& pipelineName)
 
 ///
 //  Populate the results job model by parsing patterns stored in the configuration
-//  file
+//  file.  The directories are read on an I/O thread and the model is filled in
+//  when they have been.
 //
 void ResultsBrowser::populateBrowser()
 {
+    // A scan still running for the previous refresh is no longer wanted
+    mIOClient.cancel();
+
     WStandardItemModel *model = getConfigXMLPtr()->getResultsPipelineTree(mPipelineName);
     mResultFileEntries.clear();
 
+    boost::shared_ptr<ResultsLoad> load(new ResultsLoad());
+    load->mResultsBaseDir = mResultsBaseDir;
+
     if (model != NULL)
     {
-        int index = 0;
         for(int row = 0; row < model->rowCount(); row++)
         {
-            WStandardItem *item = model->item(row);
-
-            addFilesFromTree(item, mResultsBaseDir, -1, index);
+            int patternIndex = addPatternsFromTree(load, model->item(row));
+            if (patternIndex >= 0)
+            {
+                load->mRootPatterns.push_back(patternIndex);
+            }
         }
     }
+
+    // Show that the results are loading until the directories have been read
+    addStatusItem("Loading...");
+
+    mIOClient.submit(boost::bind(&ResultsBrowser::loadResults, load),
+                     boost::bind(&ResultsBrowser::resultsLoaded, this, load, _1));
 }
 
 ///
-///  Add files from tree
-///
-void ResultsBrowser::addFilesFromTree(WStandardItem *item, const std::string& baseDir, int depth, int &index)
+//  Copy the file patterns of a configuration tree item into the load
+//
+int ResultsBrowser::addPatternsFromTree(boost::shared_ptr<ResultsLoad> load, WStandardItem *item)
 {
     boost::any data = item->data(UserRole);
-    if (!data.empty() && exists(baseDir))
+    if (data.empty())
     {
-        ConfigXML::FilePatternNode node = boost::any_cast<ConfigXML::FilePatternNode>(data);
+        return -1;
+    }
 
+    ConfigXML::FilePatternNode node = boost::any_cast<ConfigXML::FilePatternNode>(data);
 
-        path basePath(baseDir);
-        regex regEx;
+    ResultPattern pattern;
+    pattern.mDirectory = node.mDirectory;
+    pattern.mRecurse = node.mRecurse;
+
+    try
+    {
+        pattern.mRegEx = regex(node.mExpression);
+    }
+    catch(...)
+    {
+        WApplication::instance()->log("error") << "Invalid regular expression '" << node.mExpression << "' in config XML file";
+        pattern.mRegEx = regex();
+    }
 
-        try
+    int patternIndex = (int)load->mPatterns.size();
+    load->mPatterns.push_back(pattern);
+
+    for(int row = 0; row < item->rowCount(); row++)
+    {
+        int childIndex = addPatternsFromTree(load, item->child(row));
+        if (childIndex >= 0)
         {
-            regEx = regex(node.mExpression);
+            load->mPatterns[patternIndex].mChildren.push_back(childIndex);
         }
-        catch(...)
+    }
+
+    return patternIndex;
+}
+
+///
+//  Find the result files (I/O thread)
+//
+void ResultsBrowser::loadResults(boost::shared_ptr<ResultsLoad> load)
+{
+    try
+    {
+        for (size_t i = 0; i < load->mRootPatterns.size(); i++)
         {
-            WApplication::instance()->log("error") << "Invalid regular expression '" << node.mExpression << "' in config XML file";
-            regEx = regex();
+            addFilesFromTree(load, load->mRootPatterns[i], load->mResultsBaseDir, -1);
         }
+    }
+    catch(...)
+    {
+        // A directory may have gone away while being read, show what was found
+    }
+}
 
-        for(directory_iterator dirIter(basePath); dirIter != directory_iterator(); ++dirIter)
-        {
-            const string fileName = dirIter->path().filename().string();
+///
+///  Add files from tree
+///
+void ResultsBrowser::addFilesFromTree(boost::shared_ptr<ResultsLoad> load, int patternIndex,
+                                      const std::string& baseDir, int depth)
+{
+    if (!exists(baseDir))
+    {
+        return;
+    }
+
+    const ResultPattern& pattern = load->mPatterns[patternIndex];
+    path basePath(baseDir);
+
+    for(directory_iterator dirIter(basePath); dirIter != directory_iterator(); ++dirIter)
+    {
+        const string fileName = dirIter->path().filename().string();
 
-            boost::smatch what;
+        boost::smatch what;
 
-            // Skip if no match
-            if( !boost::regex_match( fileName, what, regEx ) )
-                continue;
+        // Skip if no match
+        if( !boost::regex_match( fileName, what, pattern.mRegEx ) )
+            continue;
 
-            if (is_directory(dirIter->path()) && (node.mDirectory || node.mRecurse))
+        if (is_directory(dirIter->path()) && (pattern.mDirectory || pattern.mRecurse))
+        {
+            if (pattern.mDirectory)
             {
-                if (node.mDirectory)
+                // Now do this for all the children of this directory
+                for(size_t child = 0; child < pattern.mChildren.size(); child++)
                 {
-                    // Now do this for all the children of this directory
-                    for(int row = 0; row < item->rowCount(); row++)
-                    {
-                        addFilesFromTree(item->child(row), dirIter->path().string(), depth + 1, index);
-                    }
-                }
-                else if (node.mRecurse)
-                {
-                    addFilesFromTree(item, dirIter->path().string(), depth + 1, index);
+                    addFilesFromTree(load, pattern.mChildren[child], dirIter->path().string(), depth + 1);
                 }
             }
-            else if(!is_directory(dirIter->path()) && !node.mDirectory)
+            else if (pattern.mRecurse)
             {
-                addEntry(false, depth,
-                         dirIter->path().branch_path().string(), dirIter->path().leaf().string(),
-                         index);
-
-                mResultFileEntries.push_back(dirIter->path().string());
-                index++;
+                addFilesFromTree(load, patternIndex, dirIter->path().string(), depth + 1);
             }
         }
+        else if(!is_directory(dirIter->path()) && !pattern.mDirectory)
+        {
+            ResultEntry entry;
+            entry.mDepth = depth;
+            entry.mBaseDir = dirIter->path().branch_path().string();
+            entry.mBaseName = dirIter->path().leaf().string();
+            entry.mFilePath = dirIter->path().string();
+
+            load->mEntries.push_back(entry);
+        }
     }
 }
 
+///
+//  Result files found
+//
+void ResultsBrowser::resultsLoaded(boost::shared_ptr<ResultsLoad> load, IOExecutor::StatusEnum status)
+{
+    // Remove the loading item
+    mModel->clear();
+    mResultFileEntries.clear();
+
+    if (status == IOExecutor::IO_TIMED_OUT)
+    {
+        WApplication::instance()->log("error") << "Timed out reading results in: " << load->mResultsBaseDir;
+        addStatusItem("TIMED OUT READING RESULTS");
+        return;
+    }
+
+    for (size_t i = 0; i < load->mEntries.size(); i++)
+    {
+        const ResultEntry& entry = load->mEntries[i];
+
+        addEntry(false, entry.mDepth, entry.mBaseDir, entry.mBaseName, (int)i);
+        mResultFileEntries.push_back(entry.mFilePath);
+    }
+
+    mTreeView->expandToDepth(4);
+
+    if (mModel->rowCount() == 0)
+    {
+        addStatusItem("NO RESULTS FOUND");
+    }
+}
+
+///
+//  Add an item showing the state of the results
+//
+void ResultsBrowser::addStatusItem(const std::string& text)
+{
+    WStandardItem *newItem = new WStandardItem(text);
+    newItem->setFlags(newItem->flags().clear(ItemIsSelectable));
+    newItem->setIcon("icons/folder.gif");
+    mModel->appendRow(newItem);
+}
+
 
 ///
 //  Results selection changed by user
@@ -301,16 +399,6 @@ void ResultsBrowser::refreshResults()
     delete oldModel;
 
     populateBrowser();
-
-    mTreeView->expandToDepth(4);
-
-    if (mModel->rowCount() == 0)
-    {
-        WStandardItem *newItem = new WStandardItem("NO RESULTS FOUND");
-        newItem->setFlags(newItem->flags().clear(ItemIsSelectable));
-        newItem->setIcon("icons/folder.gif");
-        mModel->appendRow(newItem);
-    }
 }
 
 ///
@@ -14,7 +14,9 @@
 #define RESULTSBROWSER_H
 
 #include "FileBrowser.h"
+#include "IOClient.h"
 #include <vector>
+#include <boost/regex.hpp>
 #include <boost/thread/thread.hpp>
 #include <boost/shared_ptr.hpp>
 
@@ -77,6 +79,57 @@ public:
 
 protected:
 
+    /// File pattern of the results tree, copied from the configuration
+    typedef struct
+    {
+        /// Expression for matching files
+        boost::regex mRegEx;
+
+        /// Whether the pattern matches a directory
+        bool mDirectory;
+
+        /// Whether to recurse into matching directories
+        bool mRecurse;
+
+        /// Indices of the child patterns
+        std::vector<int> mChildren;
+
+    } ResultPattern;
+
+    /// Result file found
+    typedef struct
+    {
+        /// Depth of the file below the results base directory
+        int mDepth;
+
+        /// Directory of the file
+        std::string mBaseDir;
+
+        /// File name
+        std::string mBaseName;
+
+        /// Full path of the file
+        std::string mFilePath;
+
+    } ResultEntry;
+
+    /// Results being read
+    typedef struct
+    {
+        /// Results base directory
+        std::string mResultsBaseDir;
+
+        /// All file patterns
+        std::vector<ResultPattern> mPatterns;
+
+        /// Indices of the top level patterns
+        std::vector<int> mRootPatterns;
+
+        /// Result files found, in the order they are added to the browser
+        std::vector<ResultEntry> mEntries;
+
+    } ResultsLoad;
+
     ///
     ///  Populate the browser model by parsing the directories for log files
     ///
@@ -88,10 +141,31 @@ protected:
     void resultChanged();
 
     ///
-    ///  Add files from tree
+    ///  Copy the file patterns of a configuration tree item into the load
+    ///  \return Index of the item's pattern, -1 if the item has none
+    ///
+    int addPatternsFromTree(boost::shared_ptr<ResultsLoad> load, WStandardItem *item);
+
+    ///
+    ///  Find the result files (I/O thread)
+    ///
+    static void loadResults(boost::shared_ptr<ResultsLoad> load);
+
+    ///
+    ///  Add files from tree (I/O thread)
     ///
-    void addFilesFromTree(WStandardItem *item, const std::string& baseDir,
-                          int depth, int &index);
+    static void addFilesFromTree(boost::shared_ptr<ResultsLoad> load, int patternIndex,
+                                 const std::string& baseDir, int depth);
+
+    ///
+    ///  Result files found [I/O callback]
+    ///
+    void resultsLoaded(boost::shared_ptr<ResultsLoad> load, IOExecutor::StatusEnum status);
+
+    ///
+    ///  Add an item showing the state of the results
+    ///
+    void addStatusItem(const std::string& text);
 
     ///
     ///  Handle refresh results button clicked [slot]
@@ -144,6 +218,9 @@ private:
     /// Buffer holding tarball file
     unsigned char *mTarBuffer;
 
+    /// Reads the results directories off the session
+    IOClient mIOClient;
+
 };
 
 #endif // LOGFILEBROWSER_H
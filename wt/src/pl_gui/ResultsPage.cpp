@@ -307,7 +307,7 @@ void ResultsPage::resultClicked(std::string clusterShFile, std::string metaScrip
 
     if (jobID != "")
     {
-        mJobStatus->setJob(clusterShFile, metaScript, jobID, userName);
+        mJobStatus->setJob(clusterShFile, metaScript, arguments, jobID, userName);
     }
 }
 
@@ -12,10 +12,11 @@
 #include "PipelineApp.h"
 #include "ResultsTable.h"
 #include "ConfigOptions.h"
+#include "ClusterJobCatalogCache.h"
+#include "ClusterJobModel.h"
 #include "ConfigXML.h"
 #include "MonitorResultsTab.h"
 #include "MonitorLogTab.h"
-#include "ResultsFilterProxyModel.h"
 #include <Wt/WApplication>
 #include <Wt/WLogger>
 #include <Wt/WContainerWidget>
@@ -28,16 +29,13 @@
 #include <Wt/WMessageBox>
 #include <Wt/WTabWidget>
 #include <Wt/WTreeView>
-#include <Wt/WStandardItem>
-#include <Wt/WStandardItemModel>
-#include <Wt/WSortFilterProxyModel>
 #include <Wt/WDateTime>
 
 #include <stdlib.h>
+#include <algorithm>
 #include <fstream>
 #include <iostream>
 #include <string>
-#include <mxml.h>
 #include <vector>
 
 ///
@@ -56,25 +54,11 @@ using namespace std;
 //  Constructor
 //
 ResultsTable::ResultsTable(WContainerWidget *parent) :
-    WContainerWidget(parent),
-    mSortFilterProxyModel(NULL)
+    WContainerWidget(parent)
 {
     setStyleClass("tabdiv");
 
-    mModel = new WStandardItemModel(this);
-    mModel->insertColumns(0, 11);
-    mModel->setHeaderData(0, boost::any(WString::fromUTF8("Date")));
-    mModel->setHeaderData(1, boost::any(WString::fromUTF8("User")));
-    mModel->setHeaderData(2, boost::any(WString::fromUTF8("MRID")));
-    mModel->setHeaderData(3, boost::any(WString::fromUTF8("Name")));
-    mModel->setHeaderData(4, boost::any(WString::fromUTF8("Scan Name")));
-    mModel->setHeaderData(5, boost::any(WString::fromUTF8("Birthday")));
-    mModel->setHeaderData(6, boost::any(WString::fromUTF8("Scan Date")));
-    mModel->setHeaderData(7, boost::any(WString::fromUTF8("Manufacturer")));
-    mModel->setHeaderData(8, boost::any(WString::fromUTF8("Model")));
-    mModel->setHeaderData(9, boost::any(WString::fromUTF8("Software Ver")));
-    mModel->setHeaderData(10, boost::any(WString::fromUTF8("Pipeline")));
-    mModel->invisibleRootItem()->setRowCount(0);
+    mModel = new ClusterJobModel(this);
 
     mTreeView = new WTreeView();
     mTreeView->setRootIsDecorated(false);
@@ -82,6 +66,9 @@ ResultsTable::ResultsTable(WContainerWidget *parent) :
     mTreeView->setSelectionMode(SingleSelection);
     mTreeView->doubleClicked().connect(SLOT(this, ResultsTable::jobSelected));
     mTreeView->clicked().connect(SLOT(this, ResultsTable::jobClicked));
+    mTreeView->setModel(mModel);
+    mTreeView->setColumnWidth(0, WLength(125, WLength::Pixel));
+    mTreeView->setColumnWidth(ClusterJobModel::STATUS_COLUMN, WLength(110, WLength::Pixel));
 
     WVBoxLayout *layout = new WVBoxLayout();
     layout->addWidget(mTreeView);
@@ -110,25 +97,14 @@ ResultsTable::~ResultsTable()
 //
 void ResultsTable::resetAll()
 {
-    if (mSortFilterProxyModel != NULL)
-    {
-        delete mSortFilterProxyModel;
-    }
-
-    mModel->removeRows(0, mModel->rowCount());
-
-    populateResultsTable();
+    mModel->resetAll();
 
-    mSortFilterProxyModel = new ResultsFilterProxyModel(this);
-    mSortFilterProxyModel->setSourceModel(mModel);
-    mSortFilterProxyModel->setDynamicSortFilter(true);
-    mSortFilterProxyModel->setFilterKeyColumn(0);
-    mSortFilterProxyModel->setFilterRole(DisplayRole);
-    mSortFilterProxyModel->sort(0, DescendingOrder);
-    mSortFilterProxyModel->setUserColumn(1);
+    // Every session shares the same parsed jobs, only the records appended to
+    // the schedule log since the last refresh are read
+    std::string scheduleLogFile = getConfigOptionsPtr()->GetClusterDir() + "/schedule.log.xml";
+    mModel->setCatalog(ClusterJobCatalogCache::instance().getCatalog(scheduleLogFile));
 
-    mTreeView->setModel(mSortFilterProxyModel);
-    mTreeView->setColumnWidth(0, WLength(125, WLength::Pixel));
+    mTreeView->sortByColumn(ClusterJobModel::DATE_COLUMN, DescendingOrder);
 }
 
 
@@ -154,8 +130,7 @@ void ResultsTable::jobClicked(const WModelIndex& item)
 //
 void ResultsTable::setUserFilter(bool filter, std::string userFilter)
 {
-    mSortFilterProxyModel->setUserFilter(filter, userFilter);
-    mTreeView->sortByColumn(0, DescendingOrder);
+    mModel->setUserFilter(filter, userFilter);
 }
 
 ///
@@ -163,8 +138,7 @@ void ResultsTable::setUserFilter(bool filter, std::string userFilter)
 //
 void ResultsTable::setSearchTerm(bool search, std::string searchTerm)
 {
-    mSortFilterProxyModel->setSearchTerm(search, searchTerm);
-    mTreeView->sortByColumn(0, DescendingOrder);
+    mModel->setSearchTerm(search, searchTerm);
 }
 
 ///
@@ -172,8 +146,7 @@ void ResultsTable::setSearchTerm(bool search, std::string searchTerm)
 //
 void ResultsTable::setProjectFilter(bool filter, std::string projectFilter)
 {
-    mSortFilterProxyModel->setProjectFilter(filter, projectFilter);
-    mTreeView->sortByColumn(0, DescendingOrder);
+    mModel->setProjectFilter(filter, projectFilter);
 }
 
 
@@ -183,97 +156,6 @@ void ResultsTable::setProjectFilter(bool filter, std::string projectFilter)
 //
 //
 
-///
-//  Populate results table by reading the schedule.log.xml file
-//
-bool ResultsTable::populateResultsTable()
-{
-    std::string scheduleLogFile;
-    scheduleLogFile = getConfigOptionsPtr()->GetClusterDir() + "/schedule.log.xml";
-
-    FILE *fp = fopen(scheduleLogFile.c_str(), "r");
-    if (fp == NULL)
-    {
-       WApplication::instance()->log("error") << "Failed opening schedule XML log file for reading: " << scheduleLogFile;
-       return false;
-    }
-
-    mxml_node_t *tree;
-
-    tree = mxmlLoadFile(NULL, fp, MXML_OPAQUE_CALLBACK);
-
-    bool result = true;
-    mxml_node_t *clusterJobNode;
-
-    for (clusterJobNode = mxmlFindElement(tree, tree,
-                                          "ClusterJob",
-                                          NULL, NULL,
-                                          MXML_DESCEND);
-        clusterJobNode != NULL;
-        clusterJobNode = mxmlFindElement(clusterJobNode, tree,
-                                         "ClusterJob",
-                                         NULL, NULL,
-                                         MXML_NO_DESCEND))
-    {
-        int row = mModel->rowCount();
-        mModel->insertRows(row, 1);
-
-        mxml_node_t *dateNode = mxmlFindElement(clusterJobNode, clusterJobNode, "Date", NULL, NULL, MXML_DESCEND);
-        if (dateNode != NULL && dateNode->child != NULL)
-        {
-            const char *dateStr = dateNode->child->value.opaque;
-            WDateTime dateTime = WDateTime::fromString(WString(dateStr),
-                                                       "MM/dd/yy HH:mm:ss ddd");
-            boost::any data = boost::any(dateTime);
-
-            mModel->setData(row, 0,  data);
-        }
-        // Set extended (not for display) data
-        setDataColumn(clusterJobNode, "Command", row, 0, UserRole);
-        setDataColumn(clusterJobNode, "MetaScript", row, 0, UserRole + 1);
-        setDataColumn(clusterJobNode, "Arguments", row, 0, UserRole + 2);
-        setDataColumn(clusterJobNode, "JobId", row, 0, UserRole + 3);
-        setDataColumn(clusterJobNode, "Project", row, 0, UserRole + 4);
-
-        // Set display data
-        setDataColumn(clusterJobNode, "User", row, 1);
-        setDataColumn(clusterJobNode, "PatientID", row, 2);
-        setDataColumn(clusterJobNode, "PatientName", row, 3);
-        setDataColumn(clusterJobNode, "ScanName", row, 4);
-        setDataColumn(clusterJobNode, "PatientBirthday", row, 5);
-        setDataColumn(clusterJobNode, "ImageScanDate", row, 6);
-        setDataColumn(clusterJobNode, "ScannerManufacturer", row, 7);
-        setDataColumn(clusterJobNode, "ScannerModel", row, 8);
-        setDataColumn(clusterJobNode, "SoftwareVer", row, 9);
-        setDataColumn(clusterJobNode, "MetaScript", row, 10);
-    }
-
-    fclose(fp);
-    mxmlRelease(tree);
-
-    return result;
-}
-
-///
-//  Set data in the model from an XML node
-//
-void ResultsTable::setDataColumn(mxml_node_t *node, const char* name, int row, int col, int role)
-{
-    boost::any data;
-    mxml_node_t *dataNode = mxmlFindElement(node, node, name, NULL, NULL, MXML_DESCEND);
-    if (dataNode != NULL && dataNode->child != NULL)
-    {
-        std::string dataStr = std::string(dataNode->child->value.opaque);
-
-        if (dataStr != "ERROR:")
-        {
-            data = boost::any(WString::fromUTF8(dataStr));
-            mModel->setData(row, col,  data, role);
-        }
-    }
-}
-
-
 ///
 /// Handle emitting result clicked or selected (they do the same thing except
 /// for the signal so combined into one function)
@@ -283,12 +165,12 @@ void ResultsTable::emitJobClickedOrSelected(const WModelIndex& item, bool clicke
 
     int modelRow = item.row();
 
-    boost::any d = mSortFilterProxyModel->data(modelRow, 0, UserRole);
-    boost::any d1 = mSortFilterProxyModel->data(modelRow, 0, UserRole + 1);
-    boost::any d2 = mSortFilterProxyModel->data(modelRow, 0, UserRole + 2);
-    boost::any d3 = mSortFilterProxyModel->data(modelRow, 0, UserRole + 3);
-    boost::any d4 = mSortFilterProxyModel->data(modelRow, 1, DisplayRole);
-    boost::any d5 = mSortFilterProxyModel->data(modelRow, 0, UserRole + 4);
+    boost::any d = mModel->data(modelRow, ClusterJobModel::DATE_COLUMN, ClusterJobModel::COMMAND_ROLE);
+    boost::any d1 = mModel->data(modelRow, ClusterJobModel::DATE_COLUMN, ClusterJobModel::META_SCRIPT_ROLE);
+    boost::any d2 = mModel->data(modelRow, ClusterJobModel::DATE_COLUMN, ClusterJobModel::ARGUMENTS_ROLE);
+    boost::any d3 = mModel->data(modelRow, ClusterJobModel::DATE_COLUMN, ClusterJobModel::JOB_ID_ROLE);
+    boost::any d4 = mModel->data(modelRow, ClusterJobModel::USER_COLUMN, DisplayRole);
+    boost::any d5 = mModel->data(modelRow, ClusterJobModel::DATE_COLUMN, ClusterJobModel::PROJECT_ROLE);
 
     if (!d.empty() && !d1.empty() && !d2.empty())
     {
@@ -16,16 +16,14 @@
 #include <Wt/WString>
 #include <Wt/WText>
 #include <string>
-#include <mxml.h>
-#include <Wt/WStandardItemModel>
 
 namespace Wt
 {
     class WTreeView;
-    class WSortFilterProxyModel;
+    class WStandardItem;
 }
 
-class ResultsFilterProxyModel;
+class ClusterJobModel;
 
 using namespace Wt;
 
@@ -91,16 +89,6 @@ private:
     //
     void jobClicked(const WModelIndex& item);
 
-    ///
-    ///  Populate results table by reading the schedule.log.xml file
-    ///
-    bool populateResultsTable();
-
-    ///
-    ///  Set data in the model from an XML node
-    ///
-    void setDataColumn(mxml_node_t *node, const char* name, int row, int col, int role=EditRole);
-
     ///
     /// Translate arguments to script using pipeline options specification given in main
     /// configuration XML file
@@ -121,14 +109,11 @@ private:
     /// Result clicked signal
     Wt::Signal<std::string, std::string,std::string,std::string,std::string, std::string> mResultClicked;
 
-    /// Model representing cluster jobs
-    WStandardItemModel *mModel;
+    /// Sorted and filtered model representing cluster jobs, backed by the shared job catalog
+    ClusterJobModel *mModel;
 
     /// Tree view for displaying of cluster jobs
     WTreeView *mTreeView;
-
-    /// Sort/Filter proxy model for table
-    ResultsFilterProxyModel *mSortFilterProxyModel;
 };
 
 #endif // RESULTSTABLE_H
@@ -0,0 +1,170 @@
+//
+//
+//  Description:
+//      Implementation of the row bitmap.  A compact set of row indices, one bit per row,
+//      used to hold the result of evaluating a filter over a whole catalog.
+//
+//  Author:
+//      Dan Ginsburg
+//
+//  Children's Hospital Boston
+//  GPL v2
+//
+#include "RowBitmap.h"
+#include <algorithm>
+
+///
+//  Namespaces
+//
+using namespace std;
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Constructor/Destructor
+//
+//
+
+///
+//  Constructor
+//
+RowBitmap::RowBitmap(int numRows, bool value)
+{
+    reset(numRows, value);
+}
+
+///
+//  Destructor
+//
+RowBitmap::~RowBitmap()
+{
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Public Members
+//
+//
+
+///
+//  Resize the bitmap, setting every row to value
+//
+void RowBitmap::reset(int numRows, bool value)
+{
+    mNumRows = numRows;
+    mWords.assign((numRows + 31) / 32, value ? 0xFFFFFFFFu : 0u);
+    clearTail();
+}
+
+///
+//  Set or clear every row
+//
+void RowBitmap::fill(bool value)
+{
+    mWords.assign(mWords.size(), value ? 0xFFFFFFFFu : 0u);
+    clearTail();
+}
+
+///
+//  Keep only the rows that are also set in other
+//
+void RowBitmap::intersect(const RowBitmap& other)
+{
+    size_t numWords = std::min(mWords.size(), other.mWords.size());
+
+    for (size_t i = 0; i < numWords; i++)
+    {
+        mWords[i] &= other.mWords[i];
+    }
+
+    for (size_t i = numWords; i < mWords.size(); i++)
+    {
+        mWords[i] = 0;
+    }
+}
+
+///
+//  Add all of the rows that are set in other
+//
+void RowBitmap::unite(const RowBitmap& other)
+{
+    size_t numWords = std::min(mWords.size(), other.mWords.size());
+
+    for (size_t i = 0; i < numWords; i++)
+    {
+        mWords[i] |= other.mWords[i];
+    }
+
+    clearTail();
+}
+
+///
+//  Get the number of rows that are set
+//
+int RowBitmap::count() const
+{
+    int total = 0;
+
+    for (size_t i = 0; i < mWords.size(); i++)
+    {
+        boost::uint32_t word = mWords[i];
+        while (word != 0)
+        {
+            word &= word - 1;
+            total++;
+        }
+    }
+
+    return total;
+}
+
+///
+//  Get the first set row at or after row
+//
+int RowBitmap::findNext(int row) const
+{
+    if (row < 0)
+    {
+        row = 0;
+    }
+
+    while (row < mNumRows)
+    {
+        boost::uint32_t word = mWords[row >> 5] >> (row & 31);
+
+        if (word == 0)
+        {
+            // Skip to the start of the next word
+            row = (row | 31) + 1;
+            continue;
+        }
+
+        while ((word & 1u) == 0)
+        {
+            word >>= 1;
+            row++;
+        }
+
+        return row < mNumRows ? row : -1;
+    }
+
+    return -1;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Protected Members
+//
+//
+
+///
+//  Clear the unused bits in the last word
+//
+void RowBitmap::clearTail()
+{
+    int tailBits = mNumRows & 31;
+
+    if (tailBits != 0 && !mWords.empty())
+    {
+        mWords.back() &= (1u << tailBits) - 1;
+    }
+}
@@ -0,0 +1,115 @@
+//
+//
+//  Description:
+//      Definition of the row bitmap.  A compact set of row indices, one bit per row,
+//      used to hold the result of evaluating a filter over a whole catalog.
+//
+//  Author:
+//      Dan Ginsburg
+//
+//  Children's Hospital Boston
+//  GPL v2
+//
+#ifndef ROWBITMAP_H
+#define ROWBITMAP_H
+
+#include <boost/cstdint.hpp>
+#include <vector>
+
+///
+/// \class RowBitmap
+/// \brief Fixed size set of rows stored as one bit per row
+///
+class RowBitmap
+{
+public:
+
+    ///
+    /// Constructor
+    /// \param numRows Number of rows in the bitmap
+    /// \param value Initial value of every row
+    ///
+    RowBitmap(int numRows = 0, bool value = false);
+
+    ///
+    /// Destructor
+    ///
+    virtual ~RowBitmap();
+
+    ///
+    /// Resize the bitmap, setting every row to value
+    ///
+    void reset(int numRows, bool value = false);
+
+    ///
+    /// Get the number of rows in the bitmap
+    ///
+    int getNumRows() const                  {   return mNumRows;    }
+
+    ///
+    /// Test whether a row is set
+    ///
+    bool test(int row) const
+    {
+        return (mWords[row >> 5] & (1u << (row & 31))) != 0;
+    }
+
+    ///
+    /// Set a row
+    ///
+    void set(int row)
+    {
+        mWords[row >> 5] |= (1u << (row & 31));
+    }
+
+    ///
+    /// Clear a row
+    ///
+    void clear(int row)
+    {
+        mWords[row >> 5] &= ~(1u << (row & 31));
+    }
+
+    ///
+    /// Set or clear every row
+    ///
+    void fill(bool value);
+
+    ///
+    /// Keep only the rows that are also set in other
+    ///
+    void intersect(const RowBitmap& other);
+
+    ///
+    /// Add all of the rows that are set in other
+    ///
+    void unite(const RowBitmap& other);
+
+    ///
+    /// Get the number of rows that are set
+    ///
+    int count() const;
+
+    ///
+    /// Get the first set row at or after row
+    /// \return Row index, or -1 if there are no more set rows
+    ///
+    int findNext(int row) const;
+
+protected:
+
+    ///
+    /// Clear the unused bits in the last word
+    ///
+    void clearTail();
+
+protected:
+
+    /// Number of rows
+    int mNumRows;
+
+    /// Bits, 32 rows per word
+    std::vector<boost::uint32_t> mWords;
+};
+
+#endif // ROWBITMAP_H
@@ -12,6 +12,8 @@
 #include "PipelineApp.h"
 #include "ScanBrowser.h"
 #include "PatientInfoBox.h"
+#include "StudyMetadata.h"
+#include "StudyMetadataCache.h"
 #include "MRIInfoBox.h"
 #include "ConfigOptions.h"
 #include "ConfigXML.h"
@@ -33,6 +35,7 @@
 #include <Wt/WRadioButton>
 #include <Wt/WDialog>
 #include <Wt/WLogger>
+#include <boost/bind.hpp>
 #include <fstream>
 #include <iostream>
 #include <string>
@@ -170,7 +173,9 @@ ScanBrowser::~ScanBrowser()
 void ScanBrowser::resetAll()
 {
     mPipelineType = Enums::PIPELINE_UNKNOWN;
+    mIOClient.cancel();
     mScansSelectionBox->clear();
+    mScansSelectionBox->enable();
     mScansDicomFiles.clear();
     mScansDate = "";
     mScansSelectionBox->setCurrentIndex(0);
@@ -202,78 +207,33 @@ void ScanBrowser::resetAll()
 //
 void ScanBrowser::setScanDir(std::string scanDir)
 {
-    stringstream tocURL;
-
     // Store the scan directory for future processing
     mCurScanDir = scanDir;
 
-    tocURL << scanDir << "/toc.txt";
-
-    // Parse table-of-contents file
-    std::ifstream tocFile(tocURL.str().c_str());
-    ostringstream oss;
-
+    // A study still loading for the previous selection is no longer wanted
+    mIOClient.cancel();
 
     mScansSelectionBox->clear();
     mScansDicomFiles.clear();
     mScansDate = "";
+
+    // Show that the study is loading until the table of contents has been read
+    mScansSelectionBox->addItem("Loading...");
     mScansSelectionBox->setCurrentIndex(0);
+    mScansSelectionBox->disable();
 
-    // Load the patient info box
-    mPatientInfoBox->setScanDir(scanDir);
+    mPatientInfoBox->resetAll();
 
     // Clear the MRI info
     mMRIInfoBox->resetAll();
 
-    if (tocFile.is_open())
-    {
-        while (!tocFile.eof())
-        {
-            char buf[1024];
-            tocFile.getline( buf, sizeof(buf));
-
-            istringstream istr(string(buf), ios_base::out);
-            string firstToken;
-            istr >> firstToken;
-
-            if (firstToken == "Scan")
-            {
-                string dicomFile,
-                       scanName;
-
-                istr >> dicomFile;
-                while (!istr.eof())
-                {
-                    string tmp;
-
-                    istr >> tmp;
-                    scanName += tmp + " ";
-                }
+    // The table of contents is read on an I/O thread and shared with every other
+    // session looking at this study
+    boost::shared_ptr<StudyLoad> load(new StudyLoad());
+    load->mScanDir = scanDir;
 
-                if (scanName == "" || scanName == " ")
-                {
-                    scanName = "unnamed";
-                }
-
-                mScansSelectionBox->addItem(scanName);
-                mScansDicomFiles.push_back(dicomFile);
-            }
-            else if (firstToken == "Image")
-            {
-                string secondToken;
-                istr >> secondToken;
-
-                if (secondToken == "Scan-Date")
-                {
-                    string scanDate;
-
-                    istr >> scanDate;
-                    mScansDate = scanDate;
-                }
-            }
-        }
-        tocFile.close();
-   }
+    mIOClient.submit(boost::bind(&ScanBrowser::loadStudy, load),
+                     boost::bind(&ScanBrowser::studyLoaded, this, load, _1));
 }
 
 
@@ -354,11 +314,24 @@ void ScanBrowser::addScanClicked()
         return;
     }
 
+    // While the study loads, or if it could not be read, the box only holds a
+    // message and there is no scan to add
+    if (mScansDicomFiles.empty())
+    {
+        return;
+    }
+
     const set<int>& selectedSet = mScansSelectionBox->selectedIndexes();
     set<int>::const_iterator iter = selectedSet.begin();
 
     while (iter != selectedSet.end())
     {
+        if (*iter < 0 || *iter >= mScansDicomFiles.size())
+        {
+            iter++;
+            continue;
+        }
+
         WString curScanText = mScansSelectionBox->itemText(*iter);
 
         mNewScanData.mMRID = mCurMRID;
@@ -545,6 +518,46 @@ void ScanBrowser::scanSelectionChanged()
     }
 }
 
+///
+//  Read the table of contents of a study (I/O thread)
+//
+void ScanBrowser::loadStudy(boost::shared_ptr<StudyLoad> load)
+{
+    load->mStudy = StudyMetadataCache::instance().getStudy(load->mScanDir);
+}
+
+///
+//  Table of contents of a study read
+//
+void ScanBrowser::studyLoaded(boost::shared_ptr<StudyLoad> load, IOExecutor::StatusEnum status)
+{
+    mScansSelectionBox->clear();
+    mScansSelectionBox->setCurrentIndex(0);
+
+    if (status == IOExecutor::IO_TIMED_OUT)
+    {
+        WApplication::instance()->log("error") << "Timed out reading table of contents in: " << load->mScanDir;
+        mScansSelectionBox->addItem("Timed out reading scans");
+        return;
+    }
+
+    const StudyMetadata& study = *load->mStudy;
+
+    // Load the patient info box
+    mPatientInfoBox->setStudy(study);
+
+    for (int i = 0; i < study.getNumScans(); i++)
+    {
+        const StudyMetadata::Scan& scan = study.getScan(i);
+
+        mScansSelectionBox->addItem(scan.mName);
+        mScansDicomFiles.push_back(scan.mDicomFile);
+    }
+
+    mScansDate = study.getInfo(StudyMetadata::IMAGE_SCAN_DATE);
+    mScansSelectionBox->enable();
+}
+
 ///
 // Set the current pipeline type
 //
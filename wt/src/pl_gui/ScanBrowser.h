@@ -18,6 +18,8 @@
 #include <string>
 #include "ScansToProcessTable.h"
 #include "GlobalEnums.h"
+#include "IOClient.h"
+#include <boost/shared_ptr.hpp>
 
 namespace Wt
 {
@@ -31,6 +33,7 @@ namespace Wt
 
 class MRIInfoBox;
 class PatientInfoBox;
+class StudyMetadata;
 
 using namespace Wt;
 
@@ -117,6 +120,27 @@ private:
     bool findSeriesMatch(const std::string& seriesList,
                          const std::string& seriesName) const;
 
+    /// Table of contents being read for the study
+    typedef struct
+    {
+        /// Study directory
+        std::string mScanDir;
+
+        /// Parsed table of contents
+        boost::shared_ptr<const StudyMetadata> mStudy;
+
+    } StudyLoad;
+
+    ///
+    /// Read the table of contents of a study (I/O thread)
+    ///
+    static void loadStudy(boost::shared_ptr<StudyLoad> load);
+
+    ///
+    /// Table of contents of a study read [I/O callback]
+    ///
+    void studyLoaded(boost::shared_ptr<StudyLoad> load, IOExecutor::StatusEnum status);
+
     ///
     ///  Add scan clicked [slot]
     ///
@@ -211,6 +235,9 @@ private:
 
     /// Add scan message box
     WMessageBox *mAddScanMessageBox;
+
+    /// Reads the study's table of contents off the session
+    IOClient mIOClient;
 };
 
 #endif // SCANBROWSER_H
@@ -0,0 +1,465 @@
+//
+//
+//  Description:
+//      Implementation of the script cluster backend.  Drives mosix, pbs and the
+//      other clusters the cluster_status.bash and cluster_kill.bash scripts know.
+//      The scripts run in a long-lived helper shell instead of a shell forked off
+//      the server per query.  A batch is written to the helper as one script, with
+//      the output of each job delimited, and read back until the batch's end marker.
+//
+//      The script is written while the output is read, so a batch larger than the
+//      pipes cannot block both sides.  A command that produces no output for too
+//      long, such as a hung ssh, gets the helper and its children killed and the
+//      batch fails rather than holding up the poller.
+//
+//  Author:
+//      Dan Ginsburg
+//
+//  Children's Hospital Boston
+//  GPL v2
+//
+#include "ScriptClusterBackend.h"
+#include <boost/thread/thread_time.hpp>
+#include <sstream>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+///
+//  Namespaces
+//
+using namespace std;
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Constructor/Destructor
+//
+//
+
+///
+//  Constructor
+//
+ScriptClusterBackend::ScriptClusterBackend(const std::string& clusterType, const std::string& clusterHeadNode,
+                                           const std::string& scriptDir) :
+    mClusterType(clusterType),
+    mClusterHeadNode(clusterHeadNode),
+    mScriptDir(scriptDir),
+    mHelperPid(-1),
+    mHelperIn(-1),
+    mHelperOut(-1),
+    mNumBatches(0)
+{
+}
+
+///
+//  Destructor
+//
+ScriptClusterBackend::~ScriptClusterBackend()
+{
+    boost::mutex::scoped_lock lock(mMutex);
+    stopHelper();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Public Members
+//
+//
+
+///
+//  Get the state of jobs in the scheduler
+//
+bool ScriptClusterBackend::queryStatus(const std::vector<JobRef>& jobs, std::vector<JobStateEnum>& states)
+{
+    states.assign(jobs.size(), JOB_NOT_FOUND);
+    if (jobs.empty())
+    {
+        return true;
+    }
+
+    // cluster_status.bash takes a single job, the helper runs it for each in turn
+    std::ostringstream script;
+    for (size_t i = 0; i < jobs.size(); i++)
+    {
+        script << "echo '@JOB " << i << "'\n";
+        script << "cluster_status.bash -J " << quote(jobs[i].mJobId);
+        addClusterOptions(script, jobs[i]);
+        script << " < /dev/null\n";
+    }
+
+    std::map<int, std::vector<std::string> > output;
+    if (!runBatch(script.str(), output))
+    {
+        return false;
+    }
+
+    // The status script prints the process and its status for jobs it knows
+    for (std::map<int, std::vector<std::string> >::const_iterator iter = output.begin();
+         iter != output.end(); ++iter)
+    {
+        const std::vector<std::string>& tokens = iter->second;
+
+        if (iter->first >= 0 && iter->first < (int)jobs.size() && tokens.size() >= 2)
+        {
+            states[iter->first] = (tokens[1] == "QUEUED") ? JOB_QUEUED : JOB_RUNNING;
+        }
+    }
+
+    return true;
+}
+
+///
+//  Submit jobs to the scheduler
+//
+bool ScriptClusterBackend::submit(const std::vector<std::string>&, std::vector<std::string>& jobIds)
+{
+    jobIds.clear();
+    return false;
+}
+
+///
+//  Kill jobs
+//
+void ScriptClusterBackend::kill(const std::vector<JobRef>& jobs)
+{
+    if (jobs.empty())
+    {
+        return;
+    }
+
+    std::ostringstream script;
+    for (size_t i = 0; i < jobs.size(); i++)
+    {
+        script << "echo '@JOB " << i << "'\n";
+        script << "cluster_kill.bash -J " << quote(jobs[i].mJobId);
+        addClusterOptions(script, jobs[i]);
+        script << " < /dev/null > /dev/null\n";
+    }
+
+    std::map<int, std::vector<std::string> > output;
+    runBatch(script.str(), output);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Private Members
+//
+//
+
+///
+//  Append the cluster options of a script to a command line
+//
+void ScriptClusterBackend::addClusterOptions(std::ostream& script, const JobRef& job) const
+{
+    script << " -C " << quote(mClusterType);
+    script << " -c " << quote(job.mClusterShFile);
+    if (mClusterHeadNode != "")
+    {
+        script << " -r " << quote(mClusterHeadNode);
+    }
+}
+
+///
+//  Run a batch in the helper shell
+//
+bool ScriptClusterBackend::runBatch(const std::string& script, std::map<int, std::vector<std::string> >& output)
+{
+    boost::mutex::scoped_lock lock(mMutex);
+
+    // A helper that exited while idle is restarted once
+    for (int attempt = 0; attempt < 2; attempt++)
+    {
+        if (mHelperPid != -1 && waitpid(mHelperPid, NULL, WNOHANG) != 0)
+        {
+            mHelperPid = -1;
+            stopHelper();
+        }
+
+        if (mHelperPid == -1 && !startHelper())
+        {
+            return false;
+        }
+
+        std::ostringstream endMarker;
+        endMarker << "@END " << mNumBatches++;
+
+        std::string input = script + "echo '" + endMarker.str() + "'\n";
+        BatchResultEnum result = exchangeBatch(input, endMarker.str(), output);
+
+        if (result == BATCH_DONE)
+        {
+            return true;
+        }
+
+        stopHelper();
+        output.clear();
+
+        // A command that hung would hang again
+        if (result == BATCH_TIMED_OUT)
+        {
+            return false;
+        }
+    }
+
+    return false;
+}
+
+///
+//  Write a batch to the helper and read its output
+//
+ScriptClusterBackend::BatchResultEnum ScriptClusterBackend::exchangeBatch(const std::string& input,
+                                                                          const std::string& endMarker,
+                                                                          std::map<int, std::vector<std::string> >& output)
+{
+    // A helper that died makes the write fail with EPIPE instead of raising
+    // SIGPIPE in the server.  A SIGPIPE raised anyway is consumed below.
+    sigset_t pipeSet;
+    sigset_t oldSet;
+    sigemptyset(&pipeSet);
+    sigaddset(&pipeSet, SIGPIPE);
+    pthread_sigmask(SIG_BLOCK, &pipeSet, &oldSet);
+
+    boost::system_time deadline = boost::get_system_time() + boost::posix_time::milliseconds((long)COMMAND_TIMEOUT_MS);
+    std::vector<std::string> *tokens = NULL;
+    std::string partialLine;
+    size_t written = 0;
+    BatchResultEnum result = BATCH_FAILED;
+    bool running = true;
+
+    while (running)
+    {
+        boost::posix_time::time_duration remaining = deadline - boost::get_system_time();
+        if (remaining.is_negative())
+        {
+            result = BATCH_TIMED_OUT;
+            break;
+        }
+
+        struct pollfd fds[2];
+        int numFds = 0;
+
+        fds[numFds].fd = mHelperOut;
+        fds[numFds].events = POLLIN;
+        fds[numFds].revents = 0;
+        numFds++;
+
+        if (written < input.size())
+        {
+            fds[numFds].fd = mHelperIn;
+            fds[numFds].events = POLLOUT;
+            fds[numFds].revents = 0;
+            numFds++;
+        }
+
+        int ready = poll(fds, numFds, (int)remaining.total_milliseconds() + 1);
+        if (ready < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            break;
+        }
+
+        // Write as much of the script as the pipe takes
+        if (numFds > 1 && (fds[1].revents & (POLLOUT | POLLERR | POLLHUP)))
+        {
+            ssize_t count = write(mHelperIn, input.data() + written, input.size() - written);
+            if (count < 0 && errno != EAGAIN && errno != EINTR)
+            {
+                break;
+            }
+            if (count > 0)
+            {
+                written += count;
+            }
+        }
+
+        if (!(fds[0].revents & (POLLIN | POLLERR | POLLHUP)))
+        {
+            continue;
+        }
+
+        char buf[4096];
+        ssize_t count = read(mHelperOut, buf, sizeof(buf));
+        if (count < 0)
+        {
+            if (errno == EAGAIN || errno == EINTR)
+            {
+                continue;
+            }
+            break;
+        }
+
+        // The helper exited in the middle of the batch
+        if (count == 0)
+        {
+            break;
+        }
+
+        partialLine.append(buf, count);
+
+        size_t start = 0;
+        size_t end;
+        while (running && (end = partialLine.find('\n', start)) != std::string::npos)
+        {
+            std::string line = partialLine.substr(start, end - start);
+            start = end + 1;
+
+            if (line == endMarker)
+            {
+                result = BATCH_DONE;
+                running = false;
+            }
+            else if (line.compare(0, 5, "@JOB ") == 0)
+            {
+                // Each command gets its own time to run
+                tokens = &output[atoi(line.c_str() + 5)];
+                deadline = boost::get_system_time() + boost::posix_time::milliseconds((long)COMMAND_TIMEOUT_MS);
+            }
+            else if (tokens != NULL)
+            {
+                std::istringstream lineStream(line);
+                std::string token;
+                while (lineStream >> token)
+                {
+                    tokens->push_back(token);
+                }
+            }
+        }
+        partialLine.erase(0, start);
+    }
+
+    struct timespec noWait = { 0, 0 };
+    while (sigtimedwait(&pipeSet, NULL, &noWait) == SIGPIPE)
+    {
+    }
+    pthread_sigmask(SIG_SETMASK, &oldSet, NULL);
+
+    return result;
+}
+
+///
+//  Start the helper shell
+//
+bool ScriptClusterBackend::startHelper()
+{
+    int inPipe[2];
+    int outPipe[2];
+
+    if (pipe(inPipe) != 0)
+    {
+        return false;
+    }
+    if (pipe(outPipe) != 0)
+    {
+        close(inPipe[0]);
+        close(inPipe[1]);
+        return false;
+    }
+
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+        // A group of its own, so that a hung command is killed with the shell
+        setpgid(0, 0);
+
+        // Only the pipes are passed on, not the server's sockets and files
+        dup2(inPipe[0], STDIN_FILENO);
+        dup2(outPipe[1], STDOUT_FILENO);
+        long maxFd = sysconf(_SC_OPEN_MAX);
+        for (int fd = STDERR_FILENO + 1; fd < maxFd; fd++)
+        {
+            close(fd);
+        }
+
+        execl("/bin/sh", "sh", (char*)NULL);
+        _exit(127);
+    }
+
+    close(inPipe[0]);
+    close(outPipe[1]);
+
+    if (pid < 0)
+    {
+        close(inPipe[1]);
+        close(outPipe[0]);
+        return false;
+    }
+
+    mHelperPid = pid;
+    mHelperIn = inPipe[1];
+    mHelperOut = outPipe[0];
+
+    // Our ends do not block, a batch is written and read in turns
+    fcntl(mHelperIn, F_SETFL, fcntl(mHelperIn, F_GETFL) | O_NONBLOCK);
+    fcntl(mHelperOut, F_SETFL, fcntl(mHelperOut, F_GETFL) | O_NONBLOCK);
+    fcntl(mHelperIn, F_SETFD, FD_CLOEXEC);
+    fcntl(mHelperOut, F_SETFD, FD_CLOEXEC);
+
+    // The scripts are found on the PATH.  This is written before any batch, the
+    // pipe is empty and takes it without blocking.
+    std::string setPath = "PATH=" + quote(mScriptDir) + ":/bin:/usr/bin:/usr/local/bin:/opt/local/bin:$PATH; export PATH\n";
+    if (write(mHelperIn, setPath.data(), setPath.size()) != (ssize_t)setPath.size())
+    {
+        stopHelper();
+        return false;
+    }
+
+    return true;
+}
+
+///
+//  Stop the helper shell
+//
+void ScriptClusterBackend::stopHelper()
+{
+    if (mHelperIn != -1)
+    {
+        close(mHelperIn);
+        mHelperIn = -1;
+    }
+
+    if (mHelperOut != -1)
+    {
+        close(mHelperOut);
+        mHelperOut = -1;
+    }
+
+    // The shell and anything it is running, such as an ssh that hung
+    if (mHelperPid != -1)
+    {
+        ::kill(-mHelperPid, SIGKILL);
+        waitpid(mHelperPid, NULL, 0);
+        mHelperPid = -1;
+    }
+}
+
+///
+//  Quote a string for the shell
+//
+std::string ScriptClusterBackend::quote(const std::string& str)
+{
+    std::string quoted = "'";
+    for (size_t i = 0; i < str.size(); i++)
+    {
+        if (str[i] == '\'')
+        {
+            quoted += "'\\''";
+        }
+        else
+        {
+            quoted += str[i];
+        }
+    }
+    quoted += "'";
+
+    return quoted;
+}
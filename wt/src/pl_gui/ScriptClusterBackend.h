@@ -0,0 +1,139 @@
+//
+//
+//  Description:
+//      Definition of the script cluster backend.  Drives mosix, pbs and the other
+//      clusters the cluster_status.bash and cluster_kill.bash scripts know.  The
+//      scripts run in a long-lived helper shell instead of a shell forked off the
+//      server per query.  A batch is written to the helper as one script, with the
+//      output of each job delimited, and read back until the batch's end marker.
+//      A command that hangs gets the helper killed and the batch fails.
+//
+//  Author:
+//      Dan Ginsburg
+//
+//  Children's Hospital Boston
+//  GPL v2
+//
+#ifndef SCRIPTCLUSTERBACKEND_H
+#define SCRIPTCLUSTERBACKEND_H
+
+#include "ClusterBackend.h"
+#include <boost/thread/mutex.hpp>
+#include <sys/types.h>
+#include <iosfwd>
+#include <map>
+#include <string>
+#include <vector>
+
+///
+/// \class ScriptClusterBackend
+/// \brief Cluster backend that runs the cluster scripts in a persistent helper shell
+///
+class ScriptClusterBackend : public ClusterBackend
+{
+public:
+
+    /// Time a command of a batch may run without output before the helper is killed
+    static const int COMMAND_TIMEOUT_MS = 30000;
+
+    ///
+    /// Constructor
+    /// \param clusterType Cluster type passed to the scripts (-C)
+    /// \param clusterHeadNode Cluster head node passed to the scripts (-r), empty for none
+    /// \param scriptDir Directory holding the cluster scripts
+    ///
+    ScriptClusterBackend(const std::string& clusterType, const std::string& clusterHeadNode,
+                         const std::string& scriptDir);
+
+    ///
+    /// Destructor
+    ///
+    virtual ~ScriptClusterBackend();
+
+    ///
+    /// Get the state of jobs in the scheduler
+    ///
+    virtual bool queryStatus(const std::vector<JobRef>& jobs, std::vector<JobStateEnum>& states);
+
+    ///
+    /// Submit jobs to the scheduler.  Not supported: on these clusters jobs are
+    /// added by pl_batch_web.bash (see ClusterJobSubmitter), the scripts have no
+    /// single job equivalent.
+    ///
+    virtual bool submit(const std::vector<std::string>& commands, std::vector<std::string>& jobIds);
+
+    ///
+    /// Kill jobs
+    ///
+    virtual void kill(const std::vector<JobRef>& jobs);
+
+private:
+
+    /// Outcome of running a batch in the helper
+    typedef enum
+    {
+        BATCH_DONE,         // The end marker was read
+        BATCH_FAILED,       // The helper exited or a pipe failed
+        BATCH_TIMED_OUT     // A command ran too long without output
+    } BatchResultEnum;
+
+    ///
+    /// Append the cluster options of a script to a command line
+    ///
+    void addClusterOptions(std::ostream& script, const JobRef& job) const;
+
+    ///
+    /// Run a batch in the helper shell.  The output of each job follows a line
+    /// "@JOB <index>", the tokens of each are returned by index.
+    /// \return false if the helper could not run the batch
+    ///
+    bool runBatch(const std::string& script, std::map<int, std::vector<std::string> >& output);
+
+    ///
+    /// Write a batch to the helper while reading its output, up to the end
+    /// marker.  Call with mMutex held.
+    ///
+    BatchResultEnum exchangeBatch(const std::string& input, const std::string& endMarker,
+                                  std::map<int, std::vector<std::string> >& output);
+
+    ///
+    /// Start the helper shell.  Call with mMutex held.
+    ///
+    bool startHelper();
+
+    ///
+    /// Stop the helper shell.  Call with mMutex held.
+    ///
+    void stopHelper();
+
+    ///
+    /// Quote a string for the shell
+    ///
+    static std::string quote(const std::string& str);
+
+    /// Cluster type
+    std::string mClusterType;
+
+    /// Cluster head node
+    std::string mClusterHeadNode;
+
+    /// Directory holding the cluster scripts
+    std::string mScriptDir;
+
+    /// Process id of the helper shell, -1 if not running
+    pid_t mHelperPid;
+
+    /// Standard input of the helper shell, -1 if not running
+    int mHelperIn;
+
+    /// Standard output of the helper shell, -1 if not running
+    int mHelperOut;
+
+    /// Number of batches run, numbers the end markers
+    int mNumBatches;
+
+    /// Mutex serializing batches through the helper
+    boost::mutex mMutex;
+};
+
+#endif // SCRIPTCLUSTERBACKEND_H
@@ -0,0 +1,161 @@
+//
+//
+//  Description:
+//      Implementation of the study metadata.  Holds the contents of a study's toc.txt
+//      file: the patient and scanner information and the list of scans with their
+//      DICOM files.  A parsed study is immutable and is shared between sessions
+//      through the StudyMetadataCache.
+//
+//  Author:
+//      Dan Ginsburg
+//
+//  Children's Hospital Boston
+//  GPL v2
+//
+#include "StudyMetadata.h"
+#include <fstream>
+#include <sstream>
+
+///
+//  Namespaces
+//
+using namespace std;
+
+///
+//  Read the remaining tokens of a line, each followed by a space
+//
+static std::string readTokens(istringstream& istr)
+{
+    string str;
+
+    while (!istr.eof())
+    {
+        string tmp;
+        istr >> tmp;
+        str += tmp + " ";
+    }
+
+    return str;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Constructor/Destructor
+//
+//
+
+///
+//  Constructor
+//
+StudyMetadata::StudyMetadata()
+{
+}
+
+///
+//  Destructor
+//
+StudyMetadata::~StudyMetadata()
+{
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Public Members
+//
+//
+
+///
+//  Parse a table of contents file
+//
+bool StudyMetadata::loadTOC(const std::string& tocFileName)
+{
+    std::ifstream tocFile(tocFileName.c_str());
+
+    if (!tocFile.is_open())
+    {
+        return false;
+    }
+
+    string line;
+    while (getline(tocFile, line))
+    {
+        istringstream istr(line);
+        string firstToken;
+        istr >> firstToken;
+
+        if (firstToken == "Patient")
+        {
+            string secondToken;
+            istr >> secondToken;
+            string str = readTokens(istr);
+
+            if (secondToken == "ID")
+            {
+                mInfo[PATIENT_ID] = str;
+            }
+            else if (secondToken == "Name")
+            {
+                mInfo[PATIENT_NAME] = str;
+            }
+            else if (secondToken == "Age")
+            {
+                mInfo[PATIENT_AGE] = str;
+            }
+            else if (secondToken == "Sex")
+            {
+                mInfo[PATIENT_SEX] = str;
+            }
+            else if (secondToken == "Birthday")
+            {
+                mInfo[PATIENT_BIRTHDAY] = str;
+            }
+        }
+        else if (firstToken == "Image")
+        {
+            string secondToken;
+            istr >> secondToken;
+
+            if (secondToken == "Scan-Date")
+            {
+                istr >> mInfo[IMAGE_SCAN_DATE];
+            }
+        }
+        else if (firstToken == "Scanner")
+        {
+            string secondToken;
+            istr >> secondToken;
+            string str = readTokens(istr);
+
+            if (secondToken == "Manufacturer")
+            {
+                mInfo[SCANNER_MANUFACTURER] = str;
+            }
+            else if (secondToken == "Model")
+            {
+                mInfo[SCANNER_MODEL] = str;
+            }
+        }
+        else if (firstToken == "Software")
+        {
+            string secondToken;
+            istr >> secondToken;
+
+            mInfo[SOFTWARE_VERSION] = readTokens(istr);
+        }
+        else if (firstToken == "Scan")
+        {
+            Scan scan;
+            istr >> scan.mDicomFile;
+            scan.mName = readTokens(istr);
+
+            if (scan.mName == "" || scan.mName == " ")
+            {
+                scan.mName = "unnamed";
+            }
+
+            mScans.push_back(scan);
+        }
+    }
+
+    return true;
+}
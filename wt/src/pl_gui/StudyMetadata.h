@@ -0,0 +1,97 @@
+//
+//
+//  Description:
+//      Definition of the study metadata.  Holds the contents of a study's toc.txt
+//      file: the patient and scanner information and the list of scans with their
+//      DICOM files.  A parsed study is immutable and is shared between sessions
+//      through the StudyMetadataCache.
+//
+//  Author:
+//      Dan Ginsburg
+//
+//  Children's Hospital Boston
+//  GPL v2
+//
+#ifndef STUDYMETADATA_H
+#define STUDYMETADATA_H
+
+#include <string>
+#include <vector>
+
+///
+/// \class StudyMetadata
+/// \brief Parsed table of contents (toc.txt) of a study directory
+///
+class StudyMetadata
+{
+public:
+
+    /// Patient and scanner information from the table of contents
+    typedef enum
+    {
+        PATIENT_ID = 0,
+        PATIENT_NAME = 1,
+        PATIENT_AGE = 2,
+        PATIENT_SEX = 3,
+        PATIENT_BIRTHDAY = 4,
+        IMAGE_SCAN_DATE = 5,
+        SCANNER_MANUFACTURER = 6,
+        SCANNER_MODEL = 7,
+        SOFTWARE_VERSION = 8,
+        NUM_INFO
+    } InfoEnum;
+
+    /// Scan of the study
+    typedef struct
+    {
+        /// Scan sequence name
+        std::string mName;
+
+        /// First DICOM file of the scan
+        std::string mDicomFile;
+
+    } Scan;
+
+    ///
+    /// Constructor
+    ///
+    StudyMetadata();
+
+    ///
+    /// Destructor
+    ///
+    virtual ~StudyMetadata();
+
+    ///
+    /// Parse a table of contents file
+    /// \param tocFileName Full path to toc.txt
+    /// \return true if the file could be opened, false otherwise
+    ///
+    bool loadTOC(const std::string& tocFileName);
+
+    ///
+    /// Get an item of patient or scanner information
+    /// \return Value as written in the table of contents, empty if it was not present
+    ///
+    const std::string& getInfo(InfoEnum info) const     { return mInfo[info]; }
+
+    ///
+    /// Get the number of scans
+    ///
+    int getNumScans() const                             { return (int)mScans.size(); }
+
+    ///
+    /// Get a scan
+    ///
+    const Scan& getScan(int index) const                { return mScans[index]; }
+
+private:
+
+    /// Patient and scanner information
+    std::string mInfo[NUM_INFO];
+
+    /// Scans, in table of contents order
+    std::vector<Scan> mScans;
+};
+
+#endif // STUDYMETADATA_H
@@ -0,0 +1,247 @@
+//
+//
+//  Description:
+//      Implementation of the process-wide study metadata cache.  Holds the most
+//      recently used parsed toc.txt files and mri_info texts, shared by every session.
+//      Each entry remembers the modification time and size of the files it was read
+//      from and is read again when they change, so a lookup costs one stat() rather
+//      than reading and parsing the files over NFS.
+//
+//      Files are read without holding the cache lock, so a slow directory only holds
+//      up the sessions that asked for it.
+//
+//  Author:
+//      Dan Ginsburg
+//
+//  Children's Hospital Boston
+//  GPL v2
+//
+#include "StudyMetadataCache.h"
+#include "StudyMetadata.h"
+#include <fstream>
+#include <sstream>
+#include <sys/stat.h>
+
+///
+//  Namespaces
+//
+using namespace std;
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Constructor/Destructor
+//
+//
+
+///
+//  Constructor
+//
+StudyMetadataCache::StudyMetadataCache()
+{
+}
+
+///
+//  Destructor
+//
+StudyMetadataCache::~StudyMetadataCache()
+{
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Public Members
+//
+//
+
+///
+//  Get the process-wide cache instance
+//
+StudyMetadataCache& StudyMetadataCache::instance()
+{
+    static StudyMetadataCache cache;
+    return cache;
+}
+
+///
+//  Get the parsed table of contents of a study directory
+//
+boost::shared_ptr<const StudyMetadata> StudyMetadataCache::getStudy(const std::string& scanDir)
+{
+    std::string tocFileName = scanDir + "/toc.txt";
+    FileStamp stamp = getFileStamp(tocFileName);
+
+    {
+        boost::mutex::scoped_lock lock(mMutex);
+        const CacheEntry *entry = findEntry(tocFileName);
+        if (entry != NULL && entry->mStudy != NULL && isSameFile(entry->mStamp, stamp))
+        {
+            return entry->mStudy;
+        }
+    }
+
+    boost::shared_ptr<StudyMetadata> study(new StudyMetadata());
+    if (!stamp.mExists || !study->loadTOC(tocFileName))
+    {
+        // Not cached, the study may not have been unpacked yet
+        return study;
+    }
+
+    CacheEntry entry = CacheEntry();
+    entry.mStamp = stamp;
+    entry.mStudy = study;
+
+    boost::mutex::scoped_lock lock(mMutex);
+    storeEntry(tocFileName, entry);
+
+    return study;
+}
+
+///
+//  Get the mri_info text of a DICOM file
+//
+bool StudyMetadataCache::getMRIInfo(const std::string& dcmFileName, std::string& text)
+{
+    std::string mriFileStd = dcmFileName + ".std";
+    std::string mriFileErr = dcmFileName + ".err";
+    FileStamp stamp = getFileStamp(mriFileStd);
+
+    if (!stamp.mExists)
+    {
+        text = "";
+        return false;
+    }
+
+    // The error file only matters when the info file is empty
+    FileStamp errStamp = CacheEntry().mErrStamp;
+    if (stamp.mFileSize <= 1)
+    {
+        errStamp = getFileStamp(mriFileErr);
+    }
+
+    {
+        boost::mutex::scoped_lock lock(mMutex);
+        const CacheEntry *entry = findEntry(mriFileStd);
+
+        if (entry != NULL && entry->mText != NULL && isSameFile(entry->mStamp, stamp) &&
+            isSameFile(entry->mErrStamp, errStamp))
+        {
+            text = *entry->mText;
+            return true;
+        }
+    }
+
+    CacheEntry entry = CacheEntry();
+    entry.mStamp = stamp;
+    entry.mErrStamp = errStamp;
+
+    std::string mriText;
+    if (!readTextFile(mriFileStd, mriText))
+    {
+        text = "";
+        return false;
+    }
+
+    if (mriText.length() <= 1)
+    {
+        std::string errText;
+        readTextFile(mriFileErr, errText);
+        mriText += errText;
+    }
+
+    text = (mriText.length() > 1) ? mriText : "";
+    entry.mText.reset(new std::string(text));
+
+    boost::mutex::scoped_lock lock(mMutex);
+    storeEntry(mriFileStd, entry);
+
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Private Members
+//
+//
+
+///
+//  Get the stamp of a file
+//
+StudyMetadataCache::FileStamp StudyMetadataCache::getFileStamp(const std::string& fileName)
+{
+    FileStamp stamp;
+    struct stat fileStat;
+
+    stamp.mExists = stat(fileName.c_str(), &fileStat) == 0;
+    stamp.mModTime = stamp.mExists ? fileStat.st_mtime : 0;
+    stamp.mFileSize = stamp.mExists ? (boost::uintmax_t)fileStat.st_size : 0;
+
+    return stamp;
+}
+
+///
+//  Get whether two stamps are of the same version of a file
+//
+bool StudyMetadataCache::isSameFile(const FileStamp& a, const FileStamp& b)
+{
+    return a.mExists == b.mExists &&
+           a.mModTime == b.mModTime &&
+           a.mFileSize == b.mFileSize;
+}
+
+///
+//  Read a whole text file
+//
+bool StudyMetadataCache::readTextFile(const std::string& fileName, std::string& text)
+{
+    std::ifstream file(fileName.c_str(), ios::in);
+    if (!file.is_open())
+    {
+        return false;
+    }
+
+    ostringstream oss;
+    oss << file.rdbuf();
+    text = oss.str();
+
+    return true;
+}
+
+///
+//  Find a cached entry and mark it most recently used
+//
+const StudyMetadataCache::CacheEntry* StudyMetadataCache::findEntry(const std::string& key)
+{
+    std::map<std::string, CacheEntry>::iterator iter = mEntries.find(key);
+    if (iter == mEntries.end())
+    {
+        return NULL;
+    }
+
+    mLRU.splice(mLRU.begin(), mLRU, iter->second.mLRUPos);
+
+    return &iter->second;
+}
+
+///
+//  Add or replace an entry
+//
+void StudyMetadataCache::storeEntry(const std::string& key, const CacheEntry& entry)
+{
+    std::map<std::string, CacheEntry>::iterator iter = mEntries.find(key);
+    if (iter != mEntries.end())
+    {
+        mLRU.erase(iter->second.mLRUPos);
+        mEntries.erase(iter);
+    }
+
+    mLRU.push_front(key);
+    CacheEntry& stored = mEntries[key];
+    stored = entry;
+    stored.mLRUPos = mLRU.begin();
+
+    while ((int)mLRU.size() > MAX_ENTRIES)
+    {
+        mEntries.erase(mLRU.back());
+        mLRU.pop_back();
+    }
+}
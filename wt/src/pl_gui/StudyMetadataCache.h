@@ -0,0 +1,144 @@
+//
+//
+//  Description:
+//      Definition of the process-wide study metadata cache.  Holds the most recently
+//      used parsed toc.txt files and mri_info texts, shared by every session.  Each
+//      entry remembers the modification time and size of the files it was read from
+//      and is read again when they change, so a lookup costs one stat() rather than
+//      reading and parsing the files over NFS.
+//
+//  Author:
+//      Dan Ginsburg
+//
+//  Children's Hospital Boston
+//  GPL v2
+//
+#ifndef STUDYMETADATACACHE_H
+#define STUDYMETADATACACHE_H
+
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/cstdint.hpp>
+#include <ctime>
+#include <list>
+#include <map>
+#include <string>
+
+class StudyMetadata;
+
+///
+/// \class StudyMetadataCache
+/// \brief Singleton LRU cache of parsed study metadata, keyed by path
+///
+class StudyMetadataCache
+{
+public:
+
+    /// Maximum number of cached studies and mri_info texts
+    static const int MAX_ENTRIES = 2048;
+
+    ///
+    /// Get the process-wide cache instance
+    ///
+    static StudyMetadataCache& instance();
+
+    ///
+    /// Get the parsed table of contents of a study directory
+    /// \param scanDir Full path to the study directory
+    /// \return Shared metadata (never NULL, empty if toc.txt could not be read)
+    ///
+    boost::shared_ptr<const StudyMetadata> getStudy(const std::string& scanDir);
+
+    ///
+    /// Get the mri_info text of a DICOM file, the contents of <dcmFileName>.std or,
+    /// if that is empty, <dcmFileName>.err
+    /// \param dcmFileName Full path to the DICOM file under the mri_info directory
+    /// \param text Filled with the text, empty if neither file has any
+    /// \return false if there is no mri_info file, true otherwise
+    ///
+    bool getMRIInfo(const std::string& dcmFileName, std::string& text);
+
+private:
+
+    ///
+    /// Constructor
+    ///
+    StudyMetadataCache();
+
+    ///
+    /// Destructor
+    ///
+    virtual ~StudyMetadataCache();
+
+    /// Modification time and size of a file, to tell when it changes
+    typedef struct
+    {
+        /// Whether the file exists
+        bool mExists;
+
+        /// Modification time
+        std::time_t mModTime;
+
+        /// Size
+        boost::uintmax_t mFileSize;
+
+    } FileStamp;
+
+    /// Cached study or mri_info text
+    typedef struct
+    {
+        /// Stamp of the file the entry was read from
+        FileStamp mStamp;
+
+        /// Stamp of the mri_info error file, if it was read
+        FileStamp mErrStamp;
+
+        /// Parsed study, for a toc.txt entry
+        boost::shared_ptr<const StudyMetadata> mStudy;
+
+        /// Text, for an mri_info entry
+        boost::shared_ptr<const std::string> mText;
+
+        /// Position in mLRU
+        std::list<std::string>::iterator mLRUPos;
+
+    } CacheEntry;
+
+    ///
+    /// Get the stamp of a file
+    ///
+    static FileStamp getFileStamp(const std::string& fileName);
+
+    ///
+    /// Get whether two stamps are of the same version of a file
+    ///
+    static bool isSameFile(const FileStamp& a, const FileStamp& b);
+
+    ///
+    /// Read a whole text file
+    ///
+    static bool readTextFile(const std::string& fileName, std::string& text);
+
+    ///
+    /// Find a cached entry and mark it most recently used
+    /// \return Entry, or NULL if the key is not cached
+    ///
+    const CacheEntry* findEntry(const std::string& key);
+
+    ///
+    /// Add or replace an entry, evicting the least recently used entries past
+    /// MAX_ENTRIES
+    ///
+    void storeEntry(const std::string& key, const CacheEntry& entry);
+
+    /// Cached entries, keyed by the path of the file they were read from
+    std::map<std::string, CacheEntry> mEntries;
+
+    /// Keys of mEntries, most recently used first
+    std::list<std::string> mLRU;
+
+    /// Mutex protecting mEntries and mLRU
+    boost::mutex mMutex;
+};
+
+#endif // STUDYMETADATACACHE_H
@@ -0,0 +1,191 @@
+//
+//
+//  Description:
+//      Implementation of the process-wide study prefetcher.  When a user selects an
+//      MRID, the studies next to it in the user's view are likely to be selected
+//      next.  Their toc.txt and mri_info files are read into the StudyMetadataCache
+//      ahead of time by a few background threads, so that stepping through the list
+//      does not wait on NFS.
+//
+//      The threads and the number of queued studies are shared by every session and
+//      bounded, so prefetching never competes with more than a fixed amount of I/O.
+//      Each new selection replaces what a session asked for before.
+//
+//  Author:
+//      Dan Ginsburg
+//
+//  Children's Hospital Boston
+//  GPL v2
+//
+#include "StudyPrefetcher.h"
+#include "StudyMetadata.h"
+#include "StudyMetadataCache.h"
+#include <boost/thread/thread.hpp>
+#include <boost/bind.hpp>
+
+///
+//  Namespaces
+//
+using namespace std;
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Constructor/Destructor
+//
+//
+
+///
+//  Constructor
+//
+StudyPrefetcher::StudyPrefetcher() :
+    mNextClientId(0)
+{
+    // The threads run detached for the life of the process
+    for (int i = 0; i < NUM_THREADS; i++)
+    {
+        boost::thread(boost::bind(&StudyPrefetcher::runWorker, this));
+    }
+}
+
+///
+//  Destructor
+//
+StudyPrefetcher::~StudyPrefetcher()
+{
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Public Members
+//
+//
+
+///
+//  Get the process-wide prefetcher instance
+//
+StudyPrefetcher& StudyPrefetcher::instance()
+{
+    // Never destroyed, its threads run for the life of the process
+    static StudyPrefetcher *prefetcher = new StudyPrefetcher();
+    return *prefetcher;
+}
+
+///
+//  Get a new id for a client
+//
+int StudyPrefetcher::newClientId()
+{
+    boost::mutex::scoped_lock lock(mMutex);
+    int clientId = mNextClientId++;
+    mGenerations[clientId] = 0;
+    return clientId;
+}
+
+///
+//  Prefetch the metadata of studies, replacing the client's earlier prefetch
+//
+void StudyPrefetcher::prefetch(int clientId, const std::vector<std::string>& scanDirs)
+{
+    boost::mutex::scoped_lock lock(mMutex);
+
+    // Studies of the earlier prefetch are dropped from the queue, a thread still
+    // reading one stops at its next file
+    int generation = ++mGenerations[clientId];
+
+    std::deque<PrefetchItem> queue;
+    for (size_t i = 0; i < mQueue.size(); i++)
+    {
+        if (mQueue[i].mClientId != clientId)
+        {
+            queue.push_back(mQueue[i]);
+        }
+    }
+    mQueue.swap(queue);
+
+    for (size_t i = 0; i < scanDirs.size() && (int)mQueue.size() < MAX_QUEUED_STUDIES; i++)
+    {
+        PrefetchItem item;
+        item.mClientId = clientId;
+        item.mGeneration = generation;
+        item.mScanDir = scanDirs[i];
+
+        mQueue.push_back(item);
+        mWorkCondition.notify_one();
+    }
+}
+
+///
+//  Cancel the client's prefetch and forget the client
+//
+void StudyPrefetcher::removeClient(int clientId)
+{
+    prefetch(clientId, std::vector<std::string>());
+
+    boost::mutex::scoped_lock lock(mMutex);
+    mGenerations.erase(clientId);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Private Members
+//
+//
+
+///
+//  Prefetch studies (prefetch thread)
+//
+void StudyPrefetcher::runWorker()
+{
+    while (true)
+    {
+        PrefetchItem item;
+
+        {
+            boost::mutex::scoped_lock lock(mMutex);
+
+            while (mQueue.empty())
+            {
+                mWorkCondition.wait(lock);
+            }
+
+            item = mQueue.front();
+            mQueue.pop_front();
+        }
+
+        prefetchStudy(item);
+    }
+}
+
+///
+//  Read the metadata of a study into the cache (prefetch thread)
+//
+void StudyPrefetcher::prefetchStudy(const PrefetchItem& item)
+{
+    try
+    {
+        StudyMetadataCache& cache = StudyMetadataCache::instance();
+        boost::shared_ptr<const StudyMetadata> study = cache.getStudy(item.mScanDir);
+
+        // The mri_info files are read as the user clicks on the scans
+        for (int i = 0; i < study->getNumScans() && isCurrent(item); i++)
+        {
+            std::string mriInfo;
+            cache.getMRIInfo(item.mScanDir + "/mri_info/" + study->getScan(i).mDicomFile, mriInfo);
+        }
+    }
+    catch (...)
+    {
+        // Prefetching is only a hint, the study is read again when selected
+    }
+}
+
+///
+//  Get whether an item still belongs to its client's current prefetch
+//
+bool StudyPrefetcher::isCurrent(const PrefetchItem& item)
+{
+    boost::mutex::scoped_lock lock(mMutex);
+    std::map<int, int>::const_iterator iter = mGenerations.find(item.mClientId);
+
+    return iter != mGenerations.end() && iter->second == item.mGeneration;
+}
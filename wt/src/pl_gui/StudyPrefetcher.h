@@ -0,0 +1,125 @@
+//
+//
+//  Description:
+//      Definition of the process-wide study prefetcher.  When a user selects an
+//      MRID, the studies next to it in the user's view are likely to be selected
+//      next.  Their toc.txt and mri_info files are read into the StudyMetadataCache
+//      ahead of time by a few background threads, so that stepping through the list
+//      does not wait on NFS.
+//
+//      The threads and the number of queued studies are shared by every session and
+//      bounded, so prefetching never competes with more than a fixed amount of I/O.
+//      Each new selection replaces what a session asked for before.
+//
+//  Author:
+//      Dan Ginsburg
+//
+//  Children's Hospital Boston
+//  GPL v2
+//
+#ifndef STUDYPREFETCHER_H
+#define STUDYPREFETCHER_H
+
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition.hpp>
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+
+///
+/// \class StudyPrefetcher
+/// \brief Singleton that warms the study metadata cache in the background
+///
+class StudyPrefetcher
+{
+public:
+
+    /// Number of prefetch threads
+    static const int NUM_THREADS = 2;
+
+    /// Maximum number of studies queued for prefetch, over all sessions
+    static const int MAX_QUEUED_STUDIES = 256;
+
+    ///
+    /// Get the process-wide prefetcher instance
+    ///
+    static StudyPrefetcher& instance();
+
+    ///
+    /// Get a new id for a client, whose prefetches replace each other
+    ///
+    int newClientId();
+
+    ///
+    /// Prefetch the metadata of studies, replacing the client's earlier prefetch.
+    /// Studies that do not fit in the queue are not prefetched.
+    /// \param clientId Id of the client
+    /// \param scanDirs Full paths of the study directories, most likely needed first
+    ///
+    void prefetch(int clientId, const std::vector<std::string>& scanDirs);
+
+    ///
+    /// Cancel the client's prefetch and forget the client
+    ///
+    void removeClient(int clientId);
+
+private:
+
+    ///
+    /// Constructor
+    ///
+    StudyPrefetcher();
+
+    ///
+    /// Destructor
+    ///
+    virtual ~StudyPrefetcher();
+
+    /// Study waiting to be prefetched
+    typedef struct
+    {
+        /// Client that asked for it
+        int mClientId;
+
+        /// Prefetch of the client it belongs to
+        int mGeneration;
+
+        /// Study directory
+        std::string mScanDir;
+
+    } PrefetchItem;
+
+    ///
+    /// Prefetch studies (prefetch thread)
+    ///
+    void runWorker();
+
+    ///
+    /// Read the metadata of a study into the cache, stopping early if the prefetch
+    /// is replaced (prefetch thread)
+    ///
+    void prefetchStudy(const PrefetchItem& item);
+
+    ///
+    /// Get whether an item still belongs to its client's current prefetch
+    ///
+    bool isCurrent(const PrefetchItem& item);
+
+    /// Studies waiting to be prefetched, in order
+    std::deque<PrefetchItem> mQueue;
+
+    /// Current prefetch of each client
+    std::map<int, int> mGenerations;
+
+    /// Next client id
+    int mNextClientId;
+
+    /// Mutex protecting all of the above
+    boost::mutex mMutex;
+
+    /// Signalled when a study is queued
+    boost::condition mWorkCondition;
+};
+
+#endif // STUDYPREFETCHER_H
@@ -19,6 +19,7 @@
 #include "ConfigXML.h"
 #include "SubmitJobDialog.h"
 #include "MRIBrowser.h"
+#include "ClusterJobSubmitQueue.h"
 #include <Wt/WApplication>
 #include <Wt/WLogger>
 #include <Wt/WContainerWidget>
@@ -31,14 +32,13 @@
 #include <Wt/WDate>
 #include <Wt/WImage>
 #include <signal.h>
-#include <boost/process/process.hpp>
-#include <boost/process/child.hpp>
-#include <boost/process/launch_shell.hpp>
 #include <boost/filesystem.hpp>
+#include <boost/bind.hpp>
 #include <sys/time.h>
 #include <stdlib.h>
 #include <fstream>
 #include <iostream>
+#include <sstream>
 #include <string>
 #include <stdlib.h>
 #include <ctime>
@@ -50,7 +50,6 @@
 using namespace Wt;
 using namespace std;
 using namespace boost::filesystem;
-using namespace boost::processes;
 
 ///////////////////////////////////////////////////////////////////////////////
 //
@@ -62,7 +61,9 @@ using namespace boost::processes;
 //  Constructor
 //
 SubjectPage::SubjectPage(WContainerWidget *parent) :
-    WContainerWidget(parent)
+    WContainerWidget(parent),
+    mSubmitPending(false),
+    mSelectionChanged(false)
 {
     setStyleClass("tabdiv");
 
@@ -140,6 +141,7 @@ SubjectPage::~SubjectPage()
 void SubjectPage::resetAll()
 {
     mSubjectState = SCAN_SELECT;
+    mSelectionChanged = true;
     mStackedStage->setCurrentIndex(0);
     mNextButton->disable();
     mBackButton->disable();
@@ -207,6 +209,8 @@ WText* SubjectPage::createTitle(const WString& title)
 //
 void SubjectPage::scanAdded(bool added)
 {
+    mSelectionChanged = true;
+
     if (mSubjectState == SCAN_SELECT)
     {
         if (added)
@@ -246,11 +250,23 @@ void SubjectPage::nextClicked()
         mPipelineConfigure->updateAll(mSelectScans);
         mSubjectState = PIPELINE_CONFIGURE;
         mNextButton->setText("Finish");
+
+        // Finish again once the pending submission is done
+        if (mSubmitPending)
+        {
+            mNextButton->disable();
+        }
         break;
 
     case PIPELINE_CONFIGURE:
     default:
 
+        // One submission at a time, the scans would be enqueued twice
+        if (mSubmitPending)
+        {
+            return;
+        }
+
         // Make sure the input validates before submitting
         if (!mPipelineConfigure->validate())
         {
@@ -277,6 +293,7 @@ void SubjectPage::backClicked()
 
     case PIPELINE_CONFIGURE:
     default:
+        mSelectionChanged = true;
         mStackedStage->setCurrentIndex((int)SCAN_SELECT);
         mSubjectState = SCAN_SELECT;
         mBackButton->disable();
@@ -287,46 +304,22 @@ void SubjectPage::backClicked()
 }
 
 ///
-//  Submit scans for processing.  This function will generate the file and
-//  execute pl_batch.bash on it to put it into the processing queue.
+//  Submit scans for processing.  This function will generate the runs of the
+//  batch file and queue them to be put into the processing queue by pl_batch.bash.
 //
-bool SubjectPage::submitForProcessing(const std::string& pipelineCommandLineString)
+void SubjectPage::submitForProcessing(const std::string& pipelineCommandLineString)
 {
-    char *tmpName = strdup("/tmp/pl_gui_tmpXXXXXX");
-
-    if (mkstemp(tmpName) == -1)
-    {
-        WApplication::instance()->log("error") << "Error creating file on server: " << tmpName;
-        mMessageBox->setWindowTitle("ERROR");
-        mMessageBox->setText(string("Error creating file on server: ") + string(tmpName));
-        mMessageBox->setButtons(Wt::Ok);
-        mMessageBox->show();
-        free(tmpName);
-
-        return false;
-    }
-
-    // Open temporary file for writing
-    ofstream tmpFile(tmpName, ios::out);
-
-    if (!tmpFile.is_open())
-    {
-
-        WApplication::instance()->log("error") << "Error opening file on server: " << tmpName;
-        mMessageBox->setWindowTitle("ERROR");
-        mMessageBox->setText(string("Error creating file on server: ") + string(tmpName));
-        mMessageBox->setButtons(Wt::Ok);
-        mMessageBox->show();
-
-        free(tmpName);
-
-        return false;
-    }
+    ClusterJobSubmitQueue::Submission submission;
 
     // plBatch_create outputs command line options and then a list
     // of files to process
-    tmpFile << "DEFAULTCOM = " << pipelineCommandLineString << endl;
-    tmpFile << "DEFAULTDIR = " << getConfigOptionsPtr()->GetDicomDir() << endl;
+    submission.mUser = getCurrentUserName();
+    submission.mPipelineType = mSelectScans->getCurrentPipelineAsString();
+    submission.mCommandLine = pipelineCommandLineString;
+    submission.mDicomDir = getConfigOptionsPtr()->GetDicomDir();
+    submission.mPackageDir = getConfigOptionsPtr()->GetPackageDir();
+    submission.mScriptDir = getConfigOptionsPtr()->GetScriptDir();
+    submission.mClusterDir = getConfigOptionsPtr()->GetClusterDir();
 
     std::string curDate = (WDate::currentDate().toString("yyyyMMdd")).toUTF8();
 
@@ -362,7 +355,8 @@ bool SubjectPage::submitForProcessing(const std::string& pipelineCommandLineStri
         clock_gettime(CLOCK_REALTIME, &timeSpec);
 
 
-        tmpFile << path(scansToProcess[i].mScanDir).leaf().string() << ";"
+        std::ostringstream run;
+        run << path(scansToProcess[i].mScanDir).leaf().string() << ";"
                 << scansToProcess[i].mDicomFile << ";"
                 << "-" << date << "_" << age << "-" << curDate << "-" << timeSpec.tv_sec << timeSpec.tv_nsec << "-" << mPipelineConfigure->getOutputFileSuffix() << ";"
                 << "-" << date << "_" << age << "-" << curDate << "-" << timeSpec.tv_sec << timeSpec.tv_nsec << "-" << mPipelineConfigure->getOutputDirSuffix();
@@ -375,93 +369,26 @@ bool SubjectPage::submitForProcessing(const std::string& pipelineCommandLineStri
         const std::vector<ConfigXML::InputNode>* inputList = getConfigXMLPtr()->getPipelineInputs(pipelineString + "_meta.bash");
         if (inputList != NULL)
         {
-            tmpFile << ";";
+            run << ";";
             for (int arg = 1; arg < inputList->size(); arg++)
             {
                 const std::vector<ScansToProcessTable::ScanData>& curArgScansToProcess = mSelectScans->getScansToProcess(arg);
                 const ConfigXML::InputNode &inputNode = (*inputList)[arg];
 
                 // Use ':' for ' ', pl_batch.bash will do the subsitution back to spaces.
-                tmpFile << ":" << inputNode.mArg << ":" << curArgScansToProcess[i].mDicomFile;
-            }
-        }
-
-        tmpFile << endl;
-
-    }
-    tmpFile.close();
-
-    // Get the number of lines in the current log file
-    std::string scheduleFileName;
-    scheduleFileName = getConfigOptionsPtr()->GetClusterDir() + "/schedule.log";
-    int scheduleLines = getNumberOfLines(scheduleFileName.c_str());
-
-    // Now run pl_batch.bash to queue up into the schedule
-    std::string packageDir = getConfigOptionsPtr()->GetPackageDir();
-    std::string scriptDir = getConfigOptionsPtr()->GetScriptDir();
-    std::string commandArgs;
-
-    // Create the following command line args for running pl_batch
-    //  -v 10 -t <tmpfile> -T <pipelineType>
-    commandArgs = "\"-v 10 -t " + path(string(tmpName)).leaf().string() + " -T ";
-    commandArgs += mSelectScans->getCurrentPipelineAsString();
-    commandArgs += "\"";
-
-    std::string cmdToExecute;
-    cmdToExecute = scriptDir + "/pl_batch_web.bash " + packageDir + " " + scriptDir + " ";
-    cmdToExecute += commandArgs + " /tmp " + tmpName;
-
-    WApplication::instance()->log("info") << "EXEC: " << cmdToExecute;
-
-    context ctx;
-    child c = launch_shell(cmdToExecute.c_str(), ctx);
-    boost::processes::status s = c.wait();
-    WApplication::instance()->log("info") << "EXIT STATUS: " << s.exit_status();
-
-    int newScheduleLines = getNumberOfLines(scheduleFileName.c_str());
-
-    if ((newScheduleLines - scheduleLines) != scansToProcess.size())
-    {
-        WApplication::instance()->log("error") << "New lines: " << newScheduleLines << " Old lines: " << scheduleLines
-                                               << "Scans to process: " << scansToProcess.size();
-        mMessageBox->setWindowTitle("ERROR");
-        mMessageBox->setText(string("Error occurred in adding files to cluster schedule."));
-        mMessageBox->setButtons(Wt::Ok);
-        mMessageBox->show();
-
-        free(tmpName);
-        return false;
-    }
-
-    free(tmpName);
-    return true;
-}
-
-///
-//  Return the number of lines in a file
-//
-int SubjectPage::getNumberOfLines(const char *fileName)
-{
-    int lineCount = 0;
-    ifstream ifs(fileName, ios::in);
-
-    if (ifs.is_open())
-    {
-        while (!ifs.eof())
-        {
-            char buf[1024] = {0};
-            ifs.getline( buf, sizeof(buf));
-
-            if(strlen(buf) > 2)
-            {
-                lineCount++;
+                run << ":" << inputNode.mArg << ":" << curArgScansToProcess[i].mDicomFile;
             }
         }
 
-        ifs.close();
+        submission.mRuns.push_back(run.str());
     }
 
-    return lineCount;
+    // Run off the event loop, progress comes back by server push
+    mSubmitPending = true;
+    mSelectionChanged = false;
+    mNextButton->disable();
+    ClusterJobSubmitQueue::instance().enqueue(mIOClient.getApp(), mIOClient.getClientId(), submission,
+                                              boost::bind(&SubjectPage::submitProgress, this, _1));
 }
 
 ///
@@ -478,31 +405,65 @@ void SubjectPage::handleMessageBoxFinished(StandardButton)
 void SubjectPage::handleSubmitScans(WDialog::DialogCode dialogCode)
 {
     mSubmitJobDialog->hide();
-    if (dialogCode == WDialog::Accepted)
+    if (dialogCode == WDialog::Accepted && !mSubmitPending)
+    {
+        submitForProcessing(mSubmitJobDialog->getCommandLine());
+
+        mMessageBox->setWindowTitle("Submitting");
+        mMessageBox->setText("Submitting jobs to the cluster...");
+        mMessageBox->setButtons(Wt::Ok);
+        mMessageBox->show();
+    }
+}
+
+///
+//  Submission progress [IOExecutor callback]
+//
+void SubjectPage::submitProgress(const ClusterJobSubmitQueue::Progress& progress)
+{
+    switch (progress.mState)
     {
-        if(submitForProcessing(mSubmitJobDialog->getCommandLine()))
+    case ClusterJobSubmitQueue::SUBMIT_QUEUED:
         {
-            std::string logEntriesToDisplay;
-            std::string scheduleFileName = getConfigOptionsPtr()->GetClusterDir() + "/schedule.log";
+            std::ostringstream text;
+            text << "Waiting to submit jobs to the cluster (" << progress.mNumAhead << " submissions ahead)...";
+            mMessageBox->setText(text.str());
+        }
+        break;
+
+    case ClusterJobSubmitQueue::SUBMIT_RUNNING:
+        WApplication::instance()->log("info") << "EXEC: " << progress.mCommand;
+        mMessageBox->setText("Submitting jobs to the cluster...");
+        break;
+
+    case ClusterJobSubmitQueue::SUBMIT_FAILED:
+        submitDone();
+        WApplication::instance()->log("info") << "EXIT STATUS: " << progress.mResult.mExitStatus;
+        WApplication::instance()->log("error") << progress.mError;
+        mMessageBox->setWindowTitle("ERROR");
+        mMessageBox->setText(string("Error occurred in adding files to cluster schedule."));
+        mMessageBox->setButtons(Wt::Ok);
+        mMessageBox->show();
+        break;
 
-            ifstream ifs(scheduleFileName.c_str(), ios::in);
+    case ClusterJobSubmitQueue::SUBMIT_SUCCEEDED:
+    default:
+        {
+            submitDone();
+            WApplication::instance()->log("info") << "EXIT STATUS: " << progress.mResult.mExitStatus;
 
-            int linesInFile = getNumberOfLines(scheduleFileName.c_str());
-            int linesToRead = mSelectScans->getScansToProcess(0).size();
-            int startLine = (linesInFile - linesToRead) + 1;
-            int line = 0;
+            for (size_t i = 0; i < progress.mResult.mJobs.size(); i++)
+            {
+                WApplication::instance()->log("info") << "Submitted job " << progress.mResult.mJobs[i].mJobId
+                                                      << " MRID: " << progress.mResult.mJobs[i].mMRID
+                                                      << " Pipeline: " << progress.mResult.mJobs[i].mPipeline;
+            }
 
-            while (!ifs.eof())
+            std::string logEntriesToDisplay;
+            for (size_t i = 0; i < progress.mResult.mLogEntries.size(); i++)
             {
-                char buf[1024] = {0};
-                ifs.getline( buf, sizeof(buf));
-                line++;
-                if (line >= startLine)
-                {
-                    logEntriesToDisplay += string(buf) + "<br/>";
-                }
+                logEntriesToDisplay += progress.mResult.mLogEntries[i] + "<br/>";
             }
-            ifs.close();
 
             mMessageBox->setWindowTitle("Success");
             mMessageBox->setText("The following jobs were submitted successfully:<br/>" +
@@ -510,11 +471,26 @@ void SubjectPage::handleSubmitScans(WDialog::DialogCode dialogCode)
             mMessageBox->setButtons(Wt::Ok);
             mMessageBox->show();
 
-            // Reset everything to the default state
-            resetAll();
-
-
+            // Reset everything to the default state, unless the user went on
+            // to select something else while the jobs were submitted
+            if (!mSelectionChanged)
+            {
+                resetAll();
+            }
         }
+        break;
+    }
+}
+
+///
+//  Allow submitting again once a submission is done
+//
+void SubjectPage::submitDone()
+{
+    mSubmitPending = false;
+    if (mSubjectState == PIPELINE_CONFIGURE)
+    {
+        mNextButton->enable();
     }
 }
 
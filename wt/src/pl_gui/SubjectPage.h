@@ -18,6 +18,8 @@
 #include <Wt/WString>
 #include <Wt/WText>
 #include <Wt/WDialog>
+#include "ClusterJobSubmitQueue.h"
+#include "IOClient.h"
 #include <string>
 
 namespace Wt
@@ -111,15 +113,20 @@ private:
     void backClicked();
 
     ///
-    ///  Submit scans for processing.  This function will generate the file and
-    ///  execute pl_batch.bash on it to put it into the processing queue.
+    ///  Submit scans for processing.  This function will generate the runs of the
+    ///  batch file and queue them to be put into the processing queue by pl_batch.bash.
     ///
-    bool submitForProcessing(const std::string& pipelineCommandLineString);
+    void submitForProcessing(const std::string& pipelineCommandLineString);
 
     ///
-    ///  Return the number of lines in a file
+    ///  Submission progress [IOExecutor callback]
     ///
-    int getNumberOfLines(const char *fileName);
+    void submitProgress(const ClusterJobSubmitQueue::Progress& progress);
+
+    ///
+    ///  Allow submitting again once a submission is done
+    ///
+    void submitDone();
 
     ///
     ///  Handle message box finished [slot]
@@ -146,6 +153,12 @@ private:
     /// Current state of widget
     SubjectState mSubjectState;
 
+    /// Whether a submission is queued or running, no other is made until it is done
+    bool mSubmitPending;
+
+    /// Whether the selection changed since the pending submission was made
+    bool mSelectionChanged;
+
     /// Stacked widget that holds the various stages
     WStackedWidget *mStackedStage;
 
@@ -172,6 +185,9 @@ private:
 
     /// Loading image
     WImage *mLoadingImage;
+
+    /// I/O client, progress of submissions is posted for it
+    IOClient mIOClient;
 };
 
 #endif // SUBJECTPAGE
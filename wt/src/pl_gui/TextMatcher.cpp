@@ -0,0 +1,128 @@
+//
+//
+//  Description:
+//      Implementation of the text matcher.  A search term compiled once into a case
+//      insensitive substring matcher (Boyer-Moore-Horspool over lowercase text)
+//      and, when the term contains regular expression syntax, a whole-string
+//      regular expression.  This is the match the results search box has always
+//      done, without rebuilding anything per row or per field.
+//
+//  Author:
+//      Dan Ginsburg
+//
+//  Children's Hospital Boston
+//  GPL v2
+//
+#include "TextMatcher.h"
+#include "MRIDTextIndex.h"
+#include <ctype.h>
+#include <string.h>
+
+///
+//  Namespaces
+//
+using namespace std;
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Constructor/Destructor
+//
+//
+
+///
+//  Constructor
+//
+TextMatcher::TextMatcher(const std::string& term) :
+    mLowerTerm(term),
+    mHasRegExp(false)
+{
+    if (!mLowerTerm.empty())
+    {
+        toLower(&mLowerTerm[0], &mLowerTerm[0] + mLowerTerm.size());
+    }
+
+    // Horspool shift table: a character not in the term (but the last) shifts
+    // the whole term length
+    int length = (int)mLowerTerm.size();
+    for (int c = 0; c < 256; c++)
+    {
+        mShift[c] = length;
+    }
+    for (int i = 0; i + 1 < length; i++)
+    {
+        mShift[(unsigned char)mLowerTerm[i]] = length - 1 - i;
+    }
+
+    if (MRIDTextIndex::isRegExp(term))
+    {
+        try
+        {
+            mRegExp.assign(term);
+            mHasRegExp = true;
+        }
+        catch (boost::regex_error&)
+        {
+            mHasRegExp = false;
+        }
+    }
+}
+
+///
+//  Destructor
+//
+TextMatcher::~TextMatcher()
+{
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Public Members
+//
+//
+
+///
+//  Find the first occurrence of the term in lowercase text
+//
+const char* TextMatcher::find(const char* begin, const char* end) const
+{
+    int length = (int)mLowerTerm.size();
+    if (length == 0)
+    {
+        return begin;
+    }
+
+    const char *term = mLowerTerm.data();
+    const char last = term[length - 1];
+
+    for (const char *pos = begin; end - pos >= length; )
+    {
+        char c = pos[length - 1];
+        if (c == last && memcmp(pos, term, length - 1) == 0)
+        {
+            return pos;
+        }
+
+        pos += mShift[(unsigned char)c];
+    }
+
+    return NULL;
+}
+
+///
+//  Get whether the regular expression matches the whole of a string
+//
+bool TextMatcher::regExpMatch(const char *str) const
+{
+    return mHasRegExp && boost::regex_match(str, mRegExp);
+}
+
+///
+//  Lowercase a string in place
+//
+void TextMatcher::toLower(char *begin, char *end)
+{
+    for (char *c = begin; c != end; c++)
+    {
+        *c = (char)tolower((unsigned char)*c);
+    }
+}
@@ -0,0 +1,79 @@
+//
+//
+//  Description:
+//      Definition of the text matcher.  A search term compiled once into a case
+//      insensitive substring matcher (Boyer-Moore-Horspool over lowercase text)
+//      and, when the term contains regular expression syntax, a whole-string
+//      regular expression.  This is the match the results search box has always
+//      done, without rebuilding anything per row or per field.
+//
+//  Author:
+//      Dan Ginsburg
+//
+//  Children's Hospital Boston
+//  GPL v2
+//
+#ifndef TEXTMATCHER_H
+#define TEXTMATCHER_H
+
+#include <boost/regex.hpp>
+#include <string>
+
+///
+/// \class TextMatcher
+/// \brief Compiled case insensitive substring / whole-string regular expression matcher
+///
+class TextMatcher
+{
+public:
+
+    ///
+    /// Constructor
+    /// \param term Search term
+    ///
+    TextMatcher(const std::string& term);
+
+    ///
+    /// Destructor
+    ///
+    virtual ~TextMatcher();
+
+    ///
+    /// Find the first occurrence of the term in lowercase text
+    /// \param begin Start of the lowercase text
+    /// \param end End of the lowercase text
+    /// \return Start of the occurrence, or NULL if there is none
+    ///
+    const char* find(const char* begin, const char* end) const;
+
+    ///
+    /// Get whether the term is matched as a regular expression as well
+    ///
+    bool hasRegExp() const                  {   return mHasRegExp;  }
+
+    ///
+    /// Get whether the regular expression matches the whole of a string
+    ///
+    bool regExpMatch(const char *str) const;
+
+    ///
+    /// Lowercase a string in place, the way the text searched by find() must be
+    ///
+    static void toLower(char *begin, char *end);
+
+private:
+
+    /// Lowercase term
+    std::string mLowerTerm;
+
+    /// Distance to shift for the text character under the last term character
+    int mShift[256];
+
+    /// Term is a valid regular expression
+    bool mHasRegExp;
+
+    /// Term as a regular expression
+    boost::regex mRegExp;
+};
+
+#endif // TEXTMATCHER_H
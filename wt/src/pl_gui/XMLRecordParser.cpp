@@ -0,0 +1,628 @@
+//
+//
+//  Description:
+//      Implementation of the XML record parser.  Reads files made of a long run of
+//      flat, like-named records (the <PatientRecord> elements of dcm_MRID.xml and the
+//      <ClusterJob> elements of schedule.log.xml) without building a DOM.  The file
+//      is mapped into memory and split at the record boundaries, and the records are
+//      scanned in parallel.  Element names and text are returned as pointers into the
+//      mapped file, so the only copies made are the ones the caller keeps.
+//
+//      The files are written by the scheduler and DICOM listener, which append to them
+//      or replace them.  A file replaced while it is mapped stays readable until it is
+//      unmapped.
+//
+//  Author:
+//      Dan Ginsburg
+//
+//  Children's Hospital Boston
+//  GPL v2
+//
+#include "XMLRecordParser.h"
+#include <boost/thread/thread.hpp>
+#include <boost/bind.hpp>
+#include <algorithm>
+#include <deque>
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+///
+//  Namespaces
+//
+using namespace std;
+
+// Below these a thread costs more to start than it saves
+static const boost::uint64_t MIN_BYTES_PER_THREAD = 1 << 20;
+static const size_t MIN_RECORDS_PER_THREAD = 256;
+
+const size_t XMLRecordParser::RECORDS_PER_PASS;
+
+///
+//  Find the first occurrence of a string in a buffer
+//
+static const char* findText(const char *data, const char *end, const char *text, size_t textLength)
+{
+    while (data + textLength <= end)
+    {
+        data = (const char*)memchr(data, text[0], end - data - textLength + 1);
+        if (data == NULL)
+        {
+            return NULL;
+        }
+
+        if (memcmp(data, text, textLength) == 0)
+        {
+            return data;
+        }
+
+        data++;
+    }
+
+    return NULL;
+}
+
+///
+//  Append a code point to a string as UTF-8
+//
+static void appendUTF8(std::string& str, unsigned long codePoint)
+{
+    if (codePoint < 0x80)
+    {
+        str += (char)codePoint;
+    }
+    else if (codePoint < 0x800)
+    {
+        str += (char)(0xC0 | (codePoint >> 6));
+        str += (char)(0x80 | (codePoint & 0x3F));
+    }
+    else if (codePoint < 0x10000)
+    {
+        str += (char)(0xE0 | (codePoint >> 12));
+        str += (char)(0x80 | ((codePoint >> 6) & 0x3F));
+        str += (char)(0x80 | (codePoint & 0x3F));
+    }
+    else
+    {
+        str += (char)(0xF0 | (codePoint >> 18));
+        str += (char)(0x80 | ((codePoint >> 12) & 0x3F));
+        str += (char)(0x80 | ((codePoint >> 6) & 0x3F));
+        str += (char)(0x80 | (codePoint & 0x3F));
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Constructor/Destructor
+//
+//
+
+///
+//  Constructor
+//
+XMLRecordParser::XMLRecordParser(const std::string& recordTag) :
+    mRecordTag(recordTag),
+    mData(NULL),
+    mSize(0),
+    mFirstRecord(0),
+    mNumRecords(0),
+    mRecordsPerChunk(1)
+{
+}
+
+///
+//  Destructor
+//
+XMLRecordParser::~XMLRecordParser()
+{
+    unmapFile();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Public Members
+//
+//
+
+///
+//  Map a file into memory
+//
+bool XMLRecordParser::mapFile(const std::string& fileName)
+{
+    unmapFile();
+
+    int fd = open(fileName.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        return false;
+    }
+
+    struct stat fileStat;
+    if (fstat(fd, &fileStat) != 0)
+    {
+        close(fd);
+        return false;
+    }
+
+    // An empty file cannot be mapped, it simply has no records
+    if (fileStat.st_size > 0)
+    {
+        void *data = mmap(NULL, (size_t)fileStat.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        if (data == MAP_FAILED)
+        {
+            close(fd);
+            return false;
+        }
+
+        // Every page is about to be read, by several threads at once
+        madvise(data, (size_t)fileStat.st_size, MADV_WILLNEED);
+
+        mData = (const char*)data;
+        mSize = (boost::uint64_t)fileStat.st_size;
+    }
+
+    close(fd);
+
+    return true;
+}
+
+///
+//  Find every record in the mapped file
+//
+bool XMLRecordParser::findRecords(std::vector<Record>& records, boost::uint64_t startOffset) const
+{
+    records.clear();
+
+    if (startOffset >= mSize)
+    {
+        return true;
+    }
+
+    // Each thread takes the records that begin within its share of the file.  A
+    // record that runs past the end of a share is still read whole by the thread
+    // that found its begin tag.
+    boost::uint64_t length = mSize - startOffset;
+    int numThreads = getNumThreads((size_t)(length / MIN_BYTES_PER_THREAD), 1);
+    boost::uint64_t rangeLength = (length + numThreads - 1) / numThreads;
+
+    if (numThreads == 1)
+    {
+        bool truncated = false;
+        findRecordsInRange(startOffset, mSize, &records, &truncated);
+        return !truncated;
+    }
+
+    std::vector< std::vector<Record> > rangeRecords(numThreads);
+    std::deque<bool> rangeTruncated(numThreads, false);
+
+    boost::thread_group threads;
+    for (int i = 0; i < numThreads; i++)
+    {
+        boost::uint64_t begin = startOffset + i * rangeLength;
+        boost::uint64_t end = std::min(begin + rangeLength, mSize);
+
+        threads.create_thread(boost::bind(&XMLRecordParser::findRecordsInRange, this, begin, end,
+                                          &rangeRecords[i], &rangeTruncated[i]));
+    }
+    threads.join_all();
+
+    // Merge in file order
+    size_t numRecords = 0;
+    for (int i = 0; i < numThreads; i++)
+    {
+        numRecords += rangeRecords[i].size();
+    }
+    records.reserve(numRecords);
+
+    bool truncated = false;
+    for (int i = 0; i < numThreads; i++)
+    {
+        records.insert(records.end(), rangeRecords[i].begin(), rangeRecords[i].end());
+        std::vector<Record>().swap(rangeRecords[i]);
+        truncated = truncated || rangeTruncated[i];
+    }
+
+    return !truncated;
+}
+
+///
+//  Parse a range of records
+//
+void XMLRecordParser::parseRecords(const std::vector<Record>& records, size_t first, size_t count)
+{
+    mFirstRecord = first;
+    mNumRecords = count;
+
+    int numThreads = getNumThreads(count, MIN_RECORDS_PER_THREAD);
+    mRecordsPerChunk = std::max((count + numThreads - 1) / numThreads, (size_t)1);
+
+    size_t numChunks = (count + mRecordsPerChunk - 1) / mRecordsPerChunk;
+    mChunks.resize(numChunks);
+
+    if (numChunks == 1)
+    {
+        parseChunk(&records, first, count, &mChunks[0]);
+        return;
+    }
+
+    boost::thread_group threads;
+    for (size_t chunk = 0; chunk < numChunks; chunk++)
+    {
+        size_t chunkFirst = chunk * mRecordsPerChunk;
+        size_t chunkCount = std::min(mRecordsPerChunk, count - chunkFirst);
+
+        threads.create_thread(boost::bind(&XMLRecordParser::parseChunk, this, &records,
+                                          first + chunkFirst, chunkCount, &mChunks[chunk]));
+    }
+    threads.join_all();
+}
+
+///
+//  Get whether a parsed record was well formed
+//
+bool XMLRecordParser::isRecordValid(size_t record) const
+{
+    size_t chunkRecord;
+    const Chunk& chunk = getChunk(record, chunkRecord);
+
+    return chunk.mValid[chunkRecord] != 0;
+}
+
+///
+//  Get the number of leaf elements of a parsed record
+//
+int XMLRecordParser::getNumElements(size_t record) const
+{
+    size_t chunkRecord;
+    const Chunk& chunk = getChunk(record, chunkRecord);
+
+    return chunk.mElementOffsets[chunkRecord + 1] - chunk.mElementOffsets[chunkRecord];
+}
+
+///
+//  Get a leaf element of a parsed record
+//
+const XMLRecordParser::Element& XMLRecordParser::getElement(size_t record, int index) const
+{
+    size_t chunkRecord;
+    const Chunk& chunk = getChunk(record, chunkRecord);
+
+    return chunk.mElements[chunk.mElementOffsets[chunkRecord] + index];
+}
+
+///
+//  Find the first leaf element of a parsed record with the given name
+//
+const XMLRecordParser::Element* XMLRecordParser::findElement(size_t record, const char *name) const
+{
+    size_t chunkRecord;
+    const Chunk& chunk = getChunk(record, chunkRecord);
+    size_t nameLength = strlen(name);
+
+    for (int i = chunk.mElementOffsets[chunkRecord]; i < chunk.mElementOffsets[chunkRecord + 1]; i++)
+    {
+        if (isElementNamed(chunk.mElements[i], name, nameLength))
+        {
+            return &chunk.mElements[i];
+        }
+    }
+
+    return NULL;
+}
+
+///
+//  Get whether an element has the given name
+//
+bool XMLRecordParser::isElementNamed(const Element& element, const char *name, size_t nameLength)
+{
+    return (size_t)element.mNameLength == nameLength &&
+           memcmp(element.mName, name, nameLength) == 0;
+}
+
+///
+//  Get the text of an element with entities decoded
+//
+std::string XMLRecordParser::getText(const Element& element)
+{
+    if (!element.mHasEntities)
+    {
+        return std::string(element.mText, element.mTextLength);
+    }
+
+    std::string text;
+    text.reserve(element.mTextLength);
+
+    const char *pos = element.mText;
+    const char *end = element.mText + element.mTextLength;
+    while (pos < end)
+    {
+        const char *semicolon = NULL;
+        if (*pos == '&')
+        {
+            semicolon = (const char*)memchr(pos, ';', std::min(end - pos, (ptrdiff_t)12));
+        }
+
+        if (semicolon == NULL)
+        {
+            text += *pos++;
+            continue;
+        }
+
+        std::string entity(pos + 1, semicolon);
+        if (entity == "amp")         text += '&';
+        else if (entity == "lt")     text += '<';
+        else if (entity == "gt")     text += '>';
+        else if (entity == "quot")   text += '"';
+        else if (entity == "apos")   text += '\'';
+        else if (entity.size() > 1 && entity[0] == '#')
+        {
+            unsigned long codePoint = (entity[1] == 'x' || entity[1] == 'X') ?
+                                      strtoul(entity.c_str() + 2, NULL, 16) :
+                                      strtoul(entity.c_str() + 1, NULL, 10);
+            appendUTF8(text, codePoint);
+        }
+        else
+        {
+            // Unknown entity, keep it as written
+            text.append(pos, semicolon + 1);
+        }
+
+        pos = semicolon + 1;
+    }
+
+    return text;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Private Members
+//
+//
+
+///
+//  Unmap the mapped file
+//
+void XMLRecordParser::unmapFile()
+{
+    if (mData != NULL)
+    {
+        munmap((void*)mData, (size_t)mSize);
+        mData = NULL;
+    }
+
+    mSize = 0;
+    mChunks.clear();
+    mNumRecords = 0;
+}
+
+///
+//  Get the number of threads to use for a number of work items
+//
+int XMLRecordParser::getNumThreads(size_t numItems, size_t minItemsPerThread)
+{
+    size_t numThreads = std::max(boost::thread::hardware_concurrency(), 1u);
+    size_t maxThreads = std::max(numItems / minItemsPerThread, (size_t)1);
+
+    return (int)std::min(numThreads, maxThreads);
+}
+
+///
+//  Find the records that begin within a range of the file (worker thread)
+//
+void XMLRecordParser::findRecordsInRange(boost::uint64_t begin, boost::uint64_t end,
+                                         std::vector<Record> *records, bool *truncated) const
+{
+    const std::string beginTag = "<" + mRecordTag;
+    const std::string endTag = "</" + mRecordTag + ">";
+
+    const char *fileEnd = mData + mSize;
+    const char *pos = mData + begin;
+
+    while ((pos = findText(pos, fileEnd, beginTag.c_str(), beginTag.size())) != NULL &&
+           pos < mData + end)
+    {
+        // Make sure this is the record tag and not a longer tag name
+        const char *tagEnd = pos + beginTag.size();
+        if (tagEnd >= fileEnd || (*tagEnd != '>' && !isspace((unsigned char)*tagEnd)))
+        {
+            pos = tagEnd;
+            continue;
+        }
+
+        const char *recordEnd = findText(tagEnd, fileEnd, endTag.c_str(), endTag.size());
+        if (recordEnd == NULL)
+        {
+            *truncated = true;
+            break;
+        }
+        recordEnd += endTag.size();
+
+        Record record;
+        record.mOffset = (boost::uint64_t)(pos - mData);
+        record.mLength = (boost::uint64_t)(recordEnd - pos);
+        record.mHash = hashRecord(pos, (size_t)record.mLength);
+        records->push_back(record);
+
+        pos = recordEnd;
+    }
+}
+
+///
+//  Parse a block of records into a chunk (worker thread)
+//
+void XMLRecordParser::parseChunk(const std::vector<Record> *records, size_t first, size_t count, Chunk *chunk) const
+{
+    chunk->mElements.clear();
+    chunk->mElementOffsets.clear();
+    chunk->mValid.clear();
+
+    for (size_t i = first; i < first + count; i++)
+    {
+        const Record& record = (*records)[i];
+        int elementOffset = (int)chunk->mElements.size();
+        chunk->mElementOffsets.push_back(elementOffset);
+
+        bool valid = parseRecord(mData + record.mOffset, (size_t)record.mLength, chunk->mElements);
+        if (!valid)
+        {
+            chunk->mElements.resize(elementOffset);
+        }
+        chunk->mValid.push_back(valid ? 1 : 0);
+    }
+
+    chunk->mElementOffsets.push_back((int)chunk->mElements.size());
+}
+
+///
+//  Scan the leaf elements of a single record
+//
+bool XMLRecordParser::parseRecord(const char *text, size_t length, std::vector<Element>& elements)
+{
+    const char *end = text + length;
+    const char *pos = text;
+
+    while ((pos = (const char*)memchr(pos, '<', end - pos)) != NULL)
+    {
+        const char *markupEnd;
+
+        if (end - pos >= 4 && memcmp(pos, "<!--", 4) == 0)
+        {
+            markupEnd = findText(pos + 4, end, "-->", 3);
+            if (markupEnd == NULL)
+            {
+                return false;
+            }
+            pos = markupEnd + 3;
+            continue;
+        }
+
+        if (end - pos >= 9 && memcmp(pos, "<![CDATA[", 9) == 0)
+        {
+            markupEnd = findText(pos + 9, end, "]]>", 3);
+            if (markupEnd == NULL)
+            {
+                return false;
+            }
+            pos = markupEnd + 3;
+            continue;
+        }
+
+        // End tags, processing instructions and declarations carry no data
+        if (pos + 1 < end && (pos[1] == '/' || pos[1] == '?' || pos[1] == '!'))
+        {
+            markupEnd = (const char*)memchr(pos, '>', end - pos);
+            if (markupEnd == NULL)
+            {
+                return false;
+            }
+            pos = markupEnd + 1;
+            continue;
+        }
+
+        // Start tag: read the name and skip any attributes
+        const char *name = pos + 1;
+        const char *nameEnd = name;
+        while (nameEnd < end && *nameEnd != '>' && *nameEnd != '/' && !isspace((unsigned char)*nameEnd))
+        {
+            nameEnd++;
+        }
+
+        if (nameEnd == name)
+        {
+            return false;
+        }
+
+        char quote = 0;
+        for (markupEnd = nameEnd; markupEnd < end; markupEnd++)
+        {
+            if (quote != 0)
+            {
+                if (*markupEnd == quote)
+                {
+                    quote = 0;
+                }
+            }
+            else if (*markupEnd == '"' || *markupEnd == '\'')
+            {
+                quote = *markupEnd;
+            }
+            else if (*markupEnd == '>')
+            {
+                break;
+            }
+        }
+
+        if (markupEnd == end)
+        {
+            return false;
+        }
+
+        // Empty element, <Name/>
+        if (markupEnd[-1] == '/')
+        {
+            pos = markupEnd + 1;
+            continue;
+        }
+
+        // A leaf element is text followed directly by its own end tag.  Empty
+        // elements are left out, as are elements with children.
+        const char *textBegin = markupEnd + 1;
+        const char *textEnd = (const char*)memchr(textBegin, '<', end - textBegin);
+        if (textEnd == NULL)
+        {
+            return false;
+        }
+
+        size_t nameLength = nameEnd - name;
+        const char *closeName = textEnd + 2;
+        if (textEnd > textBegin &&
+            closeName + nameLength < end &&
+            textEnd[1] == '/' &&
+            memcmp(closeName, name, nameLength) == 0 &&
+            (closeName[nameLength] == '>' || isspace((unsigned char)closeName[nameLength])))
+        {
+            Element element;
+            element.mName = name;
+            element.mNameLength = (int)nameLength;
+            element.mText = textBegin;
+            element.mTextLength = (int)(textEnd - textBegin);
+            element.mHasEntities = memchr(textBegin, '&', textEnd - textBegin) != NULL;
+            elements.push_back(element);
+        }
+
+        pos = textEnd;
+    }
+
+    return true;
+}
+
+///
+//  Find the chunk holding a parsed record
+//
+const XMLRecordParser::Chunk& XMLRecordParser::getChunk(size_t record, size_t& chunkRecord) const
+{
+    size_t index = record - mFirstRecord;
+    chunkRecord = index % mRecordsPerChunk;
+
+    return mChunks[index / mRecordsPerChunk];
+}
+
+///
+//  Hash the text of a record (64-bit FNV-1a)
+//
+boost::uint64_t XMLRecordParser::hashRecord(const char *text, size_t length)
+{
+    boost::uint64_t hash = 14695981039346656037ULL;
+
+    for (size_t i = 0; i < length; i++)
+    {
+        hash ^= (unsigned char)text[i];
+        hash *= 1099511628211ULL;
+    }
+
+    return hash;
+}
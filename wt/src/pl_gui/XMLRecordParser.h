@@ -0,0 +1,218 @@
+//
+//
+//  Description:
+//      Definition of the XML record parser.  Reads files made of a long run of flat,
+//      like-named records (the <PatientRecord> elements of dcm_MRID.xml and the
+//      <ClusterJob> elements of schedule.log.xml) without building a DOM.  The file
+//      is mapped into memory and split at the record boundaries, and the records are
+//      scanned in parallel.  Element names and text are returned as pointers into the
+//      mapped file, so the only copies made are the ones the caller keeps.
+//
+//  Author:
+//      Dan Ginsburg
+//
+//  Children's Hospital Boston
+//  GPL v2
+//
+#ifndef XMLRECORDPARSER_H
+#define XMLRECORDPARSER_H
+
+#include <boost/cstdint.hpp>
+#include <string>
+#include <vector>
+
+///
+/// \class XMLRecordParser
+/// \brief Zero-copy, multi-threaded parser for files of flat XML records
+///
+class XMLRecordParser
+{
+public:
+
+    /// Location of a record in the file
+    typedef struct
+    {
+        /// Offset of the record's begin tag
+        boost::uint64_t mOffset;
+
+        /// Length of the record, up to and including its end tag
+        boost::uint64_t mLength;
+
+        /// Hash of the record text, used to recognise unchanged records
+        boost::uint64_t mHash;
+
+    } Record;
+
+    /// Leaf element of a record, <Name>Text</Name>.  Both point into the file.
+    typedef struct
+    {
+        /// Element name
+        const char *mName;
+
+        /// Length of the element name
+        int mNameLength;
+
+        /// Raw element text, entities are not decoded
+        const char *mText;
+
+        /// Length of the raw element text
+        int mTextLength;
+
+        /// Whether the text contains entities and needs decoding
+        bool mHasEntities;
+
+    } Element;
+
+    /// Recommended number of records per call to parseRecords().  Bounds the memory
+    /// used by the parsed elements while leaving each thread enough work.
+    static const size_t RECORDS_PER_PASS = 16384;
+
+    ///
+    /// Constructor
+    /// \param recordTag Name of the record element, e.g. "PatientRecord"
+    ///
+    XMLRecordParser(const std::string& recordTag);
+
+    ///
+    /// Destructor
+    ///
+    virtual ~XMLRecordParser();
+
+    ///
+    /// Map a file into memory.  Any previously mapped file is unmapped.
+    /// \param fileName Full path to the file
+    /// \return true if the file could be opened, false otherwise
+    ///
+    bool mapFile(const std::string& fileName);
+
+    ///
+    /// Get the size of the mapped file
+    ///
+    boost::uint64_t getSize() const         { return mSize; }
+
+    ///
+    /// Find every record in the mapped file, in file order
+    /// \param records Filled with the records found
+    /// \param startOffset Offset to start looking from
+    /// \return false if the last record was truncated (the records before it are
+    ///         still returned), true otherwise
+    ///
+    bool findRecords(std::vector<Record>& records, boost::uint64_t startOffset = 0) const;
+
+    ///
+    /// Parse a range of records.  Only the most recently parsed range can be read
+    /// with the element accessors below.
+    /// \param records Records returned by findRecords()
+    /// \param first First record to parse
+    /// \param count Number of records to parse
+    ///
+    void parseRecords(const std::vector<Record>& records, size_t first, size_t count);
+
+    ///
+    /// Get whether a parsed record was well formed
+    /// \param record Index into the records passed to parseRecords()
+    ///
+    bool isRecordValid(size_t record) const;
+
+    ///
+    /// Get the number of leaf elements of a parsed record
+    ///
+    int getNumElements(size_t record) const;
+
+    ///
+    /// Get a leaf element of a parsed record, in document order
+    ///
+    const Element& getElement(size_t record, int index) const;
+
+    ///
+    /// Find the first leaf element of a parsed record with the given name
+    /// \return Element, or NULL if the record has no such element
+    ///
+    const Element* findElement(size_t record, const char *name) const;
+
+    ///
+    /// Get whether an element has the given name
+    ///
+    static bool isElementNamed(const Element& element, const char *name, size_t nameLength);
+
+    ///
+    /// Get the text of an element with entities decoded
+    ///
+    static std::string getText(const Element& element);
+
+private:
+
+    /// Elements of a contiguous block of parsed records, filled by one thread
+    typedef struct
+    {
+        /// Leaf elements of every record in the block
+        std::vector<Element> mElements;
+
+        /// Index of each record's first element in mElements, plus one past the end
+        std::vector<int> mElementOffsets;
+
+        /// Whether each record was well formed
+        std::vector<char> mValid;
+
+    } Chunk;
+
+    ///
+    /// Unmap the mapped file
+    ///
+    void unmapFile();
+
+    ///
+    /// Get the number of threads to use for a number of work items
+    ///
+    static int getNumThreads(size_t numItems, size_t minItemsPerThread);
+
+    ///
+    /// Find the records that begin within a range of the file (worker thread)
+    ///
+    void findRecordsInRange(boost::uint64_t begin, boost::uint64_t end,
+                            std::vector<Record> *records, bool *truncated) const;
+
+    ///
+    /// Parse a block of records into a chunk (worker thread)
+    ///
+    void parseChunk(const std::vector<Record> *records, size_t first, size_t count, Chunk *chunk) const;
+
+    ///
+    /// Scan the leaf elements of a single record
+    /// \return false if the record is not well formed
+    ///
+    static bool parseRecord(const char *text, size_t length, std::vector<Element>& elements);
+
+    ///
+    /// Find the chunk holding a parsed record and the record's index within it
+    ///
+    const Chunk& getChunk(size_t record, size_t& chunkRecord) const;
+
+    ///
+    /// Hash the text of a record (64-bit FNV-1a)
+    ///
+    static boost::uint64_t hashRecord(const char *text, size_t length);
+
+    /// Name of the record element
+    std::string mRecordTag;
+
+    /// Mapped file
+    const char *mData;
+
+    /// Size of the mapped file
+    boost::uint64_t mSize;
+
+    /// First record of the most recently parsed range
+    size_t mFirstRecord;
+
+    /// Number of records in the most recently parsed range
+    size_t mNumRecords;
+
+    /// Number of records in each chunk, the last one may hold fewer
+    size_t mRecordsPerChunk;
+
+    /// Parsed chunks of the most recently parsed range
+    std::vector<Chunk> mChunks;
+};
+
+#endif // XMLRECORDPARSER_H